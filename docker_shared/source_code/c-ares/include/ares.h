@@ -228,17 +228,18 @@ typedef enum {
 } ares_evsys_t;
 
 /* Flag values */
-#define ARES_FLAG_USEVC       (1 << 0)
-#define ARES_FLAG_PRIMARY     (1 << 1)
-#define ARES_FLAG_IGNTC       (1 << 2)
-#define ARES_FLAG_NORECURSE   (1 << 3)
-#define ARES_FLAG_STAYOPEN    (1 << 4)
-#define ARES_FLAG_NOSEARCH    (1 << 5)
-#define ARES_FLAG_NOALIASES   (1 << 6)
-#define ARES_FLAG_NOCHECKRESP (1 << 7)
-#define ARES_FLAG_EDNS        (1 << 8)
-#define ARES_FLAG_NO_DFLT_SVR (1 << 9)
-#define ARES_FLAG_DNS0x20     (1 << 10)
+#define ARES_FLAG_USEVC           (1 << 0)
+#define ARES_FLAG_PRIMARY         (1 << 1)
+#define ARES_FLAG_IGNTC           (1 << 2)
+#define ARES_FLAG_NORECURSE       (1 << 3)
+#define ARES_FLAG_STAYOPEN        (1 << 4)
+#define ARES_FLAG_NOSEARCH        (1 << 5)
+#define ARES_FLAG_NOALIASES       (1 << 6)
+#define ARES_FLAG_NOCHECKRESP     (1 << 7)
+#define ARES_FLAG_EDNS            (1 << 8)
+#define ARES_FLAG_NO_DFLT_SVR     (1 << 9)
+#define ARES_FLAG_DNS0x20         (1 << 10)
+#define ARES_FLAG_PARALLEL_SEARCH (1 << 11)
 
 /* Option mask values */
 #define ARES_OPT_FLAGS           (1 << 0)
@@ -862,6 +863,40 @@ CARES_EXTERN ares_status_t ares_query_dnsrec(ares_channel_t      *channel,
                                              ares_callback_dnsrec callback,
                                              void *arg, unsigned short *qid);
 
+/*! A single query submitted via ares_send_batch() */
+typedef struct {
+  /*! Query name */
+  const char          *name;
+  /*! DNS Class */
+  ares_dns_class_t     dnsclass;
+  /*! DNS Record Type */
+  ares_dns_rec_type_t  type;
+  /*! Callback for this query, or NULL to use the callback shared by the
+   *  batch */
+  ares_callback_dnsrec callback;
+  /*! Additional argument passed to the callback function */
+  void                *arg;
+} ares_batch_query_t;
+
+/*! Perform many DNS queries at once.  Each query behaves as if it was
+ *  submitted via ares_query_dnsrec(), but the channel is only locked once and
+ *  the queries are written to each connection together after all of them
+ *  have been enqueued.
+ *
+ *  \param[in] channel  Pointer to channel on which queries will be sent.
+ *  \param[in] queries  Array of queries to send
+ *  \param[in] cnt      Number of queries in the array
+ *  \param[in] callback Callback used for queries that don't specify their
+ *                      own, may be NULL if all do.
+ *  \return ARES_SUCCESS if all queries were enqueued, ARES_EFORMERR on invalid
+ *          parameters in which case nothing was enqueued, otherwise the status
+ *          of the first query that failed.
+ */
+CARES_EXTERN ares_status_t ares_send_batch(ares_channel_t           *channel,
+                                           const ares_batch_query_t *queries,
+                                           size_t                    cnt,
+                                           ares_callback_dnsrec      callback);
+
 CARES_EXTERN CARES_DEPRECATED_FOR(ares_search_dnsrec) void ares_search(
   ares_channel_t *channel, const char *name, int dnsclass, int type,
   ares_callback callback, void *arg);
@@ -894,6 +929,36 @@ CARES_EXTERN void ares_gethostbyaddr(ares_channel_t *channel, const void *addr,
                                      int addrlen, int family,
                                      ares_host_callback callback, void *arg);
 
+/*! A single address submitted via ares_gethostbyaddr_batch() */
+typedef struct {
+  /*! Address to look up, AF_INET or AF_INET6 */
+  struct ares_addr   addr;
+  /*! Callback for this address, or NULL to use the callback shared by the
+   *  batch */
+  ares_host_callback callback;
+  /*! Additional argument passed to the callback function */
+  void              *arg;
+} ares_batch_addr_t;
+
+/*! Perform many reverse lookups at once.  Each address behaves as if it was
+ *  submitted via ares_gethostbyaddr(), but the channel is only locked once,
+ *  an address that appears more than once is only looked up once with every
+ *  callback receiving the result, and queries are written to each connection
+ *  together after all of them have been enqueued.
+ *
+ *  \param[in] channel  Pointer to channel on which queries will be sent.
+ *  \param[in] addrs    Array of addresses to look up
+ *  \param[in] cnt      Number of addresses in the array
+ *  \param[in] callback Callback used for addresses that don't specify their
+ *                      own, may be NULL if all do.
+ *  \return ARES_SUCCESS if all lookups were started, ARES_EFORMERR on invalid
+ *          parameters in which case nothing was started, otherwise the status
+ *          of the first lookup that failed.
+ */
+CARES_EXTERN ares_status_t ares_gethostbyaddr_batch(
+  ares_channel_t *channel, const ares_batch_addr_t *addrs, size_t cnt,
+  ares_host_callback callback);
+
 CARES_EXTERN void ares_getnameinfo(ares_channel_t        *channel,
                                    const struct sockaddr *sa,
                                    ares_socklen_t salen, int flags,
@@ -1228,6 +1293,302 @@ CARES_EXTERN ares_status_t ares_queue_wait_empty(ares_channel_t *channel,
  */
 CARES_EXTERN size_t ares_queue_active_queries(const ares_channel_t *channel);
 
+/*! Trade CPU for latency in the event thread (ARES_OPT_EVENT_THREAD).  Query
+ *  timeouts are tracked with a high resolution timer rather than the
+ *  millisecond resolution of the event system, and optionally the thread
+ *  keeps polling for busy_poll_us microseconds after any activity while
+ *  queries are outstanding rather than going to sleep.
+ *
+ *  \param[in] channel      Initialized ares channel using an event thread
+ *  \param[in] enable       ARES_TRUE to enable, ARES_FALSE to disable
+ *  \param[in] busy_poll_us Busy poll window in microseconds, 0 to disable,
+ *                          at most 1000000.
+ *  \return ARES_SUCCESS on success, ARES_ENOTIMP if the channel doesn't use
+ *          an event thread or the system doesn't support this mode,
+ *          ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t ares_set_event_thread_low_latency(
+  ares_channel_t *channel, ares_bool_t enable, unsigned int busy_poll_us);
+
+/*! Time periods over which per-server latency metrics are collected */
+typedef enum {
+  ARES_METRICS_PERIOD_1MINUTE   = 0, /*!< Current minute */
+  ARES_METRICS_PERIOD_15MINUTES = 1, /*!< Current 15 minute interval */
+  ARES_METRICS_PERIOD_1HOUR     = 2, /*!< Current hour */
+  ARES_METRICS_PERIOD_1DAY      = 3, /*!< Current day */
+  ARES_METRICS_PERIOD_INCEPTION = 4  /*!< Since the server was added */
+} ares_metrics_period_t;
+
+/*! Latency distribution for a single server over a metrics period.
+ *  Percentiles are derived from a log-linear histogram and are accurate to
+ *  within 12.5%. */
+typedef struct {
+  size_t       count;  /*!< Number of successful queries recorded */
+  unsigned int min_ms; /*!< Minimum observed latency */
+  unsigned int max_ms; /*!< Maximum observed latency */
+  unsigned int avg_ms; /*!< Average latency */
+  unsigned int p50_ms; /*!< 50th percentile (median) latency */
+  unsigned int p90_ms; /*!< 90th percentile latency */
+  unsigned int p99_ms; /*!< 99th percentile latency */
+} ares_server_latency_t;
+
+/*! Retrieve the latency distribution for a server.
+ *
+ *  \param[in]  channel Initialized ares channel
+ *  \param[in]  server  Server string in the same format as returned by
+ *                      ares_get_servers_csv() and passed to the server state
+ *                      callback.
+ *  \param[in]  period  Time period to retrieve metrics for.  If the current
+ *                      period has no data, the immediately preceding period
+ *                      is used.
+ *  \param[out] latency Latency distribution, zeroed if no data is available.
+ *  \return ARES_SUCCESS on success, ARES_ENOTFOUND if the server is not
+ *          configured on the channel, ARES_ENODATA if no queries were
+ *          recorded for the period, or ARES_EFORMERR on misuse.
+ */
+CARES_EXTERN ares_status_t
+  ares_get_server_latency(const ares_channel_t *channel, const char *server,
+                          ares_metrics_period_t  period,
+                          ares_server_latency_t *latency);
+
+/*! Derive per-server retry timeouts from a latency percentile rather than
+ *  from the average latency.  The timeout used will be twice the latency at
+ *  the requested percentile, bound by the usual minimum and maximum.
+ *
+ *  \param[in] channel    Initialized ares channel
+ *  \param[in] percentile Percentile between 1 and 100, or 0 to restore the
+ *                        default behavior of using the average latency.
+ *  \return ARES_SUCCESS on success, ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t
+  ares_set_server_timeout_percentile(ares_channel_t *channel,
+                                     unsigned int    percentile);
+
+/*! Policies for picking the server a query is sent to */
+typedef enum {
+  /*! First server in priority order, or a random one among those with the
+   *  fewest failures if ARES_OPT_ROTATE is set */
+  ARES_SERVER_SELECT_DEFAULT = 0,
+  /*! Power of two choices: of two random servers among those with the fewest
+   *  failures, use the one with the lower smoothed latency weighted by the
+   *  number of queries already outstanding to it */
+  ARES_SERVER_SELECT_P2C = 1
+} ares_server_select_t;
+
+/*! Set the policy used to pick the server each query is sent to.
+ *
+ *  \param[in] channel Initialized ares channel
+ *  \param[in] policy  Server selection policy
+ *  \return ARES_SUCCESS on success, ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t ares_set_server_selection(
+  ares_channel_t *channel, ares_server_select_t policy);
+
+/*! Enable hedged queries.  When a query has been outstanding for longer than
+ *  the chosen latency percentile of the server it was sent to, the same query
+ *  is also sent to the next best server and whichever answers first is used.
+ *  The extra load is bounded by a budget expressed as a percentage of the
+ *  queries issued on the channel.
+ *
+ *  \param[in] channel    Initialized ares channel
+ *  \param[in] percentile Latency percentile between 1 and 100 after which to
+ *                        hedge (95 is a good choice), or 0 to disable.
+ *  \param[in] budget_pct Maximum hedges as a percentage of queries, 1 to 100.
+ *  \return ARES_SUCCESS on success, ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t ares_set_query_hedging(ares_channel_t *channel,
+                                                  unsigned int    percentile,
+                                                  unsigned int    budget_pct);
+
+/*! Save what the channel has learned (cached answers, per-server latency
+ *  metrics and DNS cookies) to a file, so a restarted process can start warm
+ *  by calling ares_load_state().
+ *
+ *  \param[in] channel  Initialized channel
+ *  \param[in] filename File to write, replaced if it exists
+ *  \return ARES_SUCCESS on success, ARES_EFILE if the file could not be
+ *          written.
+ */
+CARES_EXTERN ares_status_t ares_save_state(const ares_channel_t *channel,
+                                           const char           *filename);
+
+/*! Load state saved by ares_save_state().  Cache entries that have expired
+ *  since the save are discarded and state for servers no longer configured is
+ *  ignored.  Call right after initializing the channel.
+ *
+ *  \param[in] channel  Initialized channel
+ *  \param[in] filename File written by ares_save_state()
+ *  \return ARES_SUCCESS on success, ARES_ENOTFOUND if the file does not exist,
+ *          ARES_EFILE if the file could not be read or is not valid.
+ */
+CARES_EXTERN ares_status_t ares_load_state(ares_channel_t *channel,
+                                           const char     *filename);
+
+/*! Query lifecycle trace event types */
+typedef enum {
+  ARES_TRACE_QUERY_ENQUEUE  = 1, /*!< Query accepted by the channel */
+  ARES_TRACE_QCACHE_HIT     = 2, /*!< Query answered from the query cache */
+  ARES_TRACE_QUERY_SEND     = 3, /*!< Query written to a connection.  Value
+                                  *   is the timeout in milliseconds */
+  ARES_TRACE_CONN_FLUSH     = 4, /*!< Connection output flushed.  Value is
+                                  *   the number of bytes still pending */
+  ARES_TRACE_CONN_READ      = 5, /*!< Response read from a connection.
+                                  *   Value is the message length */
+  ARES_TRACE_ANSWER         = 6, /*!< Response matched to a query.  Value is
+                                  *   the DNS response code */
+  ARES_TRACE_QUERY_REQUEUE  = 7, /*!< Query requeued.  Value is the try
+                                  *   count */
+  ARES_TRACE_QUERY_TIMEOUT  = 8, /*!< Query timed out.  Value is the number
+                                  *   of timeouts so far */
+  ARES_TRACE_QUERY_END      = 9, /*!< Query completed */
+  ARES_TRACE_QUERY_CALLBACK = 10 /*!< Query callback returned */
+} ares_trace_event_type_t;
+
+/*! Server index used in trace events not associated with a server */
+#define ARES_TRACE_NOSERVER ((size_t)-1)
+
+/*! A single query lifecycle trace event */
+typedef struct {
+  ares_trace_event_type_t type;   /*!< Event type */
+  unsigned int            sec;    /*!< Seconds since tracing was enabled,
+                                   *   monotonic */
+  unsigned int            usec;   /*!< Microseconds portion of the time */
+  unsigned short          qid;    /*!< DNS query id, 0 if none */
+  size_t                  server; /*!< Index of the server in the server
+                                   *   list, or ARES_TRACE_NOSERVER */
+  ares_status_t           status; /*!< Status associated with the event */
+  size_t                  value;  /*!< Event-specific value */
+} ares_trace_event_t;
+
+/*! Callback invoked synchronously for each trace event.  The channel lock
+ *  is held, so the callback must not call back into the channel.
+ *
+ *  \param[in] event     Trace event, only valid for the duration of the call
+ *  \param[in] user_data User data passed to ares_set_trace()
+ */
+typedef void (*ares_trace_cb)(const ares_trace_event_t *event,
+                              void                     *user_data);
+
+/*! Enable or disable query lifecycle tracing on a channel.  Events are
+ *  recorded into a fixed-size ring buffer which overwrites the oldest events
+ *  when full, and optionally passed to a callback.
+ *
+ *  \param[in] channel   Initialized ares channel
+ *  \param[in] ring_size Number of events to retain, rounded up to a power of
+ *                       2.  0 to not retain events.
+ *  \param[in] cb        Optional callback to invoke for each event.
+ *  \param[in] user_data User data to pass to the callback.
+ *  \return ARES_SUCCESS on success, ARES_ENOTIMP if not built with tracing
+ *          support, ARES_ENOMEM on out of memory, ARES_EFORMERR on misuse.
+ *          Tracing is disabled if both ring_size is 0 and cb is NULL.
+ */
+CARES_EXTERN ares_status_t ares_set_trace(ares_channel_t *channel,
+                                          size_t ring_size, ares_trace_cb cb,
+                                          void *user_data);
+
+/*! Drain retained trace events from a channel, oldest first.
+ *
+ *  \param[in]  channel    Initialized ares channel
+ *  \param[out] events     Array to fill with events
+ *  \param[in]  max_events Number of entries in the events array
+ *  \param[out] num_events Number of events written
+ *  \param[out] dropped    Optional.  Number of events overwritten before they
+ *                         could be fetched since the last call.
+ *  \return ARES_SUCCESS on success, ARES_ENOTIMP if not built with tracing
+ *          support, ARES_EFORMERR on misuse.
+ */
+CARES_EXTERN ares_status_t ares_trace_fetch(ares_channel_t     *channel,
+                                            ares_trace_event_t *events,
+                                            size_t              max_events,
+                                            size_t             *num_events,
+                                            size_t             *dropped);
+
+/*! Retrieve a human readable name for a trace event type
+ *
+ *  \param[in] type Trace event type
+ *  \return String representation, or "UNKNOWN"
+ */
+CARES_EXTERN const char *
+  ares_trace_event_type_tostr(ares_trace_event_type_t type);
+
+/*! Set the RFC 8305 resolution delay used by ares_getaddrinfo() for
+ *  AF_UNSPEC lookups.  Once a usable IPv4 answer has arrived, the
+ *  outstanding IPv6 query is only waited on for this long before the
+ *  result is delivered with the addresses collected so far.
+ *
+ *  \param[in] channel  Initialized ares channel
+ *  \param[in] delay_ms Delay in milliseconds (RFC 8305 recommends 50), or 0
+ *                      to wait for all address families (default).
+ *  \return ARES_SUCCESS on success, ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t ares_set_resolution_delay(ares_channel_t *channel,
+                                                     size_t          delay_ms);
+
+/*! Flags for ares_getaddrinfo_stream().  These are unrelated to the
+ *  ARES_AI_* values used in ares_addrinfo_hints.ai_flags. */
+typedef enum {
+  /*! No flag value */
+  ARES_GAI_STREAM_NONE = 0,
+  /*! Deliver only the first response that yields addresses and cancel any
+   *  other outstanding queries for the lookup */
+  ARES_GAI_STREAM_FIRST = 1 << 0
+} ares_gai_stream_flags_t;
+
+/*! Callback used by ares_getaddrinfo_stream().
+ *
+ *  \param[in] arg       User-supplied argument
+ *  \param[in] status    ARES_SUCCESS for a batch of addresses, or the overall
+ *                       status of the lookup when done is ARES_TRUE
+ *  \param[in] timeouts  Number of timeouts seen so far
+ *  \param[in] nodes     Contiguous array of nodes_cnt addresses, each also
+ *                       linked to the next through ai_next.  Only valid for
+ *                       the duration of the callback.  May be NULL.
+ *  \param[in] nodes_cnt Number of entries in nodes
+ *  \param[in] done      ARES_TRUE on the last invocation for the lookup
+ */
+typedef void (*ares_addrinfo_stream_callback)(
+  void *arg, ares_status_t status, size_t timeouts,
+  const struct ares_addrinfo_node *nodes, size_t nodes_cnt, ares_bool_t done);
+
+/*! Variant of ares_getaddrinfo() that delivers addresses as each response is
+ *  received rather than once the lookup has completed.
+ *
+ *  \param[in] channel  Initialized ares channel
+ *  \param[in] name     Name to look up
+ *  \param[in] service  Optional service name or port number
+ *  \param[in] hints    Optional hints, as for ares_getaddrinfo()
+ *  \param[in] flags    Bitmask of ares_gai_stream_flags_t
+ *  \param[in] callback Callback invoked zero or more times with a batch of
+ *                      addresses and done set to ARES_FALSE, then exactly
+ *                      once with done set to ARES_TRUE
+ *  \param[in] arg      User-supplied argument for the callback
+ */
+CARES_EXTERN void ares_getaddrinfo_stream(
+  ares_channel_t *channel, const char *name, const char *service,
+  const struct ares_addrinfo_hints *hints, ares_gai_stream_flags_t flags,
+  ares_addrinfo_stream_callback callback, void *arg);
+
+/*! Configure negative caching in the query cache.  Has no effect if the
+ *  query cache is disabled.
+ *
+ *  NXDOMAIN and NODATA answers are cached per RFC 2308 using the SOA record
+ *  in the authority section.  Answers that lack an SOA record are cached for
+ *  fallback_ttl seconds instead.
+ *
+ *  A SERVFAIL response is remembered for servfail_ttl seconds per question
+ *  and per server.  Queries for that question skip the failing server, and
+ *  fail with ARES_ESERVFAIL without being sent if every server is failing.
+ *
+ *  \param[in] channel      Initialized ares channel
+ *  \param[in] fallback_ttl TTL in seconds for negative answers without an
+ *                          SOA record, 0 to not cache them (default)
+ *  \param[in] servfail_ttl Seconds to remember a server failure, at most
+ *                          300, 0 to disable (default)
+ *  \return ARES_SUCCESS on success, ARES_EFORMERR on invalid parameters.
+ */
+CARES_EXTERN ares_status_t ares_set_qcache_negative_ttl(
+  ares_channel_t *channel, unsigned int fallback_ttl, unsigned int servfail_ttl);
+
 #ifdef __cplusplus
 }
 #endif
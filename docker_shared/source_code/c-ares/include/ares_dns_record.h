@@ -1019,6 +1019,11 @@ CARES_EXTERN size_t ares_dns_rr_get_abin_cnt(const ares_dns_rr_t *dns_rr,
  *  If want all array membersconcatenated, may use ares_dns_rr_get_bin()
  *  instead.
  *
+ *  All values for the key share one buffer, so the returned pointer is only
+ *  valid until the next ares_dns_rr_add_abin() or ares_dns_rr_del_abin() on
+ *  the same resource record and key.  It may still be passed to
+ *  ares_dns_rr_add_abin() itself to append a copy of the value.
+ *
  *  \param[in]  dns_rr Pointer to resource record
  *  \param[in]  key    DNS Resource Record Key
  *  \param[in]  idx    Index of value to retrieve
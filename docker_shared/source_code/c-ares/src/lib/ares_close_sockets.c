@@ -37,6 +37,11 @@ static void ares_requeue_queries(ares_conn_t  *conn,
   ares_tvnow(&now);
 
   while ((query = ares_llist_first_val(conn->queries_to_conn)) != NULL) {
+    /* Only the hedge was sent here, the original attempt is still in flight */
+    if (query->hedge_conn == conn) {
+      ares_query_drop_hedge(query);
+      continue;
+    }
     ares_requeue_query(query, &now, requeue_status, ARES_TRUE, NULL, NULL);
   }
 }
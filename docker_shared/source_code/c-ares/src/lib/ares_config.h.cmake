@@ -100,6 +100,9 @@
 /* Define to 1 if you have the epoll{_create,ctl,wait} functions. */
 #cmakedefine HAVE_EPOLL 1
 
+/* Define to 1 if you have the timerfd_{create,settime} functions. */
+#cmakedefine HAVE_TIMERFD 1
+
 /* Define to 1 if you have the fcntl function. */
 #cmakedefine HAVE_FCNTL 1
 
@@ -356,6 +359,9 @@
 /* Define to 1 if you have the <sys/epoll.h> header file. */
 #cmakedefine HAVE_SYS_EPOLL_H 1
 
+/* Define to 1 if you have the <sys/timerfd.h> header file. */
+#cmakedefine HAVE_SYS_TIMERFD_H 1
+
 /* Define to 1 if you have the <sys/select.h> header file. */
 #cmakedefine HAVE_SYS_SELECT_H 1
 
@@ -503,6 +509,9 @@
 /* Define to 1 if threads are enabled */
 #cmakedefine CARES_THREADS 1
 
+/* Define to 1 if query lifecycle tracing is enabled */
+#cmakedefine CARES_TRACE 1
+
 /* Define to 1 if pthread_init() exists */
 #cmakedefine HAVE_PTHREAD_INIT 1
 
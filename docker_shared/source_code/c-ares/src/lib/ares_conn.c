@@ -318,6 +318,9 @@ done:
     ares_conn_sock_state_cb_update(conn, flags);
   }
 
+  ARES_TRACE(conn->server->channel, ARES_TRACE_CONN_FLUSH, 0, conn->server,
+             status, ares_buf_len(conn->out_buf));
+
   return status;
 }
 
@@ -372,6 +375,7 @@ ares_status_t ares_open_connection(ares_conn_t   **conn_out,
     goto done;
     /* LCOV_EXCL_STOP */
   }
+  ares_llist_set_pool(conn->queries_to_conn, channel->query_pool);
 
   /* Try to enable TFO always if using TCP. it will fail later on if its
    * really not supported when we try to enable it on the socket. */
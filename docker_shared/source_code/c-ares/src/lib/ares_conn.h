@@ -90,6 +90,23 @@ typedef enum {
   ARES_METRIC_COUNT        /*!< Count of buckets, not a real bucket */
 } ares_server_bucket_t;
 
+/*! Number of bits used for the linear sub-buckets within each power of two
+ *  of the latency histogram.  8 sub-buckets per power of two gives a worst
+ *  case relative error of 12.5% */
+#define ARES_METRICS_HIST_SUB_BITS 3
+
+/*! Number of linear sub-buckets per power of two */
+#define ARES_METRICS_HIST_SUB_CNT (1 << ARES_METRICS_HIST_SUB_BITS)
+
+/*! Largest latency in milliseconds tracked with precision by the histogram,
+ *  anything larger is accounted for in the last histogram bucket */
+#define ARES_METRICS_HIST_MAX_MS 65535
+
+/*! Total number of histogram buckets needed to cover 0 through
+ *  ARES_METRICS_HIST_MAX_MS (16 bits) */
+#define ARES_METRICS_HIST_CNT \
+  ((16 - ARES_METRICS_HIST_SUB_BITS + 1) * ARES_METRICS_HIST_SUB_CNT)
+
 /*! Data metrics collected for each bucket */
 typedef struct {
   time_t        ts;             /*!< Timestamp divided by bucket divisor */
@@ -97,11 +114,17 @@ typedef struct {
   unsigned int  latency_max_ms; /*!< Maximum latency for queries */
   ares_uint64_t total_ms;       /*!< Cumulative query time for bucket */
   ares_uint64_t total_count;    /*!< Number of queries for bucket */
+  unsigned int  hist[ARES_METRICS_HIST_CNT]; /*!< Log-linear latency
+                                              *   histogram for bucket */
 
   time_t        prev_ts;        /*!< Previous period bucket timestamp */
+  unsigned int  prev_latency_min_ms; /*!< Previous period minimum latency */
+  unsigned int  prev_latency_max_ms; /*!< Previous period maximum latency */
   ares_uint64_t
     prev_total_ms; /*!< Previous period bucket cumulative query time */
   ares_uint64_t prev_total_count; /*!< Previous period bucket query count */
+  unsigned int  prev_hist[ARES_METRICS_HIST_CNT]; /*!< Previous period
+                                                   *   latency histogram */
 } ares_server_metrics_t;
 
 typedef enum {
@@ -134,6 +157,25 @@ typedef struct {
   ares_timeval_t      unsupported_ts;
 } ares_cookie_t;
 
+typedef enum {
+  ARES_EDNS_INITIAL     = 0,
+  ARES_EDNS_SUPPORTED   = 1,
+  ARES_EDNS_UNSUPPORTED = 2
+} ares_edns_state_t;
+
+/*! Structure holding what has been learned about a server's EDNS support,
+ *  see ares_edns.c */
+typedef struct {
+  /*! starts at INITIAL, transitions as answers come in */
+  ares_edns_state_t state;
+  /*! UDP payload size to advertise, 0 to use the one in the query */
+  unsigned short    udp_size;
+  /*! Smallest raised UDP payload size that timed out, 0 if none */
+  unsigned short    udp_size_bad;
+  /*! Timestamp EDNS or a UDP payload size last failed, used to relearn */
+  ares_timeval_t    fail_ts;
+} ares_edns_t;
+
 struct ares_server {
   /* Configuration */
   size_t                idx;      /* index for server in system configuration */
@@ -157,9 +199,16 @@ struct ares_server {
   /*! Buckets for collecting metrics about the server */
   ares_server_metrics_t metrics[ARES_METRIC_COUNT];
 
+  /*! Exponentially weighted moving average of query latency, in 1/8th
+   *  milliseconds, 0 if no queries have completed yet */
+  unsigned int          latency_ewma8;
+
   /*! RFC 7873/9018 DNS Cookies */
   ares_cookie_t         cookie;
 
+  /*! RFC 6891 EDNS support and UDP payload size */
+  ares_edns_t           edns;
+
   /* Link back to owning channel */
   ares_channel_t       *channel;
 };
@@ -223,21 +223,6 @@ static ares_bool_t timeval_is_set(const ares_timeval_t *tv)
   return ARES_FALSE;
 }
 
-static ares_bool_t timeval_expired(const ares_timeval_t *tv,
-                                   const ares_timeval_t *now,
-                                   unsigned long         millsecs)
-{
-  ares_int64_t   tvdiff_ms;
-  ares_timeval_t tvdiff;
-  ares_timeval_diff(&tvdiff, tv, now);
-
-  tvdiff_ms = tvdiff.sec * 1000 + tvdiff.usec / 1000;
-  if (tvdiff_ms >= (ares_int64_t)millsecs) {
-    return ARES_TRUE;
-  }
-  return ARES_FALSE;
-}
-
 static void ares_cookie_clear(ares_cookie_t *cookie)
 {
   memset(cookie, 0, sizeof(*cookie));
@@ -315,16 +300,16 @@ ares_status_t ares_cookie_apply(ares_dns_record_t *dnsrec, ares_conn_t *conn,
   /* Look for regression */
   if (cookie->state == ARES_COOKIE_SUPPORTED &&
       timeval_is_set(&cookie->unsupported_ts) &&
-      timeval_expired(&cookie->unsupported_ts, now,
-                      COOKIE_REGRESSION_TIMEOUT_MS)) {
+      ares_timeval_expired(&cookie->unsupported_ts, now,
+                           COOKIE_REGRESSION_TIMEOUT_MS)) {
     ares_cookie_clear(cookie);
   }
 
   /* Handle unsupported state */
   if (cookie->state == ARES_COOKIE_UNSUPPORTED) {
     /* If timer hasn't expired, just delete any possible cookie and return */
-    if (!timeval_expired(&cookie->unsupported_ts, now,
-                         COOKIE_REGRESSION_TIMEOUT_MS)) {
+    if (!ares_timeval_expired(&cookie->unsupported_ts, now,
+                              COOKIE_REGRESSION_TIMEOUT_MS)) {
       ares_dns_rr_del_opt_byid(rr, ARES_RR_OPT_OPTIONS, ARES_OPT_PARAM_COOKIE);
       return ARES_SUCCESS;
     }
@@ -350,7 +335,8 @@ ares_status_t ares_cookie_apply(ares_dns_record_t *dnsrec, ares_conn_t *conn,
 
   /* If the client cookie has reached its maximum time, refresh it */
   if (cookie->state == ARES_COOKIE_SUPPORTED &&
-      timeval_expired(&cookie->client_ts, now, COOKIE_CLIENT_TIMEOUT_MS)) {
+      ares_timeval_expired(&cookie->client_ts, now,
+                           COOKIE_CLIENT_TIMEOUT_MS)) {
     ares_cookie_clear_server(cookie);
     ares_cookie_generate(cookie, conn, now);
   }
@@ -374,7 +360,7 @@ ares_status_t ares_cookie_validate(ares_query_t            *query,
 {
   ares_server_t           *server = conn->server;
   ares_cookie_t           *cookie = &server->cookie;
-  const ares_dns_record_t *dnsreq = query->query;
+  const ares_dns_record_t *dnsreq = ares_query_dnsrec_sent(query, conn);
   const unsigned char     *resp_cookie;
   size_t                   resp_cookie_len;
   const unsigned char     *req_cookie;
@@ -459,3 +445,132 @@ ares_status_t ares_cookie_validate(ares_query_t            *query,
   /* Cookie state should be UNSUPPORTED if we're here */
   return ARES_SUCCESS;
 }
+
+/* Only an established cookie is worth saving, anything else will be relearned
+ * on the first query anyhow */
+ares_status_t ares_cookie_save(const ares_server_t  *server,
+                               const ares_timeval_t *now, ares_buf_t *buf)
+{
+  const ares_cookie_t *cookie = &server->cookie;
+  ares_timeval_t       age;
+  ares_status_t        status;
+
+  if (cookie->state != ARES_COOKIE_SUPPORTED || cookie->server_len == 0 ||
+      timeval_is_set(&cookie->unsupported_ts) ||
+      (cookie->client_ip.family != AF_INET &&
+       cookie->client_ip.family != AF_INET6)) {
+    return ares_buf_append_byte(buf, 0);
+  }
+
+  ares_timeval_diff(&age, &cookie->client_ts, now);
+
+  status = ares_buf_append_byte(buf, 1);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append(buf, cookie->client, sizeof(cookie->client));
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_be32(buf, (unsigned int)age.sec);
+  }
+  if (status == ARES_SUCCESS) {
+    if (cookie->client_ip.family == AF_INET) {
+      status = ares_buf_append_byte(buf, 4);
+      if (status == ARES_SUCCESS) {
+        status = ares_buf_append(buf,
+                                 (const unsigned char *)&cookie->client_ip.addr
+                                   .addr4,
+                                 sizeof(cookie->client_ip.addr.addr4));
+      }
+    } else {
+      status = ares_buf_append_byte(buf, 6);
+      if (status == ARES_SUCCESS) {
+        status = ares_buf_append(
+          buf, cookie->client_ip.addr.addr6._S6_un._S6_u8,
+          sizeof(cookie->client_ip.addr.addr6._S6_un._S6_u8));
+      }
+    }
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_byte(buf, (unsigned char)cookie->server_len);
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append(buf, cookie->server, cookie->server_len);
+  }
+  return status;
+}
+
+/* Counterpart to ares_cookie_save().  elapsed is how many seconds ago the
+ * cookie was saved, the client cookie is still rotated on schedule. */
+ares_status_t ares_cookie_load(ares_server_t *server, const ares_timeval_t *now,
+                               unsigned int elapsed, ares_buf_t *buf)
+{
+  ares_cookie_t    *cookie = &server->cookie;
+  unsigned char     present;
+  unsigned char     client[8];
+  unsigned int      age;
+  unsigned char     family;
+  struct ares_addr  client_ip;
+  unsigned char     server_cookie[32];
+  unsigned char     server_len;
+  ares_status_t     status;
+
+  status = ares_buf_fetch_bytes(buf, &present, 1);
+  if (status != ARES_SUCCESS || !present) {
+    return status;
+  }
+
+  memset(&client_ip, 0, sizeof(client_ip));
+
+  status = ares_buf_fetch_bytes(buf, client, sizeof(client));
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_fetch_be32(buf, &age);
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_fetch_bytes(buf, &family, 1);
+  }
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  if (family == 4) {
+    client_ip.family = AF_INET;
+    status           = ares_buf_fetch_bytes(
+      buf, (unsigned char *)&client_ip.addr.addr4, sizeof(client_ip.addr.addr4));
+  } else if (family == 6) {
+    client_ip.family = AF_INET6;
+    status = ares_buf_fetch_bytes(buf, client_ip.addr.addr6._S6_un._S6_u8,
+                                  sizeof(client_ip.addr.addr6._S6_un._S6_u8));
+  } else {
+    return ARES_EBADRESP;
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_fetch_bytes(buf, &server_len, 1);
+  }
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+  if (server_len < 8 || server_len > sizeof(server_cookie)) {
+    return ARES_EBADRESP;
+  }
+  status = ares_buf_fetch_bytes(buf, server_cookie, server_len);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  /* Never override anything learned by this channel, and don't bother with a
+   * client cookie that is due for rotation */
+  if (cookie->state != ARES_COOKIE_INITIAL ||
+      (ares_uint64_t)age + elapsed >= COOKIE_CLIENT_TIMEOUT_MS / 1000 ||
+      now->sec < (ares_int64_t)age + elapsed) {
+    return ARES_SUCCESS;
+  }
+
+  ares_cookie_clear(cookie);
+  memcpy(cookie->client, client, sizeof(cookie->client));
+  memcpy(&cookie->client_ip, &client_ip, sizeof(cookie->client_ip));
+  memcpy(cookie->server, server_cookie, server_len);
+  cookie->server_len    = server_len;
+  cookie->client_ts     = *now;
+  cookie->client_ts.sec -= (ares_int64_t)age + elapsed;
+  cookie->state         = ARES_COOKIE_SUPPORTED;
+  return ARES_SUCCESS;
+}
@@ -118,6 +118,7 @@ void ares_destroy(ares_channel_t *channel)
   ares_slist_destroy(channel->queries_by_timeout);
   ares_htable_szvp_destroy(channel->queries_by_qid);
   ares_htable_asvp_destroy(channel->connnode_by_socket);
+  ares_pool_destroy(channel->query_pool);
 
   ares_free(channel->sortlist);
   ares_free(channel->lookups);
@@ -126,8 +127,15 @@ void ares_destroy(ares_channel_t *channel)
   ares_destroy_rand_state(channel->rand_state);
 
   ares_hosts_file_destroy(channel->hf);
+  ares_services_file_destroy(channel->services);
 
   ares_qcache_destroy(channel->qcache);
+  ares_sortaddrinfo_cache_flush(channel);
+  ares_iface_cache_flush(channel);
+
+#ifdef CARES_TRACE
+  ares_trace_destroy(channel->trace);
+#endif
 
   ares_channel_threading_destroy(channel);
 
@@ -0,0 +1,201 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Per-server EDNS learning.
+ *
+ * With ARES_FLAG_EDNS every query carries an OPT RR advertising the channel's
+ * UDP payload size (1232 by default, as recommended by DNS Flag Day 2020).
+ * Servers differ in how well they cope with that, so a couple of things are
+ * learned about each server and applied each time a query is written to it,
+ * much like DNS cookies are (see ares_cookie.c):
+ *
+ *  - Whether EDNS is understood at all.  When a server rejects a query because
+ *    of its OPT RR the server is marked as not supporting EDNS, and the retry
+ *    and later queries to it are sent without EDNS up front, rather than
+ *    paying for the failed round trip each time.  Only the copy written to
+ *    that server leaves the OPT RR out, the query keeps it for any other
+ *    server it fails over to.
+ *
+ *  - The UDP payload size to advertise.  A truncated UDP answer costs a TCP
+ *    round trip, and the next answer of that size to the same server will be
+ *    truncated too, so the advertised size for the server is doubled (up to
+ *    MAXENDSSZ).  Larger answers mean IP fragmentation, which some paths
+ *    drop, so if a query advertising a raised size times out the server falls
+ *    back to the size in the query and the failing size is not tried again.
+ *
+ * Both are forgotten after EDNS_RELEARN_TIMEOUT_MS so that a server that has
+ * been upgraded, or a path that has been fixed, is eventually used to its
+ * full potential again.
+ */
+
+#include "ares_private.h"
+
+/* 5 minutes */
+#define EDNS_RELEARN_TIMEOUT_MS (300 * 1000)
+
+static ares_status_t ares_edns_remove(ares_dns_record_t *dnsrec)
+{
+  size_t i;
+
+  /* Find and remove the OPT RR record */
+  for (i = 0; i < ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ADDITIONAL);
+       i++) {
+    const ares_dns_rr_t *rr;
+    rr = ares_dns_record_rr_get(dnsrec, ARES_SECTION_ADDITIONAL, i);
+    if (ares_dns_rr_get_type(rr) == ARES_REC_TYPE_OPT) {
+      ares_dns_record_rr_del(dnsrec, ARES_SECTION_ADDITIONAL, i);
+      return ARES_SUCCESS;
+    }
+  }
+
+  return ARES_EFORMERR;
+}
+
+/* Time to give the server another chance */
+static void ares_edns_relearn(ares_edns_t *edns, const ares_timeval_t *now)
+{
+  if ((edns->state == ARES_EDNS_UNSUPPORTED || edns->udp_size_bad != 0) &&
+      ares_timeval_expired(&edns->fail_ts, now, EDNS_RELEARN_TIMEOUT_MS)) {
+    memset(edns, 0, sizeof(*edns));
+  }
+}
+
+ares_bool_t ares_edns_strip(ares_server_t           *server,
+                            const ares_dns_record_t *dnsrec,
+                            const ares_timeval_t    *now)
+{
+  if (ares_dns_get_opt_rr_const(dnsrec) == NULL) {
+    return ARES_FALSE;
+  }
+
+  ares_edns_relearn(&server->edns, now);
+  return server->edns.state == ARES_EDNS_UNSUPPORTED ? ARES_TRUE : ARES_FALSE;
+}
+
+ares_status_t ares_edns_apply(ares_query_t *query, ares_dns_record_t *dnsrec,
+                              const ares_conn_t    *conn,
+                              const ares_timeval_t *now)
+{
+  ares_edns_t   *edns = &conn->server->edns;
+  ares_dns_rr_t *rr   = ares_dns_get_opt_rr(dnsrec);
+  unsigned short udp_size;
+
+  /* Not using EDNS, nothing to do */
+  if (rr == NULL) {
+    return ARES_SUCCESS;
+  }
+
+  ares_edns_relearn(edns, now);
+
+  /* Skip straight to what the EDNS fallback would have done.  dnsrec is a
+   * copy made for this server, see ares_edns_strip() */
+  if (edns->state == ARES_EDNS_UNSUPPORTED) {
+    return ares_edns_remove(dnsrec);
+  }
+
+  /* Remember what was asked for, since what we advertise varies by server */
+  if (query->edns_udp_size == 0) {
+    query->edns_udp_size = ares_dns_rr_get_u16(rr, ARES_RR_OPT_UDP_SIZE);
+  }
+
+  udp_size = query->edns_udp_size;
+  if (!(conn->flags & ARES_CONN_FLAG_TCP) && edns->udp_size > udp_size) {
+    udp_size = edns->udp_size;
+  }
+
+  return ares_dns_rr_set_u16(rr, ARES_RR_OPT_UDP_SIZE, udp_size);
+}
+
+void ares_edns_unsupported(ares_server_t *server, const ares_timeval_t *now)
+{
+  server->edns.state   = ARES_EDNS_UNSUPPORTED;
+  server->edns.fail_ts = *now;
+}
+
+void ares_edns_validate(const ares_query_t      *query,
+                        const ares_dns_record_t *dnsresp,
+                        const ares_conn_t       *conn)
+{
+  ares_edns_t             *edns   = &conn->server->edns;
+  const ares_dns_record_t *dnsreq = ares_query_dnsrec_sent(query, conn);
+  const ares_dns_rr_t     *rr     = ares_dns_get_opt_rr_const(dnsreq);
+  unsigned short           udp_size;
+
+  if (rr == NULL) {
+    return;
+  }
+
+  if (ares_dns_get_opt_rr_const(dnsresp) != NULL) {
+    edns->state = ARES_EDNS_SUPPORTED;
+  }
+
+  if (conn->flags & ARES_CONN_FLAG_TCP ||
+      !(ares_dns_record_get_flags(dnsresp) & ARES_FLAG_TC)) {
+    return;
+  }
+
+  /* Truncated, advertise more room next time unless that is known not to get
+   * through */
+  udp_size = ares_dns_rr_get_u16(rr, ARES_RR_OPT_UDP_SIZE);
+  if (udp_size >= MAXENDSSZ) {
+    return;
+  }
+
+  udp_size =
+    (udp_size > MAXENDSSZ / 2) ? MAXENDSSZ : (unsigned short)(udp_size * 2);
+  if (edns->udp_size_bad != 0 && udp_size >= edns->udp_size_bad) {
+    return;
+  }
+
+  if (udp_size > edns->udp_size) {
+    edns->udp_size = udp_size;
+  }
+}
+
+void ares_edns_timeout(const ares_query_t *query, const ares_conn_t *conn,
+                       const ares_timeval_t *now)
+{
+  ares_edns_t             *edns   = &conn->server->edns;
+  const ares_dns_record_t *dnsreq = ares_query_dnsrec_sent(query, conn);
+  const ares_dns_rr_t     *rr     = ares_dns_get_opt_rr_const(dnsreq);
+  unsigned short           udp_size;
+
+  if (rr == NULL || conn->flags & ARES_CONN_FLAG_TCP || edns->udp_size == 0) {
+    return;
+  }
+
+  /* Only a size we raised ourselves is suspect */
+  udp_size = ares_dns_rr_get_u16(rr, ARES_RR_OPT_UDP_SIZE);
+  if (udp_size <= query->edns_udp_size) {
+    return;
+  }
+
+  if (edns->udp_size_bad == 0 || udp_size < edns->udp_size_bad) {
+    edns->udp_size_bad = udp_size;
+  }
+  edns->udp_size = 0;
+  edns->fail_ts  = *now;
+}
@@ -28,13 +28,6 @@
 
 #include "ares_private.h"
 
-#ifdef HAVE_GETSERVBYNAME_R
-#  if !defined(GETSERVBYNAME_R_ARGS) || (GETSERVBYNAME_R_ARGS < 4) || \
-    (GETSERVBYNAME_R_ARGS > 6)
-#    error "you MUST specify a valid number of arguments for getservbyname_r"
-#  endif
-#endif
-
 #ifdef HAVE_NETINET_IN_H
 #  include <netinet/in.h>
 #endif
@@ -58,6 +51,16 @@
 
 #include "ares_dns.h"
 
+/* State for ares_getaddrinfo_stream(), used as the argument to the internal
+ * ares_addrinfo_callback that delivers the final batch */
+typedef struct {
+  ares_addrinfo_stream_callback callback;
+  void                         *arg;
+  ares_gai_stream_flags_t       flags;
+  int                           socktype;
+  int                           protocol;
+} addrinfo_stream_t;
+
 struct host_query {
   ares_channel_t            *channel;
   char                      *name;
@@ -84,6 +87,12 @@ struct host_query {
 
   /* Track nodata responses to possibly override final result */
   size_t                nodata_cnt;
+
+  /* Set by ares_getaddrinfo_stream(), NULL otherwise */
+  addrinfo_stream_t    *stream;
+  size_t                nodes_streamed; /* addresses already delivered */
+  ares_bool_t           cancelling;     /* outstanding queries being
+                                         * cancelled, ignore their results */
 };
 
 static const struct ares_addrinfo_hints default_hints = {
@@ -178,14 +187,10 @@ void ares_addrinfo_cat_nodes(struct ares_addrinfo_node **head,
 /* Resolve service name into port number given in host byte order.
  * If not resolved, return 0.
  */
-static unsigned short lookup_service(const char *service, int flags)
+static unsigned short lookup_service(ares_channel_t *channel,
+                                     const char *service, int flags)
 {
-  const char     *proto;
-  struct servent *sep;
-#ifdef HAVE_GETSERVBYNAME_R
-  struct servent se;
-  char           tmpbuf[4096];
-#endif
+  const char *proto;
 
   if (service) {
     if (flags & ARES_NI_UDP) {
@@ -197,34 +202,8 @@ static unsigned short lookup_service(const char *service, int flags)
     } else {
       proto = "tcp";
     }
-#ifdef HAVE_GETSERVBYNAME_R
-    memset(&se, 0, sizeof(se));
-    sep = &se;
-    memset(tmpbuf, 0, sizeof(tmpbuf));
-#  if GETSERVBYNAME_R_ARGS == 6
-    if (getservbyname_r(service, proto, &se, (void *)tmpbuf, sizeof(tmpbuf),
-                        &sep) != 0) {
-      sep = NULL; /* LCOV_EXCL_LINE: buffer large so this never fails */
-    }
-#  elif GETSERVBYNAME_R_ARGS == 5
-    sep = getservbyname_r(service, proto, &se, (void *)tmpbuf, sizeof(tmpbuf));
-#  elif GETSERVBYNAME_R_ARGS == 4
-    if (getservbyname_r(service, proto, &se, (void *)tmpbuf) != 0) {
-      sep = NULL;
-    }
-#  else
-    /* Lets just hope the OS uses TLS! */
-    sep = getservbyname(service, proto);
-#  endif
-#else
-    /* Lets just hope the OS uses TLS! */
-#  if (defined(NETWARE) && !defined(__NOVELL_LIBC__))
-    sep = getservbyname(service, (char *)proto);
-#  else
-    sep = getservbyname(service, proto);
-#  endif
-#endif
-    return (sep ? ntohs((unsigned short)sep->s_port) : 0);
+    return ares_services_name_to_port(ares_services_get(channel), service,
+                                      proto);
   }
   return 0;
 }
@@ -483,6 +462,122 @@ static void terminate_retries(const struct host_query *hquery,
   }
 
   query->no_retries = ARES_TRUE;
+
+  /* RFC 8305 Section 3: rather than letting the outstanding query run its
+   * full timeout, only wait the configured resolution delay for it. */
+  if (channel->resolution_delay) {
+    ares_timeval_t now;
+    ares_tvnow(&now);
+    ares_query_cut_short(query, &now, channel->resolution_delay);
+  }
+}
+
+/* Deliver a batch of addresses to a stream callback as a contiguous array */
+static ares_status_t stream_deliver(const addrinfo_stream_t        *stream,
+                                    ares_status_t                   status,
+                                    size_t                          timeouts,
+                                    const struct ares_addrinfo_node *nodes,
+                                    ares_bool_t                     done)
+{
+  const struct ares_addrinfo_node *node;
+  struct ares_addrinfo_node       *arr   = NULL;
+  struct sockaddr_in6             *addrs = NULL;
+  size_t                           cnt   = 0;
+  size_t                           i;
+
+  for (node = nodes; node != NULL; node = node->ai_next) {
+    cnt++;
+  }
+
+  if (cnt) {
+    /* Single allocation, the addresses follow the array of nodes */
+    arr = ares_malloc(cnt * (sizeof(*arr) + sizeof(*addrs)));
+    if (arr == NULL) {
+      return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+    addrs = (struct sockaddr_in6 *)((void *)(arr + cnt));
+
+    for (node = nodes, i = 0; node != NULL; node = node->ai_next, i++) {
+      arr[i] = *node;
+      memcpy(&addrs[i], node->ai_addr, node->ai_addrlen);
+      arr[i].ai_addr     = (struct sockaddr *)((void *)&addrs[i]);
+      arr[i].ai_socktype = stream->socktype;
+      arr[i].ai_protocol = stream->protocol;
+      arr[i].ai_next     = (i + 1 < cnt) ? &arr[i + 1] : NULL;
+    }
+  }
+
+  stream->callback(stream->arg, status, timeouts, arr, cnt, done);
+  ares_free(arr);
+  return ARES_SUCCESS;
+}
+
+/* Final ares_addrinfo_callback for ares_getaddrinfo_stream() */
+static void stream_end_callback(void *arg, int status, int timeouts,
+                                struct ares_addrinfo *res)
+{
+  addrinfo_stream_t *stream = arg;
+
+  if (stream_deliver(stream, (ares_status_t)status, (size_t)timeouts,
+                     res ? res->nodes : NULL, ARES_TRUE) != ARES_SUCCESS) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    stream->callback(stream->arg, ARES_ENOMEM, (size_t)timeouts, NULL, 0,
+                     ARES_TRUE);
+    /* LCOV_EXCL_STOP */
+  }
+  ares_freeaddrinfo(res);
+  ares_free(stream);
+}
+
+/* Hand the addresses collected so far to the stream callback, more answers
+ * are still outstanding */
+static void stream_nodes(struct host_query *hquery)
+{
+  struct ares_addrinfo_node  sentinel;
+  struct ares_addrinfo_node *node;
+
+  sentinel.ai_next = hquery->ai->nodes;
+  if (!(hquery->hints.ai_flags & ARES_AI_NOSORT) && sentinel.ai_next) {
+    ares_sortaddrinfo(hquery->channel, &sentinel);
+  }
+  hquery->ai->nodes = sentinel.ai_next;
+
+  /* On failure leave the nodes in place, they will go out with the final
+   * batch instead */
+  if (stream_deliver(hquery->stream, ARES_SUCCESS, hquery->timeouts,
+                     hquery->ai->nodes, ARES_FALSE) != ARES_SUCCESS) {
+    return; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  for (node = hquery->ai->nodes; node != NULL; node = node->ai_next) {
+    hquery->nodes_streamed++;
+  }
+  ares_freeaddrinfo_nodes(hquery->ai->nodes);
+  hquery->ai->nodes = NULL;
+}
+
+/* Cancel the other outstanding address query once a result has been
+ * delivered in ARES_GAI_STREAM_FIRST mode */
+static void cancel_outstanding(struct host_query *hquery, unsigned short qid)
+{
+  unsigned short term_qid =
+    (qid == hquery->qid_a) ? hquery->qid_aaaa : hquery->qid_a;
+  ares_query_t *query = NULL;
+
+  if (!hquery->remaining) {
+    return;
+  }
+
+  query = ares_htable_szvp_get_direct(hquery->channel->queries_by_qid,
+                                      term_qid);
+  if (query == NULL) {
+    return; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  hquery->cancelling = ARES_TRUE;
+  query->callback(query->arg, ARES_ECANCELLED, 0, NULL);
+  ares_free_query(query);
+  hquery->cancelling = ARES_FALSE;
 }
 
 static ares_bool_t ai_has_ipv4(struct ares_addrinfo *ai)
@@ -505,6 +600,10 @@ static void host_callback(void *arg, ares_status_t status, size_t timeouts,
   hquery->timeouts                 += timeouts;
   hquery->remaining--;
 
+  if (hquery->cancelling) {
+    return;
+  }
+
   if (status == ARES_SUCCESS) {
     if (dnsrec == NULL) {
       addinfostatus = ARES_EBADRESP; /* LCOV_EXCL_LINE: DefensiveCoding */
@@ -535,6 +634,14 @@ static void host_callback(void *arg, ares_status_t status, size_t timeouts,
     if (addinfostatus == ARES_SUCCESS && ai_has_ipv4(hquery->ai)) {
       terminate_retries(hquery, ares_dns_record_get_id(dnsrec));
     }
+
+    if (addinfostatus == ARES_SUCCESS && hquery->stream != NULL) {
+      if (hquery->stream->flags & ARES_GAI_STREAM_FIRST) {
+        cancel_outstanding(hquery, ares_dns_record_get_id(dnsrec));
+      } else if (hquery->remaining) {
+        stream_nodes(hquery);
+      }
+    }
   }
 
   if (!hquery->remaining) {
@@ -545,14 +652,15 @@ static void host_callback(void *arg, ares_status_t status, size_t timeouts,
       end_hquery(hquery, status);
     } else if (addinfostatus != ARES_SUCCESS && addinfostatus != ARES_ENODATA) {
       /* error in parsing result e.g. no memory */
-      if (addinfostatus == ARES_EBADRESP && hquery->ai->nodes) {
+      if (addinfostatus == ARES_EBADRESP &&
+          (hquery->ai->nodes || hquery->nodes_streamed)) {
         /* We got a bad response from server, but at least one query
          * ended with ARES_SUCCESS */
         end_hquery(hquery, ARES_SUCCESS);
       } else {
         end_hquery(hquery, addinfostatus);
       }
-    } else if (hquery->ai->nodes) {
+    } else if (hquery->ai->nodes || hquery->nodes_streamed) {
       /* at least one query ended with ARES_SUCCESS */
       end_hquery(hquery, ARES_SUCCESS);
     } else if (status == ARES_ENOTFOUND || status == ARES_ENODATA ||
@@ -595,7 +703,8 @@ static ares_bool_t numeric_service_to_port(const char *service,
 static void ares_getaddrinfo_int(ares_channel_t *channel, const char *name,
                                  const char                       *service,
                                  const struct ares_addrinfo_hints *hints,
-                                 ares_addrinfo_callback callback, void *arg)
+                                 ares_addrinfo_callback callback, void *arg,
+                                 addrinfo_stream_t *stream)
 {
   struct host_query    *hquery;
   unsigned short        port = 0;
@@ -628,7 +737,7 @@ static void ares_getaddrinfo_int(ares_channel_t *channel, const char *name,
         return;
       }
     } else {
-      port = lookup_service(service, 0);
+      port = lookup_service(channel, service, 0);
       if (!port) {
         if (!numeric_service_to_port(service, &port)) {
           callback(arg, ARES_ESERVICE, 0, NULL);
@@ -662,6 +771,7 @@ static void ares_getaddrinfo_int(ares_channel_t *channel, const char *name,
   hquery->sent_family = -1; /* nothing is sent yet */
   hquery->callback    = callback;
   hquery->arg         = arg;
+  hquery->stream      = stream;
   hquery->ai          = ai;
   hquery->name        = ares_strdup(name);
   if (hquery->name == NULL) {
@@ -701,7 +811,39 @@ void ares_getaddrinfo(ares_channel_t *channel, const char *name,
     return;
   }
   ares_channel_lock(channel);
-  ares_getaddrinfo_int(channel, name, service, hints, callback, arg);
+  ares_getaddrinfo_int(channel, name, service, hints, callback, arg, NULL);
+  ares_channel_unlock(channel);
+}
+
+void ares_getaddrinfo_stream(ares_channel_t *channel, const char *name,
+                             const char                       *service,
+                             const struct ares_addrinfo_hints *hints,
+                             ares_gai_stream_flags_t           flags,
+                             ares_addrinfo_stream_callback callback, void *arg)
+{
+  addrinfo_stream_t *stream;
+
+  if (channel == NULL || callback == NULL) {
+    return;
+  }
+
+  stream = ares_malloc_zero(sizeof(*stream));
+  if (stream == NULL) {
+    callback(arg, ARES_ENOMEM, 0, NULL, 0, ARES_TRUE);
+    return;
+  }
+  stream->callback = callback;
+  stream->arg      = arg;
+  stream->flags    = flags;
+  if (hints != NULL) {
+    stream->socktype = hints->ai_socktype;
+    stream->protocol = hints->ai_protocol;
+  }
+
+  /* The stream is released by stream_end_callback() */
+  ares_channel_lock(channel);
+  ares_getaddrinfo_int(channel, name, service, hints, stream_end_callback,
+                       stream, stream);
   ares_channel_unlock(channel);
 }
 
@@ -743,3 +885,16 @@ static ares_bool_t next_dns_lookup(struct host_query *hquery)
 
   return ARES_TRUE;
 }
+
+ares_status_t ares_set_resolution_delay(ares_channel_t *channel,
+                                        size_t          delay_ms)
+{
+  if (channel == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  ares_channel_lock(channel);
+  channel->resolution_delay = delay_ms;
+  ares_channel_unlock(channel);
+  return ARES_SUCCESS;
+}
@@ -49,8 +49,16 @@ struct addr_query {
   char       *lookups; /* duplicate memory from channel for ares_reinit() */
   const char *remaining_lookups;
   size_t      timeouts;
+  /* Other requests for the same address coalesced into this one by
+   * ares_gethostbyaddr_batch(), NULL if none */
+  ares_llist_t *waiters;
 };
 
+typedef struct {
+  ares_host_callback callback;
+  void              *arg;
+} addr_waiter_t;
+
 static void next_lookup(struct addr_query *aquery);
 static void addr_callback(void *arg, ares_status_t status, size_t timeouts,
                           const ares_dns_record_t *dnsrec);
@@ -60,48 +68,69 @@ static ares_status_t file_lookup(ares_channel_t         *channel,
                                  const struct ares_addr *addr,
                                  struct hostent        **host);
 
-void ares_gethostbyaddr_nolock(ares_channel_t *channel, const void *addr,
-                               int addrlen, int family,
-                               ares_host_callback callback, void *arg)
+static struct addr_query *addr_query_create(ares_channel_t         *channel,
+                                            const struct ares_addr *addr,
+                                            ares_host_callback      callback,
+                                            void                   *arg)
 {
   struct addr_query *aquery;
 
-  if (family != AF_INET && family != AF_INET6) {
-    callback(arg, ARES_ENOTIMP, 0, NULL);
-    return;
-  }
-
-  if ((family == AF_INET && addrlen != sizeof(aquery->addr.addr.addr4)) ||
-      (family == AF_INET6 && addrlen != sizeof(aquery->addr.addr.addr6))) {
-    callback(arg, ARES_ENOTIMP, 0, NULL);
-    return;
-  }
-
-  aquery = ares_malloc(sizeof(struct addr_query));
+  aquery = ares_malloc_zero(sizeof(struct addr_query));
   if (!aquery) {
-    callback(arg, ARES_ENOMEM, 0, NULL);
-    return;
+    return NULL;
   }
   aquery->lookups = ares_strdup(channel->lookups);
   if (aquery->lookups == NULL) {
     /* LCOV_EXCL_START: OutOfMemory */
     ares_free(aquery);
-    callback(arg, ARES_ENOMEM, 0, NULL);
-    return;
+    return NULL;
     /* LCOV_EXCL_STOP */
   }
   aquery->channel = channel;
-  if (family == AF_INET) {
-    memcpy(&aquery->addr.addr.addr4, addr, sizeof(aquery->addr.addr.addr4));
+  if (addr->family == AF_INET) {
+    memcpy(&aquery->addr.addr.addr4, &addr->addr.addr4,
+           sizeof(aquery->addr.addr.addr4));
   } else {
-    memcpy(&aquery->addr.addr.addr6, addr, sizeof(aquery->addr.addr.addr6));
+    memcpy(&aquery->addr.addr.addr6, &addr->addr.addr6,
+           sizeof(aquery->addr.addr.addr6));
   }
-  aquery->addr.family       = family;
+  aquery->addr.family       = addr->family;
   aquery->callback          = callback;
   aquery->arg               = arg;
   aquery->remaining_lookups = aquery->lookups;
   aquery->timeouts          = 0;
 
+  return aquery;
+}
+
+void ares_gethostbyaddr_nolock(ares_channel_t *channel, const void *addr,
+                               int addrlen, int family,
+                               ares_host_callback callback, void *arg)
+{
+  struct addr_query *aquery;
+  struct ares_addr   aaddr;
+
+  if (family != AF_INET && family != AF_INET6) {
+    callback(arg, ARES_ENOTIMP, 0, NULL);
+    return;
+  }
+
+  if ((family == AF_INET && addrlen != sizeof(aaddr.addr.addr4)) ||
+      (family == AF_INET6 && addrlen != sizeof(aaddr.addr.addr6))) {
+    callback(arg, ARES_ENOTIMP, 0, NULL);
+    return;
+  }
+
+  memset(&aaddr, 0, sizeof(aaddr));
+  aaddr.family = family;
+  memcpy(&aaddr.addr, addr, (size_t)addrlen);
+
+  aquery = addr_query_create(channel, &aaddr, callback, arg);
+  if (aquery == NULL) {
+    callback(arg, ARES_ENOMEM, 0, NULL);
+    return;
+  }
+
   next_lookup(aquery);
 }
 
@@ -116,8 +145,149 @@ void ares_gethostbyaddr(ares_channel_t *channel, const void *addr, int addrlen,
   ares_channel_unlock(channel);
 }
 
+static ares_status_t addr_query_add_waiter(struct addr_query *aquery,
+                                           ares_host_callback callback,
+                                           void              *arg)
+{
+  addr_waiter_t *waiter;
+
+  if (aquery->waiters == NULL) {
+    aquery->waiters = ares_llist_create(ares_free);
+    if (aquery->waiters == NULL) {
+      return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  waiter = ares_malloc(sizeof(*waiter));
+  if (waiter == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+  waiter->callback = callback;
+  waiter->arg      = arg;
+
+  if (ares_llist_insert_last(aquery->waiters, waiter) == NULL) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    ares_free(waiter);
+    return ARES_ENOMEM;
+    /* LCOV_EXCL_STOP */
+  }
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_gethostbyaddr_batch(ares_channel_t          *channel,
+                                       const ares_batch_addr_t *addrs,
+                                       size_t cnt, ares_host_callback callback)
+{
+  ares_status_t        status   = ARES_SUCCESS;
+  struct addr_query  **aqueries = NULL;
+  ares_htable_strvp_t *seen     = NULL;
+  size_t               naqueries = 0;
+  ares_bool_t          nested;
+  size_t               i;
+
+  if (channel == NULL || (addrs == NULL && cnt != 0)) {
+    return ARES_EFORMERR;
+  }
+
+  /* An unusable address or a missing callback rejects the whole batch before
+   * anything is looked up.  Failures past this point only cost the address
+   * affected its lookup, its callback is told and the others carry on. */
+  for (i = 0; i < cnt; i++) {
+    if ((addrs[i].addr.family != AF_INET &&
+         addrs[i].addr.family != AF_INET6) ||
+        (addrs[i].callback == NULL && callback == NULL)) {
+      return ARES_EFORMERR;
+    }
+  }
+
+  if (cnt == 0) {
+    return ARES_SUCCESS;
+  }
+
+  aqueries = ares_malloc_zero(cnt * sizeof(*aqueries));
+  seen     = ares_htable_strvp_create(NULL);
+  if (aqueries == NULL || seen == NULL) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    ares_free(aqueries);
+    ares_htable_strvp_destroy(seen);
+    return ARES_ENOMEM;
+    /* LCOV_EXCL_STOP */
+  }
+
+  ares_channel_lock(channel);
+
+  /* PTR queries are written out together once every lookup is started.
+   * Addresses found in the hosts file or the query cache call back before
+   * that, and if such a callback starts a batch of its own the writes are
+   * left for this one to flush. */
+  nested                = channel->defer_writes;
+  channel->defer_writes = ARES_TRUE;
+
+  /* Duplicate addresses share a single lookup.  All lookups are set up before
+   * any is started as one may complete, and be freed, right away. */
+  for (i = 0; i < cnt; i++) {
+    const ares_batch_addr_t *baddr = &addrs[i];
+    ares_host_callback       cb =
+      baddr->callback != NULL ? baddr->callback : callback;
+    char               ipaddr[INET6_ADDRSTRLEN];
+    struct addr_query *aquery = NULL;
+    ares_status_t      astatus;
+
+    if (ares_inet_ntop(baddr->addr.family, &baddr->addr.addr, ipaddr,
+                       sizeof(ipaddr)) == NULL) {
+      astatus = ARES_EBADSTR; /* LCOV_EXCL_LINE: DefensiveCoding */
+      goto fail;              /* LCOV_EXCL_LINE: DefensiveCoding */
+    }
+
+    aquery = ares_htable_strvp_get_direct(seen, ipaddr);
+    if (aquery != NULL) {
+      astatus = addr_query_add_waiter(aquery, cb, baddr->arg);
+      if (astatus != ARES_SUCCESS) {
+        goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+      continue;
+    }
+
+    aquery = addr_query_create(channel, &baddr->addr, cb, baddr->arg);
+    if (aquery == NULL) {
+      astatus = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+      goto fail;             /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+    aqueries[naqueries++] = aquery;
+
+    /* On failure the address just won't be coalesced */
+    ares_htable_strvp_insert(seen, ipaddr, aquery);
+    continue;
+
+  /* LCOV_EXCL_START: OutOfMemory */
+  fail:
+    cb(baddr->arg, (int)astatus, 0, NULL);
+    if (status == ARES_SUCCESS) {
+      status = astatus;
+    }
+    /* LCOV_EXCL_STOP */
+  }
+
+  for (i = 0; i < naqueries; i++) {
+    next_lookup(aqueries[i]);
+  }
+
+  if (!nested) {
+    ares_flush_deferred_writes(channel);
+  }
+
+  ares_channel_unlock(channel);
+
+  ares_htable_strvp_destroy(seen);
+  ares_free(aqueries);
+
+  return status;
+}
+
 static void next_lookup(struct addr_query *aquery)
 {
+  /* aquery is gone once addr_callback() returns, so hold on to the channel */
+  ares_channel_t *channel = aquery->channel;
   const char     *p;
   ares_status_t   status;
   struct hostent *host = NULL;
@@ -126,19 +296,40 @@ static void next_lookup(struct addr_query *aquery)
   for (p = aquery->remaining_lookups; *p; p++) {
     switch (*p) {
       case 'b':
+        aquery->remaining_lookups = p + 1;
+
+        /* A cached answer doesn't need the query name built at all */
+        if (ares_slist_len(channel->servers) != 0) {
+          const ares_dns_record_t *dnsrec = NULL;
+          ares_timeval_t           now;
+
+          ares_tvnow(&now);
+          status =
+            ares_qcache_fetch_ptr(channel, &now, &aquery->addr, &dnsrec);
+          if (status == ARES_SUCCESS) {
+            status = ares_dns_query_reply_tostatus(
+              ares_dns_record_get_rcode(dnsrec),
+              ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER));
+            ARES_TRACE(channel, ARES_TRACE_QCACHE_HIT, 0, NULL, ARES_SUCCESS,
+                       0);
+            addr_callback(aquery, status, 0, dnsrec);
+            ARES_TRACE(channel, ARES_TRACE_QUERY_CALLBACK, 0, NULL, status, 0);
+            return;
+          }
+        }
+
         name = ares_dns_addr_to_ptr(&aquery->addr);
         if (name == NULL) {
           end_aquery(aquery, ARES_ENOMEM,
                      NULL); /* LCOV_EXCL_LINE: OutOfMemory */
           return;           /* LCOV_EXCL_LINE: OutOfMemory */
         }
-        aquery->remaining_lookups = p + 1;
-        ares_query_nolock(aquery->channel, name, ARES_CLASS_IN,
-                          ARES_REC_TYPE_PTR, addr_callback, aquery, NULL);
+        ares_query_nolock(channel, name, ARES_CLASS_IN, ARES_REC_TYPE_PTR,
+                          addr_callback, aquery, NULL);
         ares_free(name);
         return;
       case 'f':
-        status = file_lookup(aquery->channel, &aquery->addr, &host);
+        status = file_lookup(channel, &aquery->addr, &host);
 
         /* this status check below previously checked for !ARES_ENOTFOUND,
            but we should not assume that this single error code is the one
@@ -184,10 +375,18 @@ static void addr_callback(void *arg, ares_status_t status, size_t timeouts,
 static void end_aquery(struct addr_query *aquery, ares_status_t status,
                        struct hostent *host)
 {
+  ares_llist_node_t *node;
+
   aquery->callback(aquery->arg, (int)status, (int)aquery->timeouts, host);
+  for (node = ares_llist_node_first(aquery->waiters); node != NULL;
+       node = ares_llist_node_next(node)) {
+    const addr_waiter_t *waiter = ares_llist_node_val(node);
+    waiter->callback(waiter->arg, (int)status, (int)aquery->timeouts, host);
+  }
   if (host) {
     ares_free_hostent(host);
   }
+  ares_llist_destroy(aquery->waiters);
   ares_free(aquery->lookups);
   ares_free(aquery);
 }
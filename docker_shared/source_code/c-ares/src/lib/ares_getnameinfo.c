@@ -25,13 +25,6 @@
  */
 #include "ares_private.h"
 
-#ifdef HAVE_GETSERVBYPORT_R
-#  if !defined(GETSERVBYPORT_R_ARGS) || (GETSERVBYPORT_R_ARGS < 4) || \
-    (GETSERVBYPORT_R_ARGS > 6)
-#    error "you MUST specify a valid number of arguments for getservbyport_r"
-#  endif
-#endif
-
 #ifdef HAVE_NETINET_IN_H
 #  include <netinet/in.h>
 #endif
@@ -54,6 +47,7 @@
 #include "ares_ipv6.h"
 
 struct nameinfo_query {
+  ares_channel_t        *channel;
   ares_nameinfo_callback callback;
   void                  *arg;
 
@@ -76,10 +70,11 @@ struct nameinfo_query {
 
 static void  nameinfo_callback(void *arg, int status, int timeouts,
                                struct hostent *host);
-static char *lookup_service(unsigned short port, unsigned int flags, char *buf,
-                            size_t buflen);
+static char *lookup_service(ares_channel_t *channel, unsigned short port,
+                            unsigned int flags, char *buf, size_t buflen);
 #ifdef HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID
-static void append_scopeid(const struct sockaddr_in6 *addr6, unsigned int flags,
+static void append_scopeid(ares_channel_t            *channel,
+                           const struct sockaddr_in6 *addr6, unsigned int flags,
                            char *buf, size_t buflen);
 #endif
 static char *ares_striendstr(const char *s1, const char *s2);
@@ -120,7 +115,8 @@ static void  ares_getnameinfo_int(ares_channel_t        *channel,
     char *service;
 
     service =
-      lookup_service((unsigned short)(port & 0xffff), flags, buf, sizeof(buf));
+      lookup_service(channel, (unsigned short)(port & 0xffff), flags, buf,
+                     sizeof(buf));
     callback(arg, ARES_SUCCESS, 0, NULL, service);
     return;
   }
@@ -145,15 +141,15 @@ static void  ares_getnameinfo_int(ares_channel_t        *channel,
         ares_inet_ntop(AF_INET6, &addr6->sin6_addr, ipbuf, IPBUFSIZ);
         /* If the system supports scope IDs, use it */
 #ifdef HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID
-        append_scopeid(addr6, flags, ipbuf, sizeof(ipbuf));
+        append_scopeid(channel, addr6, flags, ipbuf, sizeof(ipbuf));
 #endif
       } else {
         ares_inet_ntop(AF_INET, &addr->sin_addr, ipbuf, IPBUFSIZ);
       }
       /* They also want a service */
       if (flags & ARES_NI_LOOKUPSERVICE) {
-        service = lookup_service((unsigned short)(port & 0xffff), flags, srvbuf,
-                                 sizeof(srvbuf));
+        service = lookup_service(channel, (unsigned short)(port & 0xffff),
+                                 flags, srvbuf, sizeof(srvbuf));
       }
       callback(arg, ARES_SUCCESS, 0, ipbuf, service);
       return;
@@ -164,6 +160,7 @@ static void  ares_getnameinfo_int(ares_channel_t        *channel,
         callback(arg, ARES_ENOMEM, 0, NULL, NULL);
         return;
       }
+      niquery->channel  = channel;
       niquery->callback = callback;
       niquery->arg      = arg;
       niquery->flags    = flags;
@@ -210,11 +207,13 @@ static void nameinfo_callback(void *arg, int status, int timeouts,
     /* They want a service too */
     if (niquery->flags & ARES_NI_LOOKUPSERVICE) {
       if (niquery->family == AF_INET) {
-        service = lookup_service(niquery->addr.addr4.sin_port, niquery->flags,
-                                 srvbuf, sizeof(srvbuf));
+        service =
+          lookup_service(niquery->channel, niquery->addr.addr4.sin_port,
+                         niquery->flags, srvbuf, sizeof(srvbuf));
       } else {
-        service = lookup_service(niquery->addr.addr6.sin6_port, niquery->flags,
-                                 srvbuf, sizeof(srvbuf));
+        service =
+          lookup_service(niquery->channel, niquery->addr.addr6.sin6_port,
+                         niquery->flags, srvbuf, sizeof(srvbuf));
       }
     }
     /* NOFQDN means we have to strip off the domain name portion.  We do
@@ -247,18 +246,20 @@ static void nameinfo_callback(void *arg, int status, int timeouts,
     } else {
       ares_inet_ntop(AF_INET6, &niquery->addr.addr6.sin6_addr, ipbuf, IPBUFSIZ);
 #ifdef HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID
-      append_scopeid(&niquery->addr.addr6, niquery->flags, ipbuf,
-                     sizeof(ipbuf));
+      append_scopeid(niquery->channel, &niquery->addr.addr6, niquery->flags,
+                     ipbuf, sizeof(ipbuf));
 #endif
     }
     /* They want a service too */
     if (niquery->flags & ARES_NI_LOOKUPSERVICE) {
       if (niquery->family == AF_INET) {
-        service = lookup_service(niquery->addr.addr4.sin_port, niquery->flags,
-                                 srvbuf, sizeof(srvbuf));
+        service =
+          lookup_service(niquery->channel, niquery->addr.addr4.sin_port,
+                         niquery->flags, srvbuf, sizeof(srvbuf));
       } else {
-        service = lookup_service(niquery->addr.addr6.sin6_port, niquery->flags,
-                                 srvbuf, sizeof(srvbuf));
+        service =
+          lookup_service(niquery->channel, niquery->addr.addr6.sin6_port,
+                         niquery->flags, srvbuf, sizeof(srvbuf));
       }
     }
     niquery->callback(niquery->arg, ARES_SUCCESS, (int)niquery->timeouts, ipbuf,
@@ -270,22 +271,16 @@ static void nameinfo_callback(void *arg, int status, int timeouts,
   ares_free(niquery);
 }
 
-static char *lookup_service(unsigned short port, unsigned int flags, char *buf,
-                            size_t buflen)
+static char *lookup_service(ares_channel_t *channel, unsigned short port,
+                            unsigned int flags, char *buf, size_t buflen)
 {
-  const char     *proto;
-  struct servent *sep;
-#ifdef HAVE_GETSERVBYPORT_R
-  struct servent se;
-#endif
-  char        tmpbuf[4096];
-  const char *name;
+  const char *proto;
+  const char *name = NULL;
+  char        tmpbuf[8];
   size_t      name_len;
 
   if (port) {
-    if (flags & ARES_NI_NUMERICSERV) {
-      sep = NULL;
-    } else {
+    if (!(flags & ARES_NI_NUMERICSERV)) {
       if (flags & ARES_NI_UDP) {
         proto = "udp";
       } else if (flags & ARES_NI_SCTP) {
@@ -295,38 +290,10 @@ static char *lookup_service(unsigned short port, unsigned int flags, char *buf,
       } else {
         proto = "tcp";
       }
-#ifdef HAVE_GETSERVBYPORT_R
-      memset(&se, 0, sizeof(se));
-      sep = &se;
-      memset(tmpbuf, 0, sizeof(tmpbuf));
-#  if GETSERVBYPORT_R_ARGS == 6
-      if (getservbyport_r(port, proto, &se, (void *)tmpbuf, sizeof(tmpbuf),
-                          &sep) != 0) {
-        sep = NULL; /* LCOV_EXCL_LINE: buffer large so this never fails */
-      }
-#  elif GETSERVBYPORT_R_ARGS == 5
-      sep = getservbyport_r(port, proto, &se, (void *)tmpbuf, sizeof(tmpbuf));
-#  elif GETSERVBYPORT_R_ARGS == 4
-      if (getservbyport_r(port, proto, &se, (void *)tmpbuf) != 0) {
-        sep = NULL;
-      }
-#  else
-      /* Lets just hope the OS uses TLS! */
-      sep = getservbyport(port, proto);
-#  endif
-#else
-      /* Lets just hope the OS uses TLS! */
-#  if (defined(NETWARE) && !defined(__NOVELL_LIBC__))
-      sep = getservbyport(port, (char *)proto);
-#  else
-      sep = getservbyport(port, proto);
-#  endif
-#endif
+      name = ares_services_port_to_name(ares_services_get(channel),
+                                        ntohs(port), proto);
     }
-    if (sep && sep->s_name) {
-      /* get service name */
-      name = sep->s_name;
-    } else {
+    if (name == NULL) {
       /* get port as a string */
       snprintf(tmpbuf, sizeof(tmpbuf), "%u", (unsigned int)ntohs(port));
       name = tmpbuf;
@@ -346,7 +313,8 @@ static char *lookup_service(unsigned short port, unsigned int flags, char *buf,
 }
 
 #ifdef HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID
-static void append_scopeid(const struct sockaddr_in6 *addr6, unsigned int flags,
+static void append_scopeid(ares_channel_t            *channel,
+                           const struct sockaddr_in6 *addr6, unsigned int flags,
                            char *buf, size_t buflen)
 {
 #  ifdef HAVE_IF_INDEXTONAME
@@ -365,7 +333,9 @@ static void append_scopeid(const struct sockaddr_in6 *addr6, unsigned int flags,
     snprintf(&tmpbuf[1], sizeof(tmpbuf) - 1, "%lu",
              (unsigned long)addr6->sin6_scope_id);
   } else {
-    if (if_indextoname(addr6->sin6_scope_id, &tmpbuf[1]) == NULL) {
+    if (ares_iface_cache_indextoname(channel, addr6->sin6_scope_id,
+                                     &tmpbuf[1],
+                                     sizeof(tmpbuf) - 1) == NULL) {
       snprintf(&tmpbuf[1], sizeof(tmpbuf) - 1, "%lu",
                (unsigned long)addr6->sin6_scope_id);
     }
@@ -373,6 +343,7 @@ static void append_scopeid(const struct sockaddr_in6 *addr6, unsigned int flags,
 #  else
   snprintf(&tmpbuf[1], sizeof(tmpbuf) - 1, "%lu",
            (unsigned long)addr6->sin6_scope_id);
+  (void)channel;
   (void)flags;
 #  endif
   tmpbuf[IF_NAMESIZE + 1] = '\0';
@@ -594,8 +594,8 @@ done:
   return status;
 }
 
-static ares_bool_t ares_hosts_expired(const char              *filename,
-                                      const ares_hosts_file_t *hf)
+ares_bool_t ares_file_expired(const char *filename, const char *loaded_name,
+                              time_t loaded_ts)
 {
   time_t mod_ts = 0;
 
@@ -613,10 +613,6 @@ static ares_bool_t ares_hosts_expired(const char              *filename,
   (void)filename;
 #endif
 
-  if (hf == NULL) {
-    return ARES_TRUE;
-  }
-
   /* Expire every 60s if we can't get a time */
   if (mod_ts == 0) {
     mod_ts =
@@ -624,17 +620,27 @@ static ares_bool_t ares_hosts_expired(const char              *filename,
   }
 
   /* If filenames are different, its expired */
-  if (!ares_strcaseeq(hf->filename, filename)) {
+  if (!ares_strcaseeq(loaded_name, filename)) {
     return ARES_TRUE;
   }
 
-  if (hf->ts <= mod_ts) {
+  if (loaded_ts <= mod_ts) {
     return ARES_TRUE;
   }
 
   return ARES_FALSE;
 }
 
+static ares_bool_t ares_hosts_expired(const char              *filename,
+                                      const ares_hosts_file_t *hf)
+{
+  if (hf == NULL) {
+    return ARES_TRUE;
+  }
+
+  return ares_file_expired(filename, hf->filename, hf->ts);
+}
+
 static ares_status_t ares_hosts_path(const ares_channel_t *channel,
                                      ares_bool_t use_env, char **path)
 {
@@ -0,0 +1,119 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "ares_private.h"
+
+#ifdef HAVE_NET_IF_H
+#  include <net/if.h>
+#endif
+
+/* Translating an interface index to its name, as done when formatting
+ * link-local scope ids, costs an if_indextoname() system call per lookup.  Instead the channel keeps
+ * a snapshot of the interface table, enumerated on first use.  It is flushed
+ * on reinit and on interface changes when the event thread can monitor for
+ * them, and otherwise simply expires. */
+#define ARES_IFACE_CACHE_TTL 60 /* seconds */
+
+static const ares_iface_ips_t *ares_iface_cache_get(ares_channel_t *channel)
+{
+  ares_timeval_t now;
+
+  ares_tvnow(&now);
+  if (!ares_timedout(&now, &channel->iface_ips_expire)) {
+    return channel->iface_ips;
+  }
+
+  ares_iface_ips_destroy(channel->iface_ips);
+  channel->iface_ips = NULL;
+
+  /* On failure there is simply no table until it expires again, lookups fall
+   * back to the operating system meanwhile */
+  if (ares_iface_ips(&channel->iface_ips,
+                     ARES_IFACE_IP_DEFAULT | ARES_IFACE_IP_OFFLINE,
+                     NULL) != ARES_SUCCESS) {
+    channel->iface_ips = NULL;
+  }
+
+  channel->iface_ips_expire.sec  = now.sec + ARES_IFACE_CACHE_TTL;
+  channel->iface_ips_expire.usec = now.usec;
+  return channel->iface_ips;
+}
+
+/* Only link-local IPv6 addresses carry the index of their interface */
+static ares_bool_t ares_iface_cache_has_index(const ares_iface_ips_t *ips,
+                                              size_t                  idx)
+{
+  return (ares_iface_ips_get_flags(ips, idx) & ARES_IFACE_IP_LINKLOCAL &&
+          ares_iface_ips_get_ll_scope(ips, idx) != 0)
+           ? ARES_TRUE
+           : ARES_FALSE;
+}
+
+const char *ares_iface_cache_lookup(ares_channel_t *channel,
+                                    unsigned int    index)
+{
+  const ares_iface_ips_t *ips;
+  size_t                  i;
+
+  if (index == 0) {
+    return NULL;
+  }
+
+  ips = ares_iface_cache_get(channel);
+  for (i = 0; i < ares_iface_ips_cnt(ips); i++) {
+    if (ares_iface_cache_has_index(ips, i) &&
+        ares_iface_ips_get_ll_scope(ips, i) == index) {
+      return ares_iface_ips_get_name(ips, i);
+    }
+  }
+
+  return NULL;
+}
+
+const char *ares_iface_cache_indextoname(ares_channel_t *channel,
+                                         unsigned int index, char *name,
+                                         size_t name_len)
+{
+  const char *cached;
+
+  if (name == NULL || name_len < IF_NAMESIZE || index == 0) {
+    return NULL;
+  }
+
+  cached = ares_iface_cache_lookup(channel, index);
+  if (cached != NULL) {
+    ares_strcpy(name, cached, name_len);
+    return name;
+  }
+
+  return ares_os_if_indextoname(index, name, name_len);
+}
+
+void ares_iface_cache_flush(ares_channel_t *channel)
+{
+  ares_iface_ips_destroy(channel->iface_ips);
+  channel->iface_ips = NULL;
+  memset(&channel->iface_ips_expire, 0, sizeof(channel->iface_ips_expire));
+}
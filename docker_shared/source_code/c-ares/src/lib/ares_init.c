@@ -282,17 +282,25 @@ int ares_init_options(ares_channel_t           **channelptr,
   }
 
   /* Initialize our lists of queries */
+  channel->query_pool = ares_pool_create(ARES_QUERY_POOL_MAX);
+  if (channel->query_pool == NULL) {
+    status = ARES_ENOMEM;
+    goto done;
+  }
+
   channel->all_queries = ares_llist_create(NULL);
   if (channel->all_queries == NULL) {
     status = ARES_ENOMEM;
     goto done;
   }
+  ares_llist_set_pool(channel->all_queries, channel->query_pool);
 
   channel->queries_by_qid = ares_htable_szvp_create(NULL);
   if (channel->queries_by_qid == NULL) {
     status = ARES_ENOMEM;
     goto done;
   }
+  ares_htable_szvp_set_pool(channel->queries_by_qid, channel->query_pool);
 
   channel->queries_by_timeout =
     ares_slist_create(channel->rand_state, ares_query_timeout_cmp_cb, NULL);
@@ -300,6 +308,7 @@ int ares_init_options(ares_channel_t           **channelptr,
     status = ARES_ENOMEM;
     goto done;
   }
+  ares_slist_set_pool(channel->queries_by_timeout, channel->query_pool);
 
   channel->connnode_by_socket = ares_htable_asvp_create(NULL);
   if (channel->connnode_by_socket == NULL) {
@@ -398,6 +407,10 @@ static void *ares_reinit_thread(void *arg)
     ares_qcache_flush(channel->qcache);
   }
 
+  /* Interfaces may have changed too */
+  ares_sortaddrinfo_cache_flush(channel);
+  ares_iface_cache_flush(channel);
+
   channel->reinit_pending = ARES_FALSE;
   ares_channel_unlock(channel);
 
@@ -499,6 +512,17 @@ int ares_dup(ares_channel_t **dest, const ares_channel_t *src)
   (*dest)->notify_pending_write_cb_data = src->notify_pending_write_cb_data;
   (*dest)->query_enqueue_cb             = src->query_enqueue_cb;
   (*dest)->query_enqueue_cb_data        = src->query_enqueue_cb_data;
+  (*dest)->timeout_percentile           = src->timeout_percentile;
+  (*dest)->resolution_delay             = src->resolution_delay;
+  (*dest)->server_select                = src->server_select;
+  (*dest)->hedge_percentile             = src->hedge_percentile;
+  (*dest)->hedge_budget                 = src->hedge_budget;
+  (*dest)->qcache_negative_ttl          = src->qcache_negative_ttl;
+  (*dest)->qcache_servfail_ttl          = src->qcache_servfail_ttl;
+
+  /* Hedge credit is runtime state, the copy starts with the full burst that
+   * ares_set_query_hedging() grants */
+  (*dest)->hedge_credit = (src->hedge_budget != 0) ? ARES_HEDGE_CREDIT_MAX : 0;
 
   ares_strcpy((*dest)->local_dev_name, src->local_dev_name,
               sizeof((*dest)->local_dev_name));
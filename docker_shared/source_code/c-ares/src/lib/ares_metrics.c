@@ -88,11 +88,26 @@
  *   adjust if necessary
  * - Increment "count" by 1 and "total time" by the query time
  *
+ * Averages hide tail latency, so each bucket also carries a log-linear
+ * (HDR-style) histogram of latencies.  Each power of two is split into
+ * ARES_METRICS_HIST_SUB_CNT linear sub-buckets, so the relative error of any
+ * reported value is bounded regardless of magnitude, while the histogram is a
+ * fixed size array of counters that is cheap to update.  Latencies below
+ * ARES_METRICS_HIST_SUB_CNT ms are recorded exactly.  If a timeout percentile
+ * is configured via ares_set_server_timeout_percentile(), the timeout becomes
+ * the latency at that percentile multiplied by "Percentile Timeout
+ * Multiplier" (2x) rather than the average latency multiplied by 5x.
+ *
+ * The same histogram drives hedged queries (ares_set_query_hedging()): once a
+ * query has been outstanding longer than the configured percentile latency of
+ * its server, a duplicate is sent to another server.
+ *
  * Other Notes:
- * - This is always-on, the only user-configurable value is the initial
- *   timeout which will simply re-uses the current option.
- * - Minimum and Maximum latencies for a bucket are currently unused but are
- *   there in case we find a need for them in the future.
+ * - This is always-on, the only user-configurable values are the initial
+ *   timeout which will simply re-uses the current option, and the optional
+ *   timeout percentile.
+ * - Minimum and Maximum latencies are exported via ares_get_server_latency()
+ *   along with the p50/p90/p99 percentiles derived from the histogram.
  */
 
 #include "ares_private.h"
@@ -107,32 +122,58 @@
 /*! Upper timeout bounds, only used if channel->maxtimeout not set */
 #define MAX_TIMEOUT_MS 5000
 
+/*! Multiplier to apply to percentile latency to come up with a timeout */
+#define PCTL_TIMEOUT_MULTIPLIER 2
+
 /*! Minimum queries required to form an average */
 #define MIN_COUNT_FOR_AVERAGE 3
 
-static time_t ares_metric_timestamp(ares_server_bucket_t  bucket,
-                                    const ares_timeval_t *now,
-                                    ares_bool_t           is_previous)
-{
-  time_t divisor = 1; /* Silence bogus MSVC warning by setting default value */
+/*! Minimum queries required before a latency percentile is trusted for
+ *  hedging, too few and the tail is just the slowest query */
+#define MIN_COUNT_FOR_HEDGE 10
 
+/*! Snapshot of the data in a bucket for either the current or previous
+ *  period */
+typedef struct {
+  time_t              ts;
+  unsigned int        latency_min_ms;
+  unsigned int        latency_max_ms;
+  ares_uint64_t       total_ms;
+  ares_uint64_t       total_count;
+  const unsigned int *hist;
+} ares_metrics_view_t;
+
+/* Length of the bucket's period in seconds, 0 if it never rolls over */
+static time_t ares_metric_period(ares_server_bucket_t bucket)
+{
   switch (bucket) {
     case ARES_METRIC_1MINUTE:
-      divisor = 60;
-      break;
+      return 60;
     case ARES_METRIC_15MINUTES:
-      divisor = 15 * 60;
-      break;
+      return 15 * 60;
     case ARES_METRIC_1HOUR:
-      divisor = 60 * 60;
-      break;
+      return 60 * 60;
     case ARES_METRIC_1DAY:
-      divisor = 24 * 60 * 60;
-      break;
+      return 24 * 60 * 60;
     case ARES_METRIC_INCEPTION:
-      return is_previous ? 0 : 1;
     case ARES_METRIC_COUNT:
-      return 0; /* Invalid! */
+      break;
+  }
+  return 0;
+}
+
+static time_t ares_metric_timestamp(ares_server_bucket_t  bucket,
+                                    const ares_timeval_t *now,
+                                    ares_bool_t           is_previous)
+{
+  time_t divisor = ares_metric_period(bucket);
+
+  if (bucket == ARES_METRIC_INCEPTION) {
+    return is_previous ? 0 : 1;
+  }
+
+  if (divisor == 0) {
+    return 0; /* Invalid! */
   }
 
   if (is_previous) {
@@ -145,12 +186,129 @@ static time_t ares_metric_timestamp(ares_server_bucket_t  bucket,
   return (time_t)(now->sec / divisor);
 }
 
+/* Map a latency to its histogram bucket.  Values below the sub-bucket count
+ * map 1:1, after that each power of two is split into
+ * ARES_METRICS_HIST_SUB_CNT equally sized buckets */
+static size_t ares_metrics_hist_idx(unsigned int ms)
+{
+  unsigned int msb   = 0;
+  unsigned int shift = 0;
+
+  if (ms > ARES_METRICS_HIST_MAX_MS) {
+    ms = ARES_METRICS_HIST_MAX_MS;
+  }
+
+  if (ms < ARES_METRICS_HIST_SUB_CNT) {
+    return ms;
+  }
+
+  while ((ms >> (msb + 1)) != 0) {
+    msb++;
+  }
+
+  shift = msb - ARES_METRICS_HIST_SUB_BITS;
+  return ((size_t)shift + 1) * ARES_METRICS_HIST_SUB_CNT +
+         ((ms >> shift) - ARES_METRICS_HIST_SUB_CNT);
+}
+
+/* Highest latency that maps into the given histogram bucket */
+static unsigned int ares_metrics_hist_val(size_t idx)
+{
+  size_t shift;
+  size_t sub;
+
+  if (idx < ARES_METRICS_HIST_SUB_CNT) {
+    return (unsigned int)idx;
+  }
+
+  shift = (idx / ARES_METRICS_HIST_SUB_CNT) - 1;
+  sub   = (idx % ARES_METRICS_HIST_SUB_CNT) + ARES_METRICS_HIST_SUB_CNT;
+  return (unsigned int)(((sub + 1) << shift) - 1);
+}
+
+static unsigned int ares_metrics_percentile(const ares_metrics_view_t *view,
+                                            unsigned int percentile)
+{
+  ares_uint64_t target;
+  ares_uint64_t cnt = 0;
+  size_t        i;
+  unsigned int  val = view->latency_max_ms;
+
+  if (view->total_count == 0) {
+    return 0;
+  }
+
+  /* Rank of the sample we're looking for, rounded up */
+  target = (view->total_count * percentile + 99) / 100;
+  if (target == 0) {
+    target = 1;
+  }
+
+  for (i = 0; i < ARES_METRICS_HIST_CNT; i++) {
+    cnt += view->hist[i];
+    if (cnt >= target) {
+      val = ares_metrics_hist_val(i);
+      break;
+    }
+  }
+
+  /* The bucket value is an upper bound, so never report something outside
+   * of what was actually observed */
+  if (val > view->latency_max_ms) {
+    val = view->latency_max_ms;
+  }
+  if (val < view->latency_min_ms) {
+    val = view->latency_min_ms;
+  }
+
+  return val;
+}
+
+/* Retrieve the data for the bucket, preferring the current period but falling
+ * back to the previous period if the current period doesn't have at least
+ * min_count entries */
+static ares_bool_t ares_metrics_view(const ares_server_t  *server,
+                                     ares_server_bucket_t  bucket,
+                                     const ares_timeval_t *now,
+                                     ares_uint64_t         min_count,
+                                     ares_metrics_view_t  *view)
+{
+  const ares_server_metrics_t *metrics = &server->metrics[bucket];
+  time_t ts = ares_metric_timestamp(bucket, now, ARES_FALSE);
+
+  if (ts == metrics->ts && metrics->total_count >= min_count) {
+    view->ts             = ts;
+    view->latency_min_ms = metrics->latency_min_ms;
+    view->latency_max_ms = metrics->latency_max_ms;
+    view->total_ms       = metrics->total_ms;
+    view->total_count    = metrics->total_count;
+    view->hist           = metrics->hist;
+    return ARES_TRUE;
+  }
+
+  /* This ts has been invalidated, see if we should use the previous
+   * time period */
+  ts = ares_metric_timestamp(bucket, now, ARES_TRUE);
+  if (ts != metrics->prev_ts || metrics->prev_total_count < min_count) {
+    return ARES_FALSE;
+  }
+
+  view->ts             = ts;
+  view->latency_min_ms = metrics->prev_latency_min_ms;
+  view->latency_max_ms = metrics->prev_latency_max_ms;
+  view->total_ms       = metrics->prev_total_ms;
+  view->total_count    = metrics->prev_total_count;
+  view->hist           = metrics->prev_hist;
+  return ARES_TRUE;
+}
+
 void ares_metrics_record(const ares_query_t *query, ares_server_t *server,
                          ares_status_t status, const ares_dns_record_t *dnsrec)
 {
   ares_timeval_t       now;
   ares_timeval_t       tvdiff;
   unsigned int         query_ms;
+  size_t               hist_idx;
   ares_dns_rcode_t     rcode;
   ares_server_bucket_t i;
 
@@ -175,6 +333,16 @@ void ares_metrics_record(const ares_query_t *query, ares_server_t *server,
     query_ms = 1;
   }
 
+  hist_idx = ares_metrics_hist_idx(query_ms);
+
+  /* Same smoothing as the TCP SRTT estimator (RFC 6298), alpha = 1/8 */
+  if (server->latency_ewma8 == 0) {
+    server->latency_ewma8 = query_ms * 8;
+  } else {
+    server->latency_ewma8 =
+      server->latency_ewma8 - (server->latency_ewma8 / 8) + query_ms;
+  }
+
   /* Place in each bucket */
   for (i = 0; i < ARES_METRIC_COUNT; i++) {
     time_t ts = ares_metric_timestamp(i, &now, ARES_FALSE);
@@ -182,13 +350,20 @@ void ares_metrics_record(const ares_query_t *query, ares_server_t *server,
     /* Copy metrics to prev and clear */
     if (ts != server->metrics[i].ts) {
       server->metrics[i].prev_ts          = server->metrics[i].ts;
+      server->metrics[i].prev_latency_min_ms =
+        server->metrics[i].latency_min_ms;
+      server->metrics[i].prev_latency_max_ms =
+        server->metrics[i].latency_max_ms;
       server->metrics[i].prev_total_ms    = server->metrics[i].total_ms;
       server->metrics[i].prev_total_count = server->metrics[i].total_count;
+      memcpy(server->metrics[i].prev_hist, server->metrics[i].hist,
+             sizeof(server->metrics[i].prev_hist));
       server->metrics[i].ts               = ts;
       server->metrics[i].latency_min_ms   = 0;
       server->metrics[i].latency_max_ms   = 0;
       server->metrics[i].total_ms         = 0;
       server->metrics[i].total_count      = 0;
+      memset(server->metrics[i].hist, 0, sizeof(server->metrics[i].hist));
     }
 
     if (server->metrics[i].latency_min_ms == 0 ||
@@ -202,6 +377,7 @@ void ares_metrics_record(const ares_query_t *query, ares_server_t *server,
 
     server->metrics[i].total_count++;
     server->metrics[i].total_ms += (ares_uint64_t)query_ms;
+    server->metrics[i].hist[hist_idx]++;
   }
 }
 
@@ -214,29 +390,22 @@ size_t ares_metrics_server_timeout(const ares_server_t  *server,
   size_t                max_timeout_ms;
 
   for (i = 0; i < ARES_METRIC_COUNT; i++) {
-    time_t ts = ares_metric_timestamp(i, now, ARES_FALSE);
-
-    /* This ts has been invalidated, see if we should use the previous
-     * time period */
-    if (ts != server->metrics[i].ts ||
-        server->metrics[i].total_count < MIN_COUNT_FOR_AVERAGE) {
-      time_t prev_ts = ares_metric_timestamp(i, now, ARES_TRUE);
-      if (prev_ts != server->metrics[i].prev_ts ||
-          server->metrics[i].prev_total_count < MIN_COUNT_FOR_AVERAGE) {
-        /* Move onto next bucket */
-        continue;
-      }
-      /* Calculate average time for previous bucket */
-      timeout_ms = (size_t)(server->metrics[i].prev_total_ms /
-                            server->metrics[i].prev_total_count);
-    } else {
-      /* Calculate average time for current bucket*/
-      timeout_ms =
-        (size_t)(server->metrics[i].total_ms / server->metrics[i].total_count);
+    ares_metrics_view_t view;
+
+    if (!ares_metrics_view(server, i, now, MIN_COUNT_FOR_AVERAGE, &view)) {
+      /* Move onto next bucket */
+      continue;
     }
 
-    /* Multiply average by constant to get timeout value */
-    timeout_ms *= AVG_TIMEOUT_MULTIPLIER;
+    if (channel->timeout_percentile) {
+      /* Multiply percentile latency by constant to get timeout value */
+      timeout_ms = ares_metrics_percentile(&view, channel->timeout_percentile);
+      timeout_ms *= PCTL_TIMEOUT_MULTIPLIER;
+    } else {
+      /* Multiply average by constant to get timeout value */
+      timeout_ms  = (size_t)(view.total_ms / view.total_count);
+      timeout_ms *= AVG_TIMEOUT_MULTIPLIER;
+    }
     break;
   }
 
@@ -259,3 +428,343 @@ size_t ares_metrics_server_timeout(const ares_server_t  *server,
 
   return timeout_ms;
 }
+
+static ares_status_t ares_metrics_append_u64(ares_buf_t *buf, ares_uint64_t val)
+{
+  ares_status_t status;
+
+  status = ares_buf_append_be32(buf, (unsigned int)(val >> 32));
+  if (status != ARES_SUCCESS) {
+    return status; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+  return ares_buf_append_be32(buf, (unsigned int)(val & 0xFFFFFFFF));
+}
+
+static ares_status_t ares_metrics_fetch_u64(ares_buf_t *buf, ares_uint64_t *val)
+{
+  unsigned int  hi;
+  unsigned int  lo;
+  ares_status_t status;
+
+  status = ares_buf_fetch_be32(buf, &hi);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_fetch_be32(buf, &lo);
+  }
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+  *val = ((ares_uint64_t)hi << 32) | lo;
+  return ARES_SUCCESS;
+}
+
+/* Save the smoothed latency and, for each bucket, the data for the period
+ * that would currently be used along with how long ago that period started.
+ * Period timestamps come from the monotonic clock which doesn't carry over to
+ * another process, the age does.  Only non-zero histogram entries are saved
+ * as index/count pairs. */
+ares_status_t ares_metrics_save(const ares_server_t  *server,
+                                const ares_timeval_t *now, ares_buf_t *buf)
+{
+  ares_server_bucket_t i;
+  ares_status_t        status;
+
+  status = ares_buf_append_be32(buf, server->latency_ewma8);
+  if (status != ARES_SUCCESS) {
+    return status; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  for (i = 0; i < ARES_METRIC_COUNT; i++) {
+    ares_metrics_view_t view;
+    size_t              j;
+    size_t              cnt = 0;
+    time_t              age = 0;
+
+    if (!ares_metrics_view(server, i, now, 1, &view)) {
+      status = ares_buf_append_byte(buf, 0);
+      if (status != ARES_SUCCESS) {
+        return status; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+      continue;
+    }
+
+    for (j = 0; j < ARES_METRICS_HIST_CNT; j++) {
+      if (view.hist[j] != 0) {
+        cnt++;
+      }
+    }
+
+    if (ares_metric_period(i) != 0) {
+      age = (time_t)now->sec - (view.ts * ares_metric_period(i));
+    }
+
+    status = ares_buf_append_byte(buf, 1);
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_append_be32(buf, (unsigned int)age);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_append_be32(buf, view.latency_min_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_append_be32(buf, view.latency_max_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_metrics_append_u64(buf, view.total_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_metrics_append_u64(buf, view.total_count);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_append_be16(buf, (unsigned short)cnt);
+    }
+    for (j = 0; status == ARES_SUCCESS && j < ARES_METRICS_HIST_CNT; j++) {
+      if (view.hist[j] == 0) {
+        continue;
+      }
+      status = ares_buf_append_be16(buf, (unsigned short)j);
+      if (status == ARES_SUCCESS) {
+        status = ares_buf_append_be32(buf, view.hist[j]);
+      }
+    }
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  return ARES_SUCCESS;
+}
+
+/* Counterpart to ares_metrics_save().  The saved data becomes the previous
+ * period of each bucket, so it is used until enough fresh data has been
+ * collected and ages out on its own when the current period ends.  A period
+ * that ended more than one period length ago, counting the elapsed seconds
+ * since the save, would already have aged out while running so it is
+ * dropped. */
+ares_status_t ares_metrics_load(ares_server_t *server, const ares_timeval_t *now,
+                                unsigned int elapsed, ares_buf_t *buf)
+{
+  ares_server_bucket_t i;
+  unsigned int         ewma8;
+  ares_status_t        status;
+
+  status = ares_buf_fetch_be32(buf, &ewma8);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  if (server->latency_ewma8 == 0) {
+    server->latency_ewma8 = ewma8;
+  }
+
+  for (i = 0; i < ARES_METRIC_COUNT; i++) {
+    ares_server_metrics_t *metrics = &server->metrics[i];
+    unsigned int           hist[ARES_METRICS_HIST_CNT];
+    unsigned int           min_ms;
+    unsigned int           max_ms;
+    ares_uint64_t          total_ms;
+    ares_uint64_t          total_count;
+    unsigned int           age;
+    unsigned short         cnt;
+    unsigned short         j;
+    unsigned char          present;
+    time_t                 ts;
+
+    status = ares_buf_fetch_bytes(buf, &present, 1);
+    if (status != ARES_SUCCESS) {
+      return status;
+    }
+    if (!present) {
+      continue;
+    }
+
+    status = ares_buf_fetch_be32(buf, &age);
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_be32(buf, &min_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_be32(buf, &max_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_metrics_fetch_u64(buf, &total_ms);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_metrics_fetch_u64(buf, &total_count);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_be16(buf, &cnt);
+    }
+    if (status != ARES_SUCCESS) {
+      return status;
+    }
+
+    memset(hist, 0, sizeof(hist));
+    for (j = 0; j < cnt; j++) {
+      unsigned short idx;
+      unsigned int   val;
+
+      status = ares_buf_fetch_be16(buf, &idx);
+      if (status == ARES_SUCCESS) {
+        status = ares_buf_fetch_be32(buf, &val);
+      }
+      if (status != ARES_SUCCESS) {
+        return status;
+      }
+      if (idx >= ARES_METRICS_HIST_CNT) {
+        return ARES_EBADRESP;
+      }
+      hist[idx] = val;
+    }
+
+    if (ares_metric_period(i) != 0 &&
+        (ares_uint64_t)age + elapsed >=
+          (ares_uint64_t)ares_metric_period(i) * 2) {
+      continue;
+    }
+
+    /* Claim the current period so the first new sample doesn't rotate the
+     * loaded data out */
+    ts = ares_metric_timestamp(i, now, ARES_FALSE);
+    if (metrics->ts != ts) {
+      metrics->ts             = ts;
+      metrics->latency_min_ms = 0;
+      metrics->latency_max_ms = 0;
+      metrics->total_ms       = 0;
+      metrics->total_count    = 0;
+      memset(metrics->hist, 0, sizeof(metrics->hist));
+    }
+
+    metrics->prev_ts             = ares_metric_timestamp(i, now, ARES_TRUE);
+    metrics->prev_latency_min_ms = min_ms;
+    metrics->prev_latency_max_ms = max_ms;
+    metrics->prev_total_ms       = total_ms;
+    metrics->prev_total_count    = total_count;
+    memcpy(metrics->prev_hist, hist, sizeof(metrics->prev_hist));
+  }
+
+  return ARES_SUCCESS;
+}
+
+/* Delay after which a query sent to the server should be hedged, or 0 if
+ * hedging is disabled or there is not yet enough data */
+size_t ares_metrics_server_hedge_delay(const ares_server_t  *server,
+                                       const ares_timeval_t *now)
+{
+  const ares_channel_t *channel = server->channel;
+  ares_server_bucket_t  i;
+
+  if (channel->hedge_percentile == 0) {
+    return 0;
+  }
+
+  for (i = 0; i < ARES_METRIC_COUNT; i++) {
+    ares_metrics_view_t view;
+
+    if (!ares_metrics_view(server, i, now, MIN_COUNT_FOR_HEDGE, &view)) {
+      continue;
+    }
+
+    return ares_metrics_percentile(&view, channel->hedge_percentile);
+  }
+
+  return 0;
+}
+
+ares_status_t ares_get_server_latency(const ares_channel_t  *channel,
+                                      const char            *server,
+                                      ares_metrics_period_t  period,
+                                      ares_server_latency_t *latency)
+{
+  ares_slist_node_t  *node;
+  ares_buf_t         *buf    = NULL;
+  ares_status_t       status = ARES_ENOTFOUND;
+  ares_timeval_t      now;
+  ares_metrics_view_t view;
+
+  if (channel == NULL || server == NULL || latency == NULL ||
+      (int)period < 0 || (int)period >= (int)ARES_METRIC_COUNT) {
+    return ARES_EFORMERR;
+  }
+
+  memset(latency, 0, sizeof(*latency));
+
+  buf = ares_buf_create();
+  if (buf == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ares_tvnow(&now);
+
+  ares_channel_lock(channel);
+  for (node = ares_slist_node_first(channel->servers); node != NULL;
+       node = ares_slist_node_next(node)) {
+    const ares_server_t *sconfig = ares_slist_node_val(node);
+    const unsigned char *addr;
+    size_t               addr_len;
+
+    ares_buf_set_length(buf, 0);
+    status = ares_get_server_addr(sconfig, buf);
+    if (status != ARES_SUCCESS) {
+      goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    /* Match using the same string representation the user would have
+     * received from ares_get_servers_csv() */
+    addr   = ares_buf_peek(buf, &addr_len);
+    status = ARES_ENOTFOUND;
+    if (addr_len != ares_strlen(server) ||
+        memcmp(addr, server, addr_len) != 0) {
+      continue;
+    }
+
+    if (!ares_metrics_view(sconfig, (ares_server_bucket_t)period, &now, 1,
+                           &view)) {
+      status = ARES_ENODATA;
+      goto done;
+    }
+
+    latency->count  = (size_t)view.total_count;
+    latency->min_ms = view.latency_min_ms;
+    latency->max_ms = view.latency_max_ms;
+    latency->avg_ms = (unsigned int)(view.total_ms / view.total_count);
+    latency->p50_ms = ares_metrics_percentile(&view, 50);
+    latency->p90_ms = ares_metrics_percentile(&view, 90);
+    latency->p99_ms = ares_metrics_percentile(&view, 99);
+    status          = ARES_SUCCESS;
+    goto done;
+  }
+
+done:
+  ares_channel_unlock(channel);
+  ares_buf_destroy(buf);
+  return status;
+}
+
+ares_status_t ares_set_server_timeout_percentile(ares_channel_t *channel,
+                                                 unsigned int    percentile)
+{
+  if (channel == NULL || percentile > 100) {
+    return ARES_EFORMERR;
+  }
+
+  ares_channel_lock(channel);
+  channel->timeout_percentile = percentile;
+  ares_channel_unlock(channel);
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_set_query_hedging(ares_channel_t *channel,
+                                     unsigned int    percentile,
+                                     unsigned int    budget_pct)
+{
+  if (channel == NULL || percentile > 100 || budget_pct == 0 ||
+      budget_pct > 100) {
+    return ARES_EFORMERR;
+  }
+
+  ares_channel_lock(channel);
+  channel->hedge_percentile = percentile;
+  channel->hedge_budget     = budget_pct;
+  /* Start with a full burst so hedging is usable right away */
+  channel->hedge_credit     = ARES_HEDGE_CREDIT_MAX;
+  ares_channel_unlock(channel);
+  return ARES_SUCCESS;
+}
@@ -61,6 +61,7 @@
 #include "util/ares_threads.h"
 #include "ares_socket.h"
 #include "ares_conn.h"
+#include "ares_trace.h"
 #include "ares_str.h"
 #include "str/ares_strsplit.h"
 #include "util/ares_uri.h"
@@ -109,9 +110,11 @@ W32_FUNC const char *_w32_GetHostsFile(void);
 
 #  define PATH_RESOLV_CONF "/etc/resolv.conf"
 #  ifdef ETC_INET
-#    define PATH_HOSTS "/etc/inet/hosts"
+#    define PATH_HOSTS    "/etc/inet/hosts"
+#    define PATH_SERVICES "/etc/inet/services"
 #  else
-#    define PATH_HOSTS "/etc/hosts"
+#    define PATH_HOSTS    "/etc/hosts"
+#    define PATH_SERVICES "/etc/services"
 #  endif
 
 #endif
@@ -131,6 +134,11 @@ W32_FUNC const char *_w32_GetHostsFile(void);
 #define DEFAULT_SERVER_RETRY_CHANCE 10
 #define DEFAULT_SERVER_RETRY_DELAY  5000
 
+/* Free queries and query list nodes retained per size for reuse by the next
+ * queries on a channel, enough to absorb a typical burst without holding on
+ * to much memory afterwards. */
+#define ARES_QUERY_POOL_MAX 256
+
 struct ares_query;
 typedef struct ares_query ares_query_t;
 
@@ -162,11 +170,27 @@ struct ares_query {
   /* Query status */
   size_t        try_count; /* Number of times we tried this query already. */
   size_t        cookie_try_count; /* Attempt count for cookie resends */
+  unsigned short edns_udp_size; /* UDP payload size originally in the OPT RR,
+                                 * 0 until first sent */
   ares_bool_t   using_tcp;
   ares_status_t error_status;
   size_t        timeouts;   /* number of timeouts we saw for this request */
   ares_bool_t   no_retries; /* do not perform any additional retries, this is
                              * set when a query is to be canceled */
+  ares_bool_t   cut_short;  /* timeout was brought forward by the caller, so a
+                             * timeout is not held against the server */
+
+  /* Hedging state.  While armed, timeout is when to send the hedge and
+   * hedge_deadline is the real timeout of the attempt.  Once sent, the hedge
+   * is a second leg of the same attempt on hedge_conn. */
+  ares_bool_t          hedge_armed;
+  ares_timeval_t       hedge_deadline;
+  ares_timeval_t       hedge_ts; /*!< Timestamp hedge was sent */
+  ares_conn_t         *hedge_conn;
+  ares_llist_node_t   *node_queries_to_hedge_conn;
+  ares_dns_record_t   *hedge_query; /*!< Request as written to hedge_conn */
+  ares_dns_record_t   *conn_query;  /*!< Request as written to conn, if it is
+                                     *   not query itself */
 };
 
 struct apattern {
@@ -180,6 +204,12 @@ typedef struct ares_qcache ares_qcache_t;
 struct ares_hosts_file;
 typedef struct ares_hosts_file ares_hosts_file_t;
 
+struct ares_services_file;
+typedef struct ares_services_file ares_services_file_t;
+
+struct ares_srcaddr_cache;
+typedef struct ares_srcaddr_cache ares_srcaddr_cache_t;
+
 struct ares_channeldata {
   /* Configuration data */
   unsigned int         flags;
@@ -199,6 +229,8 @@ struct ares_channeldata {
   char                *lookups;
   size_t               ednspsz;
   unsigned int         qcache_max_ttl;
+  unsigned int         qcache_negative_ttl;  /* Negative answers without SOA */
+  unsigned int         qcache_servfail_ttl;  /* Per-server SERVFAIL, seconds */
   ares_evsys_t         evsys;
   unsigned int         optmask;
 
@@ -223,6 +255,10 @@ struct ares_channeldata {
    */
   ares_rand_state     *rand_state;
 
+  /* Recycles queries and the list nodes tracking them, protected by the
+   * channel lock */
+  ares_pool_t         *query_pool;
+
   /* All active queries in a single list */
   ares_llist_t        *all_queries;
   /* Queries bucketed by qid, for quickly dispatching DNS responses: */
@@ -254,6 +290,9 @@ struct ares_channeldata {
   ares_pending_write_cb               notify_pending_write_cb;
   void                               *notify_pending_write_cb_data;
   ares_bool_t                         notify_pending_write;
+  /* Set while ares_send_batch() is enqueuing, writes are left in the
+   * connection buffers until ares_flush_deferred_writes() */
+  ares_bool_t                         defer_writes;
 
   ares_query_enqueue_cb               query_enqueue_cb;
   void                               *query_enqueue_cb_data;
@@ -270,9 +309,23 @@ struct ares_channeldata {
   /* Cache of local hosts file */
   ares_hosts_file_t                  *hf;
 
+  /* Local services file, reloaded when it changes.  The file is checked for
+   * changes no more often than once services_expire passes */
+  ares_services_file_t               *services;
+  ares_timeval_t                      services_expire;
+
   /* Query Cache */
   ares_qcache_t                      *qcache;
 
+  /* Cache of source addresses by destination prefix used when sorting
+   * addrinfo results, created on first use */
+  ares_srcaddr_cache_t               *srcaddr_cache;
+
+  /* Snapshot of the local interface addresses, enumerated on first use and
+   * refreshed once iface_ips_expire passes or the cache is flushed */
+  ares_iface_ips_t                   *iface_ips;
+  ares_timeval_t                      iface_ips_expire;
+
   /* Fields controlling server failover behavior.
    * The retry chance is the probability (1/N) by which we will retry a failed
    * server instead of the best server when selecting a server to send queries
@@ -283,6 +336,30 @@ struct ares_channeldata {
   unsigned short                      server_retry_chance;
   size_t                              server_retry_delay;
 
+  /* Percentile of recorded server latency used to derive retry timeouts.
+   * 0 means to use the average latency. */
+  unsigned int                        timeout_percentile;
+
+  /* Policy used to pick a server for each query */
+  ares_server_select_t                server_select;
+
+  /* RFC 8305 resolution delay in milliseconds used by ares_getaddrinfo() for
+   * AF_UNSPEC lookups.  0 means to wait for all address families. */
+  size_t                              resolution_delay;
+
+  /* Hedged queries.  hedge_percentile of 0 disables hedging.  Each new query
+   * earns hedge_budget credits and each hedge sent spends
+   * ARES_HEDGE_CREDIT_COST, so hedges stay within hedge_budget percent of
+   * queries over time. */
+  unsigned int                        hedge_percentile;
+  unsigned int                        hedge_budget;
+  size_t                              hedge_credit;
+
+#ifdef CARES_TRACE
+  /* Query lifecycle tracing state, NULL if tracing is not enabled */
+  ares_trace_t                       *trace;
+#endif
+
   /* Callback triggered when a server has a successful or failed response */
   ares_server_state_callback          server_state_cb;
   void                               *server_state_cb_data;
@@ -307,12 +384,40 @@ ares_bool_t   ares_is_onion_domain(const char *name);
 /* Returns one of the normal ares status codes like ARES_SUCCESS */
 ares_status_t ares_send_query(ares_server_t *requested_server /* Optional */,
                               ares_query_t *query, const ares_timeval_t *now);
+/*! Absolute time (based on ares_tvnow()) of the next query timeout, returns
+ *  ARES_FALSE if no queries are outstanding */
+ares_bool_t   ares_timeout_next(const ares_channel_t *channel,
+                                ares_timeval_t       *deadline);
+
+/*! Write out everything queued while channel->defer_writes was set */
+void          ares_flush_deferred_writes(ares_channel_t *channel);
 ares_status_t ares_requeue_query(ares_query_t *query, const ares_timeval_t *now,
                                  ares_status_t            status,
                                  ares_bool_t              inc_try_count,
                                  ares_dns_record_t       *dnsrec,
                                  ares_array_t           **requeue);
 
+/*! Bring the timeout of the in-flight attempt of a query forward so it
+ *  expires no later than timeout_ms from now.  Retries are disabled and the
+ *  resulting timeout is not counted as a server failure. */
+void          ares_query_cut_short(ares_query_t *query, const ares_timeval_t *now,
+                                   size_t timeout_ms);
+
+/*! Credits spent per hedge, and the most that may be banked (a burst of 10
+ *  hedges) */
+#define ARES_HEDGE_CREDIT_COST 100
+#define ARES_HEDGE_CREDIT_MAX  (10 * ARES_HEDGE_CREDIT_COST)
+
+/*! Stop waiting on the hedge leg of a query, leaving the original attempt in
+ *  flight */
+void          ares_query_drop_hedge(ares_query_t *query);
+
+/*! The request as it was written to conn, which is either leg of a hedged
+ *  query.  Cookies and EDNS are applied per server, so the legs differ, and
+ *  neither need be query->query itself. */
+const ares_dns_record_t *ares_query_dnsrec_sent(const ares_query_t *query,
+                                                const ares_conn_t  *conn);
+
 /*! Count the number of labels (dots+1) in a domain */
 size_t        ares_name_label_cnt(const char *name);
 
@@ -416,6 +521,24 @@ ares_status_t ares_lookup_hostaliases(const ares_channel_t *channel,
 ares_status_t ares_cat_domain(const char *name, const char *domain, char **s);
 ares_status_t ares_sortaddrinfo(ares_channel_t            *channel,
                                 struct ares_addrinfo_node *ai_node);
+/* Flush the cache of source addresses used by ares_sortaddrinfo(), must be
+ * called with the channel lock held */
+void          ares_sortaddrinfo_cache_flush(ares_channel_t *channel);
+
+/* Name of the interface with the given index from the channel's cached
+ * interface table alone, NULL if the table doesn't know it.  Only valid
+ * until the table is refreshed.  Must be called with the channel lock held. */
+const char   *ares_iface_cache_lookup(ares_channel_t *channel,
+                                      unsigned int    index);
+/* Interface index to name lookup served from the channel's cached interface
+ * table, falling back to the operating system for interfaces the table does
+ * not know.  Must be called with the channel lock held. */
+const char   *ares_iface_cache_indextoname(ares_channel_t *channel,
+                                           unsigned int index, char *name,
+                                           size_t name_len);
+/* Flush the cached interface table, must be called with the channel lock
+ * held */
+void          ares_iface_cache_flush(ares_channel_t *channel);
 
 void          ares_freeaddrinfo_nodes(struct ares_addrinfo_node *ai_node);
 ares_bool_t   ares_is_localhost(const char *name);
@@ -454,6 +577,11 @@ ares_status_t ares_addrinfo2addrttl(const struct ares_addrinfo *ai, int family,
                                     struct ares_addrttl  *addrttls,
                                     struct ares_addr6ttl *addr6ttls,
                                     size_t               *naddrttls);
+ares_status_t ares_parse_addr_reply(const unsigned char *abuf, int alen,
+                                    int family, struct hostent **host,
+                                    struct ares_addrttl  *addrttls,
+                                    struct ares_addr6ttl *addr6ttls,
+                                    int                  *naddrttls);
 ares_status_t ares_addrinfo_localhost(const char *name, unsigned short port,
                                       const struct ares_addrinfo_hints *hints,
                                       struct ares_addrinfo             *ai);
@@ -478,6 +606,11 @@ ares_status_t ares_get_server_addr(const ares_server_t *server,
 struct ares_hosts_entry;
 typedef struct ares_hosts_entry ares_hosts_entry_t;
 
+/*! Whether a file loaded from loaded_name at loaded_ts must be reloaded from
+ *  filename, because the name differs or the file was modified since */
+ares_bool_t ares_file_expired(const char *filename, const char *loaded_name,
+                              time_t loaded_ts);
+
 void                            ares_hosts_file_destroy(ares_hosts_file_t *hf);
 ares_status_t ares_hosts_search_ipaddr(ares_channel_t *channel,
                                        ares_bool_t use_env, const char *ipaddr,
@@ -493,6 +626,27 @@ ares_status_t ares_hosts_entry_to_addrinfo(const ares_hosts_entry_t *entry,
                                            ares_bool_t           want_cnames,
                                            struct ares_addrinfo *ai);
 
+void           ares_services_file_destroy(ares_services_file_t *sf);
+ares_status_t  ares_services_parse(const char            *filename,
+                                   ares_services_file_t **out);
+/*! Parse filename into *sf unless *sf was already loaded from it and the
+ *  file has not changed since.  *sf is NULL if the file cannot be read. */
+ares_status_t  ares_services_update(ares_services_file_t **sf,
+                                    const char            *filename);
+/*! The channel's services file, reloaded when it changes, which is checked
+ *  for at most once a second.  NULL if it could not be read, in which case
+ *  only the built-in services are known.  Only valid until the next call,
+ *  with the channel lock held. */
+const ares_services_file_t *ares_services_get(ares_channel_t *channel);
+/*! Name of the service on port (host byte order) for proto ("tcp", "udp",
+ *  "sctp" or "dccp"), looked up in sf, or in the built-in table of well-known
+ *  services if sf is NULL.  NULL if unknown. */
+const char    *ares_services_port_to_name(const ares_services_file_t *sf,
+                                          unsigned short port, const char *proto);
+/*! Port (host byte order) of the service name for proto, 0 if unknown */
+unsigned short ares_services_name_to_port(const ares_services_file_t *sf,
+                                          const char *name, const char *proto);
+
 /* Same as ares_query_dnsrec() except does not take a channel lock.  Use this
  * if a channel lock is already held */
 ares_status_t ares_query_nolock(ares_channel_t *channel, const char *name,
@@ -592,10 +746,43 @@ ares_status_t ares_qcache_fetch(ares_channel_t           *channel,
                                 const ares_dns_record_t  *dnsrec,
                                 const ares_dns_record_t **dnsrec_resp);
 
+/*! Fetch the cached answer to the reverse lookup ares_gethostbyaddr() would
+ *  send for addr, without building the request */
+ares_status_t ares_qcache_fetch_ptr(ares_channel_t           *channel,
+                                    const ares_timeval_t     *now,
+                                    const struct ares_addr   *addr,
+                                    const ares_dns_record_t **dnsrec_resp);
+
+/*! Remember that server returned SERVFAIL for the question in query, if
+ *  enabled via ares_set_qcache_negative_ttl() */
+ares_status_t ares_qcache_insert_servfail(ares_channel_t       *channel,
+                                          const ares_timeval_t *now,
+                                          const ares_query_t   *query,
+                                          const ares_server_t  *server);
+
+/*! Whether server is known to return SERVFAIL for the question in query */
+ares_bool_t   ares_qcache_servfail_cached(ares_channel_t       *channel,
+                                          const ares_timeval_t *now,
+                                          const ares_query_t   *query,
+                                          const ares_server_t  *server);
+
+/*! Serialize the unexpired cache entries for ares_save_state() */
+ares_status_t ares_qcache_save(const ares_qcache_t  *qcache,
+                               const ares_timeval_t *now, ares_buf_t *buf);
+/*! Load entries saved elapsed seconds ago by ares_qcache_save() */
+ares_status_t ares_qcache_load(ares_qcache_t *qcache, const ares_timeval_t *now,
+                               unsigned int elapsed, ares_buf_t *buf);
+
 void   ares_metrics_record(const ares_query_t *query, ares_server_t *server,
                            ares_status_t status, const ares_dns_record_t *dnsrec);
 size_t ares_metrics_server_timeout(const ares_server_t  *server,
                                    const ares_timeval_t *now);
+size_t ares_metrics_server_hedge_delay(const ares_server_t  *server,
+                                       const ares_timeval_t *now);
+ares_status_t ares_metrics_save(const ares_server_t  *server,
+                                const ares_timeval_t *now, ares_buf_t *buf);
+ares_status_t ares_metrics_load(ares_server_t *server, const ares_timeval_t *now,
+                                unsigned int elapsed, ares_buf_t *buf);
 
 ares_status_t ares_cookie_apply(ares_dns_record_t *dnsrec, ares_conn_t *conn,
                                 const ares_timeval_t *now);
@@ -605,6 +792,27 @@ ares_status_t ares_cookie_validate(ares_query_t            *query,
                                    const ares_timeval_t    *now,
                                    ares_array_t           **requeue);
 
+ares_status_t ares_cookie_save(const ares_server_t  *server,
+                               const ares_timeval_t *now, ares_buf_t *buf);
+ares_status_t ares_cookie_load(ares_server_t *server, const ares_timeval_t *now,
+                               unsigned int elapsed, ares_buf_t *buf);
+
+/*! Whether dnsrec has to be sent to server without its OPT RR.  The OPT RR
+ *  is removed by ares_edns_apply(), so it must be given a copy to write. */
+ares_bool_t   ares_edns_strip(ares_server_t           *server,
+                              const ares_dns_record_t *dnsrec,
+                              const ares_timeval_t    *now);
+ares_status_t ares_edns_apply(ares_query_t *query, ares_dns_record_t *dnsrec,
+                              const ares_conn_t    *conn,
+                              const ares_timeval_t *now);
+void          ares_edns_unsupported(ares_server_t        *server,
+                                    const ares_timeval_t *now);
+void          ares_edns_validate(const ares_query_t      *query,
+                                 const ares_dns_record_t *dnsresp,
+                                 const ares_conn_t       *conn);
+void          ares_edns_timeout(const ares_query_t *query, const ares_conn_t *conn,
+                                const ares_timeval_t *now);
+
 ares_status_t ares_channel_threading_init(ares_channel_t *channel);
 void          ares_channel_threading_destroy(ares_channel_t *channel);
 void          ares_channel_lock(const ares_channel_t *channel);
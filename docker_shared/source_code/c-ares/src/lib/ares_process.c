@@ -53,6 +53,13 @@ static ares_status_t process_read(ares_channel_t       *channel,
                                   const ares_timeval_t *now);
 static ares_status_t process_timeouts(ares_channel_t       *channel,
                                       const ares_timeval_t *now);
+static ares_conn_t  *ares_fetch_connection(const ares_channel_t *channel,
+                                           ares_server_t        *server,
+                                           const ares_query_t   *query);
+static ares_status_t ares_conn_query_write(ares_conn_t          *conn,
+                                           ares_query_t         *query,
+                                           ares_dns_record_t    *dnsrec,
+                                           const ares_timeval_t *now);
 static ares_status_t process_answer(ares_channel_t      *channel,
                                     const unsigned char *abuf, size_t alen,
                                     ares_conn_t          *conn,
@@ -75,6 +82,49 @@ static void        ares_query_remove_from_conn(ares_query_t *query)
   query->node_queries_by_timeout = NULL;
   query->node_queries_to_conn    = NULL;
   query->conn                    = NULL;
+  query->hedge_armed             = ARES_FALSE;
+  ares_dns_record_destroy(query->conn_query);
+  query->conn_query = NULL;
+  ares_query_drop_hedge(query);
+}
+
+void ares_query_drop_hedge(ares_query_t *query)
+{
+  ares_llist_node_destroy(query->node_queries_to_hedge_conn);
+  query->node_queries_to_hedge_conn = NULL;
+  query->hedge_conn                 = NULL;
+  ares_dns_record_destroy(query->hedge_query);
+  query->hedge_query = NULL;
+}
+
+const ares_dns_record_t *ares_query_dnsrec_sent(const ares_query_t *query,
+                                                const ares_conn_t  *conn)
+{
+  const ares_dns_record_t *dnsrec = query->conn_query;
+
+  if (conn != NULL && conn == query->hedge_conn) {
+    dnsrec = query->hedge_query;
+  }
+  return dnsrec != NULL ? dnsrec : query->query;
+}
+
+/* Make the hedge leg of a query the leg of record, so the rest of the answer
+ * processing (and metrics) apply to the server that actually answered */
+static void ares_query_swap_hedge(ares_query_t *query)
+{
+  ares_conn_t       *conn   = query->conn;
+  ares_llist_node_t *node   = query->node_queries_to_conn;
+  ares_timeval_t     ts     = query->ts;
+  ares_dns_record_t *dnsrec = query->conn_query;
+
+  query->conn                       = query->hedge_conn;
+  query->node_queries_to_conn       = query->node_queries_to_hedge_conn;
+  query->ts                         = query->hedge_ts;
+  query->hedge_conn                 = conn;
+  query->node_queries_to_hedge_conn = node;
+  query->hedge_ts                   = ts;
+  query->conn_query                 = query->hedge_query;
+  query->hedge_query                = dnsrec;
 }
 
 /* Invoke the server state callback after a success or failure */
@@ -445,6 +495,44 @@ void ares_process_pending_write(ares_channel_t *channel)
   ares_channel_unlock(channel);
 }
 
+void ares_flush_deferred_writes(ares_channel_t *channel)
+{
+  ares_slist_node_t *snode;
+
+  channel->defer_writes = ARES_FALSE;
+
+restart:
+  for (snode = ares_slist_node_first(channel->servers); snode != NULL;
+       snode = ares_slist_node_next(snode)) {
+    const ares_server_t *server = ares_slist_node_val(snode);
+    ares_llist_node_t   *node   = ares_llist_node_first(server->connections);
+
+    while (node != NULL) {
+      ares_conn_t  *conn = ares_llist_node_val(node);
+      ares_status_t status;
+
+      node = ares_llist_node_next(node);
+
+      if (ares_buf_len(conn->out_buf) == 0 ||
+          (conn->flags & ARES_CONN_FLAG_TCP &&
+           !(conn->state_flags & ARES_CONN_STATE_CONNECTED) &&
+           !(conn->flags & ARES_CONN_FLAG_TFO_INITIAL))) {
+        continue;
+      }
+
+      status = ares_conn_flush(conn);
+      if (status != ARES_SUCCESS) {
+        /* Requeuing the connection's queries can reorder the servers and
+         * open or close other connections, so the walk can't continue.
+         * Start over, connections already flushed have nothing left to
+         * write and are skipped. */
+        handle_conn_error(conn, ARES_TRUE, status);
+        goto restart;
+      }
+    }
+  }
+}
+
 static ares_status_t read_conn_packets(ares_conn_t *conn)
 {
   ares_bool_t           read_again;
@@ -613,6 +701,10 @@ static ares_status_t read_answers(ares_conn_t *conn, const ares_timeval_t *now)
     data     += 2;
     data_len -= 2;
 
+    ARES_TRACE(channel, ARES_TRACE_CONN_READ,
+               data_len >= 2 ? (unsigned short)(data[0] << 8 | data[1]) : 0,
+               conn->server, ARES_SUCCESS, data_len);
+
     /* We finished reading this answer; process it */
     status = process_answer(channel, data, data_len, conn, now, &requeue);
     if (status != ARES_SUCCESS) {
@@ -652,6 +744,8 @@ cleanup:
     } else { /* REQUEUE_ENDQUERY */
       if (query != NULL) {
         query->callback(query->arg, entry.status, query->timeouts, entry.dnsrec);
+        ARES_TRACE(channel, ARES_TRACE_QUERY_CALLBACK, query->qid, NULL,
+                   entry.status, 0);
         ares_free_query(query);
       }
       ares_dns_record_destroy(entry.dnsrec);
@@ -691,6 +785,95 @@ static ares_status_t process_read(ares_channel_t       *channel,
   return read_answers(conn, now);
 }
 
+/* Pick the server to send a hedge to: the best server in priority order other
+ * than the one already working on the query */
+static ares_server_t *ares_hedge_server(const ares_query_t   *query,
+                                        const ares_timeval_t *now)
+{
+  ares_channel_t    *channel = query->channel;
+  ares_slist_node_t *node;
+
+  for (node = ares_slist_node_first(channel->servers); node != NULL;
+       node = ares_slist_node_next(node)) {
+    ares_server_t *server = ares_slist_node_val(node);
+
+    if (server == query->conn->server) {
+      continue;
+    }
+
+    if (ares_qcache_servfail_cached(channel, now, query, server)) {
+      continue;
+    }
+
+    return server;
+  }
+
+  return NULL;
+}
+
+/* The hedge delay for a query expired.  Restore its real timeout and, budget
+ * permitting, send the same query to a second server.  Answers are matched by
+ * query id, so whichever server answers first completes the query and the
+ * other answer is discarded when it arrives.  Failing to send a hedge is not
+ * an error, the original attempt is still in flight. */
+static void ares_query_hedge(ares_query_t *query, const ares_timeval_t *now)
+{
+  ares_channel_t    *channel = query->channel;
+  ares_server_t     *server;
+  ares_conn_t       *conn;
+  ares_dns_record_t *dnsrec = NULL;
+
+  query->hedge_armed = ARES_FALSE;
+  query->timeout     = query->hedge_deadline;
+  ares_slist_node_reinsert(query->node_queries_by_timeout);
+
+  if (channel->hedge_credit < ARES_HEDGE_CREDIT_COST) {
+    return;
+  }
+
+  server = ares_hedge_server(query, now);
+  if (server == NULL) {
+    return;
+  }
+
+  conn = ares_fetch_connection(channel, server, query);
+  if (conn == NULL &&
+      ares_open_connection(&conn, channel, server, query->using_tcp) !=
+        ARES_SUCCESS) {
+    return;
+  }
+
+  /* Cookies and EDNS are applied per server, and the original attempt's
+   * answer is validated against what was sent to it, so the hedge is written
+   * from its own copy of the request */
+  if (ares_dns_record_duplicate_ex(&dnsrec, query->query) != ARES_SUCCESS) {
+    return; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  if (ares_conn_query_write(conn, query, dnsrec, now) != ARES_SUCCESS) {
+    ares_dns_record_destroy(dnsrec);
+    return;
+  }
+
+  /* Tracking the query against the connection keeps the connection from
+   * being cleaned up before the hedge is answered */
+  query->node_queries_to_hedge_conn =
+    ares_llist_insert_last(conn->queries_to_conn, query);
+  if (query->node_queries_to_hedge_conn == NULL) {
+    ares_dns_record_destroy(dnsrec); /* LCOV_EXCL_LINE: OutOfMemory */
+    return;                          /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  query->hedge_conn     = conn;
+  query->hedge_query    = dnsrec;
+  query->hedge_ts       = *now;
+  conn->total_queries++;
+  channel->hedge_credit -= ARES_HEDGE_CREDIT_COST;
+
+  ARES_TRACE(channel, ARES_TRACE_QUERY_SEND, query->qid, server, ARES_SUCCESS,
+             0);
+}
+
 /* If any queries have timed out, note the timeout and move them on. */
 static ares_status_t process_timeouts(ares_channel_t       *channel,
                                       const ares_timeval_t *now)
@@ -711,10 +894,21 @@ static ares_status_t process_timeouts(ares_channel_t       *channel,
       break;
     }
 
+    /* Not a timeout, just time to send a hedge */
+    if (query->hedge_armed) {
+      ares_query_hedge(query, now);
+      continue;
+    }
+
     query->timeouts++;
 
     conn = query->conn;
-    server_increment_failures(conn->server, query->using_tcp);
+    ARES_TRACE(channel, ARES_TRACE_QUERY_TIMEOUT, query->qid, conn->server,
+               ARES_ETIMEOUT, query->timeouts);
+    if (!query->cut_short) {
+      ares_edns_timeout(query, conn, now);
+      server_increment_failures(conn->server, query->using_tcp);
+    }
     status = ares_requeue_query(query, now, ARES_ETIMEOUT, ARES_TRUE, NULL,
       NULL);
     if (status == ARES_ENOMEM) {
@@ -728,33 +922,6 @@ done:
   return ARES_SUCCESS;
 }
 
-static ares_status_t rewrite_without_edns(ares_query_t *query)
-{
-  ares_status_t status = ARES_SUCCESS;
-  size_t        i;
-  ares_bool_t   found_opt_rr = ARES_FALSE;
-
-  /* Find and remove the OPT RR record */
-  for (i = 0; i < ares_dns_record_rr_cnt(query->query, ARES_SECTION_ADDITIONAL);
-       i++) {
-    const ares_dns_rr_t *rr;
-    rr = ares_dns_record_rr_get(query->query, ARES_SECTION_ADDITIONAL, i);
-    if (ares_dns_rr_get_type(rr) == ARES_REC_TYPE_OPT) {
-      ares_dns_record_rr_del(query->query, ARES_SECTION_ADDITIONAL, i);
-      found_opt_rr = ARES_TRUE;
-      break;
-    }
-  }
-
-  if (!found_opt_rr) {
-    status = ARES_EFORMERR;
-    goto done;
-  }
-
-done:
-  return status;
-}
-
 static ares_bool_t issue_might_be_edns(const ares_dns_record_t *req,
                                        const ares_dns_record_t *rsp)
 {
@@ -858,28 +1025,34 @@ static ares_status_t process_answer(ares_channel_t      *channel,
     goto cleanup;
   }
 
+  ARES_TRACE(channel, ARES_TRACE_ANSWER, query->qid, server, ARES_SUCCESS,
+             ares_dns_record_get_rcode(rdnsrec));
+
   /* At this point we know we've received an answer for this query, so we should
    * remove it from the connection's queue so we can possibly invalidate the
    * connection. Delay cleaning up the connection though as we may enqueue
    * something new.  */
+  if (conn == query->hedge_conn) {
+    ares_query_swap_hedge(query);
+  }
   ares_llist_node_destroy(query->node_queries_to_conn);
   query->node_queries_to_conn = NULL;
 
   /* There are old servers that don't understand EDNS at all, then some servers
    * that have non-compliant implementations.  Lets try to detect this sort
    * of thing. */
-  if (issue_might_be_edns(query->query, rdnsrec)) {
-    status = rewrite_without_edns(query);
-    if (status != ARES_SUCCESS) {
-      end_query(channel, server, query, status, NULL, NULL);
-      goto cleanup;
-    }
+  if (issue_might_be_edns(ares_query_dnsrec_sent(query, conn), rdnsrec)) {
+    /* The retry, and anything else sent to the server for a while, goes
+     * without the OPT RR */
+    ares_edns_unsupported(server, now);
 
     /* Requeue to same server */
     status = ares_append_requeue(requeue, query, server);
     goto cleanup;
   }
 
+  ares_edns_validate(query, rdnsrec, conn);
+
   /* If we got a truncated UDP packet and are not ignoring truncation,
    * don't accept the packet, and switch the query to TCP if we hadn't
    * done so already.
@@ -904,6 +1077,7 @@ static ares_status_t process_answer(ares_channel_t      *channel,
       switch (rcode) {
         case ARES_RCODE_SERVFAIL:
           status = ARES_ESERVFAIL;
+          ares_qcache_insert_servfail(channel, now, query, server);
           break;
         case ARES_RCODE_NOTIMP:
           status = ARES_ENOTIMP;
@@ -916,6 +1090,17 @@ static ares_status_t process_answer(ares_channel_t      *channel,
       }
 
       server_increment_failures(server, query->using_tcp);
+
+      /* The other leg of a hedged query may still come back with something
+       * useful, keep waiting on it rather than retrying */
+      if (query->hedge_conn != NULL) {
+        ares_query_swap_hedge(query);
+        ares_query_drop_hedge(query);
+        query->error_status = status;
+        status              = ARES_SUCCESS;
+        goto cleanup;
+      }
+
       status = ares_requeue_query(query, now, status, ARES_TRUE, rdnsrec,
         requeue);
       rdnsrec = NULL; /* Free'd by ares_requeue_query() */
@@ -987,6 +1172,8 @@ ares_status_t ares_requeue_query(ares_query_t *query, const ares_timeval_t *now,
   }
 
   if (query->try_count < max_tries && !query->no_retries) {
+    ARES_TRACE(channel, ARES_TRACE_QUERY_REQUEUE, query->qid, NULL, status,
+               query->try_count);
     ares_dns_record_destroy(dnsrec);
     if (requeue != NULL) {
       return ares_append_requeue(requeue, query, NULL);
@@ -1003,6 +1190,38 @@ ares_status_t ares_requeue_query(ares_query_t *query, const ares_timeval_t *now,
   return ARES_ETIMEOUT;
 }
 
+void ares_query_cut_short(ares_query_t *query, const ares_timeval_t *now,
+                          size_t timeout_ms)
+{
+  ares_timeval_t deadline;
+
+  query->no_retries = ARES_TRUE;
+
+  /* Not currently in flight */
+  if (query->node_queries_by_timeout == NULL) {
+    return;
+  }
+
+  /* No point in hedging a query that is about to be given up on */
+  if (query->hedge_armed) {
+    query->hedge_armed = ARES_FALSE;
+    query->timeout     = query->hedge_deadline;
+    ares_slist_node_reinsert(query->node_queries_by_timeout);
+  }
+
+  deadline = *now;
+  timeadd(&deadline, timeout_ms);
+
+  /* Already due to expire sooner */
+  if (ares_timedout(&deadline, &query->timeout)) {
+    return;
+  }
+
+  query->timeout   = deadline;
+  query->cut_short = ARES_TRUE;
+  ares_slist_node_reinsert(query->node_queries_by_timeout);
+}
+
 /*! Count the number of servers that share the same highest priority (lowest
  *  consecutive failures).  Since they are sorted in priority order, we just
  *  stop when the consecutive failure count changes. Used for random selection
@@ -1029,6 +1248,25 @@ static size_t count_highest_prio_servers(const ares_channel_t *channel)
   return cnt;
 }
 
+/* Pick the best server that isn't known to return SERVFAIL for the question,
+ * if any */
+static ares_server_t *ares_servfail_alternate(ares_channel_t       *channel,
+                                              const ares_query_t   *query,
+                                              const ares_timeval_t *now)
+{
+  ares_slist_node_t *node;
+
+  for (node = ares_slist_node_first(channel->servers); node != NULL;
+       node = ares_slist_node_next(node)) {
+    ares_server_t *server = ares_slist_node_val(node);
+    if (!ares_qcache_servfail_cached(channel, now, query, server)) {
+      return server;
+    }
+  }
+
+  return NULL;
+}
+
 /* Pick a random *best* server from the list, we first get a random number in
  * the range of the number of *best* servers, then scan until we find that
  * server in the list */
@@ -1063,6 +1301,99 @@ static ares_server_t *ares_random_server(ares_channel_t *channel)
   return NULL;
 }
 
+/* Number of queries currently awaiting a response from the server */
+static size_t ares_server_outstanding(const ares_server_t *server)
+{
+  ares_llist_node_t *node;
+  size_t             cnt = 0;
+
+  for (node = ares_llist_node_first(server->connections); node != NULL;
+       node = ares_llist_node_next(node)) {
+    const ares_conn_t *conn = ares_llist_node_val(node);
+    cnt += ares_llist_len(conn->queries_to_conn);
+  }
+
+  return cnt;
+}
+
+/* Expected cost of sending another query to the server: its smoothed latency
+ * scaled by the queries it is already working on.  Servers without latency
+ * data yet are assumed to be average so they still get a share of queries. */
+static ares_uint64_t ares_server_cost(const ares_server_t *server,
+                                      unsigned int         default_ewma8)
+{
+  unsigned int ewma8 = server->latency_ewma8;
+
+  if (ewma8 == 0) {
+    ewma8 = default_ewma8;
+  }
+
+  return (ares_uint64_t)ewma8 * (ares_server_outstanding(server) + 1);
+}
+
+/* Power of two choices: pick two distinct random servers among the best and
+ * use the one with the lowest cost.  This spreads load in proportion to
+ * latency and outstanding queries without herding everything onto whichever
+ * server currently looks fastest. */
+static ares_server_t *ares_p2c_server(ares_channel_t *channel)
+{
+  unsigned short     r[2];
+  size_t             idx1;
+  size_t             idx2;
+  size_t             cnt;
+  size_t             measured      = 0;
+  ares_uint64_t      ewma_sum      = 0;
+  unsigned int       default_ewma8 = 1;
+  ares_server_t     *s1            = NULL;
+  ares_server_t     *s2            = NULL;
+  ares_slist_node_t *node;
+  size_t             num_servers = count_highest_prio_servers(channel);
+
+  if (num_servers <= 1) {
+    return ares_slist_first_val(channel->servers);
+  }
+
+  ares_rand_bytes(channel->rand_state, (unsigned char *)r, sizeof(r));
+  idx1 = r[0] % num_servers;
+  idx2 = r[1] % (num_servers - 1);
+  if (idx2 >= idx1) {
+    idx2++;
+  }
+
+  for (node = ares_slist_node_first(channel->servers), cnt = 0;
+       node != NULL && cnt < num_servers;
+       node = ares_slist_node_next(node), cnt++) {
+    ares_server_t *server = ares_slist_node_val(node);
+
+    if (server->latency_ewma8) {
+      ewma_sum += server->latency_ewma8;
+      measured++;
+    }
+
+    if (cnt == idx1) {
+      s1 = server;
+    } else if (cnt == idx2) {
+      s2 = server;
+    }
+  }
+
+  if (measured) {
+    default_ewma8 = (unsigned int)(ewma_sum / measured);
+  }
+
+  /* Silence coverity, not possible */
+  if (s1 == NULL || s2 == NULL) {
+    return s1; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  /* Ties go to the first pick, which is itself random */
+  if (ares_server_cost(s2, default_ewma8) <
+      ares_server_cost(s1, default_ewma8)) {
+    return s2;
+  }
+  return s1;
+}
+
 static void server_probe_cb(void *arg, ares_status_t status, size_t timeouts,
                             const ares_dns_record_t *dnsrec)
 {
@@ -1222,20 +1553,26 @@ static ares_conn_t *ares_fetch_connection(const ares_channel_t *channel,
 
 static ares_status_t ares_conn_query_write(ares_conn_t          *conn,
                                            ares_query_t         *query,
+                                           ares_dns_record_t    *dnsrec,
                                            const ares_timeval_t *now)
 {
   ares_server_t  *server  = conn->server;
   ares_channel_t *channel = server->channel;
   ares_status_t   status;
 
-  status = ares_cookie_apply(query->query, conn, now);
+  status = ares_edns_apply(query, dnsrec, conn, now);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  status = ares_cookie_apply(dnsrec, conn, now);
   if (status != ARES_SUCCESS) {
     return status;
   }
 
   /* We write using the TCP format even for UDP, we just strip the length
    * before putting on the wire */
-  status = ares_dns_write_buf_tcp(query->query, conn->out_buf);
+  status = ares_dns_write_buf_tcp(dnsrec, conn->out_buf);
   if (status != ARES_SUCCESS) {
     return status;
   }
@@ -1248,6 +1585,11 @@ static ares_status_t ares_conn_query_write(ares_conn_t          *conn,
     return ARES_SUCCESS;
   }
 
+  /* Part of a batch, everything gets written together at the end */
+  if (channel->defer_writes) {
+    return ARES_SUCCESS;
+  }
+
   /* Delay actual write if possible (TCP only, and only if callback
    * configured) */
   if (channel->notify_pending_write_cb && !channel->notify_pending_write &&
@@ -1276,13 +1618,26 @@ ares_status_t ares_send_query(ares_server_t *requested_server,
   if (requested_server != NULL) {
     server = requested_server;
   } else {
-    /* If rotate is turned on, do a random selection */
-    if (channel->rotate) {
+    if (channel->server_select == ARES_SERVER_SELECT_P2C) {
+      server = ares_p2c_server(channel);
+    } else if (channel->rotate) {
+      /* If rotate is turned on, do a random selection */
       server = ares_random_server(channel);
     } else {
       /* First server in list */
       server = ares_slist_first_val(channel->servers);
     }
+
+    /* Don't send the question to a server that recently failed it.  If every
+     * server has, fail right away rather than adding to their load. */
+    if (server != NULL &&
+        ares_qcache_servfail_cached(channel, now, query, server)) {
+      server = ares_servfail_alternate(channel, query, now);
+      if (server == NULL) {
+        end_query(channel, NULL, query, ARES_ESERVFAIL, NULL, NULL);
+        return ARES_ESERVFAIL;
+      }
+    }
   }
 
   if (server == NULL) {
@@ -1319,8 +1674,24 @@ ares_status_t ares_send_query(ares_server_t *requested_server,
     }
   }
 
+  /* A server that doesn't support EDNS is sent a copy of the request without
+   * the OPT RR, the request keeps it for any other server it fails over to */
+  ares_dns_record_destroy(query->conn_query);
+  query->conn_query = NULL;
+  if (ares_edns_strip(server, query->query, now)) {
+    status = ares_dns_record_duplicate_ex(&query->conn_query, query->query);
+    if (status != ARES_SUCCESS) {
+      /* LCOV_EXCL_START: OutOfMemory */
+      end_query(channel, server, query, status, NULL, NULL);
+      return status;
+      /* LCOV_EXCL_STOP */
+    }
+  }
+
   /* Write the query */
-  status = ares_conn_query_write(conn, query, now);
+  status = ares_conn_query_write(
+    conn, query,
+    (query->conn_query != NULL) ? query->conn_query : query->query, now);
   switch (status) {
     /* Good result, continue on */
     case ARES_SUCCESS:
@@ -1356,6 +1727,22 @@ ares_status_t ares_send_query(ares_server_t *requested_server,
   query->ts      = *now;
   query->timeout = *now;
   timeadd(&query->timeout, timeplus);
+
+  /* If hedging, wake up early to send the hedge.  Queries directed at a
+   * specific server or that won't be retried are never hedged. */
+  query->hedge_armed = ARES_FALSE;
+  ares_query_drop_hedge(query);
+  if (requested_server == NULL && !query->no_retries &&
+      channel->hedge_credit >= ARES_HEDGE_CREDIT_COST &&
+      ares_slist_len(channel->servers) > 1) {
+    size_t hedge_ms = ares_metrics_server_hedge_delay(server, now);
+    if (hedge_ms != 0 && hedge_ms < timeplus) {
+      query->hedge_deadline = query->timeout;
+      query->hedge_armed    = ARES_TRUE;
+      query->timeout        = *now;
+      timeadd(&query->timeout, hedge_ms);
+    }
+  }
   query->node_queries_by_timeout =
     ares_slist_insert(channel->queries_by_timeout, query);
   if (!query->node_queries_by_timeout) {
@@ -1365,6 +1752,9 @@ ares_status_t ares_send_query(ares_server_t *requested_server,
     /* LCOV_EXCL_STOP */
   }
 
+  ARES_TRACE(channel, ARES_TRACE_QUERY_SEND, query->qid, server, ARES_SUCCESS,
+             timeplus);
+
   /* Keep track of queries bucketed by connection, so we can process errors
    * quickly. */
   ares_llist_node_destroy(query->node_queries_to_conn);
@@ -1475,6 +1865,9 @@ static void end_query(ares_channel_t *channel, ares_server_t *server,
 
   ares_metrics_record(query, server, status, dnsrec);
 
+  ARES_TRACE(channel, ARES_TRACE_QUERY_END, query->qid, server, status,
+             query->timeouts);
+
   /* Delay calling the query callback */
   if (requeue != NULL) {
     ares_append_endqueue(requeue, query, status, dnsrec);
@@ -1483,6 +1876,7 @@ static void end_query(ares_channel_t *channel, ares_server_t *server,
 
   /* Invoke the callback. */
   query->callback(query->arg, status, query->timeouts, dnsrec);
+  ARES_TRACE(channel, ARES_TRACE_QUERY_CALLBACK, query->qid, NULL, status, 0);
   ares_free_query(query);
 
   /* Check and notify if no other queries are enqueued on the channel.  This
@@ -1502,5 +1896,5 @@ void ares_free_query(ares_query_t *query)
   /* Deallocate the memory associated with the query */
   ares_dns_record_destroy(query->query);
 
-  ares_free(query);
+  ares_pool_free(query->channel->query_pool, query, sizeof(*query));
 }
@@ -27,12 +27,19 @@
 
 struct ares_qcache {
   ares_htable_strvp_t *cache;
+  /* Reverse (PTR) entries also indexed by address, see
+   * ares_qcache_fetch_ptr() */
+  ares_htable_strvp_t *by_addr;
   ares_slist_t        *expire;
   unsigned int         max_ttl;
+  /* Number of server failure entries, lets sends skip building a key when
+   * there are none */
+  size_t               servfail_cnt;
 };
 
 typedef struct {
   char              *key;
+  char              *addr_key;
   ares_dns_record_t *dnsrec;
   time_t             expire_ts;
   time_t             insert_ts;
@@ -138,6 +145,172 @@ fail:
   /* LCOV_EXCL_STOP */
 }
 
+static int ares_qcache_hexval(char c)
+{
+  if (ares_isdigit(c)) {
+    return c - '0';
+  }
+  c = (char)ares_tolower((unsigned char)c);
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+/* Parse a reverse lookup name, e.g. 4.3.2.1.in-addr.arpa, back into the
+ * address it was built from by ares_dns_addr_to_ptr().  Only the full form is
+ * accepted, names for partial addresses don't map to a single address. */
+static ares_bool_t ares_qcache_ptr_to_addr(const char *name, size_t len,
+                                           struct ares_addr *addr)
+{
+  static const char v4_suffix[] = ".in-addr.arpa";
+  static const char v6_suffix[] = ".ip6.arpa";
+  size_t            v4_len      = sizeof(v4_suffix) - 1;
+  size_t            v6_len      = sizeof(v6_suffix) - 1;
+  size_t            i;
+
+  memset(addr, 0, sizeof(*addr));
+
+  if (len > v4_len && ares_strcaseeq_max(name + len - v4_len, v4_suffix,
+                                         v4_len)) {
+    unsigned char *octets = (unsigned char *)&addr->addr.addr4;
+    size_t         pos    = 0;
+
+    len -= v4_len;
+    for (i = 0; i < 4; i++) {
+      unsigned int val    = 0;
+      size_t       digits = 0;
+
+      while (pos < len && ares_isdigit(name[pos]) && digits < 3) {
+        val = val * 10 + (unsigned int)(name[pos] - '0');
+        pos++;
+        digits++;
+      }
+      if (digits == 0 || val > 255) {
+        return ARES_FALSE;
+      }
+      /* Labels are separated by dots, the last one ends the prefix */
+      if (i < 3) {
+        if (pos >= len || name[pos] != '.') {
+          return ARES_FALSE;
+        }
+        pos++;
+      }
+      octets[3 - i] = (unsigned char)val;
+    }
+    if (pos != len) {
+      return ARES_FALSE;
+    }
+    addr->family = AF_INET;
+    return ARES_TRUE;
+  }
+
+  /* 32 nibbles, least significant first, each followed by a dot except the
+   * last one which is followed by the suffix */
+  if (len == 63 + v6_len &&
+      ares_strcaseeq_max(name + 63, v6_suffix, v6_len)) {
+    unsigned char *bytes = (unsigned char *)&addr->addr.addr6;
+
+    for (i = 0; i < 32; i++) {
+      int val = ares_qcache_hexval(name[i * 2]);
+      if (val < 0 || (i < 31 && name[i * 2 + 1] != '.')) {
+        return ARES_FALSE;
+      }
+      if (i % 2 == 0) {
+        bytes[15 - i / 2] = (unsigned char)val;
+      } else {
+        bytes[15 - i / 2] |= (unsigned char)(val << 4);
+      }
+    }
+    addr->family = AF_INET6;
+    return ARES_TRUE;
+  }
+
+  return ARES_FALSE;
+}
+
+/* Key in the address index, the RD and CD flags as in the query key followed
+ * by the address, e.g. rd|192.168.1.1 */
+static char *ares_qcache_addr_key(const char *flags, size_t flags_len,
+                                  const struct ares_addr *addr)
+{
+  char   ipaddr[INET6_ADDRSTRLEN];
+  char   key[sizeof(ipaddr) + 8];
+  size_t len;
+
+  if (flags_len > 4 ||
+      ares_inet_ntop(addr->family, &addr->addr, ipaddr, sizeof(ipaddr)) ==
+        NULL) {
+    return NULL;
+  }
+
+  memcpy(key, flags, flags_len);
+  key[flags_len] = '|';
+  len            = ares_strlen(ipaddr);
+  memcpy(key + flags_len + 1, ipaddr, len + 1);
+
+  return ares_strdup(key);
+}
+
+/* If the entry is the answer to a reverse lookup, also index it by the
+ * address being looked up.  This works off the query key, so it applies to
+ * entries restored by ares_qcache_load() as well. */
+static void ares_qcache_index_addr(ares_qcache_t       *qcache,
+                                   ares_qcache_entry_t *entry)
+{
+  static const char prefix[]    = "QUERY|";
+  static const char ptr_class[] = "|PTR|IN|";
+  const char       *flags;
+  const char       *name;
+  size_t            flags_len;
+  struct ares_addr  addr;
+
+  if (entry->dnsrec == NULL ||
+      !ares_strcaseeq_max(entry->key, prefix, sizeof(prefix) - 1)) {
+    return;
+  }
+
+  flags     = entry->key + sizeof(prefix) - 1;
+  flags_len = 0;
+  while (flags[flags_len] != '|' && flags[flags_len] != 0) {
+    flags_len++;
+  }
+
+  if (!ares_strcaseeq_max(flags + flags_len, ptr_class,
+                          sizeof(ptr_class) - 1)) {
+    return;
+  }
+
+  name = flags + flags_len + sizeof(ptr_class) - 1;
+  if (!ares_qcache_ptr_to_addr(name, ares_strlen(name), &addr)) {
+    return;
+  }
+
+  entry->addr_key = ares_qcache_addr_key(flags, flags_len, &addr);
+  if (entry->addr_key == NULL) {
+    return; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  if (!ares_htable_strvp_insert(qcache->by_addr, entry->addr_key, entry)) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    ares_free(entry->addr_key);
+    entry->addr_key = NULL;
+    /* LCOV_EXCL_STOP */
+  }
+}
+
+static void ares_qcache_unindex_addr(ares_qcache_t             *qcache,
+                                     const ares_qcache_entry_t *entry)
+{
+  /* The same address may have been cached again under a differently cased
+   * name, only remove the index if it is still ours */
+  if (entry->addr_key != NULL &&
+      ares_htable_strvp_get_direct(qcache->by_addr, entry->addr_key) ==
+        entry) {
+    ares_htable_strvp_remove(qcache->by_addr, entry->addr_key);
+  }
+}
+
 static void ares_qcache_expire(ares_qcache_t *cache, const ares_timeval_t *now)
 {
   ares_slist_node_t *node;
@@ -154,6 +327,10 @@ static void ares_qcache_expire(ares_qcache_t *cache, const ares_timeval_t *now)
       break;
     }
 
+    if (entry->dnsrec == NULL) {
+      cache->servfail_cnt--;
+    }
+    ares_qcache_unindex_addr(cache, entry);
     ares_htable_strvp_remove(cache->cache, entry->key);
     ares_slist_node_destroy(node);
   }
@@ -170,6 +347,7 @@ void ares_qcache_destroy(ares_qcache_t *cache)
     return;
   }
 
+  ares_htable_strvp_destroy(cache->by_addr);
   ares_htable_strvp_destroy(cache->cache);
   ares_slist_destroy(cache->expire);
   ares_free(cache);
@@ -199,6 +377,7 @@ static void ares_qcache_entry_destroy_cb(void *arg)
   }
 
   ares_free(entry->key);
+  ares_free(entry->addr_key);
   ares_dns_record_destroy(entry->dnsrec);
   ares_free(entry);
 }
@@ -222,6 +401,12 @@ ares_status_t ares_qcache_create(ares_rand_state *rand_state,
     goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
   }
 
+  cache->by_addr = ares_htable_strvp_create(NULL);
+  if (cache->by_addr == NULL) {
+    status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
   cache->expire = ares_slist_create(rand_state, ares_qcache_entry_sort_cb,
                                     ares_qcache_entry_destroy_cb);
   if (cache->expire == NULL) {
@@ -271,7 +456,8 @@ static unsigned int ares_qcache_calc_minttl(ares_dns_record_t *dnsrec)
   return minttl;
 }
 
-static unsigned int ares_qcache_soa_minimum(ares_dns_record_t *dnsrec)
+static ares_bool_t ares_qcache_soa_minimum(ares_dns_record_t *dnsrec,
+                                           unsigned int      *ttl_out)
 {
   size_t i;
 
@@ -291,20 +477,19 @@ static unsigned int ares_qcache_soa_minimum(ares_dns_record_t *dnsrec)
     minimum = ares_dns_rr_get_u32(rr, ARES_RR_SOA_MINIMUM);
     ttl     = ares_dns_rr_get_ttl(rr);
 
-    if (ttl > minimum) {
-      return minimum;
-    }
-    return ttl;
+    *ttl_out = (ttl > minimum) ? minimum : ttl;
+    return ARES_TRUE;
   }
 
-  return 0;
+  return ARES_FALSE;
 }
 
 /* On success, takes ownership of dnsrec */
 static ares_status_t ares_qcache_insert_int(ares_qcache_t           *qcache,
                                             ares_dns_record_t       *qresp,
                                             const ares_dns_record_t *qreq,
-                                            const ares_timeval_t    *now)
+                                            const ares_timeval_t    *now,
+                                            unsigned int negative_ttl)
 {
   ares_qcache_entry_t *entry;
   unsigned int         ttl;
@@ -325,9 +510,14 @@ static ares_status_t ares_qcache_insert_int(ares_qcache_t           *qcache,
     return ARES_ENOTIMP;
   }
 
-  /* Look at SOA for NXDOMAIN for minimum */
-  if (rcode == ARES_RCODE_NXDOMAIN) {
-    ttl = ares_qcache_soa_minimum(qresp);
+  /* RFC 2308 Section 5: NXDOMAIN and NODATA answers are cached based on the
+   * SOA in the authority section.  Negative answers without an SOA should not
+   * be cached, unless a fallback TTL has been configured. */
+  if (rcode == ARES_RCODE_NXDOMAIN ||
+      ares_dns_record_rr_cnt(qresp, ARES_SECTION_ANSWER) == 0) {
+    if (!ares_qcache_soa_minimum(qresp, &ttl)) {
+      ttl = negative_ttl;
+    }
   } else {
     ttl = ares_qcache_calc_minttl(qresp);
   }
@@ -367,6 +557,8 @@ static ares_status_t ares_qcache_insert_int(ares_qcache_t           *qcache,
     goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
   }
 
+  ares_qcache_index_addr(qcache, entry);
+
   return ARES_SUCCESS;
 
 /* LCOV_EXCL_START: OutOfMemory */
@@ -421,6 +613,47 @@ done:
   return status;
 }
 
+ares_status_t ares_qcache_fetch_ptr(ares_channel_t           *channel,
+                                    const ares_timeval_t     *now,
+                                    const struct ares_addr   *addr,
+                                    const ares_dns_record_t **dnsrec_resp)
+{
+  char                *key;
+  ares_qcache_entry_t *entry;
+
+  if (channel == NULL || addr == NULL || dnsrec_resp == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  if (channel->qcache == NULL) {
+    return ARES_ENOTFOUND;
+  }
+
+  ares_qcache_expire(channel->qcache, now);
+
+  /* Same flags ares_query() would put in the request */
+  if (channel->flags & ARES_FLAG_NORECURSE) {
+    key = ares_qcache_addr_key("", 0, addr);
+  } else {
+    key = ares_qcache_addr_key("rd", 2, addr);
+  }
+  if (key == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  entry = ares_htable_strvp_get_direct(channel->qcache->by_addr, key);
+  ares_free(key);
+  if (entry == NULL) {
+    return ARES_ENOTFOUND;
+  }
+
+  ares_dns_record_ttl_decrement(entry->dnsrec,
+                                (unsigned int)(now->sec - entry->insert_ts));
+
+  *dnsrec_resp = entry->dnsrec;
+  return ARES_SUCCESS;
+}
+
 ares_status_t ares_qcache_insert(ares_channel_t          *channel,
                                  const ares_timeval_t    *now,
                                  const ares_query_t      *query,
@@ -432,9 +665,317 @@ ares_status_t ares_qcache_insert(ares_channel_t          *channel,
   if (dupdns == NULL) {
     return ARES_ENOMEM;
   }
-  status = ares_qcache_insert_int(channel->qcache, dupdns, query->query, now);
+  status = ares_qcache_insert_int(channel->qcache, dupdns, query->query, now,
+                                  channel->qcache_negative_ttl);
   if (status != ARES_SUCCESS) {
     ares_dns_record_destroy(dupdns);
   }
   return status;
 }
+
+/* Key for a server failure entry, RFC 2308 Section 7.1 says these are cached
+ * per question and per server.  Format is SERVFAIL|SERVER|<query key> */
+static char *ares_qcache_servfail_key(const ares_server_t     *server,
+                                      const ares_dns_record_t *dnsrec)
+{
+  ares_buf_t   *buf = ares_buf_create();
+  char         *key = ares_qcache_calc_key(dnsrec);
+  ares_status_t status;
+
+  if (buf == NULL || key == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_buf_append_str(buf, "SERVFAIL|");
+  if (status != ARES_SUCCESS) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_get_server_addr(server, buf);
+  if (status != ARES_SUCCESS) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_buf_append_byte(buf, '|');
+  if (status != ARES_SUCCESS) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_buf_append_str(buf, key);
+  if (status != ARES_SUCCESS) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ares_free(key);
+  return ares_buf_finish_str(buf, NULL);
+
+/* LCOV_EXCL_START: OutOfMemory */
+fail:
+  ares_free(key);
+  ares_buf_destroy(buf);
+  return NULL;
+  /* LCOV_EXCL_STOP */
+}
+
+ares_status_t ares_qcache_insert_servfail(ares_channel_t       *channel,
+                                          const ares_timeval_t *now,
+                                          const ares_query_t   *query,
+                                          const ares_server_t  *server)
+{
+  ares_qcache_t       *qcache = channel->qcache;
+  ares_qcache_entry_t *entry  = NULL;
+  unsigned int         ttl    = channel->qcache_servfail_ttl;
+
+  if (qcache == NULL || ttl == 0) {
+    return ARES_ENOTIMP;
+  }
+
+  if (ttl > qcache->max_ttl) {
+    ttl = qcache->max_ttl;
+  }
+
+  entry = ares_malloc_zero(sizeof(*entry));
+  if (entry == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  /* No response is stored, only the fact the server failed */
+  entry->expire_ts = (time_t)now->sec + (time_t)ttl;
+  entry->insert_ts = (time_t)now->sec;
+
+  entry->key = ares_qcache_servfail_key(server, query->query);
+  if (entry->key == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  /* Another query for the same question may have failed on this server
+   * already */
+  if (ares_htable_strvp_get(qcache->cache, entry->key, NULL)) {
+    ares_free(entry->key);
+    ares_free(entry);
+    return ARES_SUCCESS;
+  }
+
+  if (!ares_htable_strvp_insert(qcache->cache, entry->key, entry)) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  if (ares_slist_insert(qcache->expire, entry) == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  qcache->servfail_cnt++;
+  return ARES_SUCCESS;
+
+/* LCOV_EXCL_START: OutOfMemory */
+fail:
+  if (entry != NULL && entry->key != NULL) {
+    ares_htable_strvp_remove(qcache->cache, entry->key);
+    ares_free(entry->key);
+  }
+  ares_free(entry);
+  return ARES_ENOMEM;
+  /* LCOV_EXCL_STOP */
+}
+
+ares_bool_t ares_qcache_servfail_cached(ares_channel_t       *channel,
+                                        const ares_timeval_t *now,
+                                        const ares_query_t   *query,
+                                        const ares_server_t  *server)
+{
+  char       *key;
+  ares_bool_t found;
+
+  /* Checked on every send, avoid building a key when nothing could match */
+  if (channel->qcache == NULL || channel->qcache_servfail_ttl == 0 ||
+      channel->qcache->servfail_cnt == 0) {
+    return ARES_FALSE;
+  }
+
+  ares_qcache_expire(channel->qcache, now);
+
+  key = ares_qcache_servfail_key(server, query->query);
+  if (key == NULL) {
+    return ARES_FALSE; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  found = ares_htable_strvp_get(channel->qcache->cache, key, NULL);
+  ares_free(key);
+  return found;
+}
+
+/* Entries are saved as remaining TTL, key, and the response in TCP wire
+ * format (16bit length followed by the message).  Server failure entries are
+ * not saved as they are tied to this process's view of the servers. */
+ares_status_t ares_qcache_save(const ares_qcache_t *qcache,
+                               const ares_timeval_t *now, ares_buf_t *buf)
+{
+  ares_slist_node_t *node;
+  size_t             cnt = 0;
+  ares_status_t      status;
+
+  if (qcache != NULL) {
+    for (node = ares_slist_node_first(qcache->expire); node != NULL;
+         node = ares_slist_node_next(node)) {
+      const ares_qcache_entry_t *entry = ares_slist_node_val(node);
+      if (entry->dnsrec != NULL && entry->expire_ts > now->sec) {
+        cnt++;
+      }
+    }
+  }
+
+  status = ares_buf_append_be32(buf, (unsigned int)cnt);
+  if (status != ARES_SUCCESS || cnt == 0) {
+    return status;
+  }
+
+  for (node = ares_slist_node_first(qcache->expire); node != NULL;
+       node = ares_slist_node_next(node)) {
+    ares_qcache_entry_t *entry = ares_slist_node_val(node);
+    size_t               key_len;
+
+    if (entry->dnsrec == NULL || entry->expire_ts <= now->sec) {
+      continue;
+    }
+
+    status =
+      ares_buf_append_be32(buf, (unsigned int)(entry->expire_ts - now->sec));
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    key_len = ares_strlen(entry->key);
+    status  = ares_buf_append_be16(buf, (unsigned short)key_len);
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    status = ares_buf_append(buf, (const unsigned char *)entry->key, key_len);
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    /* Write the TTLs as they stand now */
+    ares_dns_record_ttl_decrement(entry->dnsrec,
+                                  (unsigned int)(now->sec - entry->insert_ts));
+    status = ares_dns_write_buf_tcp(entry->dnsrec, buf);
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  return ARES_SUCCESS;
+}
+
+/* Counterpart to ares_qcache_save().  elapsed is how many seconds have gone
+ * by since the entries were saved; anything that has expired in the meantime
+ * is discarded, as is everything if the cache is disabled. */
+ares_status_t ares_qcache_load(ares_qcache_t *qcache, const ares_timeval_t *now,
+                               unsigned int elapsed, ares_buf_t *buf)
+{
+  unsigned int  cnt;
+  unsigned int  i;
+  ares_status_t status;
+
+  status = ares_buf_fetch_be32(buf, &cnt);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    ares_qcache_entry_t *entry  = NULL;
+    ares_dns_record_t   *dnsrec = NULL;
+    unsigned char       *key    = NULL;
+    const unsigned char *msg;
+    unsigned int         ttl;
+    unsigned short       key_len;
+    unsigned short       msg_len;
+    size_t               remaining;
+
+    status = ares_buf_fetch_be32(buf, &ttl);
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_be16(buf, &key_len);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_bytes_dup(buf, key_len, ARES_TRUE, &key);
+    }
+    if (status == ARES_SUCCESS) {
+      status = ares_buf_fetch_be16(buf, &msg_len);
+    }
+    if (status != ARES_SUCCESS) {
+      ares_free(key);
+      return ARES_EBADRESP;
+    }
+
+    msg = ares_buf_peek(buf, &remaining);
+    if (remaining < msg_len) {
+      ares_free(key);
+      return ARES_EBADRESP;
+    }
+
+    status = ares_dns_parse(msg, msg_len, 0, &dnsrec);
+    ares_buf_consume(buf, msg_len);
+    if (status != ARES_SUCCESS) {
+      ares_free(key);
+      return ARES_EBADRESP;
+    }
+
+    if (qcache == NULL || ttl <= elapsed ||
+        ares_htable_strvp_get(qcache->cache, (const char *)key, NULL)) {
+      goto skip;
+    }
+
+    ttl -= elapsed;
+    if (ttl > qcache->max_ttl) {
+      ttl = qcache->max_ttl;
+    }
+
+    entry = ares_malloc_zero(sizeof(*entry));
+    if (entry == NULL) {
+      goto skip; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    entry->key       = (char *)key;
+    entry->dnsrec    = dnsrec;
+    entry->expire_ts = (time_t)now->sec + (time_t)ttl;
+    /* TTLs in the record were current as of the save */
+    entry->insert_ts = (time_t)now->sec - (time_t)elapsed;
+
+    if (!ares_htable_strvp_insert(qcache->cache, entry->key, entry)) {
+      goto skip; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    if (ares_slist_insert(qcache->expire, entry) == NULL) {
+      /* LCOV_EXCL_START: OutOfMemory */
+      ares_htable_strvp_remove(qcache->cache, entry->key);
+      goto skip;
+      /* LCOV_EXCL_STOP */
+    }
+    ares_qcache_index_addr(qcache, entry);
+    continue;
+
+  skip:
+    ares_free(entry);
+    ares_free(key);
+    ares_dns_record_destroy(dnsrec);
+  }
+
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_set_qcache_negative_ttl(ares_channel_t *channel,
+                                           unsigned int    fallback_ttl,
+                                           unsigned int    servfail_ttl)
+{
+  /* RFC 2308 Section 7.1: server failures must not be cached for longer than
+   * five minutes */
+  if (channel == NULL || servfail_ttl > 300) {
+    return ARES_EFORMERR;
+  }
+
+  ares_channel_lock(channel);
+  channel->qcache_negative_ttl = fallback_ttl;
+  channel->qcache_servfail_ttl = servfail_ttl;
+  ares_channel_unlock(channel);
+  return ARES_SUCCESS;
+}
@@ -130,6 +130,56 @@ ares_status_t ares_query_dnsrec(ares_channel_t *channel, const char *name,
   return status;
 }
 
+ares_status_t ares_send_batch(ares_channel_t           *channel,
+                              const ares_batch_query_t *queries, size_t cnt,
+                              ares_callback_dnsrec callback)
+{
+  ares_status_t status = ARES_SUCCESS;
+  ares_bool_t   nested;
+  size_t        i;
+
+  if (channel == NULL || (queries == NULL && cnt != 0)) {
+    return ARES_EFORMERR;
+  }
+
+  /* Validate everything up front so a malformed entry rejects the batch
+   * before anything is sent.  Past this point each query stands on its own, a
+   * failure is reported to that query's callback and doesn't undo the rest */
+  for (i = 0; i < cnt; i++) {
+    if (queries[i].name == NULL ||
+        (queries[i].callback == NULL && callback == NULL)) {
+      return ARES_EFORMERR;
+    }
+  }
+
+  ares_channel_lock(channel);
+
+  /* Cached answers are delivered immediately, so a callback may submit a
+   * batch of its own; only the outermost batch flushes */
+  nested                = channel->defer_writes;
+  channel->defer_writes = ARES_TRUE;
+
+  for (i = 0; i < cnt; i++) {
+    ares_status_t qstatus;
+
+    qstatus = ares_query_nolock(
+      channel, queries[i].name, queries[i].dnsclass, queries[i].type,
+      queries[i].callback != NULL ? queries[i].callback : callback,
+      queries[i].arg, NULL);
+    if (qstatus != ARES_SUCCESS && status == ARES_SUCCESS) {
+      status = qstatus;
+    }
+  }
+
+  if (!nested) {
+    ares_flush_deferred_writes(channel);
+  }
+
+  ares_channel_unlock(channel);
+
+  return status;
+}
+
 void ares_query(ares_channel_t *channel, const char *name, int dnsclass,
                 int type, ares_callback callback, void *arg)
 {
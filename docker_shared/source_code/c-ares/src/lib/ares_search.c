@@ -31,6 +31,18 @@
 #  include <strings.h>
 #endif
 
+struct search_query;
+
+/* State of a single candidate name when searching in parallel */
+typedef struct {
+  struct search_query *squery;
+  unsigned short       qid;        /* valid once sent */
+  ares_bool_t          sent;       /* query is (or was) outstanding */
+  ares_bool_t          done;       /* result has been recorded */
+  ares_status_t        status;     /* result, as interpreted by search */
+  ares_dns_record_t   *dnsrec;     /* response, only kept if it may be used */
+} search_candidate_t;
+
 struct search_query {
   /* Arguments passed to ares_search_dnsrec() */
   ares_channel_t      *channel;
@@ -48,28 +60,113 @@ struct search_query {
   size_t               next_name_idx; /* next name index being attempted */
   size_t      timeouts;        /* number of timeouts we saw for this request */
   ares_bool_t ever_got_nodata; /* did we ever get ARES_ENODATA along the way? */
+
+  /* ARES_FLAG_PARALLEL_SEARCH: one entry per name, next_name_idx is then the
+   * next candidate whose result needs to be evaluated */
+  search_candidate_t *candidates;
+  ares_bool_t         dispatching; /* still sending, don't evaluate yet */
 };
 
 static void squery_free(struct search_query *squery)
 {
+  size_t i;
+
   if (squery == NULL) {
     return; /* LCOV_EXCL_LINE: DefensiveCoding */
   }
+  if (squery->candidates != NULL) {
+    for (i = 0; i < squery->names_cnt; i++) {
+      ares_dns_record_destroy(squery->candidates[i].dnsrec);
+    }
+    ares_free(squery->candidates);
+  }
   ares_strsplit_free(squery->names, squery->names_cnt);
   ares_dns_record_destroy(squery->dnsrec);
   ares_free(squery);
 }
 
+/* Cancel any candidate queries still outstanding, their results can no
+ * longer change the outcome of the search */
+static void squery_cancel_candidates(struct search_query *squery)
+{
+  size_t i;
+
+  if (squery->candidates == NULL) {
+    return;
+  }
+
+  for (i = 0; i < squery->names_cnt; i++) {
+    search_candidate_t *cand = &squery->candidates[i];
+    ares_query_t       *query;
+
+    if (!cand->sent || cand->done) {
+      continue;
+    }
+
+    cand->done = ARES_TRUE;
+    query =
+      ares_htable_szvp_get_direct(squery->channel->queries_by_qid, cand->qid);
+    if (query != NULL && query->arg == cand) {
+      ares_free_query(query);
+    }
+  }
+}
+
 /* End a search query by invoking the user callback and freeing the
  * search_query structure.
  */
 static void end_squery(struct search_query *squery, ares_status_t status,
                        const ares_dns_record_t *dnsrec)
 {
+  squery_cancel_candidates(squery);
   squery->callback(squery->arg, status, squery->timeouts, dnsrec);
   squery_free(squery);
 }
 
+static ares_status_t search_reply_status(ares_status_t            status,
+                                         const ares_dns_record_t *dnsrec)
+{
+  if (dnsrec) {
+    ares_dns_rcode_t rcode = ares_dns_record_get_rcode(dnsrec);
+    size_t ancount = ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER);
+    return ares_dns_query_reply_tostatus(rcode, ancount);
+  }
+  return status;
+}
+
+/* Whether the result for the given name means the next name in the search
+ * list should be tried */
+static ares_bool_t search_should_continue(const struct search_query *squery,
+                                          size_t idx, ares_status_t status)
+{
+  switch (status) {
+    case ARES_ENODATA:
+    case ARES_ENOTFOUND:
+      return ARES_TRUE;
+    case ARES_ESERVFAIL:
+    case ARES_EREFUSED:
+      /* Issue #852, systemd-resolved may return SERVFAIL or REFUSED on a
+       * single label domain name. */
+      if (ares_name_label_cnt(squery->names[idx]) == 1) {
+        return ARES_TRUE;
+      }
+      return ARES_FALSE;
+    default:
+      break;
+  }
+  return ARES_FALSE;
+}
+
+/* Status to return once all names are exhausted */
+static ares_status_t search_exhausted_status(const struct search_query *squery,
+                                             ares_status_t last_status)
+{
+  if (last_status == ARES_ENOTFOUND && squery->ever_got_nodata) {
+    return ARES_ENODATA;
+  }
+  return last_status;
+}
+
 static void search_callback(void *arg, ares_status_t status, size_t timeouts,
                             const ares_dns_record_t *dnsrec);
 
@@ -113,30 +210,11 @@ static void search_callback(void *arg, ares_status_t status, size_t timeouts,
 
   squery->timeouts += timeouts;
 
-  if (dnsrec) {
-    ares_dns_rcode_t rcode = ares_dns_record_get_rcode(dnsrec);
-    size_t ancount = ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER);
-    mystatus       = ares_dns_query_reply_tostatus(rcode, ancount);
-  } else {
-    mystatus = status;
-  }
+  mystatus = search_reply_status(status, dnsrec);
 
-  switch (mystatus) {
-    case ARES_ENODATA:
-    case ARES_ENOTFOUND:
-      break;
-    case ARES_ESERVFAIL:
-    case ARES_EREFUSED:
-      /* Issue #852, systemd-resolved may return SERVFAIL or REFUSED on a
-       * single label domain name. */
-      if (ares_name_label_cnt(squery->names[squery->next_name_idx - 1]) != 1) {
-        end_squery(squery, mystatus, dnsrec);
-        return;
-      }
-      break;
-    default:
-      end_squery(squery, mystatus, dnsrec);
-      return;
+  if (!search_should_continue(squery, squery->next_name_idx - 1, mystatus)) {
+    end_squery(squery, mystatus, dnsrec);
+    return;
   }
 
   /* If we ever get ARES_ENODATA along the way, record that; if the search
@@ -158,12 +236,120 @@ static void search_callback(void *arg, ares_status_t status, size_t timeouts,
   }
 
   /* We have no more domains to search, return an appropriate response. */
-  if (mystatus == ARES_ENOTFOUND && squery->ever_got_nodata) {
-    end_squery(squery, ARES_ENODATA, NULL);
+  end_squery(squery, search_exhausted_status(squery, mystatus), NULL);
+}
+
+/* Walk the candidate results in search order for as long as they are known.
+ * Returns ARES_TRUE if that is enough to decide the result, which is the same
+ * result a serial search would have produced.  If finish is set, the search
+ * is ended when decided. */
+static ares_bool_t search_parallel_evaluate(struct search_query *squery,
+                                            ares_bool_t          finish)
+{
+  size_t idx = squery->next_name_idx;
+
+  while (idx < squery->names_cnt && squery->candidates[idx].done) {
+    const search_candidate_t *cand = &squery->candidates[idx];
+
+    if (!search_should_continue(squery, idx, cand->status)) {
+      if (finish) {
+        end_squery(squery, cand->status, cand->dnsrec);
+      }
+      return ARES_TRUE;
+    }
+
+    if (finish) {
+      if (cand->status == ARES_ENODATA) {
+        squery->ever_got_nodata = ARES_TRUE;
+      }
+      squery->next_name_idx = idx + 1;
+    }
+    idx++;
+  }
+
+  if (idx < squery->names_cnt) {
+    return ARES_FALSE;
+  }
+
+  if (finish) {
+    end_squery(squery,
+               search_exhausted_status(
+                 squery, squery->candidates[squery->names_cnt - 1].status),
+               NULL);
+  }
+  return ARES_TRUE;
+}
+
+static void search_parallel_callback(void *arg, ares_status_t status,
+                                     size_t                   timeouts,
+                                     const ares_dns_record_t *dnsrec)
+{
+  search_candidate_t  *cand   = arg;
+  struct search_query *squery = cand->squery;
+  size_t               idx    = (size_t)(cand - squery->candidates);
+
+  squery->timeouts += timeouts;
+  cand->done        = ARES_TRUE;
+  cand->status      = search_reply_status(status, dnsrec);
+
+  /* Only a response that ends the search is ever passed on */
+  if (dnsrec != NULL && !search_should_continue(squery, idx, cand->status)) {
+    cand->dnsrec = ares_dns_record_duplicate(dnsrec);
+    if (cand->dnsrec == NULL) {
+      cand->status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  if (squery->dispatching) {
     return;
   }
 
-  end_squery(squery, mystatus, NULL);
+  search_parallel_evaluate(squery, ARES_TRUE);
+}
+
+/* Send queries for all candidate names at once, stopping early if the result
+ * is already known (e.g. served from cache) */
+static ares_status_t ares_search_parallel(ares_channel_t      *channel,
+                                          struct search_query *squery)
+{
+  size_t i;
+
+  squery->candidates =
+    ares_malloc_zero(sizeof(*squery->candidates) * squery->names_cnt);
+  if (squery->candidates == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  squery->dispatching = ARES_TRUE;
+  for (i = 0; i < squery->names_cnt; i++) {
+    search_candidate_t *cand = &squery->candidates[i];
+    ares_status_t       status;
+
+    cand->squery = squery;
+
+    status =
+      ares_dns_record_query_set_name(squery->dnsrec, 0, squery->names[i]);
+    if (status != ARES_SUCCESS) {
+      /* LCOV_EXCL_START: OutOfMemory */
+      cand->done   = ARES_TRUE;
+      cand->status = status;
+      break;
+      /* LCOV_EXCL_STOP */
+    }
+
+    /* The callback is always invoked on failure */
+    cand->sent = ARES_TRUE;
+    ares_send_nolock(channel, NULL, 0, squery->dnsrec, search_parallel_callback,
+                     cand, &cand->qid);
+
+    if (search_parallel_evaluate(squery, ARES_FALSE)) {
+      break;
+    }
+  }
+  squery->dispatching = ARES_FALSE;
+
+  search_parallel_evaluate(squery, ARES_TRUE);
+  return ARES_SUCCESS;
 }
 
 /* Determine if the domain should be looked up as-is, or if it is eligible
@@ -367,6 +553,14 @@ static ares_status_t ares_search_int(ares_channel_t          *channel,
     goto fail;
   }
 
+  if (channel->flags & ARES_FLAG_PARALLEL_SEARCH && squery->names_cnt > 1) {
+    status = ares_search_parallel(channel, squery);
+    if (status != ARES_SUCCESS) {
+      goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+    return status;
+  }
+
   status = ares_search_next(channel, squery, &skip_cleanup);
   if (status != ARES_SUCCESS) {
     goto fail;
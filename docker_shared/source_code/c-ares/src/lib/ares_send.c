@@ -130,18 +130,21 @@ ares_status_t ares_send_nolock(ares_channel_t *channel, ares_server_t *server,
     if (status != ARES_ENOTFOUND) {
       /* ARES_SUCCESS means we retrieved the cache, anything else is a critical
        * failure, all result in termination */
+      if (status == ARES_SUCCESS) {
+        ARES_TRACE(channel, ARES_TRACE_QCACHE_HIT, id, NULL, status, 0);
+      }
       callback(arg, status, 0, dnsrec_resp);
+      ARES_TRACE(channel, ARES_TRACE_QUERY_CALLBACK, id, NULL, status, 0);
       return status;
     }
   }
 
   /* Allocate space for query and allocated fields. */
-  query = ares_malloc(sizeof(ares_query_t));
+  query = ares_pool_alloc(channel->query_pool, sizeof(*query));
   if (!query) {
     callback(arg, ARES_ENOMEM, 0, NULL); /* LCOV_EXCL_LINE: OutOfMemory */
     return ARES_ENOMEM;                  /* LCOV_EXCL_LINE: OutOfMemory */
   }
-  memset(query, 0, sizeof(*query));
 
   query->channel      = channel;
   query->qid          = id;
@@ -158,7 +161,7 @@ ares_status_t ares_send_nolock(ares_channel_t *channel, ares_server_t *server,
     if (status == ARES_EBADRESP) {
       status = ARES_EBADQUERY;
     }
-    ares_free(query);
+    ares_pool_free(channel->query_pool, query, sizeof(*query));
     callback(arg, status, 0, NULL);
     return status;
   }
@@ -215,6 +218,16 @@ ares_status_t ares_send_nolock(ares_channel_t *channel, ares_server_t *server,
     /* LCOV_EXCL_STOP */
   }
 
+  ARES_TRACE(channel, ARES_TRACE_QUERY_ENQUEUE, id, server, ARES_SUCCESS, 0);
+
+  /* Each new query earns a share of a hedge */
+  if (channel->hedge_percentile) {
+    channel->hedge_credit += channel->hedge_budget;
+    if (channel->hedge_credit > ARES_HEDGE_CREDIT_MAX) {
+      channel->hedge_credit = ARES_HEDGE_CREDIT_MAX;
+    }
+  }
+
   /* Perform the first query action. */
 
   status = ares_send_query(server, query, &now);
@@ -0,0 +1,505 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "ares_private.h"
+
+#ifdef USE_WINSOCK
+#  define DATABASEPATH      "DatabasePath"
+#  define WIN_PATH_SERVICES "\\services"
+#endif
+
+/* SERVICES FILE PROCESSING OVERVIEW
+ * =================================
+ * ares_getnameinfo() and ares_getaddrinfo() translate between port numbers
+ * and service names.  The system getservbyport() and getservbyname() re-read
+ * the services file on every call, and may take locks inside libc, which is a
+ * poor fit for a resolver handling many lookups.
+ *
+ * Instead the services file is parsed once per channel into forwards and
+ * backwards hashtables, and only parsed again once its modification time
+ * changes, as is done for the hosts file.  So that lookups don't touch the
+ * filesystem at all, the modification time is checked at most once every
+ * ARES_SERVICES_CHECK_INTERVAL seconds.  Each row is a service name followed
+ * by port/protocol and a list of space delimited aliases:
+ *
+ *   http   80/tcp   www   # WorldWideWeb HTTP
+ *
+ * As with getservbyport(), the first name listed for a port is the one
+ * returned.  When the file cannot be read, services are looked up in a small
+ * built-in table of well-known services instead.
+ */
+
+#define ARES_SERVICES_CHECK_INTERVAL 1 /* seconds */
+
+struct ares_services_file {
+  /*! Timestamp of the last parse, used for expiry */
+  time_t              ts;
+  /*! Path the file was loaded from */
+  char               *filename;
+  /*! "port/proto" to service name */
+  ares_htable_dict_t *byport;
+  /*! "name/proto" to port, for names and aliases */
+  ares_htable_dict_t *byname;
+};
+
+#define ARES_SERV_TCP  (1 << 0)
+#define ARES_SERV_UDP  (1 << 1)
+#define ARES_SERV_SCTP (1 << 2)
+#define ARES_SERV_DCCP (1 << 3)
+
+#define ARES_SERV_BOTH (ARES_SERV_TCP | ARES_SERV_UDP)
+
+typedef struct {
+  const char    *name;
+  unsigned short port;
+  unsigned int   protos;
+  const char    *alias;
+} ares_builtin_service_t;
+
+/* Sorted by port */
+static const ares_builtin_service_t ares_builtin_services[] = {
+  { "echo",         7,    ARES_SERV_BOTH, NULL            },
+  { "discard",      9,    ARES_SERV_BOTH, "sink"          },
+  { "daytime",      13,   ARES_SERV_BOTH, NULL            },
+  { "ftp-data",     20,   ARES_SERV_TCP,  NULL            },
+  { "ftp",          21,   ARES_SERV_TCP,  NULL            },
+  { "ssh",          22,   ARES_SERV_TCP,  NULL            },
+  { "telnet",       23,   ARES_SERV_TCP,  NULL            },
+  { "smtp",         25,   ARES_SERV_TCP,  "mail"          },
+  { "time",         37,   ARES_SERV_BOTH, NULL            },
+  { "whois",        43,   ARES_SERV_TCP,  "nicname"       },
+  { "tacacs",       49,   ARES_SERV_BOTH, NULL            },
+  { "domain",       53,   ARES_SERV_BOTH, NULL            },
+  { "bootps",       67,   ARES_SERV_UDP,  NULL            },
+  { "bootpc",       68,   ARES_SERV_UDP,  NULL            },
+  { "tftp",         69,   ARES_SERV_UDP,  NULL            },
+  { "gopher",       70,   ARES_SERV_TCP,  NULL            },
+  { "finger",       79,   ARES_SERV_TCP,  NULL            },
+  { "http",         80,   ARES_SERV_TCP,  "www"           },
+  { "kerberos",     88,   ARES_SERV_BOTH, "kerberos5"     },
+  { "pop3",         110,  ARES_SERV_TCP,  "pop-3"         },
+  { "sunrpc",       111,  ARES_SERV_BOTH, "portmapper"    },
+  { "auth",         113,  ARES_SERV_TCP,  "ident"         },
+  { "nntp",         119,  ARES_SERV_TCP,  "readnews"      },
+  { "ntp",          123,  ARES_SERV_UDP,  NULL            },
+  { "netbios-ns",   137,  ARES_SERV_UDP,  NULL            },
+  { "netbios-dgm",  138,  ARES_SERV_UDP,  NULL            },
+  { "netbios-ssn",  139,  ARES_SERV_TCP,  NULL            },
+  { "imap2",        143,  ARES_SERV_TCP,  "imap"          },
+  { "snmp",         161,  ARES_SERV_BOTH, NULL            },
+  { "snmp-trap",    162,  ARES_SERV_BOTH, "snmptrap"      },
+  { "bgp",          179,  ARES_SERV_TCP,  NULL            },
+  { "ldap",         389,  ARES_SERV_BOTH, NULL            },
+  { "https",        443,  ARES_SERV_BOTH, NULL            },
+  { "microsoft-ds", 445,  ARES_SERV_TCP,  NULL            },
+  { "kpasswd",      464,  ARES_SERV_BOTH, NULL            },
+  { "submissions",  465,  ARES_SERV_TCP,  "smtps"         },
+  { "shell",        514,  ARES_SERV_TCP,  "cmd"           },
+  { "syslog",       514,  ARES_SERV_UDP,  NULL            },
+  { "printer",      515,  ARES_SERV_TCP,  "spooler"       },
+  { "submission",   587,  ARES_SERV_TCP,  NULL            },
+  { "ldaps",        636,  ARES_SERV_BOTH, NULL            },
+  { "rsync",        873,  ARES_SERV_TCP,  NULL            },
+  { "ftps-data",    989,  ARES_SERV_TCP,  NULL            },
+  { "ftps",         990,  ARES_SERV_TCP,  NULL            },
+  { "imaps",        993,  ARES_SERV_TCP,  NULL            },
+  { "pop3s",        995,  ARES_SERV_TCP,  NULL            },
+  { "openvpn",      1194, ARES_SERV_BOTH, NULL            },
+  { "ms-sql-s",     1433, ARES_SERV_TCP,  NULL            },
+  { "radius",       1812, ARES_SERV_BOTH, NULL            },
+  { "radius-acct",  1813, ARES_SERV_BOTH, "radacct"       },
+  { "nfs",          2049, ARES_SERV_BOTH, NULL            },
+  { "mysql",        3306, ARES_SERV_TCP,  NULL            },
+  { "sip",          5060, ARES_SERV_BOTH, NULL            },
+  { "xmpp-client",  5222, ARES_SERV_TCP,  "jabber-client" },
+  { "postgresql",   5432, ARES_SERV_TCP,  "postgres"      },
+  { "redis",        6379, ARES_SERV_TCP,  NULL            },
+  { "http-alt",     8080, ARES_SERV_TCP,  "webcache"      },
+  { NULL,           0,    0,              NULL            }
+};
+
+static unsigned int ares_services_proto(const char *proto)
+{
+  if (ares_streq(proto, "tcp")) {
+    return ARES_SERV_TCP;
+  }
+  if (ares_streq(proto, "udp")) {
+    return ARES_SERV_UDP;
+  }
+  if (ares_streq(proto, "sctp")) {
+    return ARES_SERV_SCTP;
+  }
+  if (ares_streq(proto, "dccp")) {
+    return ARES_SERV_DCCP;
+  }
+  return 0;
+}
+
+static ares_services_file_t *ares_services_file_create(void)
+{
+  ares_services_file_t *sf = ares_malloc_zero(sizeof(*sf));
+  if (sf == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  sf->byport = ares_htable_dict_create();
+  if (sf->byport == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  sf->byname = ares_htable_dict_create();
+  if (sf->byname == NULL) {
+    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  return sf;
+
+/* LCOV_EXCL_START: OutOfMemory */
+fail:
+  ares_services_file_destroy(sf);
+  return NULL;
+  /* LCOV_EXCL_STOP */
+}
+
+void ares_services_file_destroy(ares_services_file_t *sf)
+{
+  if (sf == NULL) {
+    return;
+  }
+
+  ares_free(sf->filename);
+  ares_htable_dict_destroy(sf->byport);
+  ares_htable_dict_destroy(sf->byname);
+  ares_free(sf);
+}
+
+/* Adds a name or alias for port/proto, the first one seen for either wins */
+static ares_status_t ares_services_add(ares_services_file_t *sf,
+                                       const char *name, unsigned short port,
+                                       const char *proto, ares_bool_t is_alias)
+{
+  char key[64];
+  char portstr[8];
+
+  snprintf(portstr, sizeof(portstr), "%u", (unsigned int)port);
+
+  if (!is_alias) {
+    snprintf(key, sizeof(key), "%s/%s", portstr, proto);
+    if (!ares_htable_dict_get(sf->byport, key, NULL) &&
+        !ares_htable_dict_insert(sf->byport, key, name)) {
+      return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  snprintf(key, sizeof(key), "%s/%s", name, proto);
+  if (!ares_htable_dict_get(sf->byname, key, NULL) &&
+      !ares_htable_dict_insert(sf->byname, key, portstr)) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  return ARES_SUCCESS;
+}
+
+/* Tokens end at whitespace, or at a comment which may directly follow them */
+static size_t ares_services_consume_token(ares_buf_t *buf)
+{
+  static const unsigned char delims[] = " \t\v\f\r\n#";
+  return ares_buf_consume_until_charset(buf, delims, sizeof(delims) - 1,
+                                        ARES_FALSE);
+}
+
+/* Parses a single "name port/proto [alias ...]" line, the comment and line
+ * ending are left for the caller */
+static ares_status_t ares_services_parse_line(ares_services_file_t *sf,
+                                              ares_buf_t           *buf)
+{
+  char          name[32];
+  char          portproto[32];
+  char         *proto;
+  unsigned int  port;
+  ares_status_t status;
+
+  ares_buf_tag(buf);
+  ares_services_consume_token(buf);
+  status = ares_buf_tag_fetch_string(buf, name, sizeof(name));
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  ares_buf_consume_whitespace(buf, ARES_FALSE);
+
+  ares_buf_tag(buf);
+  ares_services_consume_token(buf);
+  status = ares_buf_tag_fetch_string(buf, portproto, sizeof(portproto));
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  proto = strchr(portproto, '/');
+  if (proto == NULL || proto == portproto || proto[1] == 0) {
+    return ARES_EBADSTR;
+  }
+  *proto = 0;
+  proto++;
+
+  if (!ares_str_isnum(portproto) || ares_strlen(portproto) > 5) {
+    return ARES_EBADSTR;
+  }
+  port = (unsigned int)atoi(portproto);
+  if (port == 0 || port > 65535) {
+    return ARES_EBADSTR;
+  }
+
+  status = ares_services_add(sf, name, (unsigned short)port, proto, ARES_FALSE);
+  if (status != ARES_SUCCESS) {
+    return status; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  /* Aliases run until the end of the line or a comment */
+  while (1) {
+    unsigned char c;
+    char          alias[32];
+
+    ares_buf_consume_whitespace(buf, ARES_FALSE);
+    if (ares_buf_peek_byte(buf, &c) != ARES_SUCCESS || c == '\n' ||
+        c == '#') {
+      break;
+    }
+
+    ares_buf_tag(buf);
+    ares_services_consume_token(buf);
+    if (ares_buf_tag_fetch_string(buf, alias, sizeof(alias)) != ARES_SUCCESS) {
+      continue;
+    }
+
+    status =
+      ares_services_add(sf, alias, (unsigned short)port, proto, ARES_TRUE);
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_services_parse(const char            *filename,
+                                  ares_services_file_t **out)
+{
+  ares_buf_t           *buf = NULL;
+  ares_services_file_t *sf  = NULL;
+  ares_status_t         status;
+
+  *out = NULL;
+
+  buf = ares_buf_create();
+  if (buf == NULL) {
+    status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_buf_load_file(filename, buf);
+  if (status != ARES_SUCCESS) {
+    goto done;
+  }
+
+  sf = ares_services_file_create();
+  if (sf == NULL) {
+    status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  sf->filename = ares_strdup(filename);
+  if (sf->filename == NULL) {
+    status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  while (ares_buf_len(buf)) {
+    unsigned char comment = '#';
+
+    /* -- Start of new line here -- */
+
+    /* Consume any leading whitespace */
+    ares_buf_consume_whitespace(buf, ARES_FALSE);
+
+    if (ares_buf_len(buf) == 0) {
+      break;
+    }
+
+    /* Blank and comment lines, as well as bad lines, are skipped */
+    if (!ares_buf_begins_with(buf, &comment, 1)) {
+      status = ares_services_parse_line(sf, buf);
+      if (status == ARES_ENOMEM) {
+        goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+    }
+
+    /* Go to next line */
+    ares_buf_consume_line(buf, ARES_TRUE);
+  }
+
+  sf->ts = time(NULL);
+  status = ARES_SUCCESS;
+
+done:
+  ares_buf_destroy(buf);
+  if (status != ARES_SUCCESS) {
+    ares_services_file_destroy(sf);
+  } else {
+    *out = sf;
+  }
+  return status;
+}
+
+static ares_status_t ares_services_path(char **path)
+{
+  *path = NULL;
+
+#if defined(USE_WINSOCK)
+  {
+    char  PATH_SERVICES[MAX_PATH] = "";
+    char  tmp[MAX_PATH];
+    HKEY  hkeyServices;
+    DWORD dwLength = sizeof(tmp);
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, WIN_NS_NT_KEY, 0, KEY_READ,
+                      &hkeyServices) != ERROR_SUCCESS) {
+      return ARES_ENOTFOUND;
+    }
+    RegQueryValueExA(hkeyServices, DATABASEPATH, NULL, NULL, (LPBYTE)tmp,
+                     &dwLength);
+    ExpandEnvironmentStringsA(tmp, PATH_SERVICES, MAX_PATH);
+    RegCloseKey(hkeyServices);
+    strcat(PATH_SERVICES, WIN_PATH_SERVICES);
+    *path = ares_strdup(PATH_SERVICES);
+  }
+#elif defined(PATH_SERVICES)
+  *path = ares_strdup(PATH_SERVICES);
+#else
+  return ARES_ENOTFOUND;
+#endif
+
+  if (*path == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_services_update(ares_services_file_t **sf,
+                                   const char            *filename)
+{
+  if (*sf != NULL && !ares_file_expired(filename, (*sf)->filename, (*sf)->ts)) {
+    return ARES_SUCCESS;
+  }
+
+  ares_services_file_destroy(*sf);
+  *sf = NULL;
+
+  return ares_services_parse(filename, sf);
+}
+
+const ares_services_file_t *ares_services_get(ares_channel_t *channel)
+{
+  char          *filename = NULL;
+  ares_timeval_t now;
+
+  ares_tvnow(&now);
+  if (!ares_timedout(&now, &channel->services_expire)) {
+    return channel->services;
+  }
+  channel->services_expire.sec  = now.sec + ARES_SERVICES_CHECK_INTERVAL;
+  channel->services_expire.usec = now.usec;
+
+  if (ares_services_path(&filename) != ARES_SUCCESS) {
+    ares_services_file_destroy(channel->services);
+    channel->services = NULL;
+    return NULL;
+  }
+
+  /* On failure the services are left NULL and the built-in table is used */
+  ares_services_update(&channel->services, filename);
+  ares_free(filename);
+
+  return channel->services;
+}
+
+const char *ares_services_port_to_name(const ares_services_file_t *sf,
+                                       unsigned short port, const char *proto)
+{
+  unsigned int protobit = ares_services_proto(proto);
+  size_t       i;
+
+  if (sf != NULL) {
+    char key[64];
+
+    snprintf(key, sizeof(key), "%u/%s", (unsigned int)port, proto);
+    return ares_htable_dict_get_direct(sf->byport, key);
+  }
+
+  for (i = 0; ares_builtin_services[i].name != NULL &&
+              ares_builtin_services[i].port <= port;
+       i++) {
+    if (ares_builtin_services[i].port == port &&
+        ares_builtin_services[i].protos & protobit) {
+      return ares_builtin_services[i].name;
+    }
+  }
+
+  return NULL;
+}
+
+unsigned short ares_services_name_to_port(const ares_services_file_t *sf,
+                                          const char *name, const char *proto)
+{
+  unsigned int protobit = ares_services_proto(proto);
+  size_t       i;
+
+  /* Longer than any name the file can hold */
+  if (ares_strlen(name) >= 32) {
+    return 0;
+  }
+
+  if (sf != NULL) {
+    char        key[64];
+    const char *port;
+
+    snprintf(key, sizeof(key), "%s/%s", name, proto);
+    port = ares_htable_dict_get_direct(sf->byname, key);
+    if (port == NULL) {
+      return 0;
+    }
+    return (unsigned short)atoi(port);
+  }
+
+  for (i = 0; ares_builtin_services[i].name != NULL; i++) {
+    if (ares_builtin_services[i].protos & protobit &&
+        (ares_streq(ares_builtin_services[i].name, name) ||
+         (ares_builtin_services[i].alias != NULL &&
+          ares_streq(ares_builtin_services[i].alias, name)))) {
+      return ares_builtin_services[i].port;
+    }
+  }
+
+  return 0;
+}
@@ -107,6 +107,9 @@ ares_status_t
     return ARES_EFORMERR;
   }
 
+  /* Source addresses were looked up with the prior functions */
+  ares_sortaddrinfo_cache_flush(channel);
+
   memset(&channel->sock_funcs, 0, sizeof(channel->sock_funcs));
 
   /* Copy individually for ABI compliance.  memcpy() with a sizeof would do
@@ -334,10 +334,38 @@ static int rfc6724_compare(const void *ptr1, const void *ptr2)
   return ((int)a1->original_order) - ((int)a2->original_order);
 }
 
+/* Source address lookups are cached per destination prefix.  /24 and /64 are
+ * the longest prefixes routed on the internet, so destinations sharing one
+ * only use different source addresses when host specific local routes exist.
+ * Entries are flushed on reinit and on interface or route changes when the
+ * event thread can monitor for them, and otherwise simply expire.  Once full
+ * the oldest entry is evicted, as every entry has the same TTL that is also
+ * the one closest to expiring. */
+#define ARES_SRCADDR_CACHE_TTL 60 /* seconds */
+#define ARES_SRCADDR_CACHE_MAX 256
+#define ARES_SRCADDR_KEY_LEN   64
+
+typedef struct {
+  char               key[ARES_SRCADDR_KEY_LEN];
+  int                result; /* find_src_addr() result, never -1 */
+  ares_sockaddr      src_addr;
+  ares_timeval_t     expire;
+  ares_llist_node_t *node;
+} ares_srcaddr_entry_t;
+
+struct ares_srcaddr_cache {
+  ares_htable_strvp_t *by_key; /*!< key to entry, entries not owned */
+  ares_llist_t        *order;  /*!< entries oldest first, owns the entries */
+};
+
 /*
  * Find the source address that will be used if trying to connect to the given
  * address.
  *
+ * Each probe uses a fresh socket: a reconnected UDP socket keeps the source
+ * address it was first bound to on some systems, such as Linux, and would
+ * report it for any later destination.
+ *
  * Returns 1 if a source address was found, 0 if the address is unreachable
  * and -1 if a fatal error occurred. If 0 or 1, the contents of src_addr are
  * undefined.
@@ -385,6 +413,173 @@ static int find_src_addr(ares_channel_t *channel, const struct sockaddr *addr,
   return 1;
 }
 
+static const char hexdigits[] = "0123456789abcdef";
+
+static ares_bool_t srcaddr_cache_key(const struct sockaddr *addr, char *key,
+                                     size_t key_len)
+{
+  const unsigned char *prefix;
+  size_t               prefix_len;
+  unsigned int         scope_id = 0;
+  size_t               i;
+  size_t               len = 0;
+
+  switch (addr->sa_family) {
+    case AF_INET:
+      prefix = (const unsigned char *)&CARES_INADDR_CAST(
+                 const struct sockaddr_in *, addr)
+                 ->sin_addr;
+      prefix_len = 3;
+      break;
+    case AF_INET6:
+      prefix = (const unsigned char *)&CARES_INADDR_CAST(
+                 const struct sockaddr_in6 *, addr)
+                 ->sin6_addr;
+      prefix_len = 8;
+      scope_id   = (unsigned int)CARES_INADDR_CAST(
+                   const struct sockaddr_in6 *, addr)
+                   ->sin6_scope_id;
+      break;
+    default:
+      return ARES_FALSE;
+  }
+
+  /* family, hex prefix, and 8 hex digits of scope id */
+  if (key_len < 1 + (prefix_len * 2) + 8 + 1) {
+    return ARES_FALSE; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  key[len++] = addr->sa_family == AF_INET ? '4' : '6';
+  for (i = 0; i < prefix_len; i++) {
+    key[len++] = hexdigits[(prefix[i] >> 4) & 0xF];
+    key[len++] = hexdigits[prefix[i] & 0xF];
+  }
+  for (i = 0; i < 8; i++) {
+    key[len++] = hexdigits[(scope_id >> (28 - (i * 4))) & 0xF];
+  }
+  key[len] = 0;
+  return ARES_TRUE;
+}
+
+static void srcaddr_cache_remove(ares_srcaddr_cache_t *cache,
+                                 ares_srcaddr_entry_t *entry)
+{
+  ares_htable_strvp_remove(cache->by_key, entry->key);
+  ares_llist_node_destroy(entry->node);
+}
+
+static ares_srcaddr_cache_t *srcaddr_cache_create(void)
+{
+  ares_srcaddr_cache_t *cache = ares_malloc_zero(sizeof(*cache));
+  if (cache == NULL) {
+    return NULL; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  cache->by_key = ares_htable_strvp_create(NULL);
+  cache->order  = ares_llist_create(ares_free);
+  if (cache->by_key == NULL || cache->order == NULL) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    ares_htable_strvp_destroy(cache->by_key);
+    ares_llist_destroy(cache->order);
+    ares_free(cache);
+    return NULL;
+    /* LCOV_EXCL_STOP */
+  }
+  return cache;
+}
+
+static void srcaddr_cache_insert(ares_channel_t *channel, const char *key,
+                                 const ares_timeval_t  *now, int result,
+                                 const struct sockaddr *src_addr)
+{
+  ares_srcaddr_cache_t *cache;
+  ares_srcaddr_entry_t *entry;
+
+  if (channel->srcaddr_cache == NULL) {
+    channel->srcaddr_cache = srcaddr_cache_create();
+    if (channel->srcaddr_cache == NULL) {
+      return; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+  cache = channel->srcaddr_cache;
+
+  if (ares_llist_len(cache->order) >= ARES_SRCADDR_CACHE_MAX) {
+    srcaddr_cache_remove(
+      cache, ares_llist_node_val(ares_llist_node_first(cache->order)));
+  }
+
+  entry = ares_malloc_zero(sizeof(*entry));
+  if (entry == NULL) {
+    return; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ares_strcpy(entry->key, key, sizeof(entry->key));
+  entry->result = result;
+  if (result == 1) {
+    memcpy(&entry->src_addr, src_addr, sizeof(entry->src_addr));
+  }
+  entry->expire.sec  = now->sec + ARES_SRCADDR_CACHE_TTL;
+  entry->expire.usec = now->usec;
+
+  entry->node = ares_llist_insert_last(cache->order, entry);
+  if (entry->node == NULL) {
+    ares_free(entry); /* LCOV_EXCL_LINE: OutOfMemory */
+    return;           /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  if (!ares_htable_strvp_insert(cache->by_key, key, entry)) {
+    ares_llist_node_destroy(entry->node); /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+}
+
+/* Same as find_src_addr(), but serves from and populates the source address
+ * cache */
+static int find_src_addr_cached(ares_channel_t        *channel,
+                                const ares_timeval_t  *now,
+                                const struct sockaddr *addr,
+                                struct sockaddr       *src_addr)
+{
+  char                  key[ARES_SRCADDR_KEY_LEN];
+  ares_srcaddr_entry_t *entry = NULL;
+  int                   rv;
+
+  if (!srcaddr_cache_key(addr, key, sizeof(key))) {
+    return find_src_addr(channel, addr, src_addr);
+  }
+
+  if (channel->srcaddr_cache != NULL) {
+    entry = ares_htable_strvp_get_direct(channel->srcaddr_cache->by_key, key);
+  }
+
+  if (entry != NULL) {
+    if (!ares_timedout(now, &entry->expire)) {
+      if (entry->result == 1) {
+        memcpy(src_addr, &entry->src_addr, sizeof(entry->src_addr));
+      }
+      return entry->result;
+    }
+    srcaddr_cache_remove(channel->srcaddr_cache, entry);
+  }
+
+  rv = find_src_addr(channel, addr, src_addr);
+  if (rv != -1) {
+    srcaddr_cache_insert(channel, key, now, rv, src_addr);
+  }
+  return rv;
+}
+
+void ares_sortaddrinfo_cache_flush(ares_channel_t *channel)
+{
+  if (channel->srcaddr_cache == NULL) {
+    return;
+  }
+
+  ares_htable_strvp_destroy(channel->srcaddr_cache->by_key);
+  ares_llist_destroy(channel->srcaddr_cache->order);
+  ares_free(channel->srcaddr_cache);
+  channel->srcaddr_cache = NULL;
+}
+
 /*
  * Sort the linked list starting at sentinel->ai_next in RFC6724 order.
  * Will leave the list unchanged if an error occurs.
@@ -397,6 +592,7 @@ ares_status_t ares_sortaddrinfo(ares_channel_t            *channel,
   size_t                     i;
   int                        has_src_addr;
   struct addrinfo_sort_elem *elems;
+  ares_timeval_t             now;
 
   cur = list_sentinel->ai_next;
   while (cur) {
@@ -408,12 +604,20 @@ ares_status_t ares_sortaddrinfo(ares_channel_t            *channel,
     return ARES_ENODATA;
   }
 
+  /* Without getsockname() no source address can be determined, don't bother
+   * probing */
+  if (channel->sock_funcs.agetsockname == NULL) {
+    return ARES_ENOTFOUND;
+  }
+
   elems = (struct addrinfo_sort_elem *)ares_malloc(
     nelem * sizeof(struct addrinfo_sort_elem));
   if (!elems) {
     return ARES_ENOMEM;
   }
 
+  ares_tvnow(&now);
+
   /*
    * Convert the linked list to an array that also contains the candidate
    * source address for each destination address.
@@ -423,7 +627,8 @@ ares_status_t ares_sortaddrinfo(ares_channel_t            *channel,
     assert(cur != NULL);
     elems[i].ai             = cur;
     elems[i].original_order = i;
-    has_src_addr = find_src_addr(channel, cur->ai_addr, &elems[i].src_addr.sa);
+    has_src_addr =
+      find_src_addr_cached(channel, &now, cur->ai_addr, &elems[i].src_addr.sa);
     if (has_src_addr == -1) {
       ares_free(elems);
       return ARES_ENOTFOUND;
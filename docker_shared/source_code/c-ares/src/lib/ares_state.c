@@ -0,0 +1,364 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Warm state persistence.
+ *
+ * A freshly initialized channel knows nothing: the cache is empty, every
+ * server uses the configured timeout, and DNS cookies have to be
+ * renegotiated.  ares_save_state() writes what a channel has learned to a
+ * file so a restarted process can pick up where it left off with
+ * ares_load_state().
+ *
+ * The file is big-endian binary:
+ *
+ *   magic    8 bytes "CARESWS" followed by the format version
+ *   saved_ts 64bit wall clock time of the save, used to age the contents
+ *   servers  16bit count, then per server the 16bit length prefixed address
+ *            as returned by ares_get_servers_csv() and a 32bit length prefixed
+ *            payload of the server metrics followed by the server cookie.
+ *            Servers not configured on the loading channel are skipped.
+ *   qcache   32bit count, then per entry the remaining TTL, the cache key
+ *            and the response in DNS wire format, see ares_qcache_save().
+ */
+
+#include "ares_private.h"
+
+#define ARES_STATE_MAGIC     "CARESWS"
+#define ARES_STATE_MAGIC_LEN 7
+#define ARES_STATE_VERSION   2
+
+static ares_status_t ares_state_save_server(const ares_server_t  *server,
+                                            const ares_timeval_t *now,
+                                            ares_buf_t           *buf)
+{
+  ares_buf_t          *payload = NULL;
+  const unsigned char *ptr;
+  size_t               len;
+  ares_status_t        status;
+
+  payload = ares_buf_create();
+  if (payload == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_get_server_addr(server, payload);
+  if (status != ARES_SUCCESS) {
+    goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ptr    = ares_buf_peek(payload, &len);
+  status = ares_buf_append_be16(buf, (unsigned short)len);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append(buf, ptr, len);
+  }
+  if (status != ARES_SUCCESS) {
+    goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ares_buf_set_length(payload, 0);
+  status = ares_metrics_save(server, now, payload);
+  if (status == ARES_SUCCESS) {
+    status = ares_cookie_save(server, now, payload);
+  }
+  if (status != ARES_SUCCESS) {
+    goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ptr    = ares_buf_peek(payload, &len);
+  status = ares_buf_append_be32(buf, (unsigned int)len);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append(buf, ptr, len);
+  }
+
+done:
+  ares_buf_destroy(payload);
+  return status;
+}
+
+static ares_status_t ares_state_save(const ares_channel_t *channel,
+                                     ares_buf_t           *buf)
+{
+  ares_slist_node_t *node;
+  ares_timeval_t     now;
+  ares_uint64_t      saved_ts = (ares_uint64_t)time(NULL);
+  ares_status_t      status;
+
+  ares_tvnow(&now);
+
+  status = ares_buf_append(buf, (const unsigned char *)ARES_STATE_MAGIC,
+                           ARES_STATE_MAGIC_LEN);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_byte(buf, ARES_STATE_VERSION);
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_be32(buf, (unsigned int)(saved_ts >> 32));
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_be32(buf, (unsigned int)(saved_ts & 0xFFFFFFFF));
+  }
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_append_be16(
+      buf, (unsigned short)ares_slist_len(channel->servers));
+  }
+  if (status != ARES_SUCCESS) {
+    return status; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  for (node = ares_slist_node_first(channel->servers); node != NULL;
+       node = ares_slist_node_next(node)) {
+    status = ares_state_save_server(ares_slist_node_val(node), &now, buf);
+    if (status != ARES_SUCCESS) {
+      return status; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  return ares_qcache_save(channel->qcache, &now, buf);
+}
+
+ares_status_t ares_save_state(const ares_channel_t *channel,
+                              const char           *filename)
+{
+  ares_buf_t          *buf = NULL;
+  const unsigned char *ptr;
+  size_t               len;
+  FILE                *fp = NULL;
+  ares_status_t        status;
+
+  if (channel == NULL || filename == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  buf = ares_buf_create();
+  if (buf == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  ares_channel_lock(channel);
+  status = ares_state_save(channel, buf);
+  ares_channel_unlock(channel);
+
+  if (status != ARES_SUCCESS) {
+    goto done; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    status = ARES_EFILE;
+    goto done;
+  }
+
+  ptr = ares_buf_peek(buf, &len);
+  if (fwrite(ptr, 1, len, fp) != len) {
+    status = ARES_EFILE; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  if (fclose(fp) != 0) {
+    status = ARES_EFILE; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+done:
+  ares_buf_destroy(buf);
+  return status;
+}
+
+static ares_server_t *ares_state_find_server(const ares_channel_t *channel,
+                                             const unsigned char  *addr,
+                                             size_t                addr_len,
+                                             ares_buf_t           *tmp)
+{
+  ares_slist_node_t *node;
+
+  for (node = ares_slist_node_first(channel->servers); node != NULL;
+       node = ares_slist_node_next(node)) {
+    ares_server_t       *server = ares_slist_node_val(node);
+    const unsigned char *ptr;
+    size_t               len;
+
+    ares_buf_set_length(tmp, 0);
+    if (ares_get_server_addr(server, tmp) != ARES_SUCCESS) {
+      return NULL; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    ptr = ares_buf_peek(tmp, &len);
+    if (len == addr_len && memcmp(ptr, addr, len) == 0) {
+      return server;
+    }
+  }
+
+  return NULL;
+}
+
+static ares_status_t ares_state_load_servers(ares_channel_t       *channel,
+                                             const ares_timeval_t *now,
+                                             unsigned int          elapsed,
+                                             ares_buf_t           *buf)
+{
+  ares_buf_t    *tmp = NULL;
+  unsigned short cnt;
+  unsigned short i;
+  ares_status_t  status;
+
+  status = ares_buf_fetch_be16(buf, &cnt);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  tmp = ares_buf_create();
+  if (tmp == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  for (i = 0; i < cnt; i++) {
+    ares_server_t       *server;
+    ares_buf_t          *payload;
+    const unsigned char *ptr;
+    size_t               remaining;
+    unsigned short       addr_len;
+    unsigned int         payload_len;
+
+    status = ares_buf_fetch_be16(buf, &addr_len);
+    if (status != ARES_SUCCESS) {
+      goto done;
+    }
+    ptr = ares_buf_peek(buf, &remaining);
+    if (remaining < addr_len) {
+      status = ARES_EBADRESP;
+      goto done;
+    }
+    server = ares_state_find_server(channel, ptr, addr_len, tmp);
+    ares_buf_consume(buf, addr_len);
+
+    status = ares_buf_fetch_be32(buf, &payload_len);
+    if (status != ARES_SUCCESS) {
+      goto done;
+    }
+    ptr = ares_buf_peek(buf, &remaining);
+    if (remaining < payload_len) {
+      status = ARES_EBADRESP;
+      goto done;
+    }
+
+    if (server != NULL) {
+      payload = ares_buf_create_const(ptr, payload_len);
+      if (payload == NULL) {
+        status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+        goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+      status = ares_metrics_load(server, now, elapsed, payload);
+      if (status == ARES_SUCCESS) {
+        status = ares_cookie_load(server, now, elapsed, payload);
+      }
+      ares_buf_destroy(payload);
+      if (status != ARES_SUCCESS) {
+        goto done;
+      }
+    }
+
+    ares_buf_consume(buf, payload_len);
+  }
+
+done:
+  ares_buf_destroy(tmp);
+  return status;
+}
+
+static ares_status_t ares_state_load(ares_channel_t *channel, ares_buf_t *buf)
+{
+  unsigned char  magic[ARES_STATE_MAGIC_LEN + 1];
+  unsigned int   ts_hi;
+  unsigned int   ts_lo;
+  ares_uint64_t  saved_ts;
+  ares_uint64_t  wall_ts = (ares_uint64_t)time(NULL);
+  unsigned int   elapsed = 0;
+  ares_timeval_t now;
+  ares_status_t  status;
+
+  status = ares_buf_fetch_bytes(buf, magic, sizeof(magic));
+  if (status != ARES_SUCCESS ||
+      memcmp(magic, ARES_STATE_MAGIC, ARES_STATE_MAGIC_LEN) != 0 ||
+      magic[ARES_STATE_MAGIC_LEN] != ARES_STATE_VERSION) {
+    return ARES_EBADRESP;
+  }
+
+  status = ares_buf_fetch_be32(buf, &ts_hi);
+  if (status == ARES_SUCCESS) {
+    status = ares_buf_fetch_be32(buf, &ts_lo);
+  }
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+  saved_ts = ((ares_uint64_t)ts_hi << 32) | ts_lo;
+
+  /* A clock that went backwards just means nothing is aged */
+  if (wall_ts > saved_ts) {
+    elapsed = (wall_ts - saved_ts > 0xFFFFFFFF)
+                ? 0xFFFFFFFF
+                : (unsigned int)(wall_ts - saved_ts);
+  }
+
+  ares_tvnow(&now);
+
+  status = ares_state_load_servers(channel, &now, elapsed, buf);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  return ares_qcache_load(channel->qcache, &now, elapsed, buf);
+}
+
+ares_status_t ares_load_state(ares_channel_t *channel, const char *filename)
+{
+  ares_buf_t   *buf = NULL;
+  ares_status_t status;
+
+  if (channel == NULL || filename == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  buf = ares_buf_create();
+  if (buf == NULL) {
+    return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  status = ares_buf_load_file(filename, buf);
+  if (status != ARES_SUCCESS) {
+    goto done;
+  }
+
+  ares_channel_lock(channel);
+  status = ares_state_load(channel, buf);
+  ares_channel_unlock(channel);
+
+  /* Anything that could not be parsed is reported as a bad file, whatever
+   * was loaded before that point is kept */
+  if (status != ARES_SUCCESS && status != ARES_ENOMEM) {
+    status = ARES_EFILE;
+  }
+
+done:
+  ares_buf_destroy(buf);
+  return status;
+}
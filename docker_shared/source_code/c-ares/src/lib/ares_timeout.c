@@ -65,6 +65,21 @@ void ares_timeval_diff(ares_timeval_t *tvdiff, const ares_timeval_t *tvstart,
   }
 }
 
+ares_bool_t ares_timeval_expired(const ares_timeval_t *tv,
+                                 const ares_timeval_t *now,
+                                 unsigned long         millsecs)
+{
+  ares_int64_t   tvdiff_ms;
+  ares_timeval_t tvdiff;
+  ares_timeval_diff(&tvdiff, tv, now);
+
+  tvdiff_ms = tvdiff.sec * 1000 + tvdiff.usec / 1000;
+  if (tvdiff_ms >= (ares_int64_t)millsecs) {
+    return ARES_TRUE;
+  }
+  return ARES_FALSE;
+}
+
 static void ares_timeval_to_struct_timeval(struct timeval       *tv,
                                            const ares_timeval_t *atv)
 {
@@ -132,6 +147,25 @@ static struct timeval *ares_timeout_int(const ares_channel_t *channel,
   return tvbuf;
 }
 
+ares_bool_t ares_timeout_next(const ares_channel_t *channel,
+                              ares_timeval_t       *deadline)
+{
+  const ares_query_t *query;
+  ares_slist_node_t  *node;
+
+  ares_channel_lock(channel);
+
+  node = ares_slist_node_first(channel->queries_by_timeout);
+  if (node != NULL) {
+    query     = ares_slist_node_val(node);
+    *deadline = query->timeout;
+  }
+
+  ares_channel_unlock(channel);
+
+  return node != NULL ? ARES_TRUE : ARES_FALSE;
+}
+
 struct timeval *ares_timeout(const ares_channel_t *channel,
                              struct timeval *maxtv, struct timeval *tvbuf)
 {
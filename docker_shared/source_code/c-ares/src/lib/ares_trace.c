@@ -0,0 +1,230 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "ares_private.h"
+
+const char *ares_trace_event_type_tostr(ares_trace_event_type_t type)
+{
+  switch (type) {
+    case ARES_TRACE_QUERY_ENQUEUE:
+      return "QUERY_ENQUEUE";
+    case ARES_TRACE_QCACHE_HIT:
+      return "QCACHE_HIT";
+    case ARES_TRACE_QUERY_SEND:
+      return "QUERY_SEND";
+    case ARES_TRACE_CONN_FLUSH:
+      return "CONN_FLUSH";
+    case ARES_TRACE_CONN_READ:
+      return "CONN_READ";
+    case ARES_TRACE_ANSWER:
+      return "ANSWER";
+    case ARES_TRACE_QUERY_REQUEUE:
+      return "QUERY_REQUEUE";
+    case ARES_TRACE_QUERY_TIMEOUT:
+      return "QUERY_TIMEOUT";
+    case ARES_TRACE_QUERY_END:
+      return "QUERY_END";
+    case ARES_TRACE_QUERY_CALLBACK:
+      return "QUERY_CALLBACK";
+  }
+  return "UNKNOWN";
+}
+
+#ifdef CARES_TRACE
+
+/* IMPLEMENTATION NOTES
+ * ====================
+ *
+ * Events are written into a power-of-2 sized ring of preallocated entries so
+ * that emitting an event never allocates.  The ring is indexed by two free
+ * running counters, the number of events ever written and the number of
+ * events ever read, masked to the ring size.  When the writer laps the reader
+ * the oldest events are overwritten and the reader skips ahead, accounting
+ * for them as dropped.
+ *
+ * Every emission point already runs with the channel lock held, as does
+ * fetching, so the ring needs no synchronization of its own.
+ */
+
+struct ares_trace {
+  ares_timeval_t      start;
+  ares_trace_event_t *ring;
+  size_t              ring_mask;
+  size_t              write_cnt;
+  size_t              read_cnt;
+  size_t              dropped;
+  ares_trace_cb       cb;
+  void               *cb_data;
+};
+
+void ares_trace_destroy(ares_trace_t *trace)
+{
+  if (trace == NULL) {
+    return;
+  }
+  ares_free(trace->ring);
+  ares_free(trace);
+}
+
+void ares_trace_emit(ares_channel_t *channel, ares_trace_event_type_t type,
+                     unsigned short qid, const ares_server_t *server,
+                     ares_status_t status, size_t value)
+{
+  ares_trace_t      *trace = channel->trace;
+  ares_trace_event_t event;
+  ares_timeval_t     now;
+  ares_timeval_t     diff;
+
+  ares_tvnow(&now);
+  ares_timeval_diff(&diff, &trace->start, &now);
+
+  event.type   = type;
+  event.sec    = (unsigned int)diff.sec;
+  event.usec   = diff.usec;
+  event.qid    = qid;
+  event.server = server != NULL ? server->idx : ARES_TRACE_NOSERVER;
+  event.status = status;
+  event.value  = value;
+
+  if (trace->ring != NULL) {
+    trace->ring[trace->write_cnt & trace->ring_mask] = event;
+    trace->write_cnt++;
+    if (trace->write_cnt - trace->read_cnt > trace->ring_mask + 1) {
+      trace->read_cnt++;
+      trace->dropped++;
+    }
+  }
+
+  if (trace->cb != NULL) {
+    trace->cb(&event, trace->cb_data);
+  }
+}
+
+ares_status_t ares_set_trace(ares_channel_t *channel, size_t ring_size,
+                             ares_trace_cb cb, void *user_data)
+{
+  ares_trace_t *trace = NULL;
+
+  if (channel == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  if (ring_size > 0 || cb != NULL) {
+    trace = ares_malloc_zero(sizeof(*trace));
+    if (trace == NULL) {
+      return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+
+    if (ring_size > 0) {
+      ring_size   = ares_round_up_pow2(ring_size);
+      trace->ring = ares_malloc_zero(ring_size * sizeof(*trace->ring));
+      if (trace->ring == NULL) {
+        /* LCOV_EXCL_START: OutOfMemory */
+        ares_free(trace);
+        return ARES_ENOMEM;
+        /* LCOV_EXCL_STOP */
+      }
+      trace->ring_mask = ring_size - 1;
+    }
+
+    trace->cb      = cb;
+    trace->cb_data = user_data;
+    ares_tvnow(&trace->start);
+  }
+
+  ares_channel_lock(channel);
+  ares_trace_destroy(channel->trace);
+  channel->trace = trace;
+  ares_channel_unlock(channel);
+
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_trace_fetch(ares_channel_t     *channel,
+                               ares_trace_event_t *events, size_t max_events,
+                               size_t *num_events, size_t *dropped)
+{
+  ares_trace_t *trace;
+
+  if (channel == NULL || num_events == NULL ||
+      (events == NULL && max_events > 0)) {
+    return ARES_EFORMERR;
+  }
+
+  *num_events = 0;
+  if (dropped != NULL) {
+    *dropped = 0;
+  }
+
+  ares_channel_lock(channel);
+
+  trace = channel->trace;
+  if (trace != NULL && trace->ring != NULL) {
+    while (*num_events < max_events && trace->read_cnt != trace->write_cnt) {
+      events[*num_events] = trace->ring[trace->read_cnt & trace->ring_mask];
+      trace->read_cnt++;
+      (*num_events)++;
+    }
+    if (dropped != NULL) {
+      *dropped = trace->dropped;
+    }
+    trace->dropped = 0;
+  }
+
+  ares_channel_unlock(channel);
+
+  return ARES_SUCCESS;
+}
+
+#else
+
+ares_status_t ares_set_trace(ares_channel_t *channel, size_t ring_size,
+                             ares_trace_cb cb, void *user_data)
+{
+  (void)channel;
+  (void)ring_size;
+  (void)cb;
+  (void)user_data;
+  return ARES_ENOTIMP;
+}
+
+ares_status_t ares_trace_fetch(ares_channel_t     *channel,
+                               ares_trace_event_t *events, size_t max_events,
+                               size_t *num_events, size_t *dropped)
+{
+  (void)channel;
+  (void)events;
+  (void)max_events;
+  if (num_events != NULL) {
+    *num_events = 0;
+  }
+  if (dropped != NULL) {
+    *dropped = 0;
+  }
+  return ARES_ENOTIMP;
+}
+
+#endif
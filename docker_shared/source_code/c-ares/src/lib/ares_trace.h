@@ -0,0 +1,74 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef __ARES_TRACE_H
+#define __ARES_TRACE_H
+
+/* Query lifecycle tracing.  When c-ares is built without CARES_TRACE, the
+ * ARES_TRACE() macro compiles to nothing so there is no cost at all, not even
+ * a branch.  When built with it, the cost of a channel without tracing
+ * enabled is a single pointer comparison per emission point. */
+
+struct ares_trace;
+typedef struct ares_trace ares_trace_t;
+
+#ifdef CARES_TRACE
+
+/*! Record a trace event.  Must be called with the channel lock held.
+ *
+ *  \param[in] channel Initialized ares channel with tracing enabled
+ *  \param[in] type    Event type
+ *  \param[in] qid     DNS query id, or 0 if none
+ *  \param[in] server  Server associated with the event, or NULL
+ *  \param[in] status  Status associated with the event
+ *  \param[in] value   Event-specific value
+ */
+void ares_trace_emit(ares_channel_t *channel, ares_trace_event_type_t type,
+                     unsigned short qid, const ares_server_t *server,
+                     ares_status_t status, size_t value);
+
+/*! Destroy trace state for a channel
+ *
+ *  \param[in] trace Trace state, may be NULL
+ */
+void ares_trace_destroy(ares_trace_t *trace);
+
+#  define ARES_TRACE(channel, type, qid, server, status, value)              \
+    do {                                                                      \
+      if ((channel)->trace != NULL) {                                         \
+        ares_trace_emit((channel), (type), (qid), (server), (status),        \
+                        (size_t)(value));                                     \
+      }                                                                       \
+    } while (0)
+
+#else
+
+#  define ARES_TRACE(channel, type, qid, server, status, value) \
+    do {                                                        \
+    } while (0)
+
+#endif
+
+#endif
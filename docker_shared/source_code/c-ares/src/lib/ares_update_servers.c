@@ -1360,3 +1360,24 @@ void ares_set_server_state_callback(ares_channel_t            *channel,
   channel->server_state_cb      = cb;
   channel->server_state_cb_data = data;
 }
+
+ares_status_t ares_set_server_selection(ares_channel_t      *channel,
+                                        ares_server_select_t policy)
+{
+  if (channel == NULL) {
+    return ARES_EFORMERR;
+  }
+
+  switch (policy) {
+    case ARES_SERVER_SELECT_DEFAULT:
+    case ARES_SERVER_SELECT_P2C:
+      break;
+    default:
+      return ARES_EFORMERR;
+  }
+
+  ares_channel_lock(channel);
+  channel->server_select = policy;
+  ares_channel_unlock(channel);
+  return ARES_SUCCESS;
+}
@@ -47,6 +47,7 @@ struct ares_htable {
    *       and ares_slist_t is heavier weight, so I think using ares_llist_t
    *       is an overall win. */
   ares_llist_t            **buckets;
+  ares_pool_t              *pool;
 };
 
 static unsigned int ares_htable_generate_seed(ares_htable_t *htable)
@@ -228,6 +229,7 @@ static ares_bool_t ares_htable_expand(ares_htable_t *htable)
     if (prealloc_llist[i] == NULL) {
       goto done;
     }
+    ares_llist_set_pool(prealloc_llist[i], htable->pool);
   }
 
   /* Iterate across all buckets and move the entries to the new buckets */
@@ -351,6 +353,7 @@ ares_bool_t ares_htable_insert(ares_htable_t *htable, void *bucket)
     if (htable->buckets[idx] == NULL) {
       return ARES_FALSE;
     }
+    ares_llist_set_pool(htable->buckets[idx], htable->pool);
   }
 
   node = ares_llist_insert_first(htable->buckets[idx], bucket);
@@ -407,6 +410,20 @@ ares_bool_t ares_htable_remove(ares_htable_t *htable, const void *key)
   return ARES_TRUE;
 }
 
+void ares_htable_set_pool(ares_htable_t *htable, ares_pool_t *pool)
+{
+  unsigned int i;
+
+  if (htable == NULL) {
+    return;
+  }
+
+  htable->pool = pool;
+  for (i = 0; i < htable->size; i++) {
+    ares_llist_set_pool(htable->buckets[i], pool);
+  }
+}
+
 size_t ares_htable_num_keys(const ares_htable_t *htable)
 {
   if (htable == NULL) {
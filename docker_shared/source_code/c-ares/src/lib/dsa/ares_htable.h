@@ -89,6 +89,14 @@ typedef ares_bool_t (*ares_htable_key_eq_t)(const void *key1, const void *key2);
  */
 void           ares_htable_destroy(ares_htable_t *htable);
 
+/*! Allocate the internal nodes of the hashtable from an object pool.
+ *
+ *  \param[in] htable  initialized hashtable
+ *  \param[in] pool    Pool to use, must outlive the hashtable.  NULL to
+ *                     disable.
+ */
+void           ares_htable_set_pool(ares_htable_t *htable, ares_pool_t *pool);
+
 /*! Create a new hashtable
  *
  *  \param[in] hash_func   Required. Callback for Hash function.
@@ -30,6 +30,7 @@
 struct ares_htable_szvp {
   ares_htable_szvp_val_free_t free_val;
   ares_htable_t              *hash;
+  ares_pool_t                *pool;
 };
 
 typedef struct {
@@ -68,7 +69,7 @@ static void bucket_free(void *bucket)
     arg->parent->free_val(arg->val);
   }
 
-  ares_free(arg);
+  ares_pool_free(arg->parent->pool, arg, sizeof(*arg));
 }
 
 static ares_bool_t key_eq(const void *key1, const void *key2)
@@ -97,6 +98,7 @@ ares_htable_szvp_t *
   }
 
   htable->free_val = val_free;
+  htable->pool     = NULL;
 
   return htable;
 
@@ -108,6 +110,16 @@ fail:
   return NULL;
 }
 
+void ares_htable_szvp_set_pool(ares_htable_szvp_t *htable, ares_pool_t *pool)
+{
+  if (htable == NULL) {
+    return;
+  }
+
+  htable->pool = pool;
+  ares_htable_set_pool(htable->hash, pool);
+}
+
 ares_bool_t ares_htable_szvp_insert(ares_htable_szvp_t *htable, size_t key,
                                     void *val)
 {
@@ -117,7 +129,7 @@ ares_bool_t ares_htable_szvp_insert(ares_htable_szvp_t *htable, size_t key,
     goto fail;
   }
 
-  bucket = ares_malloc(sizeof(*bucket));
+  bucket = ares_pool_alloc(htable->pool, sizeof(*bucket));
   if (bucket == NULL) {
     goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
   }
@@ -134,7 +146,9 @@ ares_bool_t ares_htable_szvp_insert(ares_htable_szvp_t *htable, size_t key,
 
 fail:
   if (bucket) {
-    ares_free(bucket); /* LCOV_EXCL_LINE: OutOfMemory */
+    /* LCOV_EXCL_START: OutOfMemory */
+    ares_pool_free(htable->pool, bucket, sizeof(*bucket));
+    /* LCOV_EXCL_STOP */
   }
   return ARES_FALSE;
 }
@@ -0,0 +1,176 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "ares_private.h"
+
+/* An object sitting in a pool is still allocated as far as AddressSanitizer
+ * knows, so it is poisoned while there.  A use after release is then reported
+ * just as a use after free would be, rather than the pool hiding it. */
+#if defined(__SANITIZE_ADDRESS__)
+#  define ARES_POOL_ASAN
+#elif defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#    define ARES_POOL_ASAN
+#  endif
+#endif
+
+#ifdef ARES_POOL_ASAN
+#  include <sanitizer/asan_interface.h>
+#  define ARES_POOL_POISON(ptr, size)   ASAN_POISON_MEMORY_REGION(ptr, size)
+#  define ARES_POOL_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#  define ARES_POOL_POISON(ptr, size)   ((void)(ptr), (void)(size))
+#  define ARES_POOL_UNPOISON(ptr, size) ((void)(ptr), (void)(size))
+#endif
+
+/* Number of distinct object sizes a pool will retain */
+#define ARES__POOL_SIZES 8
+
+/* Free objects are chained through their first bytes */
+typedef struct ares_pool_item {
+  struct ares_pool_item *next;
+} ares_pool_item_t;
+
+typedef struct {
+  size_t            size;
+  ares_pool_item_t *head;
+  size_t            cnt;
+} ares_pool_freelist_t;
+
+struct ares_pool {
+  ares_pool_freelist_t lists[ARES__POOL_SIZES];
+  size_t               nlists;
+  size_t               max_free;
+  size_t               mallocs;
+};
+
+ares_pool_t *ares_pool_create(size_t max_free)
+{
+  ares_pool_t *pool = ares_malloc_zero(sizeof(*pool));
+
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->max_free = max_free;
+  return pool;
+}
+
+void ares_pool_destroy(ares_pool_t *pool)
+{
+  size_t i;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  for (i = 0; i < pool->nlists; i++) {
+    while (pool->lists[i].head != NULL) {
+      ares_pool_item_t *item = pool->lists[i].head;
+      ARES_POOL_UNPOISON(item, pool->lists[i].size);
+      pool->lists[i].head = item->next;
+      ares_free(item);
+    }
+  }
+
+  ares_free(pool);
+}
+
+static ares_pool_freelist_t *ares_pool_freelist(ares_pool_t *pool, size_t size,
+                                                ares_bool_t create)
+{
+  size_t i;
+
+  for (i = 0; i < pool->nlists; i++) {
+    if (pool->lists[i].size == size) {
+      return &pool->lists[i];
+    }
+  }
+
+  if (!create || pool->nlists == ARES__POOL_SIZES) {
+    return NULL;
+  }
+
+  pool->lists[pool->nlists].size = size;
+  return &pool->lists[pool->nlists++];
+}
+
+void *ares_pool_alloc(ares_pool_t *pool, size_t size)
+{
+  ares_pool_freelist_t *list;
+  ares_pool_item_t     *item;
+
+  if (pool == NULL) {
+    return ares_malloc_zero(size);
+  }
+
+  list = ares_pool_freelist(pool, size, ARES_FALSE);
+  if (list == NULL || list->head == NULL) {
+    pool->mallocs++;
+    return ares_malloc_zero(size);
+  }
+
+  item = list->head;
+  ARES_POOL_UNPOISON(item, size);
+  list->head = item->next;
+  list->cnt--;
+
+  memset(item, 0, size);
+  return item;
+}
+
+void ares_pool_free(ares_pool_t *pool, void *ptr, size_t size)
+{
+  ares_pool_freelist_t *list;
+  ares_pool_item_t     *item = ptr;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (pool == NULL || size < sizeof(*item)) {
+    ares_free(ptr);
+    return;
+  }
+
+  list = ares_pool_freelist(pool, size, ARES_TRUE);
+  if (list == NULL || list->cnt >= pool->max_free) {
+    ares_free(ptr);
+    return;
+  }
+
+  item->next = list->head;
+  list->head = item;
+  list->cnt++;
+  ARES_POOL_POISON(item, size);
+}
+
+size_t ares_pool_mallocs(const ares_pool_t *pool)
+{
+  if (pool == NULL) {
+    return 0;
+  }
+  return pool->mallocs;
+}
@@ -41,6 +41,7 @@ struct ares_slist {
 
   ares_slist_cmp_t        cmp;
   ares_slist_destructor_t destruct;
+  ares_pool_t            *pool;
   size_t                  cnt;
 };
 
@@ -112,6 +113,15 @@ void ares_slist_replace_destructor(ares_slist_t           *list,
   list->destruct = destruct;
 }
 
+void ares_slist_set_pool(ares_slist_t *list, ares_pool_t *pool)
+{
+  if (list == NULL) {
+    return;
+  }
+
+  list->pool = pool;
+}
+
 static size_t ares_slist_max_level(const ares_slist_t *list)
 {
   size_t max_level = 0;
@@ -192,36 +202,41 @@ static void ares_slist_node_push(ares_slist_t *list, ares_slist_node_t *node)
   }
 }
 
+/* A node and its arrays of next and prev pointers are a single allocation.
+ * Short nodes are padded to the starting number of levels so the common
+ * sizes are few and can be pooled. */
+static size_t ares_slist_node_size(size_t levels)
+{
+  if (levels < ARES__SLIST_START_LEVELS) {
+    levels = ARES__SLIST_START_LEVELS;
+  }
+  return sizeof(ares_slist_node_t) + (sizeof(ares_slist_node_t *) * levels * 2);
+}
+
 ares_slist_node_t *ares_slist_insert(ares_slist_t *list, void *val)
 {
   ares_slist_node_t *node = NULL;
+  size_t             levels;
 
   if (list == NULL || val == NULL) {
     return NULL;
   }
 
-  node = ares_malloc_zero(sizeof(*node));
+  /* Randomly determine the number of levels we want to use */
+  levels = ares_slist_calc_level(list);
 
+  node = ares_pool_alloc(list->pool, ares_slist_node_size(levels));
   if (node == NULL) {
     goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
   }
 
   node->data   = val;
   node->parent = list;
+  node->levels = levels;
 
-  /* Randomly determine the number of levels we want to use */
-  node->levels = ares_slist_calc_level(list);
-
-  /* Allocate array of next and prev nodes for linking each level */
-  node->next = ares_malloc_zero(sizeof(*node->next) * node->levels);
-  if (node->next == NULL) {
-    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
-  }
-
-  node->prev = ares_malloc_zero(sizeof(*node->prev) * node->levels);
-  if (node->prev == NULL) {
-    goto fail; /* LCOV_EXCL_LINE: OutOfMemory */
-  }
+  /* Arrays of next and prev nodes for linking each level */
+  node->next = (ares_slist_node_t **)((void *)(node + 1));
+  node->prev = node->next + levels;
 
   /* If the number of levels is greater than we currently support in the slist,
    * increase the count */
@@ -245,11 +260,7 @@ ares_slist_node_t *ares_slist_insert(ares_slist_t *list, void *val)
 
 /* LCOV_EXCL_START: OutOfMemory */
 fail:
-  if (node) {
-    ares_free(node->prev);
-    ares_free(node->next);
-    ares_free(node);
-  }
+  ares_pool_free(list->pool, node, ares_slist_node_size(levels));
   return NULL;
   /* LCOV_EXCL_STOP */
 }
@@ -294,9 +305,7 @@ void *ares_slist_node_claim(ares_slist_node_t *node)
 
   ares_slist_node_pop(node);
 
-  ares_free(node->next);
-  ares_free(node->prev);
-  ares_free(node);
+  ares_pool_free(list->pool, node, ares_slist_node_size(node->levels));
 
   list->cnt--;
 
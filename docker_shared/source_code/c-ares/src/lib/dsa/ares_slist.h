@@ -92,6 +92,14 @@ ares_slist_t      *ares_slist_create(ares_rand_state        *rand_state,
 void               ares_slist_replace_destructor(ares_slist_t           *list,
                                                  ares_slist_destructor_t destruct);
 
+/*! Allocate SkipList Nodes from an object pool.  May only be changed while
+ *  the SkipList is empty.
+ *
+ *  \param[in] list  Initialized SkipList Object
+ *  \param[in] pool  Pool to use, must outlive the SkipList.  NULL to disable.
+ */
+void               ares_slist_set_pool(ares_slist_t *list, ares_pool_t *pool);
+
 /*! Insert Value into SkipList
  *
  *  \param[in] list   Initialized SkipList Object
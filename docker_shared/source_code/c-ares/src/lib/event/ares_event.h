@@ -67,6 +67,10 @@ struct ares_event {
   ares_event_signal_cb_t signal_cb;
 };
 
+/*! Timeout for ares_event_sys_t.wait() to only collect events that are
+ *  already pending rather than blocking, a timeout of 0 blocks indefinitely */
+#define ARES_EVENT_WAIT_POLL ((unsigned long)-1)
+
 typedef struct {
   const char *name;
   ares_bool_t (*init)(ares_event_thread_t *e);
@@ -102,6 +106,12 @@ struct ares_event_thread {
    *  thread other than the event thread itself. The event thread will then
    *  be woken then process these updates itself */
   ares_llist_t           *ev_updates;
+  /*! Index into ev_updates by socket so repeated updates to the same socket
+   *  are coalesced in constant time.  Removal updates are never indexed as
+   *  they must always be processed. */
+  ares_htable_asvp_t     *ev_updates_socks;
+  /*! Same as ev_updates_socks, for custom events keyed by their data */
+  ares_htable_vpvp_t     *ev_updates_cust;
   /*! Registered socket event handles */
   ares_htable_asvp_t     *ev_sock_handles;
   /*! Registered custom event handles. Typically used for external triggering.
@@ -114,6 +124,14 @@ struct ares_event_thread {
   ares_event_t           *ev_signal;
   /*! Handle for configuration change monitoring */
   ares_event_configchg_t *configchg;
+  /*! Whether query timeouts are tracked with ev_timer rather than the wait
+   *  timeout, see ares_set_event_thread_low_latency() */
+  ares_bool_t             low_latency;
+  /*! Microseconds to keep polling rather than sleeping after activity while
+   *  queries are outstanding, only in low latency mode */
+  unsigned int            busy_poll_us;
+  /*! High resolution timer, created on first use of low latency mode */
+  ares_event_t           *ev_timer;
   /* Event subsystem callbacks */
   const ares_event_sys_t *ev_sys;
   /* Event subsystem private data */
@@ -164,6 +182,14 @@ ares_status_t ares_event_update(ares_event_t **event, ares_event_thread_t *e,
 ares_event_t *ares_pipeevent_create(ares_event_thread_t *e);
 #  endif
 
+#  ifdef HAVE_TIMERFD
+ares_event_t *ares_timerevent_create(ares_event_thread_t *e);
+/*! Arm the timer to fire at deadline (based on ares_tvnow()), or disarm it if
+ *  deadline is NULL.  Re-arming for the same deadline is a no-op. */
+void          ares_timerevent_arm(ares_event_t         *event,
+                                  const ares_timeval_t *deadline);
+#  endif
+
 #  ifdef HAVE_POLL
 extern const ares_event_sys_t ares_evsys_poll;
 #  endif
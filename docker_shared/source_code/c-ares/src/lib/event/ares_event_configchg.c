@@ -46,9 +46,13 @@ void ares_event_configchg_destroy(ares_event_configchg_t *configchg)
 #elif defined(__linux__) && defined(CARES_THREADS)
 
 #  include <sys/inotify.h>
+#  include <sys/socket.h>
+#  include <linux/netlink.h>
+#  include <linux/rtnetlink.h>
 
 struct ares_event_configchg {
   int                  inotify_fd;
+  int                  netlink_fd;
   ares_event_thread_t *e;
 };
 
@@ -58,8 +62,12 @@ void ares_event_configchg_destroy(ares_event_configchg_t *configchg)
     return; /* LCOV_EXCL_LINE: DefensiveCoding */
   }
 
-  /* Tell event system to stop monitoring for changes.  This will cause the
-   * cleanup to be called */
+  /* Tell event system to stop monitoring for changes.  Removing the inotify
+   * handle will cause the cleanup to be called so must be last */
+  if (configchg->netlink_fd >= 0) {
+    ares_event_update(NULL, configchg->e, ARES_EVENT_FLAG_NONE, NULL,
+                      configchg->netlink_fd, NULL, NULL, NULL);
+  }
   ares_event_update(NULL, configchg->e, ARES_EVENT_FLAG_NONE, NULL,
                     configchg->inotify_fd, NULL, NULL, NULL);
 }
@@ -76,6 +84,11 @@ static void ares_event_configchg_free(void *data)
     configchg->inotify_fd = -1;
   }
 
+  if (configchg->netlink_fd >= 0) {
+    close(configchg->netlink_fd);
+    configchg->netlink_fd = -1;
+  }
+
   ares_free(configchg);
 }
 
@@ -130,6 +143,77 @@ static void ares_event_configchg_cb(ares_event_thread_t *e, ares_socket_t fd,
   }
 }
 
+/* Interface address, link and route changes don't affect the system
+ * configuration, but do invalidate any cached source addresses */
+static void ares_event_configchg_netlink_cb(ares_event_thread_t *e,
+                                            ares_socket_t fd, void *data,
+                                            ares_event_flags_t flags)
+{
+  const ares_event_configchg_t *configchg = data;
+  unsigned char                 buf[8192];
+  ares_bool_t                   triggered = ARES_FALSE;
+
+  (void)fd;
+  (void)flags;
+
+  /* We don't care what changed, just drain the socket.  It has to be drained
+   * until it would block, as with edge-triggered events it is not reported
+   * again otherwise. */
+  while (1) {
+    ssize_t len = recv(configchg->netlink_fd, buf, sizeof(buf), 0);
+
+    if (len > 0) {
+      triggered = ARES_TRUE;
+      continue;
+    }
+
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+
+    /* The receive buffer overflowed so events were lost, which can only mean
+     * something changed */
+    if (len < 0 && errno == ENOBUFS) {
+      triggered = ARES_TRUE;
+      continue;
+    }
+
+    /* EAGAIN/EWOULDBLOCK once drained */
+    break;
+  }
+
+  if (triggered) {
+    ares_channel_lock(e->channel);
+    ares_sortaddrinfo_cache_flush(e->channel);
+    ares_iface_cache_flush(e->channel);
+    ares_channel_unlock(e->channel);
+  }
+}
+
+static int ares_event_configchg_netlink_open(void)
+{
+  struct sockaddr_nl addr;
+  int                fd;
+
+  fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+              NETLINK_ROUTE);
+  if (fd == -1) {
+    return -1; /* LCOV_EXCL_LINE: UntestablePath */
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                   RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd); /* LCOV_EXCL_LINE: UntestablePath */
+    return -1; /* LCOV_EXCL_LINE: UntestablePath */
+  }
+
+  return fd;
+}
+
 ares_status_t ares_event_configchg_init(ares_event_configchg_t **configchg,
                                         ares_event_thread_t     *e)
 {
@@ -147,6 +231,7 @@ ares_status_t ares_event_configchg_init(ares_event_configchg_t **configchg,
   }
 
   c->e          = e;
+  c->netlink_fd = -1;
   c->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
   if (c->inotify_fd == -1) {
     status = ARES_ESERVFAIL; /* LCOV_EXCL_LINE: UntestablePath */
@@ -164,13 +249,28 @@ ares_status_t ares_event_configchg_init(ares_event_configchg_t **configchg,
   status =
     ares_event_update(NULL, e, ARES_EVENT_FLAG_READ, ares_event_configchg_cb,
                       c->inotify_fd, c, ares_event_configchg_free, NULL);
-
-done:
   if (status != ARES_SUCCESS) {
-    ares_event_configchg_free(c);
-  } else {
-    *configchg = c;
+    goto done; /* LCOV_EXCL_LINE: OutOfMemory */
   }
+
+  /* Monitoring interface changes is optional, netlink may be unavailable in
+   * restricted environments */
+  c->netlink_fd = ares_event_configchg_netlink_open();
+  if (c->netlink_fd >= 0 &&
+      ares_event_update(NULL, e, ARES_EVENT_FLAG_READ,
+                        ares_event_configchg_netlink_cb, c->netlink_fd, c,
+                        NULL, NULL) != ARES_SUCCESS) {
+    /* LCOV_EXCL_START: OutOfMemory */
+    close(c->netlink_fd);
+    c->netlink_fd = -1;
+    /* LCOV_EXCL_STOP */
+  }
+
+  *configchg = c;
+  return ARES_SUCCESS;
+
+done:
+  ares_event_configchg_free(c);
   return status;
 }
 
@@ -35,8 +35,17 @@
 #  include <fcntl.h>
 #endif
 
+/* Smallest and initial size of the event array handed to epoll_wait() */
+#define EPOLL_EVENTS_MIN 8
+
 typedef struct {
-  int epoll_fd;
+  int                 epoll_fd;
+  /*! Event array for epoll_wait(), sized to the number of registered events
+   *  so a single wakeup can deliver every ready socket */
+  struct epoll_event *events;
+  size_t              events_len;
+  /*! Number of events registered with epoll */
+  size_t              nfds;
 } ares_evsys_epoll_t;
 
 static void ares_evsys_epoll_destroy(ares_event_thread_t *e)
@@ -56,6 +65,7 @@ static void ares_evsys_epoll_destroy(ares_event_thread_t *e)
     close(ep->epoll_fd);
   }
 
+  ares_free(ep->events);
   ares_free(ep);
   e->ev_sys_data = NULL;
 }
@@ -77,6 +87,13 @@ static ares_bool_t ares_evsys_epoll_init(ares_event_thread_t *e)
     return ARES_FALSE;           /* LCOV_EXCL_LINE: UntestablePath */
   }
 
+  ep->events = ares_malloc_zero(sizeof(*ep->events) * EPOLL_EVENTS_MIN);
+  if (ep->events == NULL) {
+    ares_evsys_epoll_destroy(e); /* LCOV_EXCL_LINE: OutOfMemory */
+    return ARES_FALSE;           /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+  ep->events_len = EPOLL_EVENTS_MIN;
+
   e->ev_signal = ares_pipeevent_create(e);
   if (e->ev_signal == NULL) {
     ares_evsys_epoll_destroy(e); /* LCOV_EXCL_LINE: UntestablePath */
@@ -86,36 +103,55 @@ static ares_bool_t ares_evsys_epoll_init(ares_event_thread_t *e)
   return ARES_TRUE;
 }
 
+/* Edge triggering saves epoll from re-reporting a socket on every wait until
+ * it has been drained, and from rescanning its ready list.  That is only safe
+ * because every reader consumes until the socket would block (or returns
+ * less than asked for); c-ares can only do that with non-blocking sockets, so
+ * stay level triggered if the socket functions in use don't guarantee that */
+static void ares_evsys_epoll_fill(ares_event_t *event, ares_event_flags_t flags,
+                                  struct epoll_event *epev)
+{
+  const ares_channel_t *channel = event->e->channel;
+
+  memset(epev, 0, sizeof(*epev));
+  epev->data.ptr = event;
+  epev->events   = EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+  if (channel->sock_funcs.flags & ARES_SOCKFUNC_FLAG_NONBLOCKING) {
+    epev->events |= EPOLLET;
+  }
+  if (flags & ARES_EVENT_FLAG_READ) {
+    epev->events |= EPOLLIN;
+  }
+  if (flags & ARES_EVENT_FLAG_WRITE) {
+    epev->events |= EPOLLOUT;
+  }
+}
+
 static ares_bool_t ares_evsys_epoll_event_add(ares_event_t *event)
 {
   const ares_event_thread_t *e  = event->e;
-  const ares_evsys_epoll_t  *ep = e->ev_sys_data;
+  ares_evsys_epoll_t        *ep = e->ev_sys_data;
   struct epoll_event         epev;
 
-  memset(&epev, 0, sizeof(epev));
-  epev.data.fd = event->fd;
-  epev.events  = EPOLLRDHUP | EPOLLERR | EPOLLHUP;
-  if (event->flags & ARES_EVENT_FLAG_READ) {
-    epev.events |= EPOLLIN;
-  }
-  if (event->flags & ARES_EVENT_FLAG_WRITE) {
-    epev.events |= EPOLLOUT;
-  }
+  ares_evsys_epoll_fill(event, event->flags, &epev);
   if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_ADD, event->fd, &epev) != 0) {
     return ARES_FALSE; /* LCOV_EXCL_LINE: UntestablePath */
   }
+  ep->nfds++;
   return ARES_TRUE;
 }
 
 static void ares_evsys_epoll_event_del(ares_event_t *event)
 {
   const ares_event_thread_t *e  = event->e;
-  const ares_evsys_epoll_t  *ep = e->ev_sys_data;
+  ares_evsys_epoll_t        *ep = e->ev_sys_data;
   struct epoll_event         epev;
 
   memset(&epev, 0, sizeof(epev));
-  epev.data.fd = event->fd;
   epoll_ctl(ep->epoll_fd, EPOLL_CTL_DEL, event->fd, &epev);
+  if (ep->nfds > 0) {
+    ep->nfds--;
+  }
 }
 
 static void ares_evsys_epoll_event_mod(ares_event_t      *event,
@@ -125,32 +161,58 @@ static void ares_evsys_epoll_event_mod(ares_event_t      *event,
   const ares_evsys_epoll_t  *ep = e->ev_sys_data;
   struct epoll_event         epev;
 
-  memset(&epev, 0, sizeof(epev));
-  epev.data.fd = event->fd;
-  epev.events  = EPOLLRDHUP | EPOLLERR | EPOLLHUP;
-  if (new_flags & ARES_EVENT_FLAG_READ) {
-    epev.events |= EPOLLIN;
+  /* With edge triggering, a modification re-arms the event so it is reported
+   * if the socket is already ready for the newly requested operation */
+  ares_evsys_epoll_fill(event, new_flags, &epev);
+  epoll_ctl(ep->epoll_fd, EPOLL_CTL_MOD, event->fd, &epev);
+}
+
+/* Grow the event array to the number of registered events, or shrink it once
+ * it is mostly unused.  On allocation failure keep the current array, it just
+ * takes more waits to retrieve everything. */
+static void ares_evsys_epoll_resize(ares_evsys_epoll_t *ep)
+{
+  struct epoll_event *events;
+  size_t              len = ep->events_len;
+
+  while (len < ep->nfds) {
+    len <<= 1;
   }
-  if (new_flags & ARES_EVENT_FLAG_WRITE) {
-    epev.events |= EPOLLOUT;
+  while (len > EPOLL_EVENTS_MIN && ep->nfds < len / 4) {
+    len >>= 1;
   }
-  epoll_ctl(ep->epoll_fd, EPOLL_CTL_MOD, event->fd, &epev);
+
+  if (len == ep->events_len) {
+    return;
+  }
+
+  events = ares_realloc(ep->events, sizeof(*events) * len);
+  if (events == NULL) {
+    return; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+  ep->events     = events;
+  ep->events_len = len;
 }
 
 static size_t ares_evsys_epoll_wait(ares_event_thread_t *e,
                                     unsigned long        timeout_ms)
 {
-  struct epoll_event        events[8];
-  size_t                    nevents = sizeof(events) / sizeof(*events);
-  const ares_evsys_epoll_t *ep      = e->ev_sys_data;
-  int                       rv;
-  size_t                    i;
-  size_t                    cnt = 0;
+  ares_evsys_epoll_t *ep = e->ev_sys_data;
+  int                 rv;
+  int                 tout = (int)timeout_ms;
+  size_t              nevents;
+  size_t              i;
+  size_t              cnt = 0;
+
+  if (timeout_ms == 0) {
+    tout = -1;
+  } else if (timeout_ms == ARES_EVENT_WAIT_POLL) {
+    tout = 0;
+  }
 
-  memset(events, 0, sizeof(events));
+  ares_evsys_epoll_resize(ep);
 
-  rv = epoll_wait(ep->epoll_fd, events, (int)nevents,
-                  (timeout_ms == 0) ? -1 : (int)timeout_ms);
+  rv = epoll_wait(ep->epoll_fd, ep->events, (int)ep->events_len, tout);
   if (rv < 0) {
     return 0; /* LCOV_EXCL_LINE: UntestablePath */
   }
@@ -158,21 +220,22 @@ static size_t ares_evsys_epoll_wait(ares_event_thread_t *e,
   nevents = (size_t)rv;
 
   for (i = 0; i < nevents; i++) {
-    ares_event_t      *ev;
+    /* Events are only ever freed by the event thread itself while processing
+     * updates, never from within a callback, so the pointer is valid for the
+     * duration of this loop */
+    ares_event_t      *ev    = ep->events[i].data.ptr;
     ares_event_flags_t flags = 0;
 
-    ev = ares_htable_asvp_get_direct(e->ev_sock_handles,
-                                     (ares_socket_t)events[i].data.fd);
     if (ev == NULL || ev->cb == NULL) {
       continue; /* LCOV_EXCL_LINE: DefensiveCoding */
     }
 
     cnt++;
 
-    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    if (ep->events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
       flags |= ARES_EVENT_FLAG_READ;
     }
-    if (events[i].events & EPOLLOUT) {
+    if (ep->events[i].events & EPOLLOUT) {
       flags |= ARES_EVENT_FLAG_WRITE;
     }
 
@@ -195,7 +195,11 @@ static size_t ares_evsys_kqueue_wait(ares_event_thread_t *e,
   struct timespec     *timeout = NULL;
   size_t               cnt     = 0;
 
-  if (timeout_ms != 0) {
+  if (timeout_ms == ARES_EVENT_WAIT_POLL) {
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 0;
+    timeout    = &ts;
+  } else if (timeout_ms != 0) {
     ts.tv_sec  = (time_t)timeout_ms / 1000;
     ts.tv_nsec = (timeout_ms % 1000) * 1000 * 1000;
     timeout    = &ts;
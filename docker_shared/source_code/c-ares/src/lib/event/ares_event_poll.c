@@ -71,9 +71,16 @@ static size_t ares_evsys_poll_wait(ares_event_thread_t *e,
   ares_socket_t *fdlist  = ares_htable_asvp_keys(e->ev_sock_handles, &num_fds);
   struct pollfd *pollfd  = NULL;
   int            rv;
-  size_t         cnt = 0;
+  int            tout = (int)timeout_ms;
+  size_t         cnt  = 0;
   size_t         i;
 
+  if (timeout_ms == 0) {
+    tout = -1;
+  } else if (timeout_ms == ARES_EVENT_WAIT_POLL) {
+    tout = 0;
+  }
+
   if (fdlist != NULL && num_fds) {
     pollfd = ares_malloc_zero(sizeof(*pollfd) * num_fds);
     if (pollfd == NULL) {
@@ -93,7 +100,7 @@ static size_t ares_evsys_poll_wait(ares_event_thread_t *e,
   }
   ares_free(fdlist);
 
-  rv = poll(pollfd, (nfds_t)num_fds, (timeout_ms == 0) ? -1 : (int)timeout_ms);
+  rv = poll(pollfd, (nfds_t)num_fds, tout);
   if (rv <= 0) {
     goto done;
   }
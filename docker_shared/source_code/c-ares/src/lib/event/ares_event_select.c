@@ -106,7 +106,11 @@ static size_t ares_evsys_select_wait(ares_event_thread_t *e,
     }
   }
 
-  if (timeout_ms) {
+  if (timeout_ms == ARES_EVENT_WAIT_POLL) {
+    tv.tv_sec  = 0;
+    tv.tv_usec = 0;
+    tout       = &tv;
+  } else if (timeout_ms) {
     tv.tv_sec  = (int)(timeout_ms / 1000);
     tv.tv_usec = (int)((timeout_ms % 1000) * 1000);
     tout       = &tv;
@@ -66,35 +66,44 @@ static void ares_event_thread_wake(const ares_event_thread_t *e)
 }
 
 /* See if a pending update already exists. We don't want to enqueue multiple
- * updates for the same event handle. Right now this is O(n) based on number
- * of updates already enqueued.  In the future, it might make sense to make
- * this O(1) with a hashtable.
+ * updates for the same event handle.
  * NOTE: in some cases a delete then re-add of the same fd, but really pointing
  *       to a different destination can happen due to a quick close of a
- *       connection then creation of a new one.  So we need to look at the
- *       flags and ignore any delete events when finding a match since we
- *       need to process the delete always, it can't be combined with other
- *       updates. */
-static ares_event_t *ares_event_update_find(ares_event_thread_t *e,
+ *       connection then creation of a new one.  So delete events are never
+ *       indexed and can't be matched, since we need to process the delete
+ *       always, it can't be combined with other updates. */
+static ares_event_t *ares_event_update_find(const ares_event_thread_t *e,
                                             ares_socket_t fd, const void *data)
 {
-  ares_llist_node_t *node;
-
-  for (node = ares_llist_node_first(e->ev_updates); node != NULL;
-       node = ares_llist_node_next(node)) {
-    ares_event_t *ev = ares_llist_node_val(node);
+  if (fd != ARES_SOCKET_BAD) {
+    return ares_htable_asvp_get_direct(e->ev_updates_socks, fd);
+  }
+  return ares_htable_vpvp_get_direct(e->ev_updates_cust, data);
+}
 
-    if (fd != ARES_SOCKET_BAD && fd == ev->fd && ev->flags != 0) {
-      return ev;
-    }
+static ares_bool_t ares_event_update_index(ares_event_thread_t *e,
+                                           ares_event_t        *ev)
+{
+  if (ev->fd != ARES_SOCKET_BAD) {
+    return ares_htable_asvp_insert(e->ev_updates_socks, ev->fd, ev);
+  }
+  return ares_htable_vpvp_insert(e->ev_updates_cust, ev->data, ev);
+}
 
-    if (fd == ARES_SOCKET_BAD && ev->fd == ARES_SOCKET_BAD &&
-        data == ev->data && ev->flags != 0) {
-      return ev;
-    }
+static void ares_event_update_unindex(ares_event_thread_t *e,
+                                      const ares_event_t  *ev)
+{
+  /* A newer update for the same handle may be indexed if this one is a
+   * removal */
+  if (ares_event_update_find(e, ev->fd, ev->data) != ev) {
+    return;
   }
 
-  return NULL;
+  if (ev->fd != ARES_SOCKET_BAD) {
+    ares_htable_asvp_remove(e->ev_updates_socks, ev->fd);
+  } else {
+    ares_htable_vpvp_remove(e->ev_updates_cust, ev->data);
+  }
 }
 
 ares_status_t ares_event_update(ares_event_t **event, ares_event_thread_t *e,
@@ -140,6 +149,8 @@ ares_status_t ares_event_update(ares_event_t **event, ares_event_thread_t *e,
   /* See if we have a queued update already */
   ev = ares_event_update_find(e, fd, data);
   if (ev == NULL) {
+    ares_llist_node_t *node;
+
     /* Allocate a new one */
     ev = ares_malloc_zero(sizeof(*ev));
     if (ev == NULL) {
@@ -147,11 +158,27 @@ ares_status_t ares_event_update(ares_event_t **event, ares_event_thread_t *e,
       goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
     }
 
-    if (ares_llist_insert_last(e->ev_updates, ev) == NULL) {
+    ev->fd   = fd;
+    ev->data = data;
+
+    node = ares_llist_insert_last(e->ev_updates, ev);
+    if (node == NULL) {
       ares_free(ev);        /* LCOV_EXCL_LINE: OutOfMemory */
       status = ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
       goto done;            /* LCOV_EXCL_LINE: OutOfMemory */
     }
+
+    if (flags != ARES_EVENT_FLAG_NONE && !ares_event_update_index(e, ev)) {
+      /* LCOV_EXCL_START: OutOfMemory */
+      ares_llist_node_destroy(node);
+      ares_free(ev);
+      status = ARES_ENOMEM;
+      goto done;
+      /* LCOV_EXCL_STOP */
+    }
+  } else if (flags == ARES_EVENT_FLAG_NONE) {
+    /* Now a removal, which can't be combined with later updates */
+    ares_event_update_unindex(e, ev);
   }
 
   ev->flags = flags;
@@ -251,6 +278,8 @@ static void ares_event_process_updates(ares_event_thread_t *e)
     ares_event_t *newev = ares_llist_node_claim(node);
     ares_event_t *oldev;
 
+    ares_event_update_unindex(e, newev);
+
     if (newev->fd == ARES_SOCKET_BAD) {
       oldev = ares_htable_vpvp_get_direct(e->ev_cust_handles, newev->data);
     } else {
@@ -310,6 +339,11 @@ static void ares_event_thread_cleanup(ares_event_thread_t *e)
     e->ev_updates = NULL;
   }
 
+  ares_htable_asvp_destroy(e->ev_updates_socks);
+  e->ev_updates_socks = NULL;
+  ares_htable_vpvp_destroy(e->ev_updates_cust);
+  e->ev_updates_cust = NULL;
+
   if (e->ev_sock_handles != NULL) {
     ares_htable_asvp_destroy(e->ev_sock_handles);
     e->ev_sock_handles = NULL;
@@ -326,9 +360,46 @@ static void ares_event_thread_cleanup(ares_event_thread_t *e)
   }
 }
 
+#ifdef HAVE_TIMERFD
+/* Low latency mode: the timer tracks the head of queries_by_timeout so the
+ * wait itself never needs a timeout.  While queries are outstanding and there
+ * was recent activity, just poll so an imminent answer is picked up without
+ * the cost of going to sleep and being woken again. */
+static unsigned long ares_event_thread_low_latency(ares_event_thread_t  *e,
+                                                   ares_event_t         *timer,
+                                                   unsigned int          busy_us,
+                                                   const ares_timeval_t *busy_end)
+{
+  ares_timeval_t deadline;
+  ares_timeval_t now;
+
+  if (!ares_timeout_next(e->channel, &deadline)) {
+    ares_timerevent_arm(timer, NULL);
+    return 0;
+  }
+
+  ares_timerevent_arm(timer, &deadline);
+
+  if (busy_us == 0) {
+    return 0;
+  }
+
+  ares_tvnow(&now);
+  if (now.sec < busy_end->sec ||
+      (now.sec == busy_end->sec && now.usec < busy_end->usec)) {
+    return ARES_EVENT_WAIT_POLL;
+  }
+  return 0;
+}
+#endif
+
 static void *ares_event_thread(void *arg)
 {
   ares_event_thread_t *e = arg;
+  ares_timeval_t       busy_end;
+
+  memset(&busy_end, 0, sizeof(busy_end));
+
   ares_thread_mutex_lock(e->mutex);
 
   while (e->isup) {
@@ -336,6 +407,10 @@ static void *ares_event_thread(void *arg)
     const struct timeval *tvout;
     unsigned long         timeout_ms = 0; /* 0 = unlimited */
     ares_bool_t           process_pending_write;
+    ares_bool_t           isup;
+    ares_bool_t           low_latency  = e->low_latency;
+    unsigned int          busy_poll_us = e->busy_poll_us;
+    ares_event_t         *timer        = e->ev_timer;
 
     ares_event_process_updates(e);
 
@@ -344,33 +419,55 @@ static void *ares_event_thread(void *arg)
      * triggered cross-thread */
     ares_thread_mutex_unlock(e->mutex);
 
-    tvout = ares_timeout(e->channel, NULL, &tv);
-    if (tvout != NULL) {
+#ifdef HAVE_TIMERFD
+    /* Left over from low latency mode */
+    if (!low_latency && timer != NULL) {
+      ares_timerevent_arm(timer, NULL);
+    }
+
+    if (low_latency && timer != NULL) {
       timeout_ms =
-        (unsigned long)((tvout->tv_sec * 1000) + (tvout->tv_usec / 1000) + 1);
+        ares_event_thread_low_latency(e, timer, busy_poll_us, &busy_end);
+    } else
+#endif
+    {
+      tvout = ares_timeout(e->channel, NULL, &tv);
+      if (tvout != NULL) {
+        timeout_ms = (unsigned long)((tvout->tv_sec * 1000) +
+                                     (tvout->tv_usec / 1000) + 1);
+      }
     }
 
-    e->ev_sys->wait(e, timeout_ms);
+    if (e->ev_sys->wait(e, timeout_ms) > 0 && low_latency && busy_poll_us) {
+      /* Something happened, more is likely to follow shortly */
+      ares_tvnow(&busy_end);
+      busy_end.sec  += busy_poll_us / 1000000;
+      busy_end.usec += busy_poll_us % 1000000;
+      if (busy_end.usec >= 1000000) {
+        busy_end.sec  += 1;
+        busy_end.usec -= 1000000;
+      }
+    }
 
-    /* Process pending write operation */
+    /* Fetch pending write operation and shutdown state together */
     ares_thread_mutex_lock(e->mutex);
     process_pending_write    = e->process_pending_write;
     e->process_pending_write = ARES_FALSE;
+    isup                     = e->isup;
     ares_thread_mutex_unlock(e->mutex);
+
     if (process_pending_write) {
       ares_process_pending_write(e->channel);
     }
 
-    /* Relock before we loop again */
-    ares_thread_mutex_lock(e->mutex);
-
     /* Each iteration should do timeout processing and any other cleanup
      * that may not have been performed */
-    if (e->isup) {
-      ares_thread_mutex_unlock(e->mutex);
+    if (isup) {
       ares_process_fds(e->channel, NULL, 0, ARES_PROCESS_FLAG_NONE);
-      ares_thread_mutex_lock(e->mutex);
     }
+
+    /* Relock before we loop again */
+    ares_thread_mutex_lock(e->mutex);
   }
 
   /* Lets cleanup while we're in the thread itself */
@@ -504,6 +601,18 @@ ares_status_t ares_event_thread_init(ares_channel_t *channel)
     return ARES_ENOMEM;               /* LCOV_EXCL_LINE: OutOfMemory */
   }
 
+  e->ev_updates_socks = ares_htable_asvp_create(NULL);
+  if (e->ev_updates_socks == NULL) {
+    ares_event_thread_destroy_int(e); /* LCOV_EXCL_LINE: OutOfMemory */
+    return ARES_ENOMEM;               /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  e->ev_updates_cust = ares_htable_vpvp_create(NULL, NULL);
+  if (e->ev_updates_cust == NULL) {
+    ares_event_thread_destroy_int(e); /* LCOV_EXCL_LINE: OutOfMemory */
+    return ARES_ENOMEM;               /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
   e->ev_sock_handles = ares_htable_asvp_create(ares_event_destroy_cb);
   if (e->ev_sock_handles == NULL) {
     ares_event_thread_destroy_int(e); /* LCOV_EXCL_LINE: OutOfMemory */
@@ -559,6 +668,51 @@ ares_status_t ares_event_thread_init(ares_channel_t *channel)
   return ARES_SUCCESS;
 }
 
+ares_status_t ares_set_event_thread_low_latency(ares_channel_t *channel,
+                                                ares_bool_t     enable,
+                                                unsigned int    busy_poll_us)
+{
+#  ifdef HAVE_TIMERFD
+  ares_event_thread_t *e;
+  ares_status_t        status = ARES_SUCCESS;
+
+  if (channel == NULL || (enable && busy_poll_us > 1000000)) {
+    return ARES_EFORMERR;
+  }
+
+  if (!(channel->optmask & ARES_OPT_EVENT_THREAD)) {
+    return ARES_ENOTIMP;
+  }
+
+  e = channel->sock_state_cb_data;
+
+  ares_thread_mutex_lock(e->mutex);
+
+  if (enable && e->ev_timer == NULL) {
+    e->ev_timer = ares_timerevent_create(e);
+    if (e->ev_timer == NULL) {
+      status = ARES_ENOTIMP; /* LCOV_EXCL_LINE: UntestablePath */
+      goto done;             /* LCOV_EXCL_LINE: UntestablePath */
+    }
+  }
+
+  e->low_latency  = enable;
+  e->busy_poll_us = enable ? busy_poll_us : 0;
+
+  /* The thread may be sleeping on a timeout computed for the other mode */
+  ares_event_thread_wake(e);
+
+done:
+  ares_thread_mutex_unlock(e->mutex);
+  return status;
+#  else
+  (void)channel;
+  (void)enable;
+  (void)busy_poll_us;
+  return ARES_ENOTIMP;
+#  endif
+}
+
 #else
 
 ares_status_t ares_event_thread_init(ares_channel_t *channel)
@@ -572,4 +726,14 @@ void ares_event_thread_destroy(ares_channel_t *channel)
   (void)channel;
 }
 
+ares_status_t ares_set_event_thread_low_latency(ares_channel_t *channel,
+                                                ares_bool_t     enable,
+                                                unsigned int    busy_poll_us)
+{
+  (void)channel;
+  (void)enable;
+  (void)busy_poll_us;
+  return ARES_ENOTIMP;
+}
+
 #endif
@@ -0,0 +1,151 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "ares_private.h"
+#include "ares_event.h"
+
+#if defined(HAVE_TIMERFD) && defined(CARES_THREADS)
+
+#  ifdef HAVE_UNISTD_H
+#    include <unistd.h>
+#  endif
+#  ifdef HAVE_SYS_TIMERFD_H
+#    include <sys/timerfd.h>
+#  endif
+
+/* A timerfd lets the event thread sleep until a query deadline with
+ * nanosecond resolution, the wait timeout of the event systems only has
+ * millisecond resolution. */
+typedef struct {
+  int            fd;
+  /*! Deadline currently armed, only valid if armed is set */
+  ares_timeval_t deadline;
+  ares_bool_t    armed;
+} ares_timerevent_t;
+
+static void ares_timerevent_destroy(ares_timerevent_t *t)
+{
+  if (t->fd != -1) {
+    close(t->fd);
+  }
+
+  ares_free(t);
+}
+
+static void ares_timerevent_destroy_cb(void *arg)
+{
+  ares_timerevent_destroy(arg);
+}
+
+static void ares_timerevent_cb(ares_event_thread_t *e, ares_socket_t fd,
+                               void *data, ares_event_flags_t flags)
+{
+  ares_timerevent_t *t = data;
+  ares_uint64_t      expirations;
+
+  (void)e;
+  (void)fd;
+  (void)flags;
+
+  if (t == NULL) {
+    return; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  /* Clear readiness, the event thread processes timeouts on every wakeup */
+  (void)read(t->fd, &expirations, sizeof(expirations));
+  t->armed = ARES_FALSE;
+}
+
+ares_event_t *ares_timerevent_create(ares_event_thread_t *e)
+{
+  ares_event_t      *event = NULL;
+  ares_timerevent_t *t;
+  ares_status_t      status;
+
+  t = ares_malloc_zero(sizeof(*t));
+  if (t == NULL) {
+    return NULL; /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (t->fd == -1) {
+    ares_timerevent_destroy(t); /* LCOV_EXCL_LINE: UntestablePath */
+    return NULL;                /* LCOV_EXCL_LINE: UntestablePath */
+  }
+
+  status = ares_event_update(&event, e, ARES_EVENT_FLAG_READ,
+                             ares_timerevent_cb, t->fd, t,
+                             ares_timerevent_destroy_cb, NULL);
+  if (status != ARES_SUCCESS) {
+    ares_timerevent_destroy(t); /* LCOV_EXCL_LINE: OutOfMemory */
+    return NULL;                /* LCOV_EXCL_LINE: OutOfMemory */
+  }
+
+  return event;
+}
+
+void ares_timerevent_arm(ares_event_t *event, const ares_timeval_t *deadline)
+{
+  ares_timerevent_t *t = event->data;
+  struct itimerspec  its;
+
+  if (deadline == NULL) {
+    if (!t->armed) {
+      return;
+    }
+    t->armed = ARES_FALSE;
+  } else {
+    ares_timeval_t now;
+    ares_timeval_t remaining;
+
+    if (t->armed && t->deadline.sec == deadline->sec &&
+        t->deadline.usec == deadline->usec) {
+      return;
+    }
+
+    t->armed    = ARES_TRUE;
+    t->deadline = *deadline;
+
+    /* Arm relative to ares_tvnow() so we don't depend on it using the same
+     * clock as the timer */
+    ares_tvnow(&now);
+    ares_timeval_remaining(&remaining, &now, deadline);
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = (time_t)remaining.sec;
+    its.it_value.tv_nsec = (long)remaining.usec * 1000;
+
+    /* All zeros would disarm, an expired deadline should fire right away */
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+      its.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(t->fd, 0, &its, NULL);
+    return;
+  }
+
+  memset(&its, 0, sizeof(its));
+  timerfd_settime(t->fd, 0, &its, NULL);
+}
+
+#endif
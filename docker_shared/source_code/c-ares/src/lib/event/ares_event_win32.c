@@ -966,6 +966,10 @@ static size_t ares_evsys_win32_wait(ares_event_thread_t *e,
   size_t              cnt  = 0;
   DWORD               tout = (timeout_ms == 0) ? INFINITE : (DWORD)timeout_ms;
 
+  if (timeout_ms == ARES_EVENT_WAIT_POLL) {
+    tout = 0;
+  }
+
   CARES_DEBUG_LOG("** Wait Enter\n");
   /* Process in a loop for as long as it fills the entire entries buffer, and
    * on subsequent attempts, ensure the timeout is 0 */
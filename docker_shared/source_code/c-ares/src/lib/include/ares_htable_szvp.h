@@ -66,6 +66,15 @@ CARES_EXTERN void ares_htable_szvp_destroy(ares_htable_szvp_t *htable);
 CARES_EXTERN ares_htable_szvp_t *
   ares_htable_szvp_create(ares_htable_szvp_val_free_t val_free);
 
+/*! Allocate hash table entries from an object pool
+ *
+ *  \param[in] htable  Initialized hash table
+ *  \param[in] pool    Pool to use, must outlive the hash table.  NULL to
+ *                     disable.
+ */
+CARES_EXTERN void ares_htable_szvp_set_pool(ares_htable_szvp_t *htable,
+                                            ares_pool_t        *pool);
+
 /*! Insert key/value into hash table
  *
  *  \param[in] htable Initialized hash table
@@ -71,6 +71,14 @@ CARES_EXTERN void
   ares_llist_replace_destructor(ares_llist_t           *list,
                                 ares_llist_destructor_t destruct);
 
+/*! Allocate the nodes of the linked list from an object pool.  Nodes may be
+ *  moved between lists using different pools, or none.
+ *
+ *  \param[in] list  Initialized linked list object
+ *  \param[in] pool  Pool to use, must outlive the list.  NULL to disable.
+ */
+CARES_EXTERN void ares_llist_set_pool(ares_llist_t *list, ares_pool_t *pool);
+
 /*! Insert value as the first node in the linked list
  *
  *  \param[in] list   Initialized linked list object
@@ -35,4 +35,58 @@ CARES_EXTERN void *ares_malloc_zero(size_t size);
 CARES_EXTERN void *ares_realloc_zero(void *ptr, size_t orig_size,
                                      size_t new_size);
 
+/*! Free-list pool of fixed size objects.
+ *
+ *  Objects that are allocated and freed at a high rate, such as queries and
+ *  the list nodes that track them, can be returned to a pool instead of to the
+ *  allocator and handed out again on the next allocation of the same size.
+ *  A pool holds a handful of distinct sizes, anything else passes straight
+ *  through to ares_malloc()/ares_free().
+ *
+ *  A pool is not thread-safe, it must be protected by the same lock as the
+ *  objects allocated from it.  Every object is individually allocated with
+ *  ares_malloc(), so an object from a pool may still be released with
+ *  ares_free() or to a different pool.
+ */
+struct ares_pool;
+typedef struct ares_pool ares_pool_t;
+
+/*! Create an object pool
+ *
+ *  \param[in] max_free  Maximum number of free objects to retain per size
+ *  \return pool or NULL on out of memory
+ */
+CARES_EXTERN ares_pool_t *ares_pool_create(size_t max_free);
+
+/*! Destroy an object pool, freeing all retained objects.  Objects currently
+ *  allocated from the pool are not affected.
+ *
+ *  \param[in] pool  Pool to destroy
+ */
+CARES_EXTERN void ares_pool_destroy(ares_pool_t *pool);
+
+/*! Allocate a zeroed object from a pool.
+ *
+ *  \param[in] pool  Pool to allocate from.  If NULL, uses ares_malloc_zero().
+ *  \param[in] size  Size of the object
+ *  \return object or NULL on out of memory
+ */
+CARES_EXTERN void *ares_pool_alloc(ares_pool_t *pool, size_t size);
+
+/*! Release an object to a pool.
+ *
+ *  \param[in] pool  Pool to release to.  If NULL, uses ares_free().
+ *  \param[in] ptr   Object to release, may be NULL
+ *  \param[in] size  Size the object was allocated with
+ */
+CARES_EXTERN void ares_pool_free(ares_pool_t *pool, void *ptr, size_t size);
+
+/*! Number of allocations from the pool that could not be satisfied from a
+ *  free object and had to call ares_malloc().
+ *
+ *  \param[in] pool  Pool to query
+ *  \return number of allocations
+ */
+CARES_EXTERN size_t ares_pool_mallocs(const ares_pool_t *pool);
+
 #endif
@@ -49,59 +49,6 @@ int ares_parse_a_reply(const unsigned char *abuf, int alen,
                        struct hostent **host, struct ares_addrttl *addrttls,
                        int *naddrttls)
 {
-  struct ares_addrinfo ai;
-  char                *question_hostname = NULL;
-  ares_status_t        status;
-  size_t               req_naddrttls = 0;
-  ares_dns_record_t   *dnsrec        = NULL;
-
-  if (alen < 0) {
-    return ARES_EBADRESP;
-  }
-
-  if (naddrttls) {
-    req_naddrttls = (size_t)*naddrttls;
-    *naddrttls    = 0;
-  }
-
-  memset(&ai, 0, sizeof(ai));
-
-  status = ares_dns_parse(abuf, (size_t)alen, 0, &dnsrec);
-  if (status != ARES_SUCCESS) {
-    goto fail;
-  }
-
-  status = ares_parse_into_addrinfo(dnsrec, 0, 0, &ai);
-  if (status != ARES_SUCCESS && status != ARES_ENODATA) {
-    goto fail;
-  }
-
-  if (host != NULL) {
-    *host  = NULL;
-    status = ares_addrinfo2hostent(&ai, AF_INET, host);
-    if (status != ARES_SUCCESS && status != ARES_ENODATA) {
-      goto fail; /* LCOV_EXCL_LINE: DefensiveCoding */
-    }
-  }
-
-  if (addrttls != NULL && req_naddrttls) {
-    size_t temp_naddrttls = 0;
-    ares_addrinfo2addrttl(&ai, AF_INET, req_naddrttls, addrttls, NULL,
-                          &temp_naddrttls);
-    *naddrttls = (int)temp_naddrttls;
-  }
-
-
-fail:
-  ares_freeaddrinfo_cnames(ai.cnames);
-  ares_freeaddrinfo_nodes(ai.nodes);
-  ares_free(ai.name);
-  ares_free(question_hostname);
-  ares_dns_record_destroy(dnsrec);
-
-  if (status == ARES_EBADNAME) {
-    status = ARES_EBADRESP;
-  }
-
-  return (int)status;
+  return (int)ares_parse_addr_reply(abuf, alen, AF_INET, host, addrttls, NULL,
+                                    naddrttls);
 }
@@ -0,0 +1,280 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Shared implementation of ares_parse_a_reply() and ares_parse_aaaa_reply().
+ *
+ * These used to convert the parsed response to an ares_addrinfo with
+ * ares_parse_into_addrinfo() and then convert that again with
+ * ares_addrinfo2hostent() and ares_addrinfo2addrttl(), which costs an
+ * allocation per address and two per CNAME before the hostent is even
+ * started.  Instead the answer section is walked twice: once to size
+ * everything and once to fill in the hostent and addrttls directly.  The
+ * results must be identical to the old conversion, which the fuzzer checks.
+ */
+
+#include "ares_private.h"
+
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif
+#ifdef HAVE_NETDB_H
+#  include <netdb.h>
+#endif
+
+#ifdef HAVE_LIMITS_H
+#  include <limits.h>
+#endif
+
+static const void *addr_rr_data(const ares_dns_rr_t *rr, int family)
+{
+  ares_dns_rec_type_t rtype = ares_dns_rr_get_type(rr);
+
+  if (family == AF_INET && rtype == ARES_REC_TYPE_A) {
+    return ares_dns_rr_get_addr(rr, ARES_RR_A_ADDR);
+  }
+  if (family == AF_INET6 && rtype == ARES_REC_TYPE_AAAA) {
+    return ares_dns_rr_get_addr6(rr, ARES_RR_AAAA_ADDR);
+  }
+  return NULL;
+}
+
+static ares_status_t addr_reply_fill(const ares_dns_record_t *dnsrec,
+                                     int family, struct hostent *host,
+                                     int cname_ttl, size_t req_naddrttls,
+                                     struct ares_addrttl  *addrttls,
+                                     struct ares_addr6ttl *addr6ttls,
+                                     size_t               *naddrttls)
+{
+  size_t ancount  = ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER);
+  size_t naliases = 0;
+  size_t naddrs   = 0;
+  size_t i;
+
+  for (i = 0; i < ancount; i++) {
+    const ares_dns_rr_t *rr =
+      ares_dns_record_rr_get_const(dnsrec, ARES_SECTION_ANSWER, i);
+    const void *addr;
+    int         ttl;
+
+    if (ares_dns_rr_get_class(rr) != ARES_CLASS_IN) {
+      continue;
+    }
+
+    if (ares_dns_rr_get_type(rr) == ARES_REC_TYPE_CNAME) {
+      if (host != NULL) {
+        host->h_aliases[naliases] = ares_strdup(ares_dns_rr_get_name(rr));
+        if (host->h_aliases[naliases] == NULL) {
+          return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+        }
+        naliases++;
+      }
+      continue;
+    }
+
+    addr = addr_rr_data(rr, family);
+    if (addr == NULL) {
+      continue;
+    }
+
+    if (host != NULL) {
+      host->h_addr_list[naddrs] = ares_malloc((size_t)host->h_length);
+      if (host->h_addr_list[naddrs] == NULL) {
+        return ARES_ENOMEM; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+      memcpy(host->h_addr_list[naddrs], addr, (size_t)host->h_length);
+      naddrs++;
+    }
+
+    if (*naddrttls >= req_naddrttls) {
+      continue;
+    }
+
+    /* An address can't outlive the CNAMEs that led to it */
+    ttl = (int)ares_dns_rr_get_ttl(rr);
+    if (ttl > cname_ttl) {
+      ttl = cname_ttl;
+    }
+
+    if (family == AF_INET6) {
+      addr6ttls[*naddrttls].ttl = ttl;
+      memcpy(&addr6ttls[*naddrttls].ip6addr, addr,
+             sizeof(struct ares_in6_addr));
+    } else {
+      addrttls[*naddrttls].ttl = ttl;
+      memcpy(&addrttls[*naddrttls].ipaddr, addr, sizeof(struct in_addr));
+    }
+    (*naddrttls)++;
+  }
+
+  return ARES_SUCCESS;
+}
+
+ares_status_t ares_parse_addr_reply(const unsigned char *abuf, int alen,
+                                    int family, struct hostent **host,
+                                    struct ares_addrttl  *addrttls,
+                                    struct ares_addr6ttl *addr6ttls,
+                                    int                  *naddrttls)
+{
+  ares_dns_record_t *dnsrec         = NULL;
+  struct hostent    *hostent        = NULL;
+  const char        *hostname       = NULL;
+  const char        *h_name         = NULL;
+  size_t             req_naddrttls  = 0;
+  size_t             temp_naddrttls = 0;
+  size_t             naliases       = 0;
+  size_t             naddrs         = 0;
+  size_t             nother         = 0;
+  int                cname_ttl      = INT_MAX;
+  size_t             ancount;
+  size_t             i;
+  ares_status_t      status;
+
+  if (alen < 0) {
+    return ARES_EBADRESP;
+  }
+
+  if (naddrttls) {
+    req_naddrttls = (size_t)*naddrttls;
+    *naddrttls    = 0;
+  }
+
+  if ((family == AF_INET && addrttls == NULL) ||
+      (family == AF_INET6 && addr6ttls == NULL)) {
+    req_naddrttls = 0;
+  }
+
+  status = ares_dns_parse(abuf, (size_t)alen, 0, &dnsrec);
+  if (status != ARES_SUCCESS) {
+    goto done;
+  }
+
+  status = ares_dns_record_query_get(dnsrec, 0, &hostname, NULL, NULL);
+  if (status != ARES_SUCCESS) {
+    goto done; /* LCOV_EXCL_LINE: DefensiveCoding */
+  }
+
+  /* Size everything up.  The hostent is named after the target of the first
+   * CNAME in the chain, or the question if there isn't one. */
+  ancount = ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER);
+  for (i = 0; i < ancount; i++) {
+    const ares_dns_rr_t *rr =
+      ares_dns_record_rr_get_const(dnsrec, ARES_SECTION_ANSWER, i);
+    ares_dns_rec_type_t rtype;
+
+    if (ares_dns_rr_get_class(rr) != ARES_CLASS_IN) {
+      continue;
+    }
+
+    rtype = ares_dns_rr_get_type(rr);
+    if (rtype == ARES_REC_TYPE_CNAME) {
+      if (h_name == NULL) {
+        h_name = ares_dns_rr_get_str(rr, ARES_RR_CNAME_CNAME);
+      }
+      if ((int)ares_dns_rr_get_ttl(rr) < cname_ttl) {
+        cname_ttl = (int)ares_dns_rr_get_ttl(rr);
+      }
+      naliases++;
+    } else if (addr_rr_data(rr, family) != NULL) {
+      naddrs++;
+    } else if (rtype == ARES_REC_TYPE_A || rtype == ARES_REC_TYPE_AAAA) {
+      nother++;
+    }
+  }
+
+  if (h_name == NULL) {
+    h_name = hostname;
+  }
+
+  /* Nothing usable in the answer at all */
+  if (naliases == 0 && naddrs == 0 && nother == 0) {
+    status = ARES_ENODATA;
+    if (host != NULL) {
+      *host = NULL;
+    }
+    goto done;
+  }
+
+  status = ARES_SUCCESS;
+
+  if (host != NULL) {
+    *host = NULL;
+
+    /* Addresses of the other family only, hostent can't represent that */
+    if (naliases == 0 && naddrs == 0) {
+      status = ARES_ENODATA;
+    } else {
+      hostent = ares_malloc_zero(sizeof(*hostent));
+      if (hostent == NULL) {
+        goto enomem; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+
+      hostent->h_addrtype = (HOSTENT_ADDRTYPE_TYPE)family;
+      if (family == AF_INET6) {
+        hostent->h_length = sizeof(struct ares_in6_addr);
+      } else {
+        hostent->h_length = sizeof(struct in_addr);
+      }
+      hostent->h_name      = ares_strdup(h_name);
+      hostent->h_aliases   = ares_malloc_zero((naliases + 1) * sizeof(char *));
+      hostent->h_addr_list = ares_malloc_zero((naddrs + 1) * sizeof(char *));
+      if (hostent->h_name == NULL || hostent->h_aliases == NULL ||
+          hostent->h_addr_list == NULL) {
+        goto enomem; /* LCOV_EXCL_LINE: OutOfMemory */
+      }
+    }
+  }
+
+  if (hostent != NULL || req_naddrttls != 0) {
+    if (addr_reply_fill(dnsrec, family, hostent, cname_ttl, req_naddrttls,
+                        addrttls, addr6ttls,
+                        &temp_naddrttls) != ARES_SUCCESS) {
+      goto enomem; /* LCOV_EXCL_LINE: OutOfMemory */
+    }
+  }
+
+  if (host != NULL) {
+    *host = hostent;
+  }
+  if (naddrttls) {
+    *naddrttls = (int)temp_naddrttls;
+  }
+
+done:
+  ares_dns_record_destroy(dnsrec);
+
+  if (status == ARES_EBADNAME) {
+    status = ARES_EBADRESP;
+  }
+
+  return status;
+
+/* LCOV_EXCL_START: OutOfMemory */
+enomem:
+  ares_free_hostent(hostent);
+  ares_dns_record_destroy(dnsrec);
+  return ARES_ENOMEM;
+  /* LCOV_EXCL_STOP */
+}
@@ -79,57 +79,280 @@ ares_bool_t ares_dns_flags_arevalid(unsigned short flags)
   return ARES_TRUE;
 }
 
+/* Everything we know about a record type lives in a single constant table so
+ * that each mapping below is a direct index rather than a switch statement.
+ * Keys are enumerated as (type * 100) + n, so the per-type key information is
+ * indexed by n - 1.  A few types skip a key number; those slots have a NULL
+ * name. */
+typedef struct {
+  const char         *name;
+  ares_dns_datatype_t datatype;
+} ares_dns_rr_key_info_t;
+
+typedef struct {
+  ares_dns_rec_type_t           type;
+  const char                   *name;
+  ares_bool_t                   allow_name_comp;
+  const ares_dns_rr_key_t      *keys;
+  size_t                        keys_cnt;
+  const ares_dns_rr_key_info_t *key_info;
+  size_t                        key_info_cnt;
+} ares_dns_rec_type_info_t;
+
+static const ares_dns_rr_key_t rr_a_keys[]     = { ARES_RR_A_ADDR };
+static const ares_dns_rr_key_t rr_ns_keys[]    = { ARES_RR_NS_NSDNAME };
+static const ares_dns_rr_key_t rr_cname_keys[] = { ARES_RR_CNAME_CNAME };
+static const ares_dns_rr_key_t rr_soa_keys[]   = {
+  ARES_RR_SOA_MNAME,   ARES_RR_SOA_RNAME, ARES_RR_SOA_SERIAL,
+  ARES_RR_SOA_REFRESH, ARES_RR_SOA_RETRY, ARES_RR_SOA_EXPIRE,
+  ARES_RR_SOA_MINIMUM
+};
+static const ares_dns_rr_key_t rr_ptr_keys[]   = { ARES_RR_PTR_DNAME };
+static const ares_dns_rr_key_t rr_hinfo_keys[] = { ARES_RR_HINFO_CPU,
+                                                   ARES_RR_HINFO_OS };
+static const ares_dns_rr_key_t rr_mx_keys[]    = { ARES_RR_MX_PREFERENCE,
+                                                   ARES_RR_MX_EXCHANGE };
+static const ares_dns_rr_key_t rr_sig_keys[]   = {
+  ARES_RR_SIG_TYPE_COVERED, ARES_RR_SIG_ALGORITHM,    ARES_RR_SIG_LABELS,
+  ARES_RR_SIG_ORIGINAL_TTL, ARES_RR_SIG_EXPIRATION,   ARES_RR_SIG_INCEPTION,
+  ARES_RR_SIG_KEY_TAG,      ARES_RR_SIG_SIGNERS_NAME, ARES_RR_SIG_SIGNATURE
+};
+static const ares_dns_rr_key_t rr_txt_keys[]  = { ARES_RR_TXT_DATA };
+static const ares_dns_rr_key_t rr_aaaa_keys[] = { ARES_RR_AAAA_ADDR };
+static const ares_dns_rr_key_t rr_srv_keys[]  = {
+  ARES_RR_SRV_PRIORITY, ARES_RR_SRV_WEIGHT, ARES_RR_SRV_PORT, ARES_RR_SRV_TARGET
+};
+static const ares_dns_rr_key_t rr_naptr_keys[] = {
+  ARES_RR_NAPTR_ORDER,    ARES_RR_NAPTR_PREFERENCE, ARES_RR_NAPTR_FLAGS,
+  ARES_RR_NAPTR_SERVICES, ARES_RR_NAPTR_REGEXP,     ARES_RR_NAPTR_REPLACEMENT
+};
+static const ares_dns_rr_key_t rr_opt_keys[]    = { ARES_RR_OPT_UDP_SIZE,
+                                                    ARES_RR_OPT_VERSION,
+                                                    ARES_RR_OPT_FLAGS,
+                                                    ARES_RR_OPT_OPTIONS };
+static const ares_dns_rr_key_t rr_tlsa_keys[]   = { ARES_RR_TLSA_CERT_USAGE,
+                                                    ARES_RR_TLSA_SELECTOR,
+                                                    ARES_RR_TLSA_MATCH,
+                                                    ARES_RR_TLSA_DATA };
+static const ares_dns_rr_key_t rr_svcb_keys[]   = { ARES_RR_SVCB_PRIORITY,
+                                                    ARES_RR_SVCB_TARGET,
+                                                    ARES_RR_SVCB_PARAMS };
+static const ares_dns_rr_key_t rr_https_keys[]  = { ARES_RR_HTTPS_PRIORITY,
+                                                    ARES_RR_HTTPS_TARGET,
+                                                    ARES_RR_HTTPS_PARAMS };
+static const ares_dns_rr_key_t rr_uri_keys[]    = { ARES_RR_URI_PRIORITY,
+                                                    ARES_RR_URI_WEIGHT,
+                                                    ARES_RR_URI_TARGET };
+static const ares_dns_rr_key_t rr_caa_keys[]    = { ARES_RR_CAA_CRITICAL,
+                                                    ARES_RR_CAA_TAG,
+                                                    ARES_RR_CAA_VALUE };
+static const ares_dns_rr_key_t rr_raw_rr_keys[] = { ARES_RR_RAW_RR_TYPE,
+                                                    ARES_RR_RAW_RR_DATA };
+
+static const ares_dns_rr_key_info_t rr_a_info[]     = {
+  { "ADDR", ARES_DATATYPE_INADDR }
+};
+static const ares_dns_rr_key_info_t rr_ns_info[]    = {
+  { "NSDNAME", ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_cname_info[] = {
+  { "CNAME", ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_soa_info[]   = {
+  { "MNAME",   ARES_DATATYPE_NAME },
+  { "RNAME",   ARES_DATATYPE_NAME },
+  { "SERIAL",  ARES_DATATYPE_U32  },
+  { "REFRESH", ARES_DATATYPE_U32  },
+  { "RETRY",   ARES_DATATYPE_U32  },
+  { "EXPIRE",  ARES_DATATYPE_U32  },
+  { "MINIMUM", ARES_DATATYPE_U32  }
+};
+static const ares_dns_rr_key_info_t rr_ptr_info[]   = {
+  { "DNAME", ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_hinfo_info[] = {
+  { "CPU", ARES_DATATYPE_STR },
+  { "OS",  ARES_DATATYPE_STR }
+};
+static const ares_dns_rr_key_info_t rr_mx_info[]    = {
+  { "PREFERENCE", ARES_DATATYPE_U16  },
+  { "EXCHANGE",   ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_txt_info[]   = {
+  { "DATA", ARES_DATATYPE_ABINP }
+};
+static const ares_dns_rr_key_info_t rr_sig_info[]   = {
+  { "TYPE_COVERED", ARES_DATATYPE_U16  },
+  { "ALGORITHM",    ARES_DATATYPE_U8   },
+  { "LABELS",       ARES_DATATYPE_U8   },
+  { "ORIGINAL_TTL", ARES_DATATYPE_U32  },
+  { "EXPIRATION",   ARES_DATATYPE_U32  },
+  { "INCEPTION",    ARES_DATATYPE_U32  },
+  { "KEY_TAG",      ARES_DATATYPE_U16  },
+  { "SIGNERS_NAME", ARES_DATATYPE_NAME },
+  { "SIGNATURE",    ARES_DATATYPE_BIN  }
+};
+static const ares_dns_rr_key_info_t rr_aaaa_info[]  = {
+  { "ADDR", ARES_DATATYPE_INADDR6 }
+};
+static const ares_dns_rr_key_info_t rr_srv_info[]   = {
+  { NULL,       0                  }, /* SRV keys start at 2 */
+  { "PRIORITY", ARES_DATATYPE_U16  },
+  { "WEIGHT",   ARES_DATATYPE_U16  },
+  { "PORT",     ARES_DATATYPE_U16  },
+  { "TARGET",   ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_naptr_info[] = {
+  { "ORDER",       ARES_DATATYPE_U16  },
+  { "PREFERENCE",  ARES_DATATYPE_U16  },
+  { "FLAGS",       ARES_DATATYPE_STR  },
+  { "SERVICES",    ARES_DATATYPE_STR  },
+  { "REGEXP",      ARES_DATATYPE_STR  },
+  { "REPLACEMENT", ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_opt_info[]   = {
+  { "UDP_SIZE", ARES_DATATYPE_U16 },
+  { NULL,       0                 }, /* OPT has no key 2 */
+  { "VERSION",  ARES_DATATYPE_U8  },
+  { "FLAGS",    ARES_DATATYPE_U16 },
+  { "OPTIONS",  ARES_DATATYPE_OPT }
+};
+static const ares_dns_rr_key_info_t rr_tlsa_info[]  = {
+  { "CERT_USAGE", ARES_DATATYPE_U8  },
+  { "SELECTOR",   ARES_DATATYPE_U8  },
+  { "MATCH",      ARES_DATATYPE_U8  },
+  { "DATA",       ARES_DATATYPE_BIN }
+};
+static const ares_dns_rr_key_info_t rr_svcb_info[]  = {
+  { "PRIORITY", ARES_DATATYPE_U16  },
+  { "TARGET",   ARES_DATATYPE_NAME },
+  { "PARAMS",   ARES_DATATYPE_OPT  }
+};
+static const ares_dns_rr_key_info_t rr_https_info[] = {
+  { "PRIORITY", ARES_DATATYPE_U16  },
+  { "TARGET",   ARES_DATATYPE_NAME },
+  { "PARAMS",   ARES_DATATYPE_OPT  }
+};
+static const ares_dns_rr_key_info_t rr_uri_info[]   = {
+  { "PRIORITY", ARES_DATATYPE_U16  },
+  { "WEIGHT",   ARES_DATATYPE_U16  },
+  { "TARGET",   ARES_DATATYPE_NAME }
+};
+static const ares_dns_rr_key_info_t rr_caa_info[]   = {
+  { "CRITICAL", ARES_DATATYPE_U8   },
+  { "TAG",      ARES_DATATYPE_STR  },
+  { "VALUE",    ARES_DATATYPE_BINP }
+};
+static const ares_dns_rr_key_info_t rr_raw_rr_info[] = {
+  { "TYPE", ARES_DATATYPE_U16 },
+  { "DATA", ARES_DATATYPE_BIN }
+};
+
+#define ARES_RR_TYPE_ROW(type, name, comp, k)                                \
+  { type, name, comp, rr_##k##_keys,                                         \
+    sizeof(rr_##k##_keys) / sizeof(*rr_##k##_keys), rr_##k##_info,           \
+    sizeof(rr_##k##_info) / sizeof(*rr_##k##_info) }
+
+/* Only record types defined in RFC1035 allow name compression within the
+ * RDATA.  Otherwise nameservers that don't understand an RR may not be
+ * able to pass along the RR in a proper manner */
+static const ares_dns_rec_type_info_t rec_types[] = {
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_A, "A", ARES_TRUE, a),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_NS, "NS", ARES_TRUE, ns),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_CNAME, "CNAME", ARES_TRUE, cname),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_SOA, "SOA", ARES_TRUE, soa),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_PTR, "PTR", ARES_TRUE, ptr),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_HINFO, "HINFO", ARES_TRUE, hinfo),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_MX, "MX", ARES_TRUE, mx),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_TXT, "TXT", ARES_TRUE, txt),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_SIG, "SIG", ARES_FALSE, sig),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_AAAA, "AAAA", ARES_FALSE, aaaa),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_SRV, "SRV", ARES_FALSE, srv),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_NAPTR, "NAPTR", ARES_FALSE, naptr),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_OPT, "OPT", ARES_FALSE, opt),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_TLSA, "TLSA", ARES_FALSE, tlsa),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_SVCB, "SVCB", ARES_FALSE, svcb),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_HTTPS, "HTTPS", ARES_FALSE, https),
+  /* Not real, has no keys */
+  { ARES_REC_TYPE_ANY, "ANY", ARES_FALSE, NULL, 0, NULL, 0 },
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_URI, "URI", ARES_FALSE, uri),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_CAA, "CAA", ARES_FALSE, caa),
+  ARES_RR_TYPE_ROW(ARES_REC_TYPE_RAW_RR, "RAWRR", ARES_FALSE, raw_rr)
+};
+
+/* Record type values below 66 map through rec_types_low to their position in
+ * rec_types plus one (0 is unknown).  The few larger types are contiguous
+ * from ANY. */
+static const unsigned char rec_types_low[66] = {
+  0,  1,  2,  0,  0,  3,  4,  0,  0,  0, /*  0 -  9 */
+  0,  0,  5,  6,  0,  7,  8,  0,  0,  0, /* 10 - 19 */
+  0,  0,  0,  0,  9,  0,  0,  0,  10, 0, /* 20 - 29 */
+  0,  0,  0,  11, 0,  12, 0,  0,  0,  0, /* 30 - 39 */
+  0,  13, 0,  0,  0,  0,  0,  0,  0,  0, /* 40 - 49 */
+  0,  0,  14, 0,  0,  0,  0,  0,  0,  0, /* 50 - 59 */
+  0,  0,  0,  0,  15, 16                 /* 60 - 65 */
+};
+
+#define REC_TYPES_ANY_IDX    16
+#define REC_TYPES_RAW_RR_IDX 19
+
+static const ares_dns_rec_type_info_t *
+  ares_dns_rec_type_info(ares_dns_rec_type_t type)
+{
+  size_t idx;
+
+  if ((size_t)type < sizeof(rec_types_low)) {
+    idx = rec_types_low[type];
+    return idx == 0 ? NULL : &rec_types[idx - 1];
+  }
+
+  if (type >= ARES_REC_TYPE_ANY && type <= ARES_REC_TYPE_CAA) {
+    return &rec_types[REC_TYPES_ANY_IDX + (type - ARES_REC_TYPE_ANY)];
+  }
+
+  if (type == ARES_REC_TYPE_RAW_RR) {
+    return &rec_types[REC_TYPES_RAW_RR_IDX];
+  }
+
+  return NULL;
+}
+
+static const ares_dns_rr_key_info_t *ares_dns_rr_key_info(ares_dns_rr_key_t key)
+{
+  const ares_dns_rec_type_info_t *info =
+    ares_dns_rec_type_info((ares_dns_rec_type_t)(key / 100));
+  size_t idx = key % 100;
+
+  if (info == NULL || idx == 0 || idx > info->key_info_cnt ||
+      info->key_info[idx - 1].name == NULL) {
+    return NULL;
+  }
+
+  return &info->key_info[idx - 1];
+}
+
 ares_bool_t ares_dns_rec_type_isvalid(ares_dns_rec_type_t type,
                                       ares_bool_t         is_query)
 {
-  switch (type) {
-    case ARES_REC_TYPE_A:
-    case ARES_REC_TYPE_NS:
-    case ARES_REC_TYPE_CNAME:
-    case ARES_REC_TYPE_SOA:
-    case ARES_REC_TYPE_PTR:
-    case ARES_REC_TYPE_HINFO:
-    case ARES_REC_TYPE_MX:
-    case ARES_REC_TYPE_TXT:
-    case ARES_REC_TYPE_SIG:
-    case ARES_REC_TYPE_AAAA:
-    case ARES_REC_TYPE_SRV:
-    case ARES_REC_TYPE_NAPTR:
-    case ARES_REC_TYPE_OPT:
-    case ARES_REC_TYPE_TLSA:
-    case ARES_REC_TYPE_SVCB:
-    case ARES_REC_TYPE_HTTPS:
-    case ARES_REC_TYPE_ANY:
-    case ARES_REC_TYPE_URI:
-    case ARES_REC_TYPE_CAA:
-      return ARES_TRUE;
-    case ARES_REC_TYPE_RAW_RR:
-      return is_query ? ARES_FALSE : ARES_TRUE;
-    default:
-      break;
+  if (type == ARES_REC_TYPE_RAW_RR) {
+    return is_query ? ARES_FALSE : ARES_TRUE;
   }
+
+  if (ares_dns_rec_type_info(type) != NULL) {
+    return ARES_TRUE;
+  }
+
   return is_query ? ARES_TRUE : ARES_FALSE;
 }
 
 ares_bool_t ares_dns_rec_allow_name_comp(ares_dns_rec_type_t type)
 {
-  /* Only record types defined in RFC1035 allow name compression within the
-   * RDATA.  Otherwise nameservers that don't understand an RR may not be
-   * able to pass along the RR in a proper manner */
-  switch (type) {
-    case ARES_REC_TYPE_A:
-    case ARES_REC_TYPE_NS:
-    case ARES_REC_TYPE_CNAME:
-    case ARES_REC_TYPE_SOA:
-    case ARES_REC_TYPE_PTR:
-    case ARES_REC_TYPE_HINFO:
-    case ARES_REC_TYPE_MX:
-    case ARES_REC_TYPE_TXT:
-      return ARES_TRUE;
-    default:
-      break;
+  const ares_dns_rec_type_info_t *info = ares_dns_rec_type_info(type);
+
+  if (info == NULL) {
+    return ARES_FALSE;
   }
-  return ARES_FALSE;
+  return info->allow_name_comp;
 }
 
 ares_bool_t ares_dns_class_isvalid(ares_dns_class_t    qclass,
@@ -188,49 +411,12 @@ ares_dns_rec_type_t ares_dns_rr_key_to_rec_type(ares_dns_rr_key_t key)
 
 const char *ares_dns_rec_type_tostr(ares_dns_rec_type_t type)
 {
-  switch (type) {
-    case ARES_REC_TYPE_A:
-      return "A";
-    case ARES_REC_TYPE_NS:
-      return "NS";
-    case ARES_REC_TYPE_CNAME:
-      return "CNAME";
-    case ARES_REC_TYPE_SOA:
-      return "SOA";
-    case ARES_REC_TYPE_PTR:
-      return "PTR";
-    case ARES_REC_TYPE_HINFO:
-      return "HINFO";
-    case ARES_REC_TYPE_MX:
-      return "MX";
-    case ARES_REC_TYPE_TXT:
-      return "TXT";
-    case ARES_REC_TYPE_SIG:
-      return "SIG";
-    case ARES_REC_TYPE_AAAA:
-      return "AAAA";
-    case ARES_REC_TYPE_SRV:
-      return "SRV";
-    case ARES_REC_TYPE_NAPTR:
-      return "NAPTR";
-    case ARES_REC_TYPE_OPT:
-      return "OPT";
-    case ARES_REC_TYPE_TLSA:
-      return "TLSA";
-    case ARES_REC_TYPE_SVCB:
-      return "SVCB";
-    case ARES_REC_TYPE_HTTPS:
-      return "HTTPS";
-    case ARES_REC_TYPE_ANY:
-      return "ANY";
-    case ARES_REC_TYPE_URI:
-      return "URI";
-    case ARES_REC_TYPE_CAA:
-      return "CAA";
-    case ARES_REC_TYPE_RAW_RR:
-      return "RAWRR";
+  const ares_dns_rec_type_info_t *info = ares_dns_rec_type_info(type);
+
+  if (info == NULL) {
+    return "UNKNOWN";
   }
-  return "UNKNOWN";
+  return info->name;
 }
 
 const char *ares_dns_class_tostr(ares_dns_class_t qclass)
@@ -269,395 +455,41 @@ const char *ares_dns_opcode_tostr(ares_dns_opcode_t opcode)
 
 const char *ares_dns_rr_key_tostr(ares_dns_rr_key_t key)
 {
-  switch (key) {
-    case ARES_RR_A_ADDR:
-      return "ADDR";
-
-    case ARES_RR_NS_NSDNAME:
-      return "NSDNAME";
-
-    case ARES_RR_CNAME_CNAME:
-      return "CNAME";
-
-    case ARES_RR_SOA_MNAME:
-      return "MNAME";
-
-    case ARES_RR_SOA_RNAME:
-      return "RNAME";
-
-    case ARES_RR_SOA_SERIAL:
-      return "SERIAL";
-
-    case ARES_RR_SOA_REFRESH:
-      return "REFRESH";
-
-    case ARES_RR_SOA_RETRY:
-      return "RETRY";
-
-    case ARES_RR_SOA_EXPIRE:
-      return "EXPIRE";
-
-    case ARES_RR_SOA_MINIMUM:
-      return "MINIMUM";
-
-    case ARES_RR_PTR_DNAME:
-      return "DNAME";
-
-    case ARES_RR_AAAA_ADDR:
-      return "ADDR";
-
-    case ARES_RR_HINFO_CPU:
-      return "CPU";
-
-    case ARES_RR_HINFO_OS:
-      return "OS";
+  const ares_dns_rr_key_info_t *info = ares_dns_rr_key_info(key);
 
-    case ARES_RR_MX_PREFERENCE:
-      return "PREFERENCE";
-
-    case ARES_RR_MX_EXCHANGE:
-      return "EXCHANGE";
-
-    case ARES_RR_TXT_DATA:
-      return "DATA";
-
-    case ARES_RR_SIG_TYPE_COVERED:
-      return "TYPE_COVERED";
-
-    case ARES_RR_SIG_ALGORITHM:
-      return "ALGORITHM";
-
-    case ARES_RR_SIG_LABELS:
-      return "LABELS";
-
-    case ARES_RR_SIG_ORIGINAL_TTL:
-      return "ORIGINAL_TTL";
-
-    case ARES_RR_SIG_EXPIRATION:
-      return "EXPIRATION";
-
-    case ARES_RR_SIG_INCEPTION:
-      return "INCEPTION";
-
-    case ARES_RR_SIG_KEY_TAG:
-      return "KEY_TAG";
-
-    case ARES_RR_SIG_SIGNERS_NAME:
-      return "SIGNERS_NAME";
-
-    case ARES_RR_SIG_SIGNATURE:
-      return "SIGNATURE";
-
-    case ARES_RR_SRV_PRIORITY:
-      return "PRIORITY";
-
-    case ARES_RR_SRV_WEIGHT:
-      return "WEIGHT";
-
-    case ARES_RR_SRV_PORT:
-      return "PORT";
-
-    case ARES_RR_SRV_TARGET:
-      return "TARGET";
-
-    case ARES_RR_NAPTR_ORDER:
-      return "ORDER";
-
-    case ARES_RR_NAPTR_PREFERENCE:
-      return "PREFERENCE";
-
-    case ARES_RR_NAPTR_FLAGS:
-      return "FLAGS";
-
-    case ARES_RR_NAPTR_SERVICES:
-      return "SERVICES";
-
-    case ARES_RR_NAPTR_REGEXP:
-      return "REGEXP";
-
-    case ARES_RR_NAPTR_REPLACEMENT:
-      return "REPLACEMENT";
-
-    case ARES_RR_OPT_UDP_SIZE:
-      return "UDP_SIZE";
-
-    case ARES_RR_OPT_VERSION:
-      return "VERSION";
-
-    case ARES_RR_OPT_FLAGS:
-      return "FLAGS";
-
-    case ARES_RR_OPT_OPTIONS:
-      return "OPTIONS";
-
-    case ARES_RR_TLSA_CERT_USAGE:
-      return "CERT_USAGE";
-
-    case ARES_RR_TLSA_SELECTOR:
-      return "SELECTOR";
-
-    case ARES_RR_TLSA_MATCH:
-      return "MATCH";
-
-    case ARES_RR_TLSA_DATA:
-      return "DATA";
-
-    case ARES_RR_SVCB_PRIORITY:
-      return "PRIORITY";
-
-    case ARES_RR_SVCB_TARGET:
-      return "TARGET";
-
-    case ARES_RR_SVCB_PARAMS:
-      return "PARAMS";
-
-    case ARES_RR_HTTPS_PRIORITY:
-      return "PRIORITY";
-
-    case ARES_RR_HTTPS_TARGET:
-      return "TARGET";
-
-    case ARES_RR_HTTPS_PARAMS:
-      return "PARAMS";
-
-    case ARES_RR_URI_PRIORITY:
-      return "PRIORITY";
-
-    case ARES_RR_URI_WEIGHT:
-      return "WEIGHT";
-
-    case ARES_RR_URI_TARGET:
-      return "TARGET";
-
-    case ARES_RR_CAA_CRITICAL:
-      return "CRITICAL";
-
-    case ARES_RR_CAA_TAG:
-      return "TAG";
-
-    case ARES_RR_CAA_VALUE:
-      return "VALUE";
-
-    case ARES_RR_RAW_RR_TYPE:
-      return "TYPE";
-
-    case ARES_RR_RAW_RR_DATA:
-      return "DATA";
+  if (info == NULL) {
+    return "UNKNOWN";
   }
-
-  return "UNKNOWN";
+  return info->name;
 }
 
 ares_dns_datatype_t ares_dns_rr_key_datatype(ares_dns_rr_key_t key)
 {
-  switch (key) {
-    case ARES_RR_A_ADDR:
-      return ARES_DATATYPE_INADDR;
-
-    case ARES_RR_AAAA_ADDR:
-      return ARES_DATATYPE_INADDR6;
-
-    case ARES_RR_NS_NSDNAME:
-    case ARES_RR_CNAME_CNAME:
-    case ARES_RR_SOA_MNAME:
-    case ARES_RR_SOA_RNAME:
-    case ARES_RR_PTR_DNAME:
-    case ARES_RR_MX_EXCHANGE:
-    case ARES_RR_SIG_SIGNERS_NAME:
-    case ARES_RR_SRV_TARGET:
-    case ARES_RR_SVCB_TARGET:
-    case ARES_RR_HTTPS_TARGET:
-    case ARES_RR_NAPTR_REPLACEMENT:
-    case ARES_RR_URI_TARGET:
-      return ARES_DATATYPE_NAME;
-
-    case ARES_RR_HINFO_CPU:
-    case ARES_RR_HINFO_OS:
-    case ARES_RR_NAPTR_FLAGS:
-    case ARES_RR_NAPTR_SERVICES:
-    case ARES_RR_NAPTR_REGEXP:
-    case ARES_RR_CAA_TAG:
-      return ARES_DATATYPE_STR;
-
-    case ARES_RR_SOA_SERIAL:
-    case ARES_RR_SOA_REFRESH:
-    case ARES_RR_SOA_RETRY:
-    case ARES_RR_SOA_EXPIRE:
-    case ARES_RR_SOA_MINIMUM:
-    case ARES_RR_SIG_ORIGINAL_TTL:
-    case ARES_RR_SIG_EXPIRATION:
-    case ARES_RR_SIG_INCEPTION:
-      return ARES_DATATYPE_U32;
-
-    case ARES_RR_MX_PREFERENCE:
-    case ARES_RR_SIG_TYPE_COVERED:
-    case ARES_RR_SIG_KEY_TAG:
-    case ARES_RR_SRV_PRIORITY:
-    case ARES_RR_SRV_WEIGHT:
-    case ARES_RR_SRV_PORT:
-    case ARES_RR_NAPTR_ORDER:
-    case ARES_RR_NAPTR_PREFERENCE:
-    case ARES_RR_OPT_UDP_SIZE:
-    case ARES_RR_OPT_FLAGS:
-    case ARES_RR_SVCB_PRIORITY:
-    case ARES_RR_HTTPS_PRIORITY:
-    case ARES_RR_URI_PRIORITY:
-    case ARES_RR_URI_WEIGHT:
-    case ARES_RR_RAW_RR_TYPE:
-      return ARES_DATATYPE_U16;
-
-    case ARES_RR_SIG_ALGORITHM:
-    case ARES_RR_SIG_LABELS:
-    case ARES_RR_OPT_VERSION:
-    case ARES_RR_TLSA_CERT_USAGE:
-    case ARES_RR_TLSA_SELECTOR:
-    case ARES_RR_TLSA_MATCH:
-    case ARES_RR_CAA_CRITICAL:
-      return ARES_DATATYPE_U8;
-
-    case ARES_RR_CAA_VALUE:
-      return ARES_DATATYPE_BINP;
-
-    case ARES_RR_TXT_DATA:
-      return ARES_DATATYPE_ABINP;
-
-    case ARES_RR_SIG_SIGNATURE:
-    case ARES_RR_TLSA_DATA:
-    case ARES_RR_RAW_RR_DATA:
-      return ARES_DATATYPE_BIN;
+  const ares_dns_rr_key_info_t *info = ares_dns_rr_key_info(key);
 
-    case ARES_RR_OPT_OPTIONS:
-    case ARES_RR_SVCB_PARAMS:
-    case ARES_RR_HTTPS_PARAMS:
-      return ARES_DATATYPE_OPT;
+  if (info == NULL) {
+    return 0;
   }
-
-  return 0;
+  return info->datatype;
 }
 
-static const ares_dns_rr_key_t rr_a_keys[]     = { ARES_RR_A_ADDR };
-static const ares_dns_rr_key_t rr_ns_keys[]    = { ARES_RR_NS_NSDNAME };
-static const ares_dns_rr_key_t rr_cname_keys[] = { ARES_RR_CNAME_CNAME };
-static const ares_dns_rr_key_t rr_soa_keys[]   = {
-  ARES_RR_SOA_MNAME,   ARES_RR_SOA_RNAME, ARES_RR_SOA_SERIAL,
-  ARES_RR_SOA_REFRESH, ARES_RR_SOA_RETRY, ARES_RR_SOA_EXPIRE,
-  ARES_RR_SOA_MINIMUM
-};
-static const ares_dns_rr_key_t rr_ptr_keys[]   = { ARES_RR_PTR_DNAME };
-static const ares_dns_rr_key_t rr_hinfo_keys[] = { ARES_RR_HINFO_CPU,
-                                                   ARES_RR_HINFO_OS };
-static const ares_dns_rr_key_t rr_mx_keys[]    = { ARES_RR_MX_PREFERENCE,
-                                                   ARES_RR_MX_EXCHANGE };
-static const ares_dns_rr_key_t rr_sig_keys[]   = {
-  ARES_RR_SIG_TYPE_COVERED, ARES_RR_SIG_ALGORITHM,    ARES_RR_SIG_LABELS,
-  ARES_RR_SIG_ORIGINAL_TTL, ARES_RR_SIG_EXPIRATION,   ARES_RR_SIG_INCEPTION,
-  ARES_RR_SIG_KEY_TAG,      ARES_RR_SIG_SIGNERS_NAME, ARES_RR_SIG_SIGNATURE
-};
-static const ares_dns_rr_key_t rr_txt_keys[]  = { ARES_RR_TXT_DATA };
-static const ares_dns_rr_key_t rr_aaaa_keys[] = { ARES_RR_AAAA_ADDR };
-static const ares_dns_rr_key_t rr_srv_keys[]  = {
-  ARES_RR_SRV_PRIORITY, ARES_RR_SRV_WEIGHT, ARES_RR_SRV_PORT, ARES_RR_SRV_TARGET
-};
-static const ares_dns_rr_key_t rr_naptr_keys[] = {
-  ARES_RR_NAPTR_ORDER,    ARES_RR_NAPTR_PREFERENCE, ARES_RR_NAPTR_FLAGS,
-  ARES_RR_NAPTR_SERVICES, ARES_RR_NAPTR_REGEXP,     ARES_RR_NAPTR_REPLACEMENT
-};
-static const ares_dns_rr_key_t rr_opt_keys[]    = { ARES_RR_OPT_UDP_SIZE,
-                                                    ARES_RR_OPT_VERSION,
-                                                    ARES_RR_OPT_FLAGS,
-                                                    ARES_RR_OPT_OPTIONS };
-static const ares_dns_rr_key_t rr_tlsa_keys[]   = { ARES_RR_TLSA_CERT_USAGE,
-                                                    ARES_RR_TLSA_SELECTOR,
-                                                    ARES_RR_TLSA_MATCH,
-                                                    ARES_RR_TLSA_DATA };
-static const ares_dns_rr_key_t rr_svcb_keys[]   = { ARES_RR_SVCB_PRIORITY,
-                                                    ARES_RR_SVCB_TARGET,
-                                                    ARES_RR_SVCB_PARAMS };
-static const ares_dns_rr_key_t rr_https_keys[]  = { ARES_RR_HTTPS_PRIORITY,
-                                                    ARES_RR_HTTPS_TARGET,
-                                                    ARES_RR_HTTPS_PARAMS };
-static const ares_dns_rr_key_t rr_uri_keys[]    = { ARES_RR_URI_PRIORITY,
-                                                    ARES_RR_URI_WEIGHT,
-                                                    ARES_RR_URI_TARGET };
-static const ares_dns_rr_key_t rr_caa_keys[]    = { ARES_RR_CAA_CRITICAL,
-                                                    ARES_RR_CAA_TAG,
-                                                    ARES_RR_CAA_VALUE };
-static const ares_dns_rr_key_t rr_raw_rr_keys[] = { ARES_RR_RAW_RR_TYPE,
-                                                    ARES_RR_RAW_RR_DATA };
-
-const ares_dns_rr_key_t       *ares_dns_rr_get_keys(ares_dns_rec_type_t type,
-                                                    size_t             *cnt)
+const ares_dns_rr_key_t *ares_dns_rr_get_keys(ares_dns_rec_type_t type,
+                                              size_t             *cnt)
 {
+  const ares_dns_rec_type_info_t *info;
+
   if (cnt == NULL) {
     return NULL;
   }
 
-  *cnt = 0;
-
-  switch (type) {
-    case ARES_REC_TYPE_A:
-      *cnt = sizeof(rr_a_keys) / sizeof(*rr_a_keys);
-      return rr_a_keys;
-    case ARES_REC_TYPE_NS:
-      *cnt = sizeof(rr_ns_keys) / sizeof(*rr_ns_keys);
-      return rr_ns_keys;
-    case ARES_REC_TYPE_CNAME:
-      *cnt = sizeof(rr_cname_keys) / sizeof(*rr_cname_keys);
-      return rr_cname_keys;
-    case ARES_REC_TYPE_SOA:
-      *cnt = sizeof(rr_soa_keys) / sizeof(*rr_soa_keys);
-      return rr_soa_keys;
-    case ARES_REC_TYPE_PTR:
-      *cnt = sizeof(rr_ptr_keys) / sizeof(*rr_ptr_keys);
-      return rr_ptr_keys;
-    case ARES_REC_TYPE_HINFO:
-      *cnt = sizeof(rr_hinfo_keys) / sizeof(*rr_hinfo_keys);
-      return rr_hinfo_keys;
-    case ARES_REC_TYPE_MX:
-      *cnt = sizeof(rr_mx_keys) / sizeof(*rr_mx_keys);
-      return rr_mx_keys;
-    case ARES_REC_TYPE_TXT:
-      *cnt = sizeof(rr_txt_keys) / sizeof(*rr_txt_keys);
-      return rr_txt_keys;
-    case ARES_REC_TYPE_SIG:
-      *cnt = sizeof(rr_sig_keys) / sizeof(*rr_sig_keys);
-      return rr_sig_keys;
-    case ARES_REC_TYPE_AAAA:
-      *cnt = sizeof(rr_aaaa_keys) / sizeof(*rr_aaaa_keys);
-      return rr_aaaa_keys;
-    case ARES_REC_TYPE_SRV:
-      *cnt = sizeof(rr_srv_keys) / sizeof(*rr_srv_keys);
-      return rr_srv_keys;
-    case ARES_REC_TYPE_NAPTR:
-      *cnt = sizeof(rr_naptr_keys) / sizeof(*rr_naptr_keys);
-      return rr_naptr_keys;
-    case ARES_REC_TYPE_OPT:
-      *cnt = sizeof(rr_opt_keys) / sizeof(*rr_opt_keys);
-      return rr_opt_keys;
-    case ARES_REC_TYPE_TLSA:
-      *cnt = sizeof(rr_tlsa_keys) / sizeof(*rr_tlsa_keys);
-      return rr_tlsa_keys;
-    case ARES_REC_TYPE_SVCB:
-      *cnt = sizeof(rr_svcb_keys) / sizeof(*rr_svcb_keys);
-      return rr_svcb_keys;
-    case ARES_REC_TYPE_HTTPS:
-      *cnt = sizeof(rr_https_keys) / sizeof(*rr_https_keys);
-      return rr_https_keys;
-    case ARES_REC_TYPE_ANY:
-      /* Not real */
-      break;
-    case ARES_REC_TYPE_URI:
-      *cnt = sizeof(rr_uri_keys) / sizeof(*rr_uri_keys);
-      return rr_uri_keys;
-    case ARES_REC_TYPE_CAA:
-      *cnt = sizeof(rr_caa_keys) / sizeof(*rr_caa_keys);
-      return rr_caa_keys;
-    case ARES_REC_TYPE_RAW_RR:
-      *cnt = sizeof(rr_raw_rr_keys) / sizeof(*rr_raw_rr_keys);
-      return rr_raw_rr_keys;
+  info = ares_dns_rec_type_info(type);
+  if (info == NULL) {
+    *cnt = 0;
+    return NULL;
   }
 
-  return NULL;
+  *cnt = info->keys_cnt;
+  return info->keys;
 }
 
 ares_bool_t ares_dns_class_fromstr(ares_dns_class_t *qclass, const char *str)
@@ -689,49 +521,79 @@ ares_bool_t ares_dns_class_fromstr(ares_dns_class_t *qclass, const char *str)
   return ARES_FALSE;
 }
 
+/* Perfect hash of the upper-cased record type names into rec_types_byname.
+ * The seed was chosen so every name in the table lands in its own bucket;
+ * a lookup is one hash plus a single case-insensitive compare.  If a record
+ * type is added, pick a new seed (and/or grow the table) and regenerate the
+ * bucket layout, the DNSMapping test will catch a mismatch. */
+#define REC_TYPES_HASH_SEED 2330U
+#define REC_TYPES_HASH_BITS 5
+
+static size_t ares_dns_rec_type_hash(const char *str)
+{
+  unsigned int hv = REC_TYPES_HASH_SEED;
+
+  for (; *str != 0; str++) {
+    hv ^= (unsigned int)((unsigned char)*str | 0x20);
+    hv  = (hv * 16777619U) & 0xFFFFFFFFU;
+  }
+  return (size_t)(hv >> (32 - REC_TYPES_HASH_BITS));
+}
+
 ares_bool_t ares_dns_rec_type_fromstr(ares_dns_rec_type_t *qtype,
                                       const char          *str)
 {
-  size_t i;
-
   static const struct {
     const char         *name;
     ares_dns_rec_type_t type;
-  } list[] = {
-    { "A",      ARES_REC_TYPE_A      },
-    { "NS",     ARES_REC_TYPE_NS     },
-    { "CNAME",  ARES_REC_TYPE_CNAME  },
-    { "SOA",    ARES_REC_TYPE_SOA    },
-    { "PTR",    ARES_REC_TYPE_PTR    },
-    { "HINFO",  ARES_REC_TYPE_HINFO  },
-    { "MX",     ARES_REC_TYPE_MX     },
-    { "TXT",    ARES_REC_TYPE_TXT    },
-    { "SIG",    ARES_REC_TYPE_SIG    },
-    { "AAAA",   ARES_REC_TYPE_AAAA   },
-    { "SRV",    ARES_REC_TYPE_SRV    },
-    { "NAPTR",  ARES_REC_TYPE_NAPTR  },
-    { "OPT",    ARES_REC_TYPE_OPT    },
-    { "TLSA",   ARES_REC_TYPE_TLSA   },
-    { "SVCB",   ARES_REC_TYPE_SVCB   },
-    { "HTTPS",  ARES_REC_TYPE_HTTPS  },
-    { "ANY",    ARES_REC_TYPE_ANY    },
-    { "URI",    ARES_REC_TYPE_URI    },
-    { "CAA",    ARES_REC_TYPE_CAA    },
-    { "RAW_RR", ARES_REC_TYPE_RAW_RR },
-    { NULL,     0                    }
+  } rec_types_byname[1 << REC_TYPES_HASH_BITS] = {
+    { "HTTPS",  ARES_REC_TYPE_HTTPS  }, /*  0 */
+    { NULL,     0                    }, /*  1 */
+    { "CAA",    ARES_REC_TYPE_CAA    }, /*  2 */
+    { NULL,     0                    }, /*  3 */
+    { NULL,     0                    }, /*  4 */
+    { "SIG",    ARES_REC_TYPE_SIG    }, /*  5 */
+    { NULL,     0                    }, /*  6 */
+    { "SOA",    ARES_REC_TYPE_SOA    }, /*  7 */
+    { NULL,     0                    }, /*  8 */
+    { "SRV",    ARES_REC_TYPE_SRV    }, /*  9 */
+    { NULL,     0                    }, /* 10 */
+    { "TXT",    ARES_REC_TYPE_TXT    }, /* 11 */
+    { NULL,     0                    }, /* 12 */
+    { "OPT",    ARES_REC_TYPE_OPT    }, /* 13 */
+    { "SVCB",   ARES_REC_TYPE_SVCB   }, /* 14 */
+    { "A",      ARES_REC_TYPE_A      }, /* 15 */
+    { "HINFO",  ARES_REC_TYPE_HINFO  }, /* 16 */
+    { NULL,     0                    }, /* 17 */
+    { NULL,     0                    }, /* 18 */
+    { "MX",     ARES_REC_TYPE_MX     }, /* 19 */
+    { "NS",     ARES_REC_TYPE_NS     }, /* 20 */
+    { "NAPTR",  ARES_REC_TYPE_NAPTR  }, /* 21 */
+    { "AAAA",   ARES_REC_TYPE_AAAA   }, /* 22 */
+    { "PTR",    ARES_REC_TYPE_PTR    }, /* 23 */
+    { NULL,     0                    }, /* 24 */
+    { NULL,     0                    }, /* 25 */
+    { "CNAME",  ARES_REC_TYPE_CNAME  }, /* 26 */
+    { "RAW_RR", ARES_REC_TYPE_RAW_RR }, /* 27 */
+    { "URI",    ARES_REC_TYPE_URI    }, /* 28 */
+    { NULL,     0                    }, /* 29 */
+    { "ANY",    ARES_REC_TYPE_ANY    }, /* 30 */
+    { "TLSA",   ARES_REC_TYPE_TLSA   }  /* 31 */
   };
+  size_t idx;
 
   if (qtype == NULL || str == NULL) {
     return ARES_FALSE;
   }
 
-  for (i = 0; list[i].name != NULL; i++) {
-    if (ares_strcaseeq(list[i].name, str)) {
-      *qtype = list[i].type;
-      return ARES_TRUE;
-    }
+  idx = ares_dns_rec_type_hash(str);
+  if (rec_types_byname[idx].name == NULL ||
+      !ares_strcaseeq(rec_types_byname[idx].name, str)) {
+    return ARES_FALSE;
   }
-  return ARES_FALSE;
+
+  *qtype = rec_types_byname[idx].type;
+  return ARES_TRUE;
 }
 
 const char *ares_dns_section_tostr(ares_dns_section_t section)
@@ -27,30 +27,29 @@
 #include "ares_dns_private.h"
 
 typedef struct {
-  unsigned char *data;
-  size_t         len;
+  size_t offset;
+  size_t len;
 } multistring_data_t;
 
 struct ares_dns_multistring {
+  /*! Backing storage, every string stored back to back each followed by a
+   *  NULL terminator that is not part of its length */
+  unsigned char *data;
+  /*! Bytes of backing storage in use */
+  size_t         data_len;
+  /*! Bytes of backing storage allocated */
+  size_t         data_alloc;
+  /*! Offset and length of each string within data */
+  ares_array_t  *strs; /*!< multistring_data_t type */
   /*! whether or not cached concatenated string is valid */
   ares_bool_t    cache_invalidated;
-  /*! combined/concatenated string cache */
+  /*! combined/concatenated string cache, only needed when there is more
+   *  than one string as otherwise the backing storage is returned */
   unsigned char *cache_str;
   /*! length of combined/concatenated string */
   size_t         cache_str_len;
-  /*! Data making up strings */
-  ares_array_t  *strs; /*!< multistring_data_t type */
 };
 
-static void ares_dns_multistring_free_cb(void *arg)
-{
-  multistring_data_t *data = arg;
-  if (data == NULL) {
-    return;
-  }
-  ares_free(data->data);
-}
-
 ares_dns_multistring_t *ares_dns_multistring_create(void)
 {
   ares_dns_multistring_t *strs = ares_malloc_zero(sizeof(*strs));
@@ -58,8 +57,7 @@ ares_dns_multistring_t *ares_dns_multistring_create(void)
     return NULL;
   }
 
-  strs->strs =
-    ares_array_create(sizeof(multistring_data_t), ares_dns_multistring_free_cb);
+  strs->strs = ares_array_create(sizeof(multistring_data_t), NULL);
   if (strs->strs == NULL) {
     ares_free(strs);
     return NULL;
@@ -77,6 +75,8 @@ void ares_dns_multistring_clear(ares_dns_multistring_t *strs)
   while (ares_array_len(strs->strs)) {
     ares_array_remove_last(strs->strs);
   }
+  strs->data_len          = 0;
+  strs->cache_invalidated = ARES_TRUE;
 }
 
 void ares_dns_multistring_destroy(ares_dns_multistring_t *strs)
@@ -84,86 +84,137 @@ void ares_dns_multistring_destroy(ares_dns_multistring_t *strs)
   if (strs == NULL) {
     return;
   }
-  ares_dns_multistring_clear(strs);
   ares_array_destroy(strs->strs);
+  ares_free(strs->data);
   ares_free(strs->cache_str);
   ares_free(strs);
 }
 
-ares_status_t ares_dns_multistring_swap_own(ares_dns_multistring_t *strs,
-                                            size_t idx, unsigned char *str,
-                                            size_t len)
+static ares_status_t ares_dns_multistring_ensure_space(
+  ares_dns_multistring_t *strs, size_t needed_size)
 {
-  multistring_data_t *data;
+  size_t         alloc_size = strs->data_alloc;
+  unsigned char *ptr;
 
-  if (strs == NULL || str == NULL || len == 0) {
-    return ARES_EFORMERR;
+  if (strs->data_alloc - strs->data_len >= needed_size) {
+    return ARES_SUCCESS;
   }
 
-  strs->cache_invalidated = ARES_TRUE;
+  if (alloc_size == 0) {
+    alloc_size = 64;
+  }
+  while (alloc_size - strs->data_len < needed_size) {
+    alloc_size <<= 1;
+  }
 
-  data = ares_array_at(strs->strs, idx);
-  if (data == NULL) {
-    return ARES_EFORMERR;
+  ptr = ares_realloc(strs->data, alloc_size);
+  if (ptr == NULL) {
+    return ARES_ENOMEM;
   }
 
-  ares_free(data->data);
-  data->data = str;
-  data->len  = len;
+  strs->data       = ptr;
+  strs->data_alloc = alloc_size;
   return ARES_SUCCESS;
 }
 
 ares_status_t ares_dns_multistring_del(ares_dns_multistring_t *strs, size_t idx)
 {
+  const multistring_data_t *data;
+  size_t                    remove_len;
+  size_t                    i;
+
   if (strs == NULL) {
     return ARES_EFORMERR;
   }
 
+  data = ares_array_at_const(strs->strs, idx);
+  if (data == NULL) {
+    return ARES_EFORMERR;
+  }
+
   strs->cache_invalidated = ARES_TRUE;
 
+  /* Close the gap in the backing storage and shift every later string */
+  remove_len = data->len + 1;
+  memmove(strs->data + data->offset, strs->data + data->offset + remove_len,
+          strs->data_len - (data->offset + remove_len));
+  strs->data_len -= remove_len;
+
+  for (i = idx + 1; i < ares_array_len(strs->strs); i++) {
+    multistring_data_t *next = ares_array_at(strs->strs, i);
+    next->offset            -= remove_len;
+  }
+
   return ares_array_remove_at(strs->strs, idx);
 }
 
-ares_status_t ares_dns_multistring_add_own(ares_dns_multistring_t *strs,
-                                           unsigned char *str, size_t len)
+ares_status_t ares_dns_multistring_add(ares_dns_multistring_t *strs,
+                                       const unsigned char *str, size_t len)
 {
   multistring_data_t *data;
   ares_status_t       status;
+  ares_bool_t         is_self     = ARES_FALSE;
+  size_t              self_offset = 0;
 
   if (strs == NULL) {
     return ARES_EFORMERR;
   }
 
-  strs->cache_invalidated = ARES_TRUE;
-
   /* NOTE: its ok to have an empty string added */
   if (str == NULL && len != 0) {
     return ARES_EFORMERR;
   }
 
+  /* The string may be one already returned by ares_dns_multistring_get(),
+   * which would be left dangling if the backing storage is reallocated, so
+   * remember where it lives instead */
+  if (len && strs->data != NULL && str >= strs->data &&
+      str < strs->data + strs->data_len) {
+    is_self     = ARES_TRUE;
+    self_offset = (size_t)(str - strs->data);
+  }
+
+  status = ares_dns_multistring_ensure_space(strs, len + 1);
+  if (status != ARES_SUCCESS) {
+    return status;
+  }
+
+  if (is_self) {
+    str = strs->data + self_offset;
+  }
+
   status = ares_array_insert_last((void **)&data, strs->strs);
   if (status != ARES_SUCCESS) {
     return status;
   }
 
+  strs->cache_invalidated = ARES_TRUE;
+
   /* Issue #921, ares_dns_multistring_get() doesn't have a way to indicate
-   * success or fail on a zero-length string which is actually valid.  So we
-   * are going to allocate a 1-byte buffer to use as a placeholder in this
-   * case */
-  if (str == NULL) {
-    str = ares_malloc_zero(1);
-    if (str == NULL) {
-      ares_array_remove_last(strs->strs);
-      return ARES_ENOMEM;
-    }
+   * success or fail on a zero-length string which is actually valid.  Since
+   * every string has a NULL terminator in the backing storage, an empty one
+   * still has a valid pointer */
+  data->offset = strs->data_len;
+  data->len    = len;
+  if (len) {
+    memcpy(strs->data + data->offset, str, len);
   }
-
-  data->data = str;
-  data->len  = len;
+  strs->data[data->offset + len] = 0;
+  strs->data_len                += len + 1;
 
   return ARES_SUCCESS;
 }
 
+ares_status_t ares_dns_multistring_add_own(ares_dns_multistring_t *strs,
+                                           unsigned char *str, size_t len)
+{
+  ares_status_t status = ares_dns_multistring_add(strs, str, len);
+  if (status == ARES_SUCCESS) {
+    ares_free(str);
+  }
+  return status;
+}
+
 size_t ares_dns_multistring_cnt(const ares_dns_multistring_t *strs)
 {
   if (strs == NULL) {
@@ -188,49 +239,56 @@ const unsigned char *
   }
 
   *len = data->len;
-  return data->data;
+  return strs->data + data->offset;
 }
 
 const unsigned char *ares_dns_multistring_combined(ares_dns_multistring_t *strs,
                                                    size_t                 *len)
 {
-  ares_buf_t *buf = NULL;
-  size_t      i;
+  size_t cnt;
+  size_t i;
 
   if (strs == NULL || len == NULL) {
     return NULL;
   }
 
   *len = 0;
+  cnt  = ares_array_len(strs->strs);
+
+  if (cnt == 0) {
+    return (const unsigned char *)"";
+  }
+
+  /* A single string is already its own concatenation */
+  if (cnt == 1) {
+    return ares_dns_multistring_get(strs, 0, len);
+  }
 
   /* Return cache if possible */
-  if (!strs->cache_invalidated) {
+  if (!strs->cache_invalidated && strs->cache_str != NULL) {
     *len = strs->cache_str_len;
     return strs->cache_str;
   }
 
-  /* Clear cache */
+  /* The backing storage holds all strings in order, it just needs the
+   * terminators between them squeezed out, so the result is never larger */
   ares_free(strs->cache_str);
-  strs->cache_str     = NULL;
   strs->cache_str_len = 0;
+  strs->cache_str     = ares_malloc(strs->data_len);
+  if (strs->cache_str == NULL) {
+    return NULL;
+  }
 
-  buf = ares_buf_create();
-
-  for (i = 0; i < ares_array_len(strs->strs); i++) {
+  for (i = 0; i < cnt; i++) {
     const multistring_data_t *data = ares_array_at_const(strs->strs, i);
-    if (data == NULL ||
-        ares_buf_append(buf, data->data, data->len) != ARES_SUCCESS) {
-      ares_buf_destroy(buf);
-      return NULL;
-    }
+    memcpy(strs->cache_str + strs->cache_str_len, strs->data + data->offset,
+           data->len);
+    strs->cache_str_len += data->len;
   }
+  strs->cache_str[strs->cache_str_len] = 0;
 
-  strs->cache_str =
-    (unsigned char *)ares_buf_finish_str(buf, &strs->cache_str_len);
-  if (strs->cache_str != NULL) {
-    strs->cache_invalidated = ARES_FALSE;
-  }
-  *len = strs->cache_str_len;
+  strs->cache_invalidated = ARES_FALSE;
+  *len                    = strs->cache_str_len;
   return strs->cache_str;
 }
 
@@ -256,46 +314,52 @@ ares_status_t ares_dns_multistring_parse_buf(ares_buf_t *buf,
     if (*strs == NULL) {
       return ARES_ENOMEM;
     }
+
+    /* Each length prefix becomes a NULL terminator, so the strings will
+     * take exactly as much storage as their wire form */
+    status = ares_dns_multistring_ensure_space(
+      *strs, remaining_len < orig_len ? remaining_len : orig_len);
+    if (status != ARES_SUCCESS) {
+      ares_dns_multistring_destroy(*strs);
+      *strs = NULL;
+      return status;
+    }
   }
 
   while (orig_len - ares_buf_len(buf) < remaining_len) {
+    size_t               mylen;
+    const unsigned char *data;
+
     status = ares_buf_fetch_bytes(buf, &len, 1);
     if (status != ARES_SUCCESS) {
       break; /* LCOV_EXCL_LINE: DefensiveCoding */
     }
 
+    data = ares_buf_peek(buf, &mylen);
+    if (mylen < len) {
+      status = ARES_EBADRESP;
+      break;
+    }
 
     /* When used by the _str() parser, it really needs to be validated to
      * be a valid printable ascii string.  Do that here */
-    if (len && validate_printable && ares_buf_len(buf) >= len) {
-      size_t      mylen;
-      const char *data = (const char *)ares_buf_peek(buf, &mylen);
-      if (!ares_str_isprint(data, len)) {
-        status = ARES_EBADSTR;
-        break;
-      }
+    if (len && validate_printable &&
+        !ares_str_isprint((const char *)data, len)) {
+      status = ARES_EBADSTR;
+      break;
     }
 
     if (strs != NULL) {
-      unsigned char *data = NULL;
-      if (len) {
-        status = ares_buf_fetch_bytes_dup(buf, len, ARES_TRUE, &data);
-        if (status != ARES_SUCCESS) {
-          break;
-        }
-      }
-      status = ares_dns_multistring_add_own(*strs, data, len);
-      if (status != ARES_SUCCESS) {
-        ares_free(data);
-        break;
-      }
-    } else {
-      status = ares_buf_consume(buf, len);
+      status = ares_dns_multistring_add(*strs, data, len);
       if (status != ARES_SUCCESS) {
         break;
       }
     }
 
+    status = ares_buf_consume(buf, len);
+    if (status != ARES_SUCCESS) {
+      break; /* LCOV_EXCL_LINE: DefensiveCoding */
+    }
   }
 
   if (status != ARES_SUCCESS && strs != NULL) {
@@ -34,11 +34,22 @@ typedef struct ares_dns_multistring ares_dns_multistring_t;
 ares_dns_multistring_t             *ares_dns_multistring_create(void);
 void          ares_dns_multistring_clear(ares_dns_multistring_t *strs);
 void          ares_dns_multistring_destroy(ares_dns_multistring_t *strs);
-ares_status_t ares_dns_multistring_swap_own(ares_dns_multistring_t *strs,
-                                            size_t idx, unsigned char *str,
-                                            size_t len);
 ares_status_t ares_dns_multistring_del(ares_dns_multistring_t *strs,
                                        size_t                  idx);
+
+/*! Append a copy of a string.  All strings share one backing buffer, so
+ *  pointers previously returned by ares_dns_multistring_get() or
+ *  ares_dns_multistring_combined() are invalidated by any modification.
+ *
+ *  \param[in] strs  Initialized multistring object
+ *  \param[in] str   String to copy, may be NULL if len is 0
+ *  \param[in] len   Length of str
+ *  \return ARES_SUCCESS on success
+ */
+ares_status_t ares_dns_multistring_add(ares_dns_multistring_t *strs,
+                                       const unsigned char *str, size_t len);
+
+/*! Same as ares_dns_multistring_add() but takes ownership of str on success */
 ares_status_t ares_dns_multistring_add_own(ares_dns_multistring_t *strs,
                                            unsigned char *str, size_t len);
 size_t        ares_dns_multistring_cnt(const ares_dns_multistring_t *strs);
@@ -925,12 +925,6 @@ ares_status_t ares_dns_rr_del_abin(ares_dns_rr_t *dns_rr, ares_dns_rr_key_t key,
 ares_status_t ares_dns_rr_add_abin(ares_dns_rr_t *dns_rr, ares_dns_rr_key_t key,
                                    const unsigned char *val, size_t len)
 {
-  ares_status_t       status;
-  ares_dns_datatype_t datatype = ares_dns_rr_key_datatype(key);
-  ares_bool_t         is_nullterm =
-    (datatype == ARES_DATATYPE_ABINP) ? ARES_TRUE : ARES_FALSE;
-  size_t                   alloclen = is_nullterm ? len + 1 : len;
-  unsigned char           *temp;
   ares_dns_multistring_t **strs;
 
   if (ares_dns_rr_key_datatype(key) != ARES_DATATYPE_ABINP) {
@@ -949,24 +943,8 @@ ares_status_t ares_dns_rr_add_abin(ares_dns_rr_t *dns_rr, ares_dns_rr_key_t key,
     }
   }
 
-  temp = ares_malloc(alloclen);
-  if (temp == NULL) {
-    return ARES_ENOMEM;
-  }
-
-  memcpy(temp, val, len);
-
-  /* NULL-term ABINP */
-  if (is_nullterm) {
-    temp[len] = 0;
-  }
-
-  status = ares_dns_multistring_add_own(*strs, temp, len);
-  if (status != ARES_SUCCESS) {
-    ares_free(temp);
-  }
-
-  return status;
+  /* Copied into the shared backing storage which is always NULL-terminated */
+  return ares_dns_multistring_add(*strs, val, len);
 }
 
 const char *ares_dns_rr_get_str(const ares_dns_rr_t *dns_rr,
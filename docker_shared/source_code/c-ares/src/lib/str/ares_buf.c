@@ -95,6 +95,16 @@ static ares_bool_t ares_buf_is_const(const ares_buf_t *buf)
   return ARES_FALSE;
 }
 
+/* Size of the already processed data at the start of the buffer that may be
+ * discarded, which stops at the tag if there is one */
+static size_t ares_buf_prefix_size(const ares_buf_t *buf)
+{
+  if (buf->tag_offset != SIZE_MAX && buf->tag_offset < buf->offset) {
+    return buf->tag_offset;
+  }
+  return buf->offset;
+}
+
 void ares_buf_reclaim(ares_buf_t *buf)
 {
   size_t prefix_size;
@@ -114,12 +124,7 @@ void ares_buf_reclaim(ares_buf_t *buf)
     return;
   }
 
-  if (buf->tag_offset != SIZE_MAX && buf->tag_offset < buf->offset) {
-    prefix_size = buf->tag_offset;
-  } else {
-    prefix_size = buf->offset;
-  }
-
+  prefix_size = ares_buf_prefix_size(buf);
   if (prefix_size == 0) {
     return;
   }
@@ -138,6 +143,7 @@ void ares_buf_reclaim(ares_buf_t *buf)
 static ares_status_t ares_buf_ensure_space(ares_buf_t *buf, size_t needed_size)
 {
   size_t         remaining_size;
+  size_t         prefix_size;
   size_t         alloc_size;
   unsigned char *ptr;
 
@@ -160,12 +166,19 @@ static ares_status_t ares_buf_ensure_space(ares_buf_t *buf, size_t needed_size)
     return ARES_SUCCESS;
   }
 
-  /* See if just moving consumed data frees up enough space */
-  ares_buf_reclaim(buf);
+  /* See if just moving consumed data frees up enough space.  That costs a
+   * copy of all the unprocessed data, so only do it once the consumed data is
+   * at least as large.  Otherwise a buffer that is consumed a little at a time
+   * while a lot remains, such as a busy TCP connection, would move the same
+   * data over and over; growing instead keeps each byte to roughly one move. */
+  prefix_size = ares_buf_prefix_size(buf);
+  if (prefix_size >= buf->data_len - prefix_size) {
+    ares_buf_reclaim(buf);
 
-  remaining_size = buf->alloc_buf_len - buf->data_len;
-  if (remaining_size >= needed_size) {
-    return ARES_SUCCESS;
+    remaining_size = buf->alloc_buf_len - buf->data_len;
+    if (remaining_size >= needed_size) {
+      return ARES_SUCCESS;
+    }
   }
 
   alloc_size = buf->alloc_buf_len;
@@ -508,12 +508,13 @@ static ares_status_t ares_iface_ips_enumerate(ares_iface_ips_t *ips,
       addr.family = AF_INET6;
       memcpy(&addr.addr.addr6, &sockaddr_in6->sin6_addr,
              sizeof(addr.addr.addr6));
-      /* netmask */
-      sockaddr_in6 = (struct sockaddr_in6 *)((void *)ifa->ifa_netmask);
-      netmask = count_addr_bits((const void *)&sockaddr_in6->sin6_addr, 16);
 #  ifdef HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID
+      /* The scope id belongs to the address, the netmask doesn't carry one */
       ll_scope = sockaddr_in6->sin6_scope_id;
 #  endif
+      /* netmask */
+      sockaddr_in6 = (struct sockaddr_in6 *)((void *)ifa->ifa_netmask);
+      netmask = count_addr_bits((const void *)&sockaddr_in6->sin6_addr, 16);
     } else {
       /* unknown */
       continue;
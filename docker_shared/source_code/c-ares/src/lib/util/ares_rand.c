@@ -37,20 +37,106 @@
 #  include <sys/random.h>
 #endif
 
+#if defined(CARES_THREADS) && !defined(_WIN32)
+#  include <pthread.h>
+#  define ARES_RAND_ATFORK
+#elif !defined(_WIN32) && defined(HAVE_UNISTD_H)
+#  include <unistd.h>
+#  define ARES_RAND_GETPID
+#endif
+
 
+/* All random data is produced by a ChaCha20 keystream generator using "fast
+ * key erasure": each refill generates a batch of keystream blocks, the first
+ * bytes of which immediately replace the key so prior output can never be
+ * reconstructed from the current state.  The backends below are only used to
+ * seed (and periodically reseed) the generator. */
 typedef enum {
-  ARES_RAND_OS   = 1 << 0, /* OS-provided such as RtlGenRandom or arc4random */
-  ARES_RAND_FILE = 1 << 1, /* OS file-backed random number generator */
-  ARES_RAND_RC4  = 1 << 2  /* Internal RC4 based PRNG */
+  ARES_RAND_OS       = 1 << 0, /* OS-provided such as RtlGenRandom or arc4random */
+  ARES_RAND_FILE     = 1 << 1, /* OS file-backed random number generator */
+  ARES_RAND_FALLBACK = 1 << 2  /* Internal time and address based seed */
 } ares_rand_backend;
 
-#define ARES_RC4_KEY_LEN 32 /* 256 bits */
+#define ARES_CHACHA20_KEY_LEN   32 /* 256 bits */
+#define ARES_CHACHA20_IV_LEN    8  /* 64 bits, the counter is the other 64 */
+#define ARES_CHACHA20_BLOCK_LEN 64
+#define ARES_CHACHA20_SEED_LEN  (ARES_CHACHA20_KEY_LEN + ARES_CHACHA20_IV_LEN)
+
+/* Number of keystream blocks generated per refill.  Every query pulls at
+ * least 2 bytes for its id, so 1kB of output (less the rekey) serves several
+ * hundred queries between refills. */
+#define ARES_RAND_CACHE_BLOCKS 16
+#define ARES_RAND_CACHE_LEN    (ARES_RAND_CACHE_BLOCKS * ARES_CHACHA20_BLOCK_LEN)
+
+/* Mix fresh entropy from the seed backend in after this much output */
+#define ARES_RAND_RESEED_LEN (1024 * 1024)
+
+typedef struct {
+  unsigned int input[16];
+} ares_rand_chacha20;
+
+struct ares_rand_state {
+  ares_rand_backend  type;
+  ares_rand_backend  bad_backends;
+  FILE              *rand_file;
+  ares_rand_chacha20 chacha;
+
+  /* Unserved keystream is kept at the end of the cache, bytes are zeroed once
+   * they have been handed out */
+  unsigned char      cache[ARES_RAND_CACHE_LEN];
+  size_t             cache_remaining;
+  size_t             reseed_remaining;
+
+  /* The generator state lives in process memory, so after fork() parent and
+   * child would hand out the same ids and ports.  This records the process
+   * the generator was last seeded in. */
+#ifdef ARES_RAND_ATFORK
+  unsigned int       fork_gen;
+#elif defined(ARES_RAND_GETPID)
+  pid_t              pid;
+#endif
+};
+
+#ifdef ARES_RAND_ATFORK
+/* Bumped in the child of every fork(), which is cheaper than calling getpid()
+ * for every id generated */
+static volatile unsigned int ares_rand_fork_gen   = 0;
+static pthread_once_t        ares_rand_atfork_reg = PTHREAD_ONCE_INIT;
+
+static void ares_rand_atfork_child(void)
+{
+  ares_rand_fork_gen++;
+}
 
-typedef struct ares_rand_rc4 {
-  unsigned char S[256];
-  size_t        i;
-  size_t        j;
-} ares_rand_rc4;
+static void ares_rand_atfork_register(void)
+{
+  pthread_atfork(NULL, NULL, ares_rand_atfork_child);
+}
+#endif
+
+/* Remember the current process, returns ARES_TRUE if it changed since the
+ * last call */
+static ares_bool_t ares_rand_update_process(ares_rand_state *state)
+{
+#ifdef ARES_RAND_ATFORK
+  unsigned int gen = ares_rand_fork_gen;
+  if (state->fork_gen == gen) {
+    return ARES_FALSE;
+  }
+  state->fork_gen = gen;
+  return ARES_TRUE;
+#elif defined(ARES_RAND_GETPID)
+  pid_t pid = getpid();
+  if (state->pid == pid) {
+    return ARES_FALSE;
+  }
+  state->pid = pid;
+  return ARES_TRUE;
+#else
+  (void)state;
+  return ARES_FALSE;
+#endif
+}
 
 static unsigned int ares_u32_from_ptr(void *addr)
 {
@@ -63,9 +149,9 @@ static unsigned int ares_u32_from_ptr(void *addr)
   /* LCOV_EXCL_STOP */
 }
 
-/* initialize an rc4 key as the last possible fallback. */
-static void ares_rc4_generate_key(ares_rand_rc4 *rc4_state, unsigned char *key,
-                                  size_t key_len)
+/* generate a seed as the last possible fallback. */
+static void ares_rand_fallback_seed(ares_rand_state *state, unsigned char *seed,
+                                    size_t seed_len)
 {
   /* LCOV_EXCL_START: FallbackCode */
   size_t         i;
@@ -73,112 +159,139 @@ static void ares_rc4_generate_key(ares_rand_rc4 *rc4_state, unsigned char *key,
   unsigned int   data;
   ares_timeval_t tv;
 
-  if (key_len != ARES_RC4_KEY_LEN) {
-    return;
-  }
-
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
   /* For fuzzing, random should be deterministic */
+  (void)state;
+  (void)data;
+  (void)tv;
   srand(0);
 #else
   /* Randomness is hard to come by.  Maybe the system randomizes heap and stack
    * addresses. Maybe the current timestamp give us some randomness. Use
-   * rc4_state (heap), &i (stack), and ares_tvnow()
+   * state (heap), &i (stack), and ares_tvnow()
    */
-  data = ares_u32_from_ptr(rc4_state);
-  memcpy(key + len, &data, sizeof(data));
+  data = ares_u32_from_ptr(state);
+  memcpy(seed + len, &data, sizeof(data));
   len += sizeof(data);
 
   data = ares_u32_from_ptr(&i);
-  memcpy(key + len, &data, sizeof(data));
+  memcpy(seed + len, &data, sizeof(data));
   len += sizeof(data);
 
   ares_tvnow(&tv);
   data = (unsigned int)((tv.sec ^ tv.usec) & 0xFFFFFFFF);
-  memcpy(key + len, &data, sizeof(data));
+  memcpy(seed + len, &data, sizeof(data));
   len += sizeof(data);
 
-  srand(ares_u32_from_ptr(rc4_state) ^ ares_u32_from_ptr(&i) ^
+  srand(ares_u32_from_ptr(state) ^ ares_u32_from_ptr(&i) ^
         (unsigned int)((tv.sec ^ tv.usec) & 0xFFFFFFFF));
 #endif
 
-  for (i = len; i < key_len; i++) {
-    key[i] = (unsigned char)(rand() % 256); /* LCOV_EXCL_LINE */
+  for (i = len; i < seed_len; i++) {
+    seed[i] = (unsigned char)(rand() % 256); /* LCOV_EXCL_LINE */
   }
   /* LCOV_EXCL_STOP */
 }
 
-#define ARES_SWAP_BYTE(a, b)           \
-  do {                                 \
-    unsigned char swapByte = *(a);     \
-    *(a)                   = *(b);     \
-    *(b)                   = swapByte; \
-  } while (0)
-
-static void ares_rc4_init(ares_rand_rc4 *rc4_state)
+static unsigned int ares_chacha20_u32le(const unsigned char *p)
 {
-  /* LCOV_EXCL_START: FallbackCode */
-  unsigned char key[ARES_RC4_KEY_LEN];
-  size_t        i;
-  size_t        j;
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+         ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
 
-  ares_rc4_generate_key(rc4_state, key, sizeof(key));
+/* Load a 256bit key and 64bit iv and reset the block counter, as per the
+ * original ChaCha construction */
+static void ares_chacha20_keysetup(ares_rand_chacha20  *ctx,
+                                   const unsigned char *seed)
+{
+  size_t i;
 
-  for (i = 0; i < sizeof(rc4_state->S); i++) {
-    rc4_state->S[i] = i & 0xFF;
-  }
+  /* "expand 32-byte k" */
+  ctx->input[0] = 0x61707865;
+  ctx->input[1] = 0x3320646e;
+  ctx->input[2] = 0x79622d32;
+  ctx->input[3] = 0x6b206574;
 
-  for (i = 0, j = 0; i < 256; i++) {
-    j = (j + rc4_state->S[i] + key[i % sizeof(key)]) % 256;
-    ARES_SWAP_BYTE(&rc4_state->S[i], &rc4_state->S[j]);
+  for (i = 0; i < 8; i++) {
+    ctx->input[4 + i] = ares_chacha20_u32le(seed + (i * 4));
   }
 
-  rc4_state->i = 0;
-  rc4_state->j = 0;
-  /* LCOV_EXCL_STOP */
+  ctx->input[12] = 0;
+  ctx->input[13] = 0;
+  ctx->input[14] = ares_chacha20_u32le(seed + ARES_CHACHA20_KEY_LEN);
+  ctx->input[15] = ares_chacha20_u32le(seed + ARES_CHACHA20_KEY_LEN + 4);
 }
 
-/* Just outputs the key schedule, no need to XOR with any data since we have
- * none */
-static void ares_rc4_prng(ares_rand_rc4 *rc4_state, unsigned char *buf,
-                          size_t len)
+#define ARES_CHACHA20_ROTL(v, n) \
+  ((((v) << (n)) | ((v) >> (32 - (n)))) & 0xFFFFFFFF)
+
+#define ARES_CHACHA20_QR(x, a, b, c, d)                    \
+  do {                                                     \
+    x[a] = (x[a] + x[b]) & 0xFFFFFFFF;                     \
+    x[d] = ARES_CHACHA20_ROTL(x[d] ^ x[a], 16);            \
+    x[c] = (x[c] + x[d]) & 0xFFFFFFFF;                     \
+    x[b] = ARES_CHACHA20_ROTL(x[b] ^ x[c], 12);            \
+    x[a] = (x[a] + x[b]) & 0xFFFFFFFF;                     \
+    x[d] = ARES_CHACHA20_ROTL(x[d] ^ x[a], 8);             \
+    x[c] = (x[c] + x[d]) & 0xFFFFFFFF;                     \
+    x[b] = ARES_CHACHA20_ROTL(x[b] ^ x[c], 7);             \
+  } while (0)
+
+/* Output nblocks consecutive keystream blocks.  Each block is independent of
+ * the others other than the counter, and the rounds operate on whole columns
+ * and diagonals at a time, which compilers are able to vectorize. */
+static void ares_chacha20_blocks(ares_rand_chacha20 *ctx, unsigned char *out,
+                                 size_t nblocks)
 {
-  /* LCOV_EXCL_START: FallbackCode */
-  unsigned char *S = rc4_state->S;
-  size_t         i = rc4_state->i;
-  size_t         j = rc4_state->j;
-  size_t         cnt;
+  unsigned int x[16];
+  size_t       blk;
+  size_t       i;
+
+  for (blk = 0; blk < nblocks; blk++) {
+    memcpy(x, ctx->input, sizeof(x));
+
+    /* 20 rounds, as 10 column + diagonal double rounds */
+    for (i = 0; i < 10; i++) {
+      ARES_CHACHA20_QR(x, 0, 4, 8, 12);
+      ARES_CHACHA20_QR(x, 1, 5, 9, 13);
+      ARES_CHACHA20_QR(x, 2, 6, 10, 14);
+      ARES_CHACHA20_QR(x, 3, 7, 11, 15);
+      ARES_CHACHA20_QR(x, 0, 5, 10, 15);
+      ARES_CHACHA20_QR(x, 1, 6, 11, 12);
+      ARES_CHACHA20_QR(x, 2, 7, 8, 13);
+      ARES_CHACHA20_QR(x, 3, 4, 9, 14);
+    }
 
-  for (cnt = 0; cnt < len; cnt++) {
-    i = (i + 1) % 256;
-    j = (j + S[i]) % 256;
+    for (i = 0; i < 16; i++) {
+      unsigned int v = (x[i] + ctx->input[i]) & 0xFFFFFFFF;
+      out[0]         = (unsigned char)(v & 0xFF);
+      out[1]         = (unsigned char)((v >> 8) & 0xFF);
+      out[2]         = (unsigned char)((v >> 16) & 0xFF);
+      out[3]         = (unsigned char)((v >> 24) & 0xFF);
+      out           += 4;
+    }
 
-    ARES_SWAP_BYTE(&S[i], &S[j]);
-    buf[cnt] = S[(S[i] + S[j]) % 256];
+    /* 64bit block counter */
+    ctx->input[12] = (ctx->input[12] + 1) & 0xFFFFFFFF;
+    if (ctx->input[12] == 0) {
+      ctx->input[13] = (ctx->input[13] + 1) & 0xFFFFFFFF; /* LCOV_EXCL_LINE */
+    }
   }
-
-  rc4_state->i = i;
-  rc4_state->j = j;
-  /* LCOV_EXCL_STOP */
 }
 
-struct ares_rand_state {
-  ares_rand_backend type;
-  ares_rand_backend bad_backends;
-
-  union {
-    FILE         *rand_file;
-    ares_rand_rc4 rc4;
-  } state;
-
-  /* Since except for RC4, random data will likely result in a syscall, lets
-   * pre-pull 256 bytes at a time.  Every query will pull 2 bytes off this so
-   * that means we should only need a syscall every 128 queries. 256bytes
-   * appears to be a sweet spot that may be able to be served without
-   * interruption */
-  unsigned char cache[256];
-  size_t        cache_remaining;
-};
+void ares_chacha20_keystream(const unsigned char *key, const unsigned char *iv,
+                             unsigned char *out, size_t nblocks)
+{
+  ares_rand_chacha20 ctx;
+  unsigned char      seed[ARES_CHACHA20_SEED_LEN];
+
+  memcpy(seed, key, ARES_CHACHA20_KEY_LEN);
+  memcpy(seed + ARES_CHACHA20_KEY_LEN, iv, ARES_CHACHA20_IV_LEN);
+  ares_chacha20_keysetup(&ctx, seed);
+  ares_chacha20_blocks(&ctx, out, nblocks);
+  memset(&ctx, 0, sizeof(ctx));
+  memset(seed, 0, sizeof(seed));
+}
 
 /* Define RtlGenRandom = SystemFunction036.  This is in advapi32.dll.  There is
  * no need to dynamically load this, other software used widely does not.
@@ -193,10 +306,8 @@ BOOLEAN WINAPI SystemFunction036(PVOID RandomBuffer, ULONG RandomBufferLength);
 #endif
 
 
-static ares_bool_t ares_init_rand_engine(ares_rand_state *state)
+static void ares_init_rand_engine(ares_rand_state *state)
 {
-  state->cache_remaining = 0;
-
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
   /* For fuzzing, random should be deterministic */
   state->bad_backends |= ARES_RAND_OS | ARES_RAND_FILE;
@@ -205,49 +316,26 @@ static ares_bool_t ares_init_rand_engine(ares_rand_state *state)
 #if defined(HAVE_ARC4RANDOM_BUF) || defined(HAVE_GETRANDOM) || defined(_WIN32)
   if (!(state->bad_backends & ARES_RAND_OS)) {
     state->type = ARES_RAND_OS;
-    return ARES_TRUE;
+    return;
   }
 #endif
 
 #if defined(CARES_RANDOM_FILE)
   /* LCOV_EXCL_START: FallbackCode */
   if (!(state->bad_backends & ARES_RAND_FILE)) {
-    state->type            = ARES_RAND_FILE;
-    state->state.rand_file = fopen(CARES_RANDOM_FILE, "rb");
-    if (state->state.rand_file) {
-      setvbuf(state->state.rand_file, NULL, _IONBF, 0);
-      return ARES_TRUE;
+    state->type      = ARES_RAND_FILE;
+    state->rand_file = fopen(CARES_RANDOM_FILE, "rb");
+    if (state->rand_file) {
+      setvbuf(state->rand_file, NULL, _IONBF, 0);
+      return;
     }
   }
   /* LCOV_EXCL_STOP */
 
-  /* Fall-Thru on failure to RC4 */
+  /* Fall-Thru on failure to internal seed */
 #endif
 
-  /* LCOV_EXCL_START: FallbackCode */
-  state->type = ARES_RAND_RC4;
-  ares_rc4_init(&state->state.rc4);
-  /* LCOV_EXCL_STOP */
-
-  /* Currently cannot fail */
-  return ARES_TRUE; /* LCOV_EXCL_LINE: UntestablePath */
-}
-
-ares_rand_state *ares_init_rand_state(void)
-{
-  ares_rand_state *state = NULL;
-
-  state = ares_malloc_zero(sizeof(*state));
-  if (!state) {
-    return NULL;
-  }
-
-  if (!ares_init_rand_engine(state)) {
-    ares_free(state); /* LCOV_EXCL_LINE: UntestablePath */
-    return NULL;      /* LCOV_EXCL_LINE: UntestablePath */
-  }
-
-  return state;
+  state->type = ARES_RAND_FALLBACK; /* LCOV_EXCL_LINE: FallbackCode */
 }
 
 static void ares_clear_rand_state(ares_rand_state *state)
@@ -261,9 +349,10 @@ static void ares_clear_rand_state(ares_rand_state *state)
       break;
     /* LCOV_EXCL_START: FallbackCode */
     case ARES_RAND_FILE:
-      fclose(state->state.rand_file);
+      fclose(state->rand_file);
+      state->rand_file = NULL;
       break;
-    case ARES_RAND_RC4:
+    case ARES_RAND_FALLBACK:
       break;
       /* LCOV_EXCL_STOP */
   }
@@ -277,18 +366,9 @@ static void ares_reinit_rand(ares_rand_state *state)
   /* LCOV_EXCL_STOP */
 }
 
-void ares_destroy_rand_state(ares_rand_state *state)
-{
-  if (!state) {
-    return;
-  }
-
-  ares_clear_rand_state(state);
-  ares_free(state);
-}
-
-static void ares_rand_bytes_fetch(ares_rand_state *state, unsigned char *buf,
-                                  size_t len)
+/* Fetch seed material from the best available backend */
+static void ares_rand_seed_fetch(ares_rand_state *state, unsigned char *buf,
+                                 size_t len)
 {
   while (1) {
     size_t bytes_read = 0;
@@ -332,8 +412,8 @@ static void ares_rand_bytes_fetch(ares_rand_state *state, unsigned char *buf,
 
       case ARES_RAND_FILE:
         while (1) {
-          size_t rv = fread(buf + bytes_read, 1, len - bytes_read,
-                            state->state.rand_file);
+          size_t rv =
+            fread(buf + bytes_read, 1, len - bytes_read, state->rand_file);
           if (rv == 0) {
             break; /* critical error, will reinit rand state */
           }
@@ -345,8 +425,8 @@ static void ares_rand_bytes_fetch(ares_rand_state *state, unsigned char *buf,
         }
         break;
 
-      case ARES_RAND_RC4:
-        ares_rc4_prng(&state->state.rc4, buf, len);
+      case ARES_RAND_FALLBACK:
+        ares_rand_fallback_seed(state, buf, len);
         return;
 
         /* LCOV_EXCL_STOP */
@@ -358,26 +438,109 @@ static void ares_rand_bytes_fetch(ares_rand_state *state, unsigned char *buf,
   }
 }
 
-void ares_rand_bytes(ares_rand_state *state, unsigned char *buf, size_t len)
+/* Generate a fresh batch of keystream into the cache and immediately replace
+ * the key with the first bytes of it.  If seed is provided it is mixed into
+ * the new key. */
+static void ares_rand_rekey(ares_rand_state *state, const unsigned char *seed)
 {
-  /* See if we need to refill the cache to serve the request, but if len is
-   * excessive, we're not going to update our cache or serve from cache */
-  if (len > state->cache_remaining && len < sizeof(state->cache)) {
-    size_t fetch_size = sizeof(state->cache) - state->cache_remaining;
-    ares_rand_bytes_fetch(state, state->cache, fetch_size);
-    state->cache_remaining = sizeof(state->cache);
+  size_t i;
+
+  ares_chacha20_blocks(&state->chacha, state->cache, ARES_RAND_CACHE_BLOCKS);
+
+  if (seed != NULL) {
+    for (i = 0; i < ARES_CHACHA20_SEED_LEN; i++) {
+      state->cache[i] ^= seed[i];
+    }
   }
 
-  /* Serve from cache */
-  if (len <= state->cache_remaining) {
-    size_t offset = sizeof(state->cache) - state->cache_remaining;
-    memcpy(buf, state->cache + offset, len);
-    state->cache_remaining -= len;
+  ares_chacha20_keysetup(&state->chacha, state->cache);
+  memset(state->cache, 0, ARES_CHACHA20_SEED_LEN);
+  state->cache_remaining = sizeof(state->cache) - ARES_CHACHA20_SEED_LEN;
+}
+
+/* Discard any unserved keystream and rekey with fresh seed material */
+static void ares_rand_reseed(ares_rand_state *state)
+{
+  unsigned char seed[ARES_CHACHA20_SEED_LEN];
+
+  ares_rand_seed_fetch(state, seed, sizeof(seed));
+  ares_rand_rekey(state, seed);
+  memset(seed, 0, sizeof(seed));
+  state->reseed_remaining = ARES_RAND_RESEED_LEN;
+}
+
+static void ares_rand_refill(ares_rand_state *state)
+{
+  if (state->reseed_remaining <= sizeof(state->cache)) {
+    ares_rand_reseed(state);
     return;
   }
 
-  /* Serve direct due to excess size of request */
-  ares_rand_bytes_fetch(state, buf, len);
+  ares_rand_rekey(state, NULL);
+  state->reseed_remaining -= sizeof(state->cache);
+}
+
+ares_rand_state *ares_init_rand_state(void)
+{
+  ares_rand_state *state = NULL;
+  unsigned char    seed[ARES_CHACHA20_SEED_LEN];
+
+  state = ares_malloc_zero(sizeof(*state));
+  if (!state) {
+    return NULL;
+  }
+
+#ifdef ARES_RAND_ATFORK
+  pthread_once(&ares_rand_atfork_reg, ares_rand_atfork_register);
+#endif
+  ares_rand_update_process(state);
+  ares_init_rand_engine(state);
+
+  ares_rand_seed_fetch(state, seed, sizeof(seed));
+  ares_chacha20_keysetup(&state->chacha, seed);
+  memset(seed, 0, sizeof(seed));
+
+  state->cache_remaining  = 0;
+  state->reseed_remaining = ARES_RAND_RESEED_LEN;
+
+  return state;
+}
+
+void ares_destroy_rand_state(ares_rand_state *state)
+{
+  if (!state) {
+    return;
+  }
+
+  ares_clear_rand_state(state);
+  memset(state, 0, sizeof(*state));
+  ares_free(state);
+}
+
+void ares_rand_bytes(ares_rand_state *state, unsigned char *buf, size_t len)
+{
+  if (ares_rand_update_process(state)) {
+    ares_rand_reseed(state);
+  }
+
+  while (len) {
+    size_t offset;
+    size_t n;
+
+    if (state->cache_remaining == 0) {
+      ares_rand_refill(state);
+    }
+
+    n = len < state->cache_remaining ? len : state->cache_remaining;
+
+    /* Serve from cache, erasing what is handed out */
+    offset = sizeof(state->cache) - state->cache_remaining;
+    memcpy(buf, state->cache + offset, n);
+    memset(state->cache + offset, 0, n);
+    state->cache_remaining -= n;
+    buf                    += n;
+    len                    -= n;
+  }
 }
 
 unsigned short ares_generate_new_id(ares_rand_state *state)
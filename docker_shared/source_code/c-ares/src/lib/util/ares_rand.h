@@ -33,4 +33,10 @@ ares_rand_state               *ares_init_rand_state(void);
 void                           ares_destroy_rand_state(ares_rand_state *state);
 void ares_rand_bytes(ares_rand_state *state, unsigned char *buf, size_t len);
 
+/* Raw ChaCha20 keystream for a 256bit key and 64bit iv, starting at block
+ * counter 0.  nblocks 64 byte blocks are written to out.  Only exposed for
+ * known-answer testing of the generator's cipher. */
+void ares_chacha20_keystream(const unsigned char *key, const unsigned char *iv,
+                             unsigned char *out, size_t nblocks);
+
 #endif
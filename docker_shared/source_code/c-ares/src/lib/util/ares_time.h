@@ -45,4 +45,9 @@ void        ares_timeval_remaining(ares_timeval_t       *remaining,
 void ares_timeval_diff(ares_timeval_t *tvdiff, const ares_timeval_t *tvstart,
                        const ares_timeval_t *tvstop);
 
+/* return true if at least millsecs have passed between tv and now */
+ares_bool_t ares_timeval_expired(const ares_timeval_t *tv,
+                                 const ares_timeval_t *now,
+                                 unsigned long         millsecs);
+
 #endif
@@ -91,6 +91,7 @@ typedef struct {
   ares_bool_t    display_authority;
   ares_bool_t    display_additional;
   ares_bool_t    display_comments;
+  ares_bool_t    trace;
 } dns_options_t;
 
 typedef struct {
@@ -180,6 +181,8 @@ static const char   *helpstr[] = {
   "+[no]stats:       Toggles printing the statistics. On by default.",
   "+[no]tcp:         Whether to use TCP when querying name servers. Default is",
   "                  UDP.",
+  "+[no]trace:       Print the query lifecycle trace after completion. Off by",
+  "                  default.  Requires c-ares built with tracing support.",
   "+tries=#:         Number of query tries. Defaults to 3.",
   "+[no]ttlid:       Display the TTL when printing the record. On by default.",
   "+[no]vc:          Alias for +[no]tcp",
@@ -916,6 +919,36 @@ static int event_loop(ares_channel_t *channel)
   return 0;
 }
 
+static void print_trace(ares_channel_t *channel)
+{
+  ares_trace_event_t events[64];
+  size_t             num_events;
+  size_t             dropped;
+  size_t             i;
+
+  printf(";; QUERY TRACE:\n");
+  do {
+    if (ares_trace_fetch(channel, events, sizeof(events) / sizeof(*events),
+                         &num_events, &dropped) != ARES_SUCCESS) {
+      break;
+    }
+    if (dropped) {
+      printf(";; %u events dropped\n", (unsigned int)dropped);
+    }
+    for (i = 0; i < num_events; i++) {
+      const ares_trace_event_t *ev = &events[i];
+      printf(";; %u.%06u %-14s qid=0x%04X", ev->sec, ev->usec,
+             ares_trace_event_type_tostr(ev->type), (unsigned int)ev->qid);
+      if (ev->server != ARES_TRACE_NOSERVER) {
+        printf(" server=%u", (unsigned int)ev->server);
+      }
+      printf(" value=%lu status=%s\n", (unsigned long)ev->value,
+             ares_strerror((int)ev->status));
+    }
+  } while (num_events > 0);
+  printf("\n");
+}
+
 typedef enum {
   OPT_TYPE_BOOL,
   OPT_TYPE_STRING,
@@ -1137,6 +1170,7 @@ static const struct {
   { '+', "search",     0,   OPT_TYPE_BOOL,   &global_config.opts.do_search,          NULL            },
   { '+', "stats",      0,   OPT_TYPE_BOOL,   &global_config.opts.display_stats,      NULL            },
   { '+', "tcp",        0,   OPT_TYPE_BOOL,   &global_config.opts.tcp,                NULL            },
+  { '+', "trace",      0,   OPT_TYPE_BOOL,   &global_config.opts.trace,              NULL            },
   { '+', "tries",      '=', OPT_TYPE_SIZE_T, &global_config.opts.tries,              NULL            },
   { '+', "ttlid",      0,   OPT_TYPE_BOOL,   &global_config.opts.display_ttl,        NULL            },
   { '+', "vc",         0,   OPT_TYPE_BOOL,   &global_config.opts.tcp,                NULL            },
@@ -1553,6 +1587,15 @@ int main(int argc, char **argv)
     }
   }
 
+  if (global_config.opts.trace) {
+    status = ares_set_trace(channel, 1024, NULL, NULL);
+    if (status != ARES_SUCCESS) {
+      fprintf(stderr, "ares_set_trace: %s\n", ares_strerror((int)status));
+      final_rv = RV_MISUSE;
+      goto done;
+    }
+  }
+
   /* Debug */
   if (global_config.opts.display_command) {
     printf("\n; <<>> c-ares DiG %s <<>>", ares_version(NULL));
@@ -1574,6 +1617,10 @@ int main(int argc, char **argv)
     final_rv = RV_SYSERR;
   }
 
+  if (global_config.opts.trace) {
+    print_trace(channel);
+  }
+
 done:
   free_config();
   ares_destroy(channel);
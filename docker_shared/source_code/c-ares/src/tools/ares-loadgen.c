@@ -0,0 +1,630 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Open-loop load generator.  Queries are scheduled at fixed intervals derived
+ * from the target rate regardless of how many are still outstanding, and
+ * latency is measured from the scheduled send time rather than the actual
+ * one, so a stalled client shows up as latency instead of silently lowering
+ * the offered load.
+ *
+ * Sockets are serviced by the channel's event thread, which isn't limited to
+ * FD_SETSIZE sockets the way select() is.  Callbacks are always invoked with
+ * the channel lock held, so the result counters they update need no further
+ * locking, and the sending side only touches its own counters. */
+
+#include "ares_setup.h"
+
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+#endif
+#include <time.h>
+#include <signal.h>
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+
+#include "ares.h"
+#include "ares_array.h"
+#include "ares_getopt.h"
+#include "ares_mem.h"
+#include "ares_str.h"
+
+#define RV_OK     0 /* Success */
+#define RV_SYSERR 1 /* Internal system failure */
+#define RV_MISUSE 2 /* Misuse (command line) */
+
+#define MAX_SERVERS 32
+
+typedef struct {
+  char  *name;
+  size_t success;
+  size_t failure;
+} loadgen_server_t;
+
+typedef struct {
+  /* Configuration */
+  unsigned int         qps;
+  unsigned int         duration;
+  size_t               max_queries;
+  ares_dns_rec_type_t  qtype;
+  char               **names;
+  ares_dns_rec_type_t *types;
+  size_t               num_names;
+
+  /* Runtime state */
+  double               start_ms;
+  size_t               sent;
+  size_t               send_failed;
+  size_t               max_outstanding;
+  double               max_lag_ms;
+
+  /* Results */
+  size_t               completed;
+  size_t               status_cnt[ARES_ENOSERVER + 1];
+  size_t               retried;
+  size_t               timeouts;
+  ares_array_t        *latencies;
+  loadgen_server_t     servers[MAX_SERVERS];
+  size_t               num_servers;
+} loadgen_t;
+
+typedef struct {
+  loadgen_t *lg;
+  double     sched_ms;
+} loadgen_query_t;
+
+static volatile sig_atomic_t is_running = 1;
+
+static void sig_handler(int sig)
+{
+  (void)sig;
+  is_running = 0;
+}
+
+static double now_ms(void)
+{
+#if defined(_WIN32) && !defined(MSDOS)
+  LARGE_INTEGER freq;
+  LARGE_INTEGER current;
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&current);
+  return (double)current.QuadPart * 1000.0 / (double)freq.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec * 1000.0 + (double)tv.tv_usec / 1000.0;
+#endif
+}
+
+static void usage(void)
+{
+  fprintf(
+    stderr,
+    "usage: ares-loadgen [-h] [-q qps] [-d seconds] [-n count] [-s servers]\n"
+    "                    [-t type] [-T timeout_ms] [-r tries] [-c] [-u]\n"
+    "                    -f file\n\n");
+  fprintf(
+    stderr,
+    "  -f file:       File of names to query, one per line, optionally\n"
+    "                 followed by a record type.  Use - for stdin.\n"
+    "  -q qps:        Target queries per second.  Default 100.\n"
+    "  -d seconds:    Duration to send queries for.  Default 10.\n"
+    "  -n count:      Stop after sending count queries.\n"
+    "  -s servers:    Servers to query, in ares_set_servers_ports_csv()\n"
+    "                 format.  Default is the system configuration.\n"
+    "  -t type:       Default record type.  Default A.\n");
+  fprintf(
+    stderr,
+    "  -T timeout_ms: Initial query timeout in milliseconds.\n"
+    "  -r tries:      Number of tries per server.\n"
+    "  -c:            Enable the query cache.  Disabled by default so every\n"
+    "                 query reaches a server.\n"
+    "  -u:            Rotate between servers rather than preferring the first\n"
+    "  -h:            Display this help\n");
+}
+
+static ares_bool_t read_names(loadgen_t *lg, const char *filename)
+{
+  FILE  *fp;
+  char   line[512];
+  size_t alloc = 0;
+
+  if (ares_streq(filename, "-")) {
+    fp = stdin;
+  } else {
+    fp = fopen(filename, "r");
+  }
+  if (fp == NULL) {
+    fprintf(stderr, "unable to open %s\n", filename);
+    return ARES_FALSE;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char               *name = line;
+    char               *type;
+    ares_dns_rec_type_t qtype = lg->qtype;
+
+    while (ares_isspace(*name)) {
+      name++;
+    }
+    if (*name == 0 || *name == '#') {
+      continue;
+    }
+
+    type = name;
+    while (*type != 0 && !ares_isspace(*type)) {
+      type++;
+    }
+    if (*type != 0) {
+      *type = 0;
+      type++;
+      ares_str_trim(type);
+      if (*type != 0 && !ares_dns_rec_type_fromstr(&qtype, type)) {
+        fprintf(stderr, "unrecognized record type %s for %s\n", type, name);
+        continue;
+      }
+    }
+
+    if (lg->num_names == alloc) {
+      char               **names;
+      ares_dns_rec_type_t *types;
+
+      alloc = alloc ? alloc * 2 : 64;
+      names = realloc(lg->names, alloc * sizeof(*lg->names));
+      if (names == NULL) {
+        goto nomem;
+      }
+      lg->names = names;
+      types     = realloc(lg->types, alloc * sizeof(*lg->types));
+      if (types == NULL) {
+        goto nomem;
+      }
+      lg->types = types;
+    }
+    lg->names[lg->num_names] = strdup(name);
+    if (lg->names[lg->num_names] == NULL) {
+      goto nomem;
+    }
+    lg->types[lg->num_names] = qtype;
+    lg->num_names++;
+  }
+
+  if (fp != stdin) {
+    fclose(fp);
+  }
+
+  if (lg->num_names == 0) {
+    fprintf(stderr, "no names to query in %s\n", filename);
+    return ARES_FALSE;
+  }
+  return ARES_TRUE;
+
+nomem:
+  fprintf(stderr, "out of memory\n");
+  if (fp != stdin) {
+    fclose(fp);
+  }
+  return ARES_FALSE;
+}
+
+static void server_state_cb(const char *server_string, ares_bool_t success,
+                            int flags, void *data)
+{
+  loadgen_t *lg = data;
+  size_t     i;
+
+  (void)flags;
+
+  for (i = 0; i < lg->num_servers; i++) {
+    if (ares_streq(lg->servers[i].name, server_string)) {
+      break;
+    }
+  }
+
+  if (i == lg->num_servers) {
+    if (lg->num_servers == MAX_SERVERS) {
+      return;
+    }
+    lg->servers[i].name = strdup(server_string);
+    lg->num_servers++;
+  }
+
+  if (success) {
+    lg->servers[i].success++;
+  } else {
+    lg->servers[i].failure++;
+  }
+}
+
+static void query_cb(void *arg, ares_status_t status, size_t timeouts,
+                     const ares_dns_record_t *dnsrec)
+{
+  loadgen_query_t *q  = arg;
+  loadgen_t       *lg = q->lg;
+  double           latency_ms;
+  unsigned int     latency_us;
+
+  (void)dnsrec;
+
+  latency_ms = now_ms() - q->sched_ms;
+  latency_us = latency_ms > 4294967.0 ? 0xFFFFFFFF
+                                      : (unsigned int)(latency_ms * 1000.0);
+
+  lg->completed++;
+  lg->timeouts += timeouts;
+  if (timeouts > 0) {
+    lg->retried++;
+  }
+  if ((size_t)status < sizeof(lg->status_cnt) / sizeof(*lg->status_cnt)) {
+    lg->status_cnt[status]++;
+  }
+
+  /* Only successful answers contribute to the latency distribution, failures
+   * are reported by status */
+  if (status == ARES_SUCCESS || status == ARES_ENOTFOUND ||
+      status == ARES_ENODATA) {
+    ares_array_insertdata_last(lg->latencies, &latency_us);
+  }
+
+  free(q);
+}
+
+static void send_query(ares_channel_t *channel, loadgen_t *lg, double sched)
+{
+  loadgen_query_t *q   = malloc(sizeof(*q));
+  size_t           idx = lg->sent % lg->num_names;
+  ares_status_t    status;
+
+  lg->sent++;
+
+  if (q == NULL) {
+    lg->send_failed++;
+    return;
+  }
+  q->lg       = lg;
+  q->sched_ms = sched;
+
+  /* On failure the callback has already been called */
+  status = ares_query_dnsrec(channel, lg->names[idx], ARES_CLASS_IN,
+                             lg->types[idx], query_cb, q, NULL);
+  if (status != ARES_SUCCESS) {
+    lg->send_failed++;
+  }
+
+  if (ares_queue_active_queries(channel) > lg->max_outstanding) {
+    lg->max_outstanding = ares_queue_active_queries(channel);
+  }
+}
+
+static ares_bool_t sending_done(const loadgen_t *lg, double now)
+{
+  if (!is_running) {
+    return ARES_TRUE;
+  }
+  if (lg->max_queries && lg->sent >= lg->max_queries) {
+    return ARES_TRUE;
+  }
+  return (now - lg->start_ms) >= (double)lg->duration * 1000.0 ? ARES_TRUE
+                                                                : ARES_FALSE;
+}
+
+static void sleep_ms(double ms)
+{
+#ifdef _WIN32
+  Sleep((DWORD)ms);
+#else
+  struct timespec ts;
+
+  ts.tv_sec  = (time_t)(ms / 1000.0);
+  ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1000000.0);
+  nanosleep(&ts, NULL);
+#endif
+}
+
+static void send_loop(ares_channel_t *channel, loadgen_t *lg)
+{
+  double interval_ms = 1000.0 / (double)lg->qps;
+  double next_ms;
+
+  lg->start_ms = now_ms();
+  next_ms      = lg->start_ms;
+
+  while (1) {
+    double      now  = now_ms();
+    ares_bool_t done = sending_done(lg, now);
+
+    /* Send everything that is due.  If we fell behind, catch up rather than
+     * skip so the offered load matches the target. */
+    while (!done && next_ms <= now) {
+      if (now - next_ms > lg->max_lag_ms) {
+        lg->max_lag_ms = now - next_ms;
+      }
+      send_query(channel, lg, next_ms);
+      next_ms += interval_ms;
+      done     = sending_done(lg, now);
+    }
+
+    if (done) {
+      break;
+    }
+
+    now = now_ms();
+    if (next_ms > now) {
+      sleep_ms(next_ms - now);
+    }
+  }
+
+  /* Let everything outstanding complete */
+  ares_queue_wait_empty(channel, -1);
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *)a;
+  unsigned int y = *(const unsigned int *)b;
+
+  if (x < y) {
+    return -1;
+  }
+  if (x > y) {
+    return 1;
+  }
+  return 0;
+}
+
+static double pctl_ms(const unsigned int *vals, size_t cnt, double pctl)
+{
+  size_t idx;
+
+  if (cnt == 0) {
+    return 0;
+  }
+  idx = (size_t)((pctl / 100.0) * (double)cnt);
+  if (idx >= cnt) {
+    idx = cnt - 1;
+  }
+  return (double)vals[idx] / 1000.0;
+}
+
+static void report(loadgen_t *lg, double elapsed_ms)
+{
+  unsigned int *lat;
+  size_t        cnt = 0;
+  size_t        i;
+  double        sum = 0;
+
+  lat = ares_array_finish(lg->latencies, &cnt);
+  lg->latencies = NULL;
+  if (cnt) {
+    qsort(lat, cnt, sizeof(*lat), cmp_uint);
+  }
+  for (i = 0; i < cnt; i++) {
+    sum += (double)lat[i];
+  }
+
+  printf(";; Sent %u queries in %.3fs (target %u qps, achieved %.1f qps)\n",
+         (unsigned int)lg->sent, elapsed_ms / 1000.0, lg->qps,
+         elapsed_ms > 0 ? (double)lg->sent * 1000.0 / elapsed_ms : 0.0);
+  printf(";; Completed %u queries (%.1f qps), %u failed to send\n",
+         (unsigned int)lg->completed,
+         elapsed_ms > 0 ? (double)lg->completed * 1000.0 / elapsed_ms : 0.0,
+         (unsigned int)lg->send_failed);
+  printf(";; Max outstanding %u, max send lag %.3fms\n",
+         (unsigned int)lg->max_outstanding, lg->max_lag_ms);
+
+  printf("\n;; STATUS:\n");
+  for (i = 0; i < sizeof(lg->status_cnt) / sizeof(*lg->status_cnt); i++) {
+    if (lg->status_cnt[i] == 0) {
+      continue;
+    }
+    printf(";;   %-30s %u\n", ares_strerror((int)i),
+           (unsigned int)lg->status_cnt[i]);
+  }
+
+  printf("\n;; LATENCY (ms, from scheduled send time, %u answers):\n",
+         (unsigned int)cnt);
+  if (cnt) {
+    printf(";;   min %.3f  avg %.3f  max %.3f\n", (double)lat[0] / 1000.0,
+           sum / (double)cnt / 1000.0, (double)lat[cnt - 1] / 1000.0);
+    printf(";;   p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f\n",
+           pctl_ms(lat, cnt, 50), pctl_ms(lat, cnt, 90),
+           pctl_ms(lat, cnt, 99), pctl_ms(lat, cnt, 99.9));
+  }
+
+  printf("\n;; RETRIES:\n");
+  printf(";;   %u timeouts, %u queries retried after a timeout\n",
+         (unsigned int)lg->timeouts, (unsigned int)lg->retried);
+
+  printf("\n;; SERVERS (successful / failed responses):\n");
+  for (i = 0; i < lg->num_servers; i++) {
+    printf(";;   %-40s %u / %u\n", lg->servers[i].name,
+           (unsigned int)lg->servers[i].success,
+           (unsigned int)lg->servers[i].failure);
+  }
+
+  ares_free(lat);
+}
+
+int main(int argc, char **argv)
+{
+  loadgen_t           lg;
+  struct ares_options options;
+  int                 optmask  = ARES_OPT_QUERY_CACHE;
+  ares_channel_t     *channel  = NULL;
+  ares_getopt_state_t state;
+  const char         *filename = NULL;
+  char               *servers  = NULL;
+  int                 rv       = RV_OK;
+  int                 c;
+  size_t              i;
+  ares_status_t       status;
+
+#ifdef USE_WINSOCK
+  WORD    wVersionRequested = MAKEWORD(USE_WINSOCK, USE_WINSOCK);
+  WSADATA wsaData;
+  WSAStartup(wVersionRequested, &wsaData);
+#endif
+
+  memset(&lg, 0, sizeof(lg));
+  memset(&options, 0, sizeof(options));
+  lg.qps                 = 100;
+  lg.duration            = 10;
+  lg.qtype               = ARES_REC_TYPE_A;
+  options.qcache_max_ttl = 0;
+  options.evsys          = ARES_EVSYS_DEFAULT;
+  optmask               |= ARES_OPT_EVENT_THREAD;
+
+  status = (ares_status_t)ares_library_init(ARES_LIB_INIT_ALL);
+  if (status != ARES_SUCCESS) {
+    fprintf(stderr, "ares_library_init: %s\n", ares_strerror((int)status));
+    return RV_SYSERR;
+  }
+
+  ares_getopt_init(&state, argc, (const char * const *)argv);
+  while ((c = ares_getopt(&state, "f:q:d:n:s:t:T:r:cuh")) != -1) {
+    switch (c) {
+      case 'f':
+        filename = state.optarg;
+        break;
+      case 'q':
+        lg.qps = (unsigned int)strtoul(state.optarg, NULL, 10);
+        break;
+      case 'd':
+        lg.duration = (unsigned int)strtoul(state.optarg, NULL, 10);
+        break;
+      case 'n':
+        lg.max_queries = (size_t)strtoul(state.optarg, NULL, 10);
+        break;
+      case 's':
+        free(servers);
+        servers = strdup(state.optarg);
+        break;
+      case 't':
+        if (!ares_dns_rec_type_fromstr(&lg.qtype, state.optarg)) {
+          fprintf(stderr, "unrecognized record type %s\n", state.optarg);
+          rv = RV_MISUSE;
+          goto done;
+        }
+        break;
+      case 'T':
+        optmask         |= ARES_OPT_TIMEOUTMS;
+        options.timeout  = (int)strtoul(state.optarg, NULL, 10);
+        break;
+      case 'r':
+        optmask       |= ARES_OPT_TRIES;
+        options.tries  = (int)strtoul(state.optarg, NULL, 10);
+        break;
+      case 'c':
+        optmask &= ~ARES_OPT_QUERY_CACHE;
+        break;
+      case 'u':
+        optmask |= ARES_OPT_ROTATE;
+        break;
+      case 'h':
+      default:
+        usage();
+        rv = c == 'h' ? RV_OK : RV_MISUSE;
+        goto done;
+    }
+  }
+
+  if (filename == NULL || lg.qps == 0) {
+    usage();
+    rv = RV_MISUSE;
+    goto done;
+  }
+
+  if (!ares_threadsafety()) {
+    fprintf(stderr, "c-ares must be built with thread safety\n");
+    rv = RV_SYSERR;
+    goto done;
+  }
+
+  if (!read_names(&lg, filename)) {
+    rv = RV_MISUSE;
+    goto done;
+  }
+
+  lg.latencies = ares_array_create(sizeof(unsigned int), NULL);
+  if (lg.latencies == NULL) {
+    rv = RV_SYSERR;
+    goto done;
+  }
+
+  status = (ares_status_t)ares_init_options(&channel, &options, optmask);
+  if (status != ARES_SUCCESS) {
+    fprintf(stderr, "ares_init_options: %s\n", ares_strerror((int)status));
+    rv = RV_SYSERR;
+    goto done;
+  }
+
+  if (servers != NULL) {
+    status = (ares_status_t)ares_set_servers_ports_csv(channel, servers);
+    if (status != ARES_SUCCESS) {
+      fprintf(stderr, "ares_set_servers_ports_csv: %s: %s\n",
+              ares_strerror((int)status), servers);
+      rv = RV_MISUSE;
+      goto done;
+    }
+  }
+
+  ares_set_server_state_callback(channel, server_state_cb, &lg);
+
+  signal(SIGINT, sig_handler);
+
+  send_loop(channel, &lg);
+
+  report(&lg, now_ms() - lg.start_ms);
+
+done:
+  ares_destroy(channel);
+  ares_array_destroy(lg.latencies);
+  for (i = 0; i < lg.num_names; i++) {
+    free(lg.names[i]);
+  }
+  free(lg.names);
+  free(lg.types);
+  for (i = 0; i < lg.num_servers; i++) {
+    free(lg.servers[i].name);
+  }
+  free(servers);
+  ares_library_cleanup();
+
+#ifdef USE_WINSOCK
+  WSACleanup();
+#endif
+  return rv;
+}
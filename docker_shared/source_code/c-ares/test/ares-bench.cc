@@ -0,0 +1,596 @@
+/* MIT License
+ *
+ * Copyright (c) The c-ares project and its contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Micro-benchmarks for c-ares internals, plus an end-to-end throughput
+ * benchmark against the mock server over loopback.  All inputs are generated
+ * deterministically so results are comparable between runs.  Run with
+ * --benchmark_filter=<regex> to select benchmarks. */
+
+#include "ares-test.h"
+#include "dns-proto.h"
+
+#include <benchmark/benchmark.h>
+
+#include <signal.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+// Remove command-line defines of package variables for the test project...
+#undef PACKAGE_NAME
+#undef PACKAGE_BUGREPORT
+#undef PACKAGE_STRING
+#undef PACKAGE_TARNAME
+// ... so we can include the library's config without symbol redefinitions.
+#include "ares_private.h"
+#include "dsa/ares_slist.h"
+}
+
+namespace ares {
+namespace test {
+
+/* Simple LCG so key sequences are identical on every run and platform */
+static unsigned int bench_rand(unsigned int *state)
+{
+  *state = *state * 1103515245U + 12345U;
+  return (*state >> 16) & 0x7FFF;
+}
+
+/* Build a response for www.example.com with the requested number of A
+ * records in the answer section */
+static ares_dns_record_t *bench_response(size_t num_answers)
+{
+  ares_dns_record_t *dnsrec = NULL;
+
+  ares_dns_record_create(&dnsrec, 0x1234, ARES_FLAG_QR | ARES_FLAG_RD |
+                                            ARES_FLAG_RA,
+                         ARES_OPCODE_QUERY, ARES_RCODE_NOERROR);
+  ares_dns_record_query_add(dnsrec, "www.example.com", ARES_REC_TYPE_A,
+                            ARES_CLASS_IN);
+  for (size_t i = 0; i < num_answers; i++) {
+    ares_dns_rr_t *rr = NULL;
+    struct in_addr addr;
+
+    addr.s_addr = htonl(0xC0000200 | (unsigned int)(i & 0xFF));
+    ares_dns_record_rr_add(&rr, dnsrec, ARES_SECTION_ANSWER,
+                           "www.example.com", ARES_REC_TYPE_A, ARES_CLASS_IN,
+                           300);
+    ares_dns_rr_set_addr(rr, ARES_RR_A_ADDR, &addr);
+  }
+  return dnsrec;
+}
+
+static void BM_DnsParse(benchmark::State &state)
+{
+  ares_dns_record_t *dnsrec = bench_response((size_t)state.range(0));
+  unsigned char     *msg    = NULL;
+  size_t             msglen = 0;
+
+  ares_dns_write(dnsrec, &msg, &msglen);
+  ares_dns_record_destroy(dnsrec);
+
+  for (auto _ : state) {
+    ares_dns_record_t *parsed = NULL;
+    if (ares_dns_parse(msg, msglen, 0, &parsed) != ARES_SUCCESS) {
+      state.SkipWithError("ares_dns_parse failed");
+      break;
+    }
+    ares_dns_record_destroy(parsed);
+  }
+
+  state.SetBytesProcessed((int64_t)(state.iterations() * msglen));
+  ares_free_string(msg);
+}
+BENCHMARK(BM_DnsParse)->Arg(1)->Arg(8)->Arg(64);
+
+/* A TXT answer split into the requested number of 255-byte strings, as
+ * large SPF and DKIM records are */
+static void BM_DnsParseTxt(benchmark::State &state)
+{
+  ares_dns_record_t *dnsrec = NULL;
+  ares_dns_rr_t     *rr     = NULL;
+  unsigned char     *msg    = NULL;
+  size_t             msglen = 0;
+  std::string        chunk(255, 'k');
+
+  ares_dns_record_create(&dnsrec, 0x1234, ARES_FLAG_QR | ARES_FLAG_RD |
+                                            ARES_FLAG_RA,
+                         ARES_OPCODE_QUERY, ARES_RCODE_NOERROR);
+  ares_dns_record_query_add(dnsrec, "example.com", ARES_REC_TYPE_TXT,
+                            ARES_CLASS_IN);
+  ares_dns_record_rr_add(&rr, dnsrec, ARES_SECTION_ANSWER, "example.com",
+                         ARES_REC_TYPE_TXT, ARES_CLASS_IN, 300);
+  for (int i = 0; i < state.range(0); i++) {
+    ares_dns_rr_add_abin(rr, ARES_RR_TXT_DATA,
+                         (const unsigned char *)chunk.data(), chunk.size());
+  }
+  ares_dns_write(dnsrec, &msg, &msglen);
+  ares_dns_record_destroy(dnsrec);
+
+  for (auto _ : state) {
+    ares_dns_record_t *parsed = NULL;
+    if (ares_dns_parse(msg, msglen, 0, &parsed) != ARES_SUCCESS) {
+      state.SkipWithError("ares_dns_parse failed");
+      break;
+    }
+    ares_dns_record_destroy(parsed);
+  }
+
+  state.SetBytesProcessed((int64_t)(state.iterations() * msglen));
+  ares_free_string(msg);
+}
+BENCHMARK(BM_DnsParseTxt)->Arg(1)->Arg(16);
+
+static void BM_DnsWrite(benchmark::State &state)
+{
+  ares_dns_record_t *dnsrec = bench_response((size_t)state.range(0));
+  size_t             total  = 0;
+
+  for (auto _ : state) {
+    unsigned char *msg    = NULL;
+    size_t         msglen = 0;
+    if (ares_dns_write(dnsrec, &msg, &msglen) != ARES_SUCCESS) {
+      state.SkipWithError("ares_dns_write failed");
+      break;
+    }
+    total += msglen;
+    ares_free_string(msg);
+  }
+
+  state.SetBytesProcessed((int64_t)total);
+  ares_dns_record_destroy(dnsrec);
+}
+BENCHMARK(BM_DnsWrite)->Arg(1)->Arg(8)->Arg(64);
+
+/* Every record type: name <-> type, then each key's name and datatype, the
+ * same lookups the parser, writer and qcache key builder do per RR */
+static void BM_RrTypeMapping(benchmark::State &state)
+{
+  static const ares_dns_rec_type_t types[] = {
+    ARES_REC_TYPE_A,     ARES_REC_TYPE_NS,    ARES_REC_TYPE_CNAME,
+    ARES_REC_TYPE_SOA,   ARES_REC_TYPE_PTR,   ARES_REC_TYPE_HINFO,
+    ARES_REC_TYPE_MX,    ARES_REC_TYPE_TXT,   ARES_REC_TYPE_SIG,
+    ARES_REC_TYPE_AAAA,  ARES_REC_TYPE_SRV,   ARES_REC_TYPE_NAPTR,
+    ARES_REC_TYPE_OPT,   ARES_REC_TYPE_TLSA,  ARES_REC_TYPE_SVCB,
+    ARES_REC_TYPE_HTTPS, ARES_REC_TYPE_ANY,   ARES_REC_TYPE_URI,
+    ARES_REC_TYPE_CAA,   ARES_REC_TYPE_RAW_RR
+  };
+  size_t lookups = 0;
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < sizeof(types) / sizeof(*types); i++) {
+      ares_dns_rec_type_t      type = types[i];
+      size_t                   cnt  = 0;
+      const ares_dns_rr_key_t *keys;
+
+      benchmark::DoNotOptimize(ares_dns_rec_type_fromstr(
+        &type, ares_dns_rec_type_tostr(types[i])));
+      benchmark::DoNotOptimize(ares_dns_rec_type_isvalid(type, ARES_FALSE));
+      benchmark::DoNotOptimize(ares_dns_rec_allow_name_comp(type));
+      keys = ares_dns_rr_get_keys(type, &cnt);
+      for (size_t j = 0; j < cnt; j++) {
+        benchmark::DoNotOptimize(ares_dns_rr_key_tostr(keys[j]));
+        benchmark::DoNotOptimize(ares_dns_rr_key_datatype(keys[j]));
+        benchmark::DoNotOptimize(ares_dns_rr_key_to_rec_type(keys[j]));
+      }
+      lookups += 4 + (cnt * 3);
+    }
+  }
+
+  state.SetItemsProcessed((int64_t)lookups);
+}
+BENCHMARK(BM_RrTypeMapping);
+
+static void BM_BufAppendFetch(benchmark::State &state)
+{
+  const size_t count = (size_t)state.range(0);
+
+  for (auto _ : state) {
+    ares_buf_t    *buf = ares_buf_create();
+    unsigned short u16;
+    unsigned int   u32;
+
+    for (size_t i = 0; i < count; i++) {
+      ares_buf_append_be16(buf, (unsigned short)i);
+      ares_buf_append_be32(buf, (unsigned int)i);
+    }
+    for (size_t i = 0; i < count; i++) {
+      ares_buf_fetch_be16(buf, &u16);
+      ares_buf_fetch_be32(buf, &u32);
+    }
+    benchmark::DoNotOptimize(u32);
+    ares_buf_destroy(buf);
+  }
+
+  state.SetItemsProcessed((int64_t)(state.iterations() * count));
+}
+BENCHMARK(BM_BufAppendFetch)->Arg(16)->Arg(1024);
+
+static void BM_BufSplit(benchmark::State &state)
+{
+  std::string text;
+
+  for (int i = 0; i < state.range(0); i++) {
+    text += "nameserver 192.0.2." + std::to_string(i % 256) + "\n";
+    text += "search example" + std::to_string(i) + ".com example.net\n";
+  }
+
+  for (auto _ : state) {
+    ares_buf_t   *buf = ares_buf_create_const(
+      (const unsigned char *)text.data(), text.size());
+    ares_array_t *arr = NULL;
+
+    ares_buf_split(buf, (const unsigned char *)"\n", 1,
+                   ARES_BUF_SPLIT_TRIM, 0, &arr);
+    benchmark::DoNotOptimize(arr);
+    ares_array_destroy(arr);
+    ares_buf_destroy(buf);
+  }
+
+  state.SetBytesProcessed((int64_t)(state.iterations() * text.size()));
+}
+BENCHMARK(BM_BufSplit)->Arg(4)->Arg(256);
+
+static void BM_HtableSzvp(benchmark::State &state)
+{
+  const size_t count = (size_t)state.range(0);
+
+  for (auto _ : state) {
+    ares_htable_szvp_t *htable = ares_htable_szvp_create(NULL);
+    unsigned int        seed   = 1;
+
+    for (size_t i = 0; i < count; i++) {
+      ares_htable_szvp_insert(htable, bench_rand(&seed), &seed);
+    }
+    seed = 1;
+    for (size_t i = 0; i < count; i++) {
+      benchmark::DoNotOptimize(
+        ares_htable_szvp_get_direct(htable, bench_rand(&seed)));
+    }
+    ares_htable_szvp_destroy(htable);
+  }
+
+  state.SetItemsProcessed((int64_t)(state.iterations() * count));
+}
+BENCHMARK(BM_HtableSzvp)->Arg(64)->Arg(4096);
+
+static int bench_slist_cmp(const void *data1, const void *data2)
+{
+  size_t a = *(const size_t *)data1;
+  size_t b = *(const size_t *)data2;
+
+  if (a < b) {
+    return -1;
+  }
+  if (a > b) {
+    return 1;
+  }
+  return 0;
+}
+
+static void BM_SlistInsertPop(benchmark::State &state)
+{
+  const size_t        count      = (size_t)state.range(0);
+  ares_rand_state    *rand_state = ares_init_rand_state();
+  std::vector<size_t> vals(count);
+  unsigned int        seed = 1;
+
+  for (size_t i = 0; i < count; i++) {
+    vals[i] = bench_rand(&seed);
+  }
+
+  for (auto _ : state) {
+    ares_slist_t *list =
+      ares_slist_create(rand_state, bench_slist_cmp, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+      ares_slist_insert(list, &vals[i]);
+    }
+    while (ares_slist_len(list) > 0) {
+      ares_slist_node_claim(ares_slist_node_first(list));
+    }
+    ares_slist_destroy(list);
+  }
+
+  state.SetItemsProcessed((int64_t)(state.iterations() * count));
+  ares_destroy_rand_state(rand_state);
+}
+BENCHMARK(BM_SlistInsertPop)->Arg(64)->Arg(4096);
+
+static void BM_GenerateId(benchmark::State &state)
+{
+  ares_rand_state *rand_state = ares_init_rand_state();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ares_generate_new_id(rand_state));
+  }
+
+  state.SetItemsProcessed((int64_t)state.iterations());
+  ares_destroy_rand_state(rand_state);
+}
+BENCHMARK(BM_GenerateId);
+
+static void BM_RandBytes(benchmark::State &state)
+{
+  const size_t               len        = (size_t)state.range(0);
+  ares_rand_state           *rand_state = ares_init_rand_state();
+  std::vector<unsigned char> buf(len);
+
+  for (auto _ : state) {
+    ares_rand_bytes(rand_state, buf.data(), len);
+    benchmark::DoNotOptimize(buf.data());
+  }
+
+  state.SetBytesProcessed((int64_t)(state.iterations() * len));
+  ares_destroy_rand_state(rand_state);
+}
+BENCHMARK(BM_RandBytes)->Arg(32)->Arg(4096);
+
+static void BM_ArrayInsertRemove(benchmark::State &state)
+{
+  const size_t count = (size_t)state.range(0);
+
+  for (auto _ : state) {
+    ares_array_t *arr = ares_array_create(sizeof(size_t), NULL);
+
+    for (size_t i = 0; i < count; i++) {
+      ares_array_insertdata_last(arr, &i);
+    }
+    while (ares_array_len(arr) > 0) {
+      ares_array_remove_first(arr);
+    }
+    ares_array_destroy(arr);
+  }
+
+  state.SetItemsProcessed((int64_t)(state.iterations() * count));
+}
+BENCHMARK(BM_ArrayInsertRemove)->Arg(64)->Arg(4096);
+
+/* Channel with no servers contacted, used by benchmarks that only need the
+ * channel for configuration or internal state */
+class BenchChannel {
+public:
+  BenchChannel()
+  {
+    struct ares_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.qcache_max_ttl = 3600;
+    ares_init_options(&channel_, &opts, ARES_OPT_QUERY_CACHE);
+    ares_set_servers_csv(channel_, "127.0.0.1");
+  }
+
+  ~BenchChannel()
+  {
+    ares_destroy(channel_);
+  }
+
+  ares_channel_t *channel_ = nullptr;
+};
+
+static void BM_QcacheFetch(benchmark::State &state)
+{
+  const size_t                     count = (size_t)state.range(0);
+  BenchChannel                     bench;
+  std::vector<ares_dns_record_t *> reqs;
+  ares_timeval_t                   now;
+
+  ares_tvnow(&now);
+
+  /* Populate the cache with distinct names */
+  for (size_t i = 0; i < count; i++) {
+    ares_dns_record_t *req  = NULL;
+    ares_dns_record_t *resp = NULL;
+    ares_query_t       query;
+    std::string        name = "host" + std::to_string(i) + ".example.com";
+
+    ares_dns_record_create(&req, 0, ARES_FLAG_RD, ARES_OPCODE_QUERY,
+                           ARES_RCODE_NOERROR);
+    ares_dns_record_query_add(req, name.c_str(), ARES_REC_TYPE_A,
+                              ARES_CLASS_IN);
+    resp = bench_response(1);
+    ares_dns_record_query_set_name(resp, 0, name.c_str());
+
+    memset(&query, 0, sizeof(query));
+    query.query = req;
+    ares_qcache_insert(bench.channel_, &now, &query, resp);
+    ares_dns_record_destroy(resp);
+    reqs.push_back(req);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    const ares_dns_record_t *resp = NULL;
+    if (ares_qcache_fetch(bench.channel_, &now, reqs[i], &resp) !=
+        ARES_SUCCESS) {
+      state.SkipWithError("ares_qcache_fetch missed");
+      break;
+    }
+    if (++i == count) {
+      i = 0;
+    }
+  }
+
+  for (auto req : reqs) {
+    ares_dns_record_destroy(req);
+  }
+}
+BENCHMARK(BM_QcacheFetch)->Arg(16)->Arg(4096);
+
+static void BM_SortAddrinfo(benchmark::State &state)
+{
+  const size_t count = (size_t)state.range(0);
+  BenchChannel bench;
+
+  for (auto _ : state) {
+    struct ares_addrinfo_node  sentinel;
+    struct ares_addrinfo_node *nodes = NULL;
+
+    state.PauseTiming();
+    for (size_t i = 0; i < count; i++) {
+      struct in_addr       addr4;
+      struct ares_in6_addr addr6;
+
+      addr4.s_addr = htonl(0x7F000001 + (unsigned int)i);
+      memset(&addr6, 0, sizeof(addr6));
+      addr6._S6_un._S6_u8[15] = 1;
+      ares_append_ai_node(AF_INET, 0, 0, &addr4, &nodes);
+      ares_append_ai_node(AF_INET6, 0, 0, &addr6, &nodes);
+    }
+    /* The list is sorted after the sentinel, as in ares_getaddrinfo.c */
+    memset(&sentinel, 0, sizeof(sentinel));
+    sentinel.ai_next = nodes;
+    state.ResumeTiming();
+
+    ares_sortaddrinfo(bench.channel_, &sentinel);
+
+    state.PauseTiming();
+    ares_freeaddrinfo_nodes(sentinel.ai_next);
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed((int64_t)(state.iterations() * count * 2));
+}
+BENCHMARK(BM_SortAddrinfo)->Arg(1)->Arg(8);
+
+static void BM_AddrinfoLocalhost(benchmark::State &state)
+{
+  struct ares_addrinfo_hints hints;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = (int)state.range(0);
+
+  for (auto _ : state) {
+    struct ares_addrinfo *ai =
+      (struct ares_addrinfo *)ares_malloc_zero(sizeof(*ai));
+    ares_addrinfo_localhost("localhost", 80, &hints, ai);
+    ares_freeaddrinfo(ai);
+  }
+}
+BENCHMARK(BM_AddrinfoLocalhost)->Arg(AF_UNSPEC)->Arg(AF_INET);
+
+/* End-to-end: a batch of queries resolved by the mock server over loopback,
+ * with the query cache disabled so every query hits the wire. */
+static void bench_qps_callback(void *arg, ares_status_t status,
+                               size_t timeouts, const ares_dns_record_t *dnsrec)
+{
+  size_t *done = (size_t *)arg;
+  (void)timeouts;
+  (void)dnsrec;
+  if (status == ARES_SUCCESS) {
+    (*done)++;
+  }
+}
+
+static void BM_QueryQPS(benchmark::State &state)
+{
+  const size_t                  batch = (size_t)state.range(0);
+  const bool                    tcp   = state.range(1) != 0;
+  testing::NiceMock<MockServer> server(AF_INET, 0);
+  DNSPacket                     rsp;
+  ares_channel_t               *channel = nullptr;
+  struct ares_options           opts;
+  ares_dns_record_t            *req  = NULL;
+  size_t                        done = 0;
+
+  rsp.set_response()
+    .set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(new DNSARR("www.example.com", 100, { 192, 0, 2, 1 }));
+  server.SetReply(&rsp);
+
+  memset(&opts, 0, sizeof(opts));
+  opts.flags          = ARES_FLAG_STAYOPEN | (tcp ? ARES_FLAG_USEVC : 0);
+  opts.qcache_max_ttl = 0;
+  ares_init_options(&channel, &opts, ARES_OPT_FLAGS | ARES_OPT_QUERY_CACHE);
+  std::string servers =
+    "127.0.0.1:" + std::to_string(tcp ? server.tcpport() : server.udpport());
+  ares_set_servers_ports_csv(channel, servers.c_str());
+
+  ares_dns_record_create(&req, 0, ARES_FLAG_RD, ARES_OPCODE_QUERY,
+                         ARES_RCODE_NOERROR);
+  ares_dns_record_query_add(req, "www.example.com", ARES_REC_TYPE_A,
+                            ARES_CLASS_IN);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < batch; i++) {
+      ares_send_dnsrec(channel, req, bench_qps_callback, &done, NULL);
+    }
+    ProcessWork(
+      channel, [&server]() { return server.fds(); },
+      [&server](ares_socket_t fd) { server.ProcessFD(fd); }, 0);
+  }
+
+  if (done != state.iterations() * batch) {
+    state.SkipWithError("not all queries succeeded");
+  }
+  state.SetItemsProcessed((int64_t)done);
+
+  /* Should trend to 0 as queries recycle the objects of earlier queries */
+  if (done > 0) {
+    state.counters["pool_mallocs_per_query"] =
+      (double)ares_pool_mallocs(channel->query_pool) / (double)done;
+  }
+
+  ares_dns_record_destroy(req);
+  ares_destroy(channel);
+}
+BENCHMARK(BM_QueryQPS)
+  ->ArgNames({ "batch", "tcp" })
+  ->Args({ 1, 0 })
+  ->Args({ 64, 0 })
+  ->Args({ 64, 1 })
+  ->UseRealTime();
+
+}  // namespace test
+}  // namespace ares
+
+int main(int argc, char *argv[])
+{
+#ifdef WIN32
+  WORD    wVersionRequested = MAKEWORD(2, 2);
+  WSADATA wsaData;
+  WSAStartup(wVersionRequested, &wsaData);
+#else
+  signal(SIGPIPE, SIG_IGN);
+#endif
+
+  ares_library_init(ARES_LIB_INIT_ALL);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  ares_library_cleanup();
+
+#ifdef WIN32
+  WSACleanup();
+#endif
+  return 0;
+}
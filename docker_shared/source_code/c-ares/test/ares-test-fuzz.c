@@ -25,7 +25,13 @@
  */
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ares_private.h"
 #include "ares.h"
+#ifdef HAVE_NETDB_H
+#  include <netdb.h>
+#endif
 #include "include/ares_buf.h"
 #include "include/ares_mem.h"
 
@@ -126,6 +132,131 @@ int LLVMFuzzerTestOneInput(const unsigned char *data, unsigned long size)
 
 #else
 
+#ifndef CARES_SYMBOL_HIDING
+
+/* ares_parse_a_reply() and ares_parse_aaaa_reply() fill in their results
+ * directly from the parsed response.  They must produce exactly what the
+ * generic conversion through ares_addrinfo does, which is what they were
+ * originally implemented with, so compare the two on every input. */
+static int addr_reply_reference(const unsigned char *abuf, int alen,
+                                int family, struct hostent **host,
+                                struct ares_addrttl  *addrttls,
+                                struct ares_addr6ttl *addr6ttls,
+                                int                  *naddrttls)
+{
+  struct ares_addrinfo ai;
+  ares_status_t        status;
+  size_t               req_naddrttls = (size_t)*naddrttls;
+  ares_dns_record_t   *dnsrec        = NULL;
+
+  *naddrttls = 0;
+  memset(&ai, 0, sizeof(ai));
+
+  status = ares_dns_parse(abuf, (size_t)alen, 0, &dnsrec);
+  if (status != ARES_SUCCESS) {
+    goto done;
+  }
+
+  status = ares_parse_into_addrinfo(dnsrec, 0, 0, &ai);
+  if (status != ARES_SUCCESS && status != ARES_ENODATA) {
+    goto done;
+  }
+
+  if (host != NULL) {
+    *host  = NULL;
+    status = ares_addrinfo2hostent(&ai, family, host);
+    if (status != ARES_SUCCESS && status != ARES_ENODATA) {
+      goto done;
+    }
+  }
+
+  if (req_naddrttls) {
+    size_t temp_naddrttls = 0;
+    ares_addrinfo2addrttl(&ai, family, req_naddrttls, addrttls, addr6ttls,
+                          &temp_naddrttls);
+    *naddrttls = (int)temp_naddrttls;
+  }
+
+done:
+  ares_freeaddrinfo_cnames(ai.cnames);
+  ares_freeaddrinfo_nodes(ai.nodes);
+  ares_free(ai.name);
+  ares_dns_record_destroy(dnsrec);
+
+  if (status == ARES_EBADNAME) {
+    status = ARES_EBADRESP;
+  }
+  return (int)status;
+}
+
+static int hostent_equal(const struct hostent *a, const struct hostent *b)
+{
+  size_t i;
+
+  if (a == NULL || b == NULL) {
+    return a == b;
+  }
+
+  if (a->h_addrtype != b->h_addrtype || a->h_length != b->h_length ||
+      strcmp(a->h_name, b->h_name) != 0) {
+    return 0;
+  }
+
+  for (i = 0; a->h_aliases[i] != NULL || b->h_aliases[i] != NULL; i++) {
+    if (a->h_aliases[i] == NULL || b->h_aliases[i] == NULL ||
+        strcmp(a->h_aliases[i], b->h_aliases[i]) != 0) {
+      return 0;
+    }
+  }
+
+  for (i = 0; a->h_addr_list[i] != NULL || b->h_addr_list[i] != NULL; i++) {
+    if (a->h_addr_list[i] == NULL || b->h_addr_list[i] == NULL ||
+        memcmp(a->h_addr_list[i], b->h_addr_list[i], (size_t)a->h_length) !=
+          0) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void addr_reply_differential(const unsigned char *data,
+                                    unsigned long size, int family,
+                                    int want_host)
+{
+  struct hostent      *host[2] = { NULL, NULL };
+  struct ares_addrttl  info[2][5];
+  struct ares_addr6ttl info6[2][5];
+  int                  count[2] = { 5, 5 };
+  int                  status[2];
+
+  memset(info, 0, sizeof(info));
+  memset(info6, 0, sizeof(info6));
+
+  if (family == AF_INET) {
+    status[0] = ares_parse_a_reply(data, (int)size, want_host ? &host[0] : NULL,
+                                   info[0], &count[0]);
+  } else {
+    status[0] = ares_parse_aaaa_reply(
+      data, (int)size, want_host ? &host[0] : NULL, info6[0], &count[0]);
+  }
+  status[1] = addr_reply_reference(data, (int)size, family,
+                                   want_host ? &host[1] : NULL, info[1],
+                                   info6[1], &count[1]);
+
+  if (status[0] != status[1] || count[0] != count[1] ||
+      !hostent_equal(host[0], host[1]) ||
+      memcmp(info[0], info[1], sizeof(info[0])) != 0 ||
+      memcmp(info6[0], info6[1], sizeof(info6[0])) != 0) {
+    abort();
+  }
+
+  ares_free_hostent(host[0]);
+  ares_free_hostent(host[1]);
+}
+
+#endif
+
 int LLVMFuzzerTestOneInput(const unsigned char *data, unsigned long size)
 {
   ares_dns_record_t *dnsrec    = NULL;
@@ -141,6 +272,13 @@ int LLVMFuzzerTestOneInput(const unsigned char *data, unsigned long size)
     return -1;
   }
 
+#ifndef CARES_SYMBOL_HIDING
+  addr_reply_differential(data, size, AF_INET, 1);
+  addr_reply_differential(data, size, AF_INET, 0);
+  addr_reply_differential(data, size, AF_INET6, 1);
+  addr_reply_differential(data, size, AF_INET6, 0);
+#endif
+
   if (ares_dns_parse(data, size, 0, &dnsrec) != ARES_SUCCESS) {
     goto done;
   }
@@ -31,9 +31,8 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
-#include <fcntl.h>
-#ifdef HAVE_SYS_IOCTL_H
-#  include <sys/ioctl.h>
+#if !defined(_WIN32)
+#include <sys/wait.h>
 #endif
 extern "C" {
 // Remove command-line defines of package variables for the test project...
@@ -56,6 +55,7 @@ extern "C" {
 #endif
 }
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -305,6 +305,126 @@ TEST_F(LibraryTest, SlistMisuse) {
   EXPECT_EQ(NULL, ares_slist_node_claim(NULL));
 }
 
+TEST_F(LibraryTest, RandBytes) {
+  ares_rand_state           *state = ares_init_rand_state();
+  std::vector<unsigned char> a(5000);
+  std::vector<unsigned char> b(5000);
+  std::vector<unsigned char> zero(5000);
+  std::vector<unsigned char> big(3 * 1024 * 1024);
+  std::set<unsigned short>   ids;
+  size_t                     i;
+
+  ASSERT_NE(nullptr, state);
+
+  // Requests larger than the internal cache span multiple refills
+  ares_rand_bytes(state, a.data(), a.size());
+  ares_rand_bytes(state, b.data(), b.size());
+  EXPECT_NE(a, zero);
+  EXPECT_NE(a, b);
+
+  // Small requests straddling a refill
+  for (i = 0; i < a.size(); i++) {
+    ares_rand_bytes(state, &a[i], 1);
+  }
+  EXPECT_NE(a, b);
+
+  // Past the reseed interval
+  ares_rand_bytes(state, big.data(), big.size());
+  ares_rand_bytes(state, a.data(), a.size());
+  EXPECT_NE(a, zero);
+
+  // Query ids should be spread across the whole space
+  for (i = 0; i < 1000; i++) {
+    ids.insert(ares_generate_new_id(state));
+  }
+  EXPECT_GT(ids.size(), (size_t)980);
+
+  ares_destroy_rand_state(state);
+}
+
+static std::string HexDump(const unsigned char *data, size_t len) {
+  static const char hexdigits[] = "0123456789abcdef";
+  std::string       out;
+  for (size_t i = 0; i < len; i++) {
+    out += hexdigits[data[i] >> 4];
+    out += hexdigits[data[i] & 0xF];
+  }
+  return out;
+}
+
+TEST_F(LibraryTest, RandChaCha20KnownAnswer) {
+  /* RFC 8439 Appendix A.1.  The generator uses the original 64bit nonce and
+   * 64bit counter layout, which these vectors map onto directly as their
+   * nonce words are zero where the two layouts differ. */
+  struct {
+    unsigned char key[32];
+    unsigned char iv[8];
+    size_t        block;
+    const char   *keystream;
+  } vectors[] = {
+    { { 0 }, { 0 }, 0,
+      "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+      "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586" },
+    { { 0 }, { 0 }, 1,
+      "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+      "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f" },
+    { { 0 }, { 0 }, 1,
+      "3aeb5224ecf849929b9d828db1ced4dd832025e8018b8160b82284f3c949aa5a"
+      "8eca00bbb4a73bdad192b5c42f73f2fd4e273644c8b36125a64addeb006c13a0" },
+    { { 0 }, { 0 }, 2,
+      "72d54dfbf12ec44b362692df94137f328fea8da73990265ec1bbbea1ae9af0ca"
+      "13b25aa26cb4a648cb9b9d1be65b2c0924a66c54d545ec1b7374f4872e99f096" },
+    { { 0 }, { 0 }, 0,
+      "c2c64d378cd536374ae204b9ef933fcd1a8b2288b3dfa49672ab765b54ee27c7"
+      "8a970e0e955c14f3a88e741b97c286f75f8fc299e8148362fa198a39531bed6d" },
+  };
+  vectors[2].key[31] = 0x01;
+  vectors[3].key[1]  = 0xff;
+  vectors[4].iv[7]   = 0x02;
+
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(*vectors); i++) {
+    unsigned char out[3 * 64];
+    ares_chacha20_keystream(vectors[i].key, vectors[i].iv, out,
+                            vectors[i].block + 1);
+    EXPECT_EQ(std::string(vectors[i].keystream),
+              HexDump(out + (vectors[i].block * 64), 64))
+      << "vector " << i + 1;
+  }
+}
+
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+TEST_F(LibraryTest, RandBytesAfterFork) {
+  ares_rand_state *state = ares_init_rand_state();
+  unsigned char    warm[16];
+  unsigned char    parent[32];
+  unsigned char    child[32];
+  int              fds[2];
+  int              wstatus = 0;
+
+  ASSERT_NE(nullptr, state);
+  /* Leave unserved keystream behind that both processes would inherit */
+  ares_rand_bytes(state, warm, sizeof(warm));
+
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    ares_rand_bytes(state, child, sizeof(child));
+    ssize_t rv = write(fds[1], child, sizeof(child));
+    _exit(rv == (ssize_t)sizeof(child) ? 0 : 1);
+  }
+  close(fds[1]);
+  ares_rand_bytes(state, parent, sizeof(parent));
+  EXPECT_EQ((ssize_t)sizeof(child), read(fds[0], child, sizeof(child)));
+  close(fds[0]);
+  waitpid(pid, &wstatus, 0);
+  EXPECT_EQ(0, WEXITSTATUS(wstatus));
+
+  EXPECT_NE(HexDump(parent, sizeof(parent)), HexDump(child, sizeof(child)));
+  ares_destroy_rand_state(state);
+}
+#endif
+
 #if !defined(_WIN32) || _WIN32_WINNT >= 0x0600
 TEST_F(LibraryTest, IfaceIPs) {
   ares_status_t      status;
@@ -363,6 +483,151 @@ TEST_F(LibraryTest, IfaceIPs) {
 }
 #endif
 
+TEST_F(DefaultChannelTest, SortAddrinfoCacheFull) {
+  /* More distinct /24 prefixes than the source address cache holds, sorted
+   * twice so entries are both evicted and served */
+  for (size_t pass = 0; pass < 2; pass++) {
+    struct ares_addrinfo_node  sentinel;
+    struct ares_addrinfo_node *cur;
+    size_t                     cnt = 0;
+
+    memset(&sentinel, 0, sizeof(sentinel));
+    for (unsigned int i = 0; i < 300; i++) {
+      struct in_addr addr4;
+      addr4.s_addr = htonl(0x7F000001 + (i << 8));
+      EXPECT_EQ(ARES_SUCCESS,
+                ares_append_ai_node(AF_INET, 0, 0, &addr4, &sentinel.ai_next));
+    }
+
+    EXPECT_EQ(ARES_SUCCESS, ares_sortaddrinfo(channel_, &sentinel));
+    for (cur = sentinel.ai_next; cur != NULL; cur = cur->ai_next) {
+      cnt++;
+    }
+    EXPECT_EQ(300, (int)cnt);
+    ares_freeaddrinfo_nodes(sentinel.ai_next);
+  }
+}
+
+TEST_F(DefaultChannelTest, SortAddrinfoLoopbackAfterGlobal) {
+  ares_iface_ips_t       *ips  = NULL;
+  const struct ares_addr *addr = NULL;
+  size_t                  i;
+
+  if (ares_iface_ips(&ips, ARES_IFACE_IP_V4, NULL) != ARES_SUCCESS)
+    return;
+
+  for (i=0; i<ares_iface_ips_cnt(ips); i++) {
+    if (!(ares_iface_ips_get_flags(ips, i) &
+          (ARES_IFACE_IP_LOOPBACK | ARES_IFACE_IP_LINKLOCAL))) {
+      addr = ares_iface_ips_get_addr(ips, i);
+      break;
+    }
+  }
+  if (addr == NULL) {
+    ares_iface_ips_destroy(ips);
+    return;
+  }
+
+  /* Probing a local address first must not leak its source address into the
+   * loopback probe, loopback has the smaller scope so it sorts first once
+   * both are seen as reachable from a matching source */
+  struct ares_addrinfo_node sentinel;
+  struct in_addr            loopback;
+  memset(&sentinel, 0, sizeof(sentinel));
+  loopback.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(ARES_SUCCESS, ares_append_ai_node(AF_INET, 0, 0, &addr->addr.addr4,
+                                              &sentinel.ai_next));
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_append_ai_node(AF_INET, 0, 0, &loopback, &sentinel.ai_next));
+  ares_iface_ips_destroy(ips);
+
+  EXPECT_EQ(ARES_SUCCESS, ares_sortaddrinfo(channel_, &sentinel));
+  ASSERT_NE(nullptr, sentinel.ai_next);
+  struct sockaddr_in *first = (struct sockaddr_in *)sentinel.ai_next->ai_addr;
+  EXPECT_EQ(htonl(INADDR_LOOPBACK), first->sin_addr.s_addr);
+
+  ares_freeaddrinfo_nodes(sentinel.ai_next);
+}
+
+TEST_F(DefaultChannelTest, IfaceCache) {
+  ares_iface_ips_t *ips = NULL;
+  size_t            i;
+  char              namebuf[256];
+
+  if (ares_iface_ips(&ips, ARES_IFACE_IP_DEFAULT, NULL) != ARES_SUCCESS)
+    return;
+
+  ares_channel_lock(channel_);
+  for (i=0; i<ares_iface_ips_cnt(ips); i++) {
+    const char  *name = ares_iface_ips_get_name(ips, i);
+    unsigned int idx  = ares_os_if_nametoindex(name);
+    const char *cached = ares_iface_cache_indextoname(channel_, idx, namebuf,
+                                                      sizeof(namebuf));
+    ASSERT_NE(nullptr, cached);
+    EXPECT_EQ(std::string(name), std::string(cached));
+  }
+
+  /* The table is enumerated once and kept until flushed */
+  const ares_iface_ips_t *table = channel_->iface_ips;
+  EXPECT_NE(nullptr, table);
+
+  /* Interfaces with a link-local address are named from the table, others
+   * such as loopback only through the operating system fallback */
+  for (i=0; i<ares_iface_ips_cnt(table); i++) {
+    const char  *name  = ares_iface_ips_get_name(table, i);
+    unsigned int scope = ares_iface_ips_get_ll_scope(table, i);
+    if (!(ares_iface_ips_get_flags(table, i) & ARES_IFACE_IP_LINKLOCAL) ||
+        scope == 0) {
+      continue;
+    }
+    const char *cached = ares_iface_cache_lookup(channel_, scope);
+    ASSERT_NE(nullptr, cached);
+    EXPECT_EQ(std::string(name), std::string(cached));
+    EXPECT_EQ(std::string(name),
+              std::string(ares_iface_cache_indextoname(channel_, scope, namebuf,
+                                                       sizeof(namebuf))));
+  }
+  unsigned int lo_idx = ares_os_if_nametoindex("lo");
+  if (lo_idx != 0) {
+    EXPECT_EQ(nullptr, ares_iface_cache_lookup(channel_, lo_idx));
+    EXPECT_NE(nullptr, ares_iface_cache_indextoname(channel_, lo_idx, namebuf,
+                                                    sizeof(namebuf)));
+  }
+  EXPECT_EQ(table, channel_->iface_ips);
+
+  ares_iface_cache_flush(channel_);
+  EXPECT_EQ(nullptr, channel_->iface_ips);
+
+  EXPECT_EQ(nullptr, ares_iface_cache_indextoname(channel_, 0x7FFFFFFF,
+                                                  namebuf, sizeof(namebuf)));
+  EXPECT_NE(nullptr, channel_->iface_ips);
+  EXPECT_EQ(nullptr, ares_iface_cache_indextoname(channel_, 0, namebuf,
+                                                  sizeof(namebuf)));
+  EXPECT_EQ(nullptr, ares_iface_cache_indextoname(channel_, 1, namebuf, 1));
+  EXPECT_EQ(nullptr, ares_iface_cache_indextoname(channel_, 1, NULL, 0));
+  ares_channel_unlock(channel_);
+
+#if defined(HAVE_STRUCT_SOCKADDR_IN6_SIN6_SCOPE_ID) && defined(HAVE_IF_INDEXTONAME)
+  /* Link-local scope ids are formatted from the cached table */
+  if (ares_iface_ips_cnt(ips) > 0) {
+    const char         *name = ares_iface_ips_get_name(ips, 0);
+    struct sockaddr_in6 sin6;
+    NameInfoResult      result;
+    memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family   = AF_INET6;
+    sin6.sin6_scope_id = ares_os_if_nametoindex(name);
+    ares_inet_pton(AF_INET6, "fe80::1", &sin6.sin6_addr);
+    ares_getnameinfo(channel_, (const struct sockaddr *)&sin6, sizeof(sin6),
+                     ARES_NI_NUMERICHOST, NameInfoCallback, &result);
+    EXPECT_TRUE(result.done_);
+    EXPECT_EQ(ARES_SUCCESS, result.status_);
+    EXPECT_EQ("fe80::1%" + std::string(name), result.node_);
+  }
+#endif
+
+  ares_iface_ips_destroy(ips);
+}
+
 TEST_F(LibraryTest, HtableMisuse) {
   EXPECT_EQ(NULL, ares_htable_create(NULL, NULL, NULL, NULL));
   EXPECT_EQ(ARES_FALSE, ares_htable_insert(NULL, NULL));
@@ -472,6 +737,165 @@ TEST_F(LibraryTest, URI) {
   EXPECT_NE(ARES_SUCCESS, ares_uri_parse_buf(NULL, NULL));
   EXPECT_NE(ARES_SUCCESS, ares_uri_parse_buf(NULL, NULL));
 }
+static size_t MetricsLoadedPrevCount(ares_server_t *server,
+                                     const std::vector<unsigned char> &saved,
+                                     unsigned int elapsed,
+                                     ares_server_bucket_t bucket)
+{
+  ares_timeval_t now;
+  ares_tvnow(&now);
+  memset(server->metrics, 0, sizeof(server->metrics));
+  ares_buf_t *buf = ares_buf_create_const(saved.data(), saved.size());
+  EXPECT_EQ(ARES_SUCCESS, ares_metrics_load(server, &now, elapsed, buf));
+  ares_buf_destroy(buf);
+  return (size_t)server->metrics[bucket].prev_total_count;
+}
+
+TEST_F(DefaultChannelTest, MetricsLoadDropsStalePeriods) {
+  ares_server_t *server =
+    (ares_server_t *)ares_slist_node_val(ares_slist_node_first(channel_->servers));
+  ASSERT_NE(nullptr, server);
+
+  ares_timeval_t now;
+  ares_tvnow(&now);
+  const time_t periods[ARES_METRIC_COUNT] = { 60, 15 * 60, 60 * 60,
+                                              24 * 60 * 60, 0 };
+  for (size_t i = 0; i < ARES_METRIC_COUNT; i++) {
+    ares_server_metrics_t *m = &server->metrics[i];
+    memset(m, 0, sizeof(*m));
+    m->ts             = periods[i] ? (time_t)now.sec / periods[i] : 1;
+    m->latency_min_ms = 10;
+    m->latency_max_ms = 10;
+    m->total_ms       = 50;
+    m->total_count    = 5;
+    m->hist[10]       = 5;
+  }
+
+  ares_buf_t *buf = ares_buf_create();
+  ASSERT_NE(nullptr, buf);
+  EXPECT_EQ(ARES_SUCCESS, ares_metrics_save(server, &now, buf));
+  size_t len = 0;
+  const unsigned char *ptr = ares_buf_peek(buf, &len);
+  std::vector<unsigned char> saved(ptr, ptr + len);
+  ares_buf_destroy(buf);
+
+  /* Saved just now, every bucket is restored */
+  for (size_t i = 0; i < ARES_METRIC_COUNT; i++) {
+    EXPECT_EQ(5, MetricsLoadedPrevCount(server, saved, 0,
+                                        (ares_server_bucket_t)i));
+  }
+
+  /* Two minutes later the minute bucket is stale, longer ones aren't */
+  EXPECT_EQ(0, MetricsLoadedPrevCount(server, saved, 120, ARES_METRIC_1MINUTE));
+  EXPECT_EQ(5,
+            MetricsLoadedPrevCount(server, saved, 120, ARES_METRIC_15MINUTES));
+
+  /* Days later only the since-inception data is left */
+  const unsigned int days = 3 * 24 * 60 * 60;
+  EXPECT_EQ(0, MetricsLoadedPrevCount(server, saved, days, ARES_METRIC_1DAY));
+  EXPECT_EQ(0, MetricsLoadedPrevCount(server, saved, days, ARES_METRIC_1HOUR));
+  EXPECT_EQ(5,
+            MetricsLoadedPrevCount(server, saved, days, ARES_METRIC_INCEPTION));
+
+  memset(server->metrics, 0, sizeof(server->metrics));
+}
+
+TEST_F(LibraryTest, ServicesFile) {
+  TempFile services("# Comment line\n"
+                    "\n"
+                    "http\t\t80/tcp\t\twww\t# WorldWideWeb HTTP\n"
+                    "  myservice 12345/tcp alias1 alias2#comment\n"
+                    "other 12345/tcp other-alias\n"
+                    "myservice 12345/sctp\n"
+                    "toobig 99999/tcp\n"
+                    "notnum abc/tcp\n"
+                    "noproto 81\n"
+                    "noproto2 82/\n"
+                    "last 4242/udp");
+  ares_services_file_t *sf = NULL;
+
+  EXPECT_NE(ARES_SUCCESS,
+            ares_services_parse("/nonexistent/services", &sf));
+  EXPECT_EQ(nullptr, sf);
+
+  EXPECT_EQ(ARES_SUCCESS, ares_services_parse(services.filename(), &sf));
+  ASSERT_NE(nullptr, sf);
+
+  EXPECT_STREQ("http", ares_services_port_to_name(sf, 80, "tcp"));
+  /* First name listed for a port wins */
+  EXPECT_STREQ("myservice", ares_services_port_to_name(sf, 12345, "tcp"));
+  EXPECT_STREQ("myservice", ares_services_port_to_name(sf, 12345, "sctp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(sf, 12345, "udp"));
+  EXPECT_STREQ("last", ares_services_port_to_name(sf, 4242, "udp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(sf, 81, "tcp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(sf, 82, "tcp"));
+
+  EXPECT_EQ(80, ares_services_name_to_port(sf, "www", "tcp"));
+  EXPECT_EQ(12345, ares_services_name_to_port(sf, "alias2", "tcp"));
+  EXPECT_EQ(12345, ares_services_name_to_port(sf, "other", "tcp"));
+  EXPECT_EQ(12345, ares_services_name_to_port(sf, "other-alias", "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(sf, "comment", "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(sf, "toobig", "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(sf, "notnum", "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(sf, "myservice", "udp"));
+
+  /* The built-in table is not consulted once the file has been read */
+  EXPECT_EQ(nullptr, ares_services_port_to_name(sf, 22, "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(sf, "https", "udp"));
+
+  /* A modified file is parsed again, a modification within the same second
+   * as the last parse counts as a change */
+  FILE *fp = fopen(services.filename(), "w");
+  ASSERT_NE(nullptr, fp);
+  fputs("ssh 22/tcp\n", fp);
+  fclose(fp);
+  EXPECT_EQ(ARES_SUCCESS, ares_services_update(&sf, services.filename()));
+  ASSERT_NE(nullptr, sf);
+  EXPECT_STREQ("ssh", ares_services_port_to_name(sf, 22, "tcp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(sf, 80, "tcp"));
+
+  /* A file that can no longer be read falls back to the built-in table */
+  EXPECT_NE(ARES_SUCCESS,
+            ares_services_update(&sf, "/nonexistent/services"));
+  EXPECT_EQ(nullptr, sf);
+
+  EXPECT_STREQ("shell", ares_services_port_to_name(NULL, 514, "tcp"));
+  EXPECT_STREQ("syslog", ares_services_port_to_name(NULL, 514, "udp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(NULL, 53, "dccp"));
+  EXPECT_EQ(nullptr, ares_services_port_to_name(NULL, 65535, "tcp"));
+  EXPECT_EQ(80, ares_services_name_to_port(NULL, "www", "tcp"));
+  EXPECT_EQ(0, ares_services_name_to_port(NULL, "ntp", "tcp"));
+  EXPECT_EQ(123, ares_services_name_to_port(NULL, "ntp", "udp"));
+  EXPECT_EQ(0, ares_services_name_to_port(
+                 NULL, "a-service-name-longer-than-the-file-allows", "tcp"));
+}
+
+TEST_F(DefaultChannelTest, ServicesCheckInterval) {
+  TempFile       services("myservice 12345/tcp\n");
+  ares_timeval_t now;
+
+  /* A table loaded from another file would be replaced on the next check,
+   * but until the check interval passes lookups just use what is loaded */
+  ares_channel_lock(channel_);
+  ares_services_file_destroy(channel_->services);
+  channel_->services = NULL;
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_services_parse(services.filename(), &channel_->services));
+  ares_tvnow(&now);
+  channel_->services_expire.sec  = now.sec + 60;
+  channel_->services_expire.usec = 0;
+  EXPECT_STREQ("myservice", ares_services_port_to_name(
+                              ares_services_get(channel_), 12345, "tcp"));
+
+  /* Once it passes, the system file is checked and replaces it */
+  memset(&channel_->services_expire, 0, sizeof(channel_->services_expire));
+  const ares_services_file_t *sf = ares_services_get(channel_);
+  EXPECT_EQ(sf, channel_->services);
+  EXPECT_STRNE("myservice", ares_services_port_to_name(sf, 12345, "tcp"));
+  EXPECT_FALSE(ares_timedout(&now, &channel_->services_expire));
+  ares_channel_unlock(channel_);
+}
+
 #endif /* !CARES_SYMBOL_HIDING */
 
 TEST_F(LibraryTest, InetPtoN) {
@@ -1564,6 +1988,54 @@ TEST_F(LibraryTest, BufReplace) {
   }
 }
 
+TEST_F(LibraryTest, BufInterleavedAppendConsume) {
+  ares_buf_t  *buf   = ares_buf_create();
+  std::string  model;
+  unsigned int seed  = 1;
+  size_t       i;
+
+  /* Like a busy connection: data is appended and consumed in pieces, with
+   * partial messages left behind and rolled back, so the buffer has to both
+   * compact and grow while keeping the unprocessed data intact. */
+  for (i = 0; i < 2000; i++) {
+    std::string          chunk;
+    size_t               len;
+    const unsigned char *ptr;
+    size_t               j;
+
+    seed = seed * 1103515245U + 12345U;
+    for (j = 0; j < ((seed >> 16) % 300) + 1; j++) {
+      chunk += (char)('a' + ((i + j) % 26));
+    }
+    EXPECT_EQ(ARES_SUCCESS,
+              ares_buf_append(buf, (const unsigned char *)chunk.data(),
+                              chunk.size()));
+    model += chunk;
+
+    seed = seed * 1103515245U + 12345U;
+    len  = (seed >> 16) % 320;
+    if (len > model.size()) {
+      len = model.size();
+    }
+    ares_buf_tag(buf);
+    EXPECT_EQ(ARES_SUCCESS, ares_buf_consume(buf, len));
+    if (i % 5 == 0) {
+      ares_buf_tag_rollback(buf);
+    } else {
+      ares_buf_tag_clear(buf);
+      model.erase(0, len);
+    }
+
+    ptr = ares_buf_peek(buf, &len);
+    EXPECT_EQ(model.size(), len);
+    if (len) {
+      EXPECT_EQ(0, memcmp(ptr, model.data(), len));
+    }
+  }
+
+  ares_buf_destroy(buf);
+}
+
 typedef struct {
   ares_socket_t s;
 } test_htable_asvp_t;
@@ -1798,6 +2270,138 @@ TEST_F(LibraryTest, HtableDict) {
   ares_htable_dict_destroy(h);
 }
 
+TEST_F(LibraryTest, Pool) {
+  ares_pool_t   *pool = ares_pool_create(2);
+  unsigned char *a;
+  unsigned char *b;
+  unsigned char *c;
+  unsigned char *d;
+  size_t         i;
+
+  EXPECT_NE((void *)NULL, pool);
+
+  a = (unsigned char *)ares_pool_alloc(pool, 32);
+  b = (unsigned char *)ares_pool_alloc(pool, 32);
+  c = (unsigned char *)ares_pool_alloc(pool, 32);
+  EXPECT_EQ((size_t)3, ares_pool_mallocs(pool));
+
+  /* Only 2 are retained, the third goes back to the allocator */
+  memset(a, 0xFF, 32);
+  ares_pool_free(pool, a, 32);
+  ares_pool_free(pool, b, 32);
+  ares_pool_free(pool, c, 32);
+
+  a = (unsigned char *)ares_pool_alloc(pool, 32);
+  b = (unsigned char *)ares_pool_alloc(pool, 32);
+  EXPECT_EQ((size_t)3, ares_pool_mallocs(pool));
+  for (i = 0; i < 32; i++) {
+    EXPECT_EQ(0, a[i]);
+    EXPECT_EQ(0, b[i]);
+  }
+
+  c = (unsigned char *)ares_pool_alloc(pool, 32);
+  d = (unsigned char *)ares_pool_alloc(pool, 64);
+  EXPECT_EQ((size_t)5, ares_pool_mallocs(pool));
+
+  /* Objects may also be released outside of the pool */
+  ares_free(a);
+  ares_pool_free(pool, b, 32);
+  ares_pool_free(pool, c, 32);
+  ares_pool_free(pool, d, 64);
+  ares_pool_destroy(pool);
+
+  a = (unsigned char *)ares_pool_alloc(NULL, 16);
+  EXPECT_NE((void *)NULL, a);
+  ares_pool_free(NULL, a, 16);
+  EXPECT_EQ((size_t)0, ares_pool_mallocs(NULL));
+}
+
+#ifndef CARES_SYMBOL_HIDING
+class PtrCacheTest
+    : public MockChannelOptsTest,
+      public ::testing::WithParamInterface<int> {
+ public:
+  PtrCacheTest()
+    : MockChannelOptsTest(1, GetParam(), false, false,
+                          FillOptions(&opts_),
+                          ARES_OPT_QUERY_CACHE) {}
+  static struct ares_options* FillOptions(struct ares_options * opts) {
+    memset(opts, 0, sizeof(struct ares_options));
+    opts->qcache_max_ttl = 3600;
+    return opts;
+  }
+ private:
+  struct ares_options opts_;
+};
+
+TEST_P(PtrCacheTest, FetchByAddr) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("5.4.3.2.in-addr.arpa", T_PTR))
+    .add_answer(new DNSPtrRR("5.4.3.2.in-addr.arpa", 100, "www.google.com"));
+  DNSPacket rsp6;
+  rsp6.set_response().set_aa()
+    .add_question(new DNSQuestion("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                                  "0.0.8.b.d.0.1.0.0.2.ip6.arpa", T_PTR))
+    .add_answer(new DNSPtrRR("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                             "8.b.d.0.1.0.0.2.ip6.arpa", 100, "www.google.com"));
+  ON_CALL(server_, OnRequest("5.4.3.2.in-addr.arpa", T_PTR))
+    .WillByDefault(SetReply(&server_, &rsp4));
+  ON_CALL(server_, OnRequest("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                             "8.b.d.0.1.0.0.2.ip6.arpa", T_PTR))
+    .WillByDefault(SetReply(&server_, &rsp6));
+
+  struct ares_addr addr4;
+  struct ares_addr addr6;
+  struct ares_addr other;
+  memset(&addr4, 0, sizeof(addr4));
+  memset(&addr6, 0, sizeof(addr6));
+  addr4.family = AF_INET;
+  ares_inet_pton(AF_INET, "2.3.4.5", &addr4.addr.addr4);
+  addr6.family = AF_INET6;
+  ares_inet_pton(AF_INET6, "2001:db8::1", &addr6.addr.addr6);
+  other        = addr4;
+  other.addr.addr4.s_addr ^= 1;
+
+  ares_timeval_t           now;
+  const ares_dns_record_t *dnsrec = NULL;
+  ares_tvnow(&now);
+  EXPECT_EQ(ARES_ENOTFOUND,
+            ares_qcache_fetch_ptr(channel_, &now, &addr4, &dnsrec));
+
+  HostResult result4;
+  HostResult result6;
+  ares_gethostbyaddr(channel_, &addr4.addr.addr4, sizeof(addr4.addr.addr4),
+                     AF_INET, HostCallback, &result4);
+  ares_gethostbyaddr(channel_, &addr6.addr.addr6, sizeof(addr6.addr.addr6),
+                     AF_INET6, HostCallback, &result6);
+  Process();
+  EXPECT_EQ(ARES_SUCCESS, result4.status_);
+  EXPECT_EQ(ARES_SUCCESS, result6.status_);
+
+  /* Both answers are now found by address alone */
+  ares_tvnow(&now);
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_qcache_fetch_ptr(channel_, &now, &addr4, &dnsrec));
+  EXPECT_EQ((size_t)1, ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER));
+  dnsrec = NULL;
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_qcache_fetch_ptr(channel_, &now, &addr6, &dnsrec));
+  EXPECT_EQ((size_t)1, ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ANSWER));
+  EXPECT_EQ(ARES_ENOTFOUND,
+            ares_qcache_fetch_ptr(channel_, &now, &other, &dnsrec));
+
+  /* And forgotten along with the rest of the cache */
+  ares_qcache_flush(channel_->qcache);
+  EXPECT_EQ(ARES_ENOTFOUND,
+            ares_qcache_fetch_ptr(channel_, &now, &addr4, &dnsrec));
+}
+
+INSTANTIATE_TEST_SUITE_P(AddressFamilies, PtrCacheTest,
+                         ::testing::ValuesIn(ares::test::families),
+                         PrintFamily);
+#endif
+
 TEST_F(DefaultChannelTest, SaveInvalidChannel) {
   ares_slist_t *saved = channel_->servers;
   channel_->servers = NULL;
@@ -1807,62 +2411,5 @@ TEST_F(DefaultChannelTest, SaveInvalidChannel) {
   channel_->servers = saved;
 }
 
-// Need to put this in own function due to nested lambda bug
-// in VS2013. (C2888)
-static int configure_socket(ares_socket_t s) {
-  // transposed from ares-process, simplified non-block setter.
-#if defined(USE_BLOCKING_SOCKETS)
-  return 0; /* returns success */
-#elif defined(HAVE_FCNTL_O_NONBLOCK)
-  /* most recent unix versions */
-  int flags;
-  flags = fcntl(s, F_GETFL, 0);
-  return fcntl(s, F_SETFL, flags | O_NONBLOCK);
-#elif defined(HAVE_IOCTL_FIONBIO)
-  /* older unix versions */
-  int flags = 1;
-  return ioctl(s, FIONBIO, &flags);
-#elif defined(HAVE_IOCTLSOCKET_FIONBIO)
-#ifdef WATT32
-  char flags = 1;
-#else
-  /* Windows */
-  unsigned long flags = 1UL;
-#endif
-  return ioctlsocket(s, (long)FIONBIO, &flags);
-#elif defined(HAVE_IOCTLSOCKET_CAMEL_FIONBIO)
-  /* Amiga */
-  long flags = 1L;
-  return IoctlSocket(s, FIONBIO, flags);
-#elif defined(HAVE_SETSOCKOPT_SO_NONBLOCK)
-  /* BeOS */
-  long b = 1L;
-  return setsockopt(s, SOL_SOCKET, SO_NONBLOCK, &b, sizeof(b));
-#else
-#  error "no non-blocking method was found/used/set"
-#endif
-}
-
-// TODO: This should not really be in this file, but we need ares config
-// flags, and here they are available.
-const struct ares_socket_functions VirtualizeIO::default_functions = {
-  [](int af, int type, int protocol, void *) -> ares_socket_t {
-    auto s = ::socket(af, type, protocol);
-    if (s == ARES_SOCKET_BAD) {
-      return s;
-    }
-    if (configure_socket(s) != 0) {
-      sclose(s);
-      return ares_socket_t(-1);
-    }
-    return s;
-  },
-  NULL,
-  NULL,
-  NULL,
-  NULL
-};
-
-
 }  // namespace test
 }  // namespace ares
@@ -358,6 +358,37 @@ TEST_F(DefaultChannelTest, SearchOnionDomain) {
   EXPECT_EQ(ARES_ENOTFOUND, result.status_);
 }
 
+TEST_F(DefaultChannelTest, GetNameInfoServiceOnly) {
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family      = AF_INET;
+  sin.sin_addr.s_addr = htonl(0x01020304);
+
+  /* Well-known services are known with or without a services file */
+  NameInfoResult result1;
+  sin.sin_port = htons(80);
+  ares_getnameinfo(channel_, (const struct sockaddr *)&sin, sizeof(sin),
+                   ARES_NI_LOOKUPSERVICE, NameInfoCallback, &result1);
+  EXPECT_TRUE(result1.done_);
+  EXPECT_EQ(ARES_SUCCESS, result1.status_);
+  EXPECT_EQ("http", result1.service_);
+
+  NameInfoResult result2;
+  sin.sin_port = htons(53);
+  ares_getnameinfo(channel_, (const struct sockaddr *)&sin, sizeof(sin),
+                   ARES_NI_LOOKUPSERVICE | ARES_NI_UDP, NameInfoCallback,
+                   &result2);
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ("domain", result2.service_);
+
+  NameInfoResult result3;
+  ares_getnameinfo(channel_, (const struct sockaddr *)&sin, sizeof(sin),
+                   ARES_NI_LOOKUPSERVICE | ARES_NI_NUMERICSERV,
+                   NameInfoCallback, &result3);
+  EXPECT_TRUE(result3.done_);
+  EXPECT_EQ("53", result3.service_);
+}
+
 TEST_F(DefaultChannelTest, SendFailure) {
   unsigned char buf[2] = {};
   SearchResult result;
@@ -611,6 +642,40 @@ TEST_F(LibraryTest, DNSMapping) {
       EXPECT_NE(0, (int)ares_dns_rr_key_datatype(keys[j]));
     }
   }
+
+  ares_dns_rec_type_t type;
+  EXPECT_TRUE(ares_dns_rec_type_fromstr(&type, "aaaa"));
+  EXPECT_EQ(ARES_REC_TYPE_AAAA, type);
+  EXPECT_TRUE(ares_dns_rec_type_fromstr(&type, "RAW_RR"));
+  EXPECT_EQ(ARES_REC_TYPE_RAW_RR, type);
+  EXPECT_EQ("RAWRR", std::string(ares_dns_rec_type_tostr(ARES_REC_TYPE_RAW_RR)));
+  EXPECT_FALSE(ares_dns_rec_type_fromstr(&type, ""));
+  EXPECT_FALSE(ares_dns_rec_type_fromstr(&type, "AAAAA"));
+  EXPECT_FALSE(ares_dns_rec_type_fromstr(&type, "DNSKEY"));
+
+  EXPECT_EQ("UNKNOWN", std::string(ares_dns_rec_type_tostr((ares_dns_rec_type_t)3)));
+  EXPECT_EQ("UNKNOWN", std::string(ares_dns_rec_type_tostr((ares_dns_rec_type_t)254)));
+  EXPECT_EQ("UNKNOWN", std::string(ares_dns_rec_type_tostr((ares_dns_rec_type_t)258)));
+  EXPECT_EQ(0, (int)ares_dns_rr_key_to_rec_type((ares_dns_rr_key_t)(99 * 100 + 1)));
+
+  size_t cnt = 1;
+  EXPECT_EQ(nullptr, ares_dns_rr_get_keys(ARES_REC_TYPE_ANY, &cnt));
+  EXPECT_EQ(0, (int)cnt);
+  EXPECT_EQ(nullptr, ares_dns_rr_get_keys((ares_dns_rec_type_t)3, &cnt));
+
+  /* Gaps in the key numbering are not valid keys */
+  ares_dns_rr_key_t bad_keys[] = {
+    (ares_dns_rr_key_t)(ARES_REC_TYPE_SRV * 100 + 1),
+    (ares_dns_rr_key_t)(ARES_REC_TYPE_OPT * 100 + 2),
+    (ares_dns_rr_key_t)(ARES_REC_TYPE_A * 100),
+    (ares_dns_rr_key_t)(ARES_REC_TYPE_A * 100 + 2),
+    (ares_dns_rr_key_t)(ARES_REC_TYPE_ANY * 100 + 1),
+    (ares_dns_rr_key_t)(3 * 100 + 1)
+  };
+  for (size_t i=0; i<sizeof(bad_keys) / sizeof(*bad_keys); i++) {
+    EXPECT_EQ("UNKNOWN", std::string(ares_dns_rr_key_tostr(bad_keys[i])));
+    EXPECT_EQ(0, (int)ares_dns_rr_key_datatype(bad_keys[i]));
+  }
 }
 
 TEST_F(LibraryTest, StrError) {
@@ -30,6 +30,7 @@
 #include <netinet/in.h>
 #endif
 
+#include <chrono>
 #include <sstream>
 #include <vector>
 
@@ -89,6 +90,44 @@ MATCHER_P(IncludesV6Address, address, "") {
   return false;
 }
 
+struct StreamResult {
+  StreamResult() : done_(false), status_(ARES_SUCCESS), contiguous_(true) {}
+  bool                     done_;
+  ares_status_t            status_;
+  bool                     contiguous_;
+  std::vector<size_t>      batches_;
+  std::vector<std::string> addrs_;
+};
+
+static void StreamCallback(void *data, ares_status_t status, size_t timeouts,
+                           const struct ares_addrinfo_node *nodes,
+                           size_t nodes_cnt, ares_bool_t done) {
+  StreamResult *result = reinterpret_cast<StreamResult *>(data);
+  (void)timeouts;
+  EXPECT_FALSE(result->done_);
+  if (nodes_cnt) {
+    result->batches_.push_back(nodes_cnt);
+  }
+  for (size_t i = 0; i < nodes_cnt; i++) {
+    char        addr[INET6_ADDRSTRLEN];
+    const void *ptr;
+    if (nodes[i].ai_family == AF_INET) {
+      ptr = &reinterpret_cast<const sockaddr_in *>(nodes[i].ai_addr)->sin_addr;
+    } else {
+      ptr = &reinterpret_cast<const sockaddr_in6 *>(nodes[i].ai_addr)->sin6_addr;
+    }
+    ares_inet_ntop(nodes[i].ai_family, ptr, addr, sizeof(addr));
+    result->addrs_.push_back(addr);
+    if (nodes[i].ai_next != ((i + 1 < nodes_cnt) ? &nodes[i + 1] : nullptr)) {
+      result->contiguous_ = false;
+    }
+  }
+  if (done) {
+    result->done_   = true;
+    result->status_ = status;
+  }
+}
+
 // UDP only so mock server doesn't get confused by concatenated requests
 TEST_P(MockUDPChannelTestAI, GetAddrInfoParallelLookups) {
   DNSPacket rsp1;
@@ -685,6 +724,121 @@ TEST_P(MockChannelTestAI, FamilyV4_MultipleAddresses) {
   EXPECT_EQ("{addr=[2.3.4.5], addr=[7.8.9.0]}", ss.str());
 }
 
+#ifndef _WIN32
+static ares_socket_t probecount_socket(int domain, int type, int protocol,
+                                       void *user_data)
+{
+  if (type == SOCK_DGRAM) {
+    (*reinterpret_cast<size_t *>(user_data))++;
+  }
+  return ::socket(domain, type, protocol);
+}
+
+static int probecount_close(ares_socket_t sock, void *user_data)
+{
+  (void)user_data;
+  return ::close(sock);
+}
+
+static int probecount_setsockopt(ares_socket_t sock, ares_socket_opt_t opt,
+                                 const void *val, ares_socklen_t val_size,
+                                 void *user_data)
+{
+  (void)sock;
+  (void)opt;
+  (void)val;
+  (void)val_size;
+  (void)user_data;
+  errno = ENOSYS;
+  return -1;
+}
+
+static int probecount_connect(ares_socket_t sock, const struct sockaddr *address,
+                              ares_socklen_t address_len, unsigned int flags,
+                              void *user_data)
+{
+  (void)flags;
+  (void)user_data;
+  return ::connect(sock, address, address_len);
+}
+
+static ares_ssize_t probecount_recvfrom(ares_socket_t sock, void *buffer,
+                                        size_t length, int flags,
+                                        struct sockaddr *address,
+                                        ares_socklen_t  *address_len,
+                                        void            *user_data)
+{
+  (void)user_data;
+  return ::recvfrom(sock, buffer, length, flags, address, address_len);
+}
+
+static ares_ssize_t probecount_sendto(ares_socket_t sock, const void *buffer,
+                                      size_t length, int flags,
+                                      const struct sockaddr *address,
+                                      ares_socklen_t address_len,
+                                      void *user_data)
+{
+  (void)user_data;
+  return ::sendto(sock, buffer, length, flags, address, address_len);
+}
+
+static int probecount_getsockname(ares_socket_t sock, struct sockaddr *address,
+                                  ares_socklen_t *address_len, void *user_data)
+{
+  (void)user_data;
+  return ::getsockname(sock, address, address_len);
+}
+
+// TCP so the only datagram sockets opened are source address probes
+TEST_P(MockTCPChannelTestAI, SortSourceAddrCache) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("example.com", T_A))
+    .add_answer(new DNSARR("example.com", 100, {2, 3, 4, 5}))
+    .add_answer(new DNSARR("example.com", 100, {2, 3, 4, 6}))
+    .add_answer(new DNSARR("example.com", 100, {7, 8, 9, 0}));
+  ON_CALL(server_, OnRequest("example.com", T_A))
+    .WillByDefault(SetReply(&server_, &rsp4));
+
+  size_t probes = 0;
+  struct ares_socket_functions_ex sock_funcs;
+  memset(&sock_funcs, 0, sizeof(sock_funcs));
+  sock_funcs.version      = 1;
+  sock_funcs.asocket      = probecount_socket;
+  sock_funcs.aclose       = probecount_close;
+  sock_funcs.asetsockopt  = probecount_setsockopt;
+  sock_funcs.aconnect     = probecount_connect;
+  sock_funcs.arecvfrom    = probecount_recvfrom;
+  sock_funcs.asendto      = probecount_sendto;
+  sock_funcs.agetsockname = probecount_getsockname;
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_set_socket_functions_ex(channel_, &sock_funcs, &probes));
+
+  struct ares_addrinfo_hints hints = {0, 0, 0, 0};
+  hints.ai_family = AF_INET;
+
+  AddrInfoResult result1;
+  ares_getaddrinfo(channel_, "example.com.", NULL, &hints,
+                   AddrInfoCallback, &result1);
+  Process();
+  EXPECT_TRUE(result1.done_);
+  EXPECT_EQ(ARES_SUCCESS, result1.status_);
+  EXPECT_THAT(result1.ai_, IncludesNumAddresses(3));
+  EXPECT_NE((size_t)0, probes);
+
+  // Same prefixes again, should be served entirely from the cache
+  probes = 0;
+  AddrInfoResult result2;
+  ares_getaddrinfo(channel_, "example.com.", NULL, &hints,
+                   AddrInfoCallback, &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(ARES_SUCCESS, result2.status_);
+  EXPECT_THAT(result2.ai_, IncludesNumAddresses(3));
+  EXPECT_EQ((size_t)0, probes);
+}
+#endif
+
 TEST_P(MockChannelTestAI, FamilyUnspecified) {
   DNSPacket rsp6;
   rsp6.set_response().set_aa()
@@ -805,6 +959,137 @@ TEST_P(MockUDPChannelTestAI, TriggerResendThenConnFailEDNS) {
   EXPECT_THAT(result.ai_, IncludesV6Address("2121:0000:0000:0000:0000:0000:0000:0303"));
 }
 
+class MockLongTimeoutTestAI : public MockChannelOptsTest,
+                              public ::testing::WithParamInterface<int> {
+public:
+  MockLongTimeoutTestAI()
+    : MockChannelOptsTest(1, GetParam(), false, false, FillOptions(&opts_),
+                          ARES_OPT_TIMEOUTMS)
+  {
+  }
+  static struct ares_options* FillOptions(struct ares_options * opts) {
+    memset(opts, 0, sizeof(struct ares_options));
+    opts->timeout = 5000;
+    return opts;
+  }
+ private:
+  struct ares_options opts_;
+};
+
+TEST_P(MockLongTimeoutTestAI, ResolutionDelay) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {0x01, 0x02, 0x03, 0x04}));
+
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp4));
+  // AAAA is never answered
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_AAAA))
+    .Times(1);
+
+  EXPECT_EQ(ARES_SUCCESS, ares_set_resolution_delay(channel_, 10));
+
+  AddrInfoResult result;
+  struct ares_addrinfo_hints hints = {0, 0, 0, 0};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_flags = ARES_AI_NOSORT;
+  auto tv_begin = std::chrono::steady_clock::now();
+  ares_getaddrinfo(channel_, "www.google.com.", NULL, &hints,
+                   AddrInfoCallback, &result);
+  Process();
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - tv_begin);
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_EQ(1, result.timeouts_);
+  EXPECT_THAT(result.ai_, IncludesNumAddresses(1));
+  EXPECT_THAT(result.ai_, IncludesV4Address("1.2.3.4"));
+  // Without the resolution delay the AAAA query would wait out the full 5s
+  // timeout, the 10ms delay leaves a wide margin for slow test machines
+  EXPECT_LT(elapsed.count(), 2500);
+}
+
+TEST_P(MockUDPChannelTestAI, StreamBatches) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {0x01, 0x02, 0x03, 0x04}))
+    .add_answer(new DNSARR("www.google.com", 100, {0x05, 0x06, 0x07, 0x08}));
+  DNSPacket rsp6;
+  rsp6.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_AAAA))
+    .add_answer(new DNSAaaaRR("www.google.com", 100,
+                              {0x21, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                               0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x03}));
+
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp4));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_AAAA))
+    .WillOnce(SetReply(&server_, &rsp6));
+
+  StreamResult result;
+  struct ares_addrinfo_hints hints = {0, 0, 0, 0};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_flags = ARES_AI_NOSORT;
+  ares_getaddrinfo_stream(channel_, "www.google.com.", NULL, &hints,
+                          ARES_GAI_STREAM_NONE, StreamCallback, &result);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_TRUE(result.contiguous_);
+  // One batch per response
+  EXPECT_EQ(std::vector<size_t>({2, 1}), result.batches_);
+  EXPECT_EQ(std::vector<std::string>({"1.2.3.4", "5.6.7.8", "2121::303"}),
+            result.addrs_);
+}
+
+TEST_P(MockUDPChannelTestAI, StreamFirstOnly) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {0x01, 0x02, 0x03, 0x04}));
+
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp4));
+  // AAAA is never answered, and is cancelled once the A answer arrives
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_AAAA))
+    .Times(1);
+
+  StreamResult result;
+  struct ares_addrinfo_hints hints = {0, 0, 0, 0};
+  hints.ai_family = AF_UNSPEC;
+  ares_getaddrinfo_stream(channel_, "www.google.com.", NULL, &hints,
+                          ARES_GAI_STREAM_FIRST, StreamCallback, &result);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_EQ(std::vector<std::string>({"1.2.3.4"}), result.addrs_);
+  EXPECT_EQ(0, (int)ares_queue_active_queries(channel_));
+}
+
+TEST_P(MockUDPChannelTestAI, StreamNotFound) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.google.com", T_A));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp));
+
+  StreamResult result;
+  struct ares_addrinfo_hints hints = {0, 0, 0, 0};
+  hints.ai_family = AF_INET;
+  ares_getaddrinfo_stream(channel_, "www.google.com.", NULL, &hints,
+                          ARES_GAI_STREAM_NONE, StreamCallback, &result);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_ENOTFOUND, result.status_);
+  EXPECT_TRUE(result.batches_.empty());
+}
+
 TEST_P(MockUDPChannelTestAI, ConnectionRefusedOnSearchDomainRetry) {
   DNSPacket badrsp4;
   badrsp4.set_response().set_aa()
@@ -1290,6 +1575,9 @@ INSTANTIATE_TEST_SUITE_P(AddressFamiliesAI, MockUDPChannelTestAI,
 INSTANTIATE_TEST_SUITE_P(AddressFamiliesAI, MockTCPChannelTestAI,
                         ::testing::ValuesIn(ares::test::families), PrintFamily);
 
+INSTANTIATE_TEST_SUITE_P(AddressFamiliesAI, MockLongTimeoutTestAI,
+                        ::testing::ValuesIn(ares::test::families), PrintFamily);
+
 INSTANTIATE_TEST_SUITE_P(AddressFamiliesAI, MockExtraOptsTestAI,
 			::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
 
@@ -357,6 +357,34 @@ TEST_P(MockUDPEventThreadMaxQueriesTest, GetHostByNameParallelLookups) {
   }
 }
 
+// More sockets than the event system retrieves per wait by default
+TEST_P(MockUDPEventThreadMaxQueriesTest, ManySocketsParallelLookups) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  ON_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillByDefault(SetReply(&server_, &rsp));
+
+  int rc = ARES_SUCCESS;
+  ares_set_socket_callback(channel_, SocketConnectCallback, &rc);
+  sock_cb_count = 0;
+
+  std::vector<HostResult> result(MAXUDPQUERIES_TOTAL * 4);
+  for (size_t i=0; i<result.size(); i++) {
+    ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result[i]);
+  }
+
+  Process();
+
+  EXPECT_EQ(MAXUDPQUERIES_TOTAL * 4 / MAXUDPQUERIES_LIMIT, sock_cb_count);
+
+  for (size_t i=0; i<result.size(); i++) {
+    EXPECT_TRUE(result[i].done_);
+    EXPECT_EQ(ARES_SUCCESS, result[i].status_);
+  }
+}
+
 /* This test case is likely to fail in heavily loaded environments, it was
  * there to stress the windows event system.  Not needed to be on normally */
 #if 0
@@ -949,6 +977,47 @@ TEST_P(MockEventThreadTest, V4WorksV6Timeout) {
   EXPECT_EQ("{'www.google.com' aliases=[] addrs=[1.2.3.4]}", ss.str());
 }
 
+TEST_P(MockEventThreadTest, LowLatencyMode) {
+  EXPECT_EQ(ARES_EFORMERR,
+            ares_set_event_thread_low_latency(channel_, ARES_TRUE, 2000000));
+  ares_status_t status = ares_set_event_thread_low_latency(channel_, ARES_TRUE,
+                                                           200);
+  if (status == ARES_ENOTIMP) {
+    return;
+  }
+  EXPECT_EQ(ARES_SUCCESS, status);
+
+  std::vector<byte> nothing;
+  DNSPacket reply;
+  reply.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 0x0100, {0x01, 0x02, 0x03, 0x04}));
+
+  /* First attempt times out so the retry is driven by the timer */
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReplyData(&server_, nothing))
+    .WillRepeatedly(SetReply(&server_, &reply));
+
+  HostResult result;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(1, result.timeouts_);
+  std::stringstream ss;
+  ss << result.host_;
+  EXPECT_EQ("{'www.google.com' aliases=[] addrs=[1.2.3.4]}", ss.str());
+
+  /* And back to the default behavior */
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_set_event_thread_low_latency(channel_, ARES_FALSE, 0));
+  HostResult result2;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                     &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(0, result2.timeouts_);
+}
+
 TEST_P(MockEventThreadTest, DestroyQuick) {
   /* We are not looking for any particular result as its possible (but unlikely)
    * it finished before the destroy completed. We really just want to make sure
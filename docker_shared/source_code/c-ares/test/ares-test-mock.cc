@@ -26,11 +26,17 @@
 #include "ares-test.h"
 #include "dns-proto.h"
 
+extern "C" {
+  #include "ares_private.h"
+}
+
 #ifndef WIN32
 #include <sys/types.h>
 #include <sys/stat.h>
 #endif
 
+#include <chrono>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -427,6 +433,214 @@ TEST_P(MockChannelTest, ServStateCallbackRecover) {
   ares_free_string(exp_server_string);
 }
 
+TEST_P(MockChannelTest, ServerLatencyMetrics) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  ON_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillByDefault(SetReply(&server_, &rsp));
+
+  char                 *server = ares_get_servers_csv(channel_);
+  ares_server_latency_t latency;
+
+  /* No queries yet */
+  EXPECT_EQ(ARES_ENODATA,
+            ares_get_server_latency(channel_, server,
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+  EXPECT_EQ(ARES_ENOTFOUND,
+            ares_get_server_latency(channel_, "192.0.2.1:53",
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+  EXPECT_EQ(ARES_EFORMERR,
+            ares_get_server_latency(channel_, NULL,
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_set_server_timeout_percentile(channel_, 99));
+  EXPECT_EQ(ARES_EFORMERR, ares_set_server_timeout_percentile(channel_, 101));
+
+  for (size_t i = 0; i < 5; i++) {
+    HostResult result;
+    ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                       &result);
+    Process();
+    EXPECT_TRUE(result.done_);
+    EXPECT_EQ(ARES_SUCCESS, result.status_);
+  }
+
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_get_server_latency(channel_, server,
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+  EXPECT_EQ(5, (int)latency.count);
+  EXPECT_LE(1U, latency.min_ms);
+  EXPECT_LE(latency.min_ms, latency.p50_ms);
+  EXPECT_LE(latency.p50_ms, latency.p90_ms);
+  EXPECT_LE(latency.p90_ms, latency.p99_ms);
+  EXPECT_LE(latency.p99_ms, latency.max_ms);
+  EXPECT_LE(latency.min_ms, latency.avg_ms);
+  EXPECT_LE(latency.avg_ms, latency.max_ms);
+
+  ares_free_string(server);
+}
+
+static void CountQueryCallback(void *data, ares_status_t status,
+                               size_t timeouts, const ares_dns_record_t *dnsrec)
+{
+  (void)status;
+  (void)timeouts;
+  (void)dnsrec;
+  (*(int *)data)++;
+}
+
+static void CountHostCallback(void *data, int status, int timeouts,
+                              struct hostent *hostent)
+{
+  (void)status;
+  (void)timeouts;
+  (void)hostent;
+  (*(int *)data)++;
+}
+
+TEST_P(MockChannelTest, SendBatch) {
+  DNSPacket rspa;
+  rspa.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  DNSPacket rspmx;
+  rspmx.set_response().set_aa()
+    .add_question(new DNSQuestion("google.com", T_MX))
+    .add_answer(new DNSMxRR("google.com", 100, 10, "mx.google.com"));
+  DNSPacket rspptr;
+  rspptr.set_response().set_aa()
+    .add_question(new DNSQuestion("5.4.3.2.in-addr.arpa", T_PTR))
+    .add_answer(new DNSPtrRR("5.4.3.2.in-addr.arpa", 100, "www.google.com"));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rspa));
+  EXPECT_CALL(server_, OnRequest("google.com", T_MX))
+    .WillOnce(SetReply(&server_, &rspmx));
+  EXPECT_CALL(server_, OnRequest("5.4.3.2.in-addr.arpa", T_PTR))
+    .WillOnce(SetReply(&server_, &rspptr));
+
+  QueryResult        result[2];
+  int                count = 0;
+  ares_batch_query_t queries[] = {
+    { "www.google.com", ARES_CLASS_IN, ARES_REC_TYPE_A, NULL, &result[0] },
+    { "google.com", ARES_CLASS_IN, ARES_REC_TYPE_MX, NULL, &result[1] },
+    { "5.4.3.2.in-addr.arpa", ARES_CLASS_IN, ARES_REC_TYPE_PTR,
+      CountQueryCallback, &count }
+  };
+
+  /* Shared callback required when a query doesn't have its own */
+  EXPECT_EQ(ARES_EFORMERR, ares_send_batch(channel_, queries, 3, NULL));
+  EXPECT_EQ(ARES_EFORMERR, ares_send_batch(channel_, NULL, 3, QueryCallback));
+  EXPECT_EQ(ARES_SUCCESS, ares_send_batch(channel_, NULL, 0, NULL));
+  EXPECT_EQ(0U, ares_queue_active_queries(channel_));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_send_batch(channel_, queries, 3, QueryCallback));
+  EXPECT_EQ(3U, ares_queue_active_queries(channel_));
+  Process();
+
+  for (size_t i = 0; i < 2; i++) {
+    EXPECT_TRUE(result[i].done_);
+    EXPECT_EQ(ARES_SUCCESS, result[i].status_);
+    EXPECT_EQ(0U, result[i].timeouts_);
+  }
+  EXPECT_EQ(1, count);
+}
+
+#ifdef CARES_TRACE
+static void TraceCallback(const ares_trace_event_t *event, void *user_data) {
+  std::vector<ares_trace_event_type_t> *types =
+    (std::vector<ares_trace_event_type_t> *)user_data;
+  types->push_back(event->type);
+}
+
+TEST_P(MockChannelTest, QueryTrace) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  ON_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillByDefault(SetReply(&server_, &rsp));
+
+  std::vector<ares_trace_event_type_t> cb_types;
+  ares_trace_event_t                   events[4];
+  size_t                               num_events = 0;
+  size_t                               dropped    = 0;
+
+  EXPECT_EQ(ARES_EFORMERR, ares_set_trace(NULL, 16, NULL, NULL));
+  EXPECT_EQ(ARES_SUCCESS, ares_set_trace(channel_, 16, TraceCallback,
+                                         &cb_types));
+
+  HostResult result;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                     &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+
+  /* Callback sees events in lifecycle order.  Connection flushes may happen
+   * more than once depending on the transport. */
+  EXPECT_NE(cb_types.end(), std::find(cb_types.begin(), cb_types.end(),
+                                      ARES_TRACE_CONN_FLUSH));
+  std::vector<ares_trace_event_type_t> expected = {
+    ARES_TRACE_QUERY_ENQUEUE, ARES_TRACE_QUERY_SEND, ARES_TRACE_CONN_READ,
+    ARES_TRACE_ANSWER,        ARES_TRACE_QUERY_END,  ARES_TRACE_QUERY_CALLBACK
+  };
+  std::vector<ares_trace_event_type_t> seen;
+  for (auto type : cb_types) {
+    if (std::find(expected.begin(), expected.end(), type) != expected.end()) {
+      seen.push_back(type);
+    }
+  }
+  EXPECT_EQ(expected, seen);
+
+  /* Ring drains oldest first, in batches */
+  std::vector<ares_trace_event_type_t> fetched;
+  do {
+    EXPECT_EQ(ARES_SUCCESS, ares_trace_fetch(channel_, events, 4, &num_events,
+                                             &dropped));
+    EXPECT_EQ(0, (int)dropped);
+    for (size_t i = 0; i < num_events; i++) {
+      fetched.push_back(events[i].type);
+      if (events[i].type == ARES_TRACE_ANSWER) {
+        EXPECT_NE(ARES_TRACE_NOSERVER, events[i].server);
+        EXPECT_EQ(0, (int)events[i].value);
+      }
+    }
+  } while (num_events > 0);
+  EXPECT_EQ(cb_types, fetched);
+
+  /* Overflowing the ring drops the oldest events */
+  EXPECT_EQ(ARES_SUCCESS, ares_set_trace(channel_, 2, NULL, NULL));
+  HostResult result2;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                     &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(ARES_SUCCESS, ares_trace_fetch(channel_, events, 4, &num_events,
+                                           &dropped));
+  EXPECT_EQ(2, (int)num_events);
+  EXPECT_LT(0, (int)dropped);
+  EXPECT_EQ(ARES_TRACE_QUERY_CALLBACK, events[1].type);
+  EXPECT_STREQ("QUERY_CALLBACK", ares_trace_event_type_tostr(events[1].type));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_set_trace(channel_, 0, NULL, NULL));
+  EXPECT_EQ(ARES_SUCCESS, ares_trace_fetch(channel_, events, 4, &num_events,
+                                           NULL));
+  EXPECT_EQ(0, (int)num_events);
+}
+#else
+TEST_P(MockChannelTest, QueryTraceNotImplemented) {
+  ares_trace_event_t events[4];
+  size_t             num_events = 1;
+
+  EXPECT_EQ(ARES_ENOTIMP, ares_set_trace(channel_, 16, NULL, NULL));
+  EXPECT_EQ(ARES_ENOTIMP, ares_trace_fetch(channel_, events, 4, &num_events,
+                                           NULL));
+  EXPECT_EQ(0, (int)num_events);
+}
+#endif
+
 TEST_P(MockChannelTest, ReInit) {
   DNSPacket rsp;
   rsp.set_response().set_aa()
@@ -547,6 +761,141 @@ TEST_P(CacheQueriesTest, GetHostByNameCache) {
   EXPECT_EQ(1, sock_cb_count);
 }
 
+#ifdef CARES_TRACE
+TEST_P(CacheQueriesTest, QueryTraceCacheHit) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp));
+
+  HostResult result1;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result1);
+  Process();
+  EXPECT_TRUE(result1.done_);
+
+  /* A cached answer still completes the lifecycle with a callback event */
+  std::vector<ares_trace_event_type_t> cb_types;
+  EXPECT_EQ(ARES_SUCCESS, ares_set_trace(channel_, 16, TraceCallback,
+                                         &cb_types));
+  HostResult result2;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(ARES_SUCCESS, result2.status_);
+  std::vector<ares_trace_event_type_t> expected = {
+    ARES_TRACE_QCACHE_HIT, ARES_TRACE_QUERY_CALLBACK
+  };
+  EXPECT_EQ(expected, cb_types);
+
+}
+#endif
+
+TEST_P(CacheQueriesTest, SaveLoadState) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {2, 3, 4, 5}));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsp));
+
+  HostResult result1;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result1);
+  Process();
+  EXPECT_TRUE(result1.done_);
+  EXPECT_EQ(ARES_SUCCESS, result1.status_);
+
+  TempFile state("");
+  EXPECT_EQ(ARES_SUCCESS, ares_save_state(channel_, state.filename()));
+
+  /* A fresh channel starts out with nothing */
+  ares_channel_t       *copy;
+  char                 *server = ares_get_servers_csv(channel_);
+  ares_server_latency_t latency;
+  EXPECT_EQ(ARES_SUCCESS, ares_dup(&copy, channel_));
+  EXPECT_EQ(ARES_ENODATA,
+            ares_get_server_latency(copy, server,
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_load_state(copy, state.filename()));
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_get_server_latency(copy, server,
+                                    ARES_METRICS_PERIOD_INCEPTION, &latency));
+  EXPECT_EQ(1U, latency.count);
+
+  /* Answered from the loaded cache, no second request to the server */
+  HostResult result2;
+  ares_gethostbyname(copy, "www.google.com.", AF_INET, HostCallback, &result2);
+  ProcessAltChannel(copy);
+  std::stringstream ss;
+  EXPECT_TRUE(result2.done_);
+  ss << result2.host_;
+  EXPECT_EQ("{'www.google.com' aliases=[] addrs=[2.3.4.5]}", ss.str());
+
+  TempFile garbage("not a state file");
+  EXPECT_EQ(ARES_EFILE, ares_load_state(copy, garbage.filename()));
+  EXPECT_EQ(ARES_ENOTFOUND, ares_load_state(copy, "/nonexistent/state"));
+
+  ares_free_string(server);
+  ares_destroy(copy);
+}
+
+TEST_P(CacheQueriesTest, NegativeFallbackTTL) {
+  DNSPacket rsp;
+  rsp.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.google.com", T_A));
+  // No SOA, so not cached until a fallback TTL is configured
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .Times(3)
+    .WillRepeatedly(SetReply(&server_, &rsp));
+
+  for (int i = 0; i < 4; i++) {
+    if (i == 2) {
+      EXPECT_EQ(ARES_SUCCESS, ares_set_qcache_negative_ttl(channel_, 60, 0));
+    }
+    HostResult result;
+    ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                       &result);
+    Process();
+    EXPECT_TRUE(result.done_);
+    EXPECT_EQ(ARES_ENOTFOUND, result.status_);
+  }
+}
+
+TEST_P(CacheQueriesTest, NoDataUsesSOAMinimum) {
+  DNSPacket nosoa;
+  nosoa.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A));
+  DNSPacket soa;
+  soa.set_response().set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_auth(new DNSSoaRR("example.com", 100, "ns1.example.com",
+                           "hostmaster.example.com", 1, 3600, 600, 86400, 60));
+  // NODATA without SOA is not cached, with SOA it is
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .Times(2)
+    .WillRepeatedly(SetReply(&server_, &nosoa));
+  EXPECT_CALL(server_, OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(&server_, &soa));
+
+  for (int i = 0; i < 2; i++) {
+    HostResult result1;
+    ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                       &result1);
+    Process();
+    EXPECT_TRUE(result1.done_);
+    EXPECT_EQ(ARES_ENODATA, result1.status_);
+
+    HostResult result2;
+    ares_gethostbyname(channel_, "www.example.com.", AF_INET, HostCallback,
+                       &result2);
+    Process();
+    EXPECT_TRUE(result2.done_);
+    EXPECT_EQ(ARES_ENODATA, result2.status_);
+  }
+}
+
 #define TCPPARALLELLOOKUPS 32
 TEST_P(MockTCPChannelTest, GetHostByNameParallelLookups) {
   DNSPacket rsp;
@@ -791,6 +1140,127 @@ TEST_P(MockEDNSChannelTest, RetryWithoutEDNS) {
 }
 
 
+// A record answer that notes the EDNS UDP payload size advertised by the
+// request it answers, 0 if the request had no OPT RR.
+struct DNSARRNoteUDPSize : public DNSARR {
+  DNSARRNoteUDPSize(const std::string &name, int ttl,
+                    const std::vector<byte> &addr)
+    : DNSARR(name, ttl, addr), udp_size_(-1) {}
+
+  std::vector<byte> data(const ares_dns_record_t *dnsrec) const override {
+    udp_size_ = 0;
+    for (size_t i = 0; dnsrec != nullptr &&
+         i < ares_dns_record_rr_cnt(dnsrec, ARES_SECTION_ADDITIONAL); i++) {
+      const ares_dns_rr_t *rr =
+        ares_dns_record_rr_get_const(dnsrec, ARES_SECTION_ADDITIONAL, i);
+      if (ares_dns_rr_get_type(rr) == ARES_REC_TYPE_OPT) {
+        udp_size_ = ares_dns_rr_get_u16(rr, ARES_RR_OPT_UDP_SIZE);
+      }
+    }
+    return DNSARR::data(dnsrec);
+  }
+
+  mutable int udp_size_;
+};
+
+TEST_P(MockEDNSChannelTest, RememberNoEDNS) {
+  DNSPacket rspfail;
+  rspfail.set_response().set_aa().set_rcode(FORMERR)
+    .add_question(new DNSQuestion("www.google.com", T_A));
+  DNSPacket rspok;
+  rspok.set_response()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {1, 2, 3, 4}));
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rspfail))
+    .WillOnce(SetReply(&server_, &rspok));
+  HostResult result;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+
+  // The server has been seen to reject EDNS, so the next query goes out
+  // without it rather than failing first.
+  auto answer = new DNSARRNoteUDPSize("www.example.com", 100, {1, 2, 3, 4});
+  DNSPacket rspnote;
+  rspnote.set_response()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(answer);
+  EXPECT_CALL(server_, OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(&server_, &rspnote));
+  HostResult result2;
+  ares_gethostbyname(channel_, "www.example.com.", AF_INET, HostCallback,
+                     &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(ARES_SUCCESS, result2.status_);
+  EXPECT_EQ(0, answer->udp_size_);
+}
+
+TEST_P(MockUDPChannelTest, TruncationRaisesUDPSize) {
+  std::vector<byte> nothing;
+  DNSPacket rsptruncated;
+  rsptruncated.set_response().set_aa().set_tc()
+    .add_question(new DNSQuestion("www.google.com", T_A));
+  DNSPacket rspok;
+  rspok.set_response()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 100, {1, 2, 3, 4}));
+  auto answer = new DNSARRNoteUDPSize("www.example.com", 100, {1, 2, 3, 4});
+  DNSPacket rspnote;
+  rspnote.set_response()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(answer);
+
+  // Truncation over UDP doubles the size advertised to the server
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsptruncated))
+    .WillOnce(SetReply(&server_, &rspok));
+  HostResult result;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+
+  EXPECT_CALL(server_, OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(&server_, &rspnote));
+  HostResult result2;
+  ares_gethostbyname(channel_, "www.example.com.", AF_INET, HostCallback,
+                     &result2);
+  Process();
+  EXPECT_TRUE(result2.done_);
+  EXPECT_EQ(2464, answer->udp_size_);
+
+  // A timeout at the raised size falls back to the original size for the
+  // retry, and truncation won't raise it to the failing size again
+  EXPECT_CALL(server_, OnRequest("www.example.com", T_A))
+    .WillOnce(SetReplyData(&server_, nothing))
+    .WillOnce(SetReply(&server_, &rspnote));
+  HostResult result3;
+  ares_gethostbyname(channel_, "www.example.com.", AF_INET, HostCallback,
+                     &result3);
+  Process();
+  EXPECT_TRUE(result3.done_);
+  EXPECT_EQ(1232, answer->udp_size_);
+
+  EXPECT_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillOnce(SetReply(&server_, &rsptruncated))
+    .WillOnce(SetReply(&server_, &rspok));
+  HostResult result4;
+  ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                     &result4);
+  Process();
+  EXPECT_TRUE(result4.done_);
+
+  EXPECT_CALL(server_, OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(&server_, &rspnote));
+  HostResult result5;
+  ares_gethostbyname(channel_, "www.example.com.", AF_INET, HostCallback,
+                     &result5);
+  Process();
+  EXPECT_TRUE(result5.done_);
+  EXPECT_EQ(1232, answer->udp_size_);
+}
+
 // Issue #911
 TEST_P(MockUDPChannelTest, RetryWithoutEDNSNonCompliant) {
   DNSPacket rspfail;
@@ -903,6 +1373,76 @@ CONTAINED_TEST_P(ContainedMockChannelSysConfig, SysConfigNdots0,
 #endif
 
 // Issue #858
+TEST_P(CacheQueriesTest, GetHostByAddrBatch) {
+  DNSPacket rsp4;
+  rsp4.set_response().set_aa()
+    .add_question(new DNSQuestion("5.4.3.2.in-addr.arpa", T_PTR))
+    .add_answer(new DNSPtrRR("5.4.3.2.in-addr.arpa", 100, "www.google.com"));
+  DNSPacket rsp6;
+  rsp6.set_response().set_aa()
+    .add_question(new DNSQuestion("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                                  "0.0.8.b.d.0.1.0.0.2.ip6.arpa", T_PTR))
+    .add_answer(new DNSPtrRR("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                             "8.b.d.0.1.0.0.2.ip6.arpa", 100, "www.google.com"));
+  /* Duplicates are looked up once, and later lookups come from the cache */
+  EXPECT_CALL(server_, OnRequest("5.4.3.2.in-addr.arpa", T_PTR))
+    .WillOnce(SetReply(&server_, &rsp4));
+  EXPECT_CALL(server_, OnRequest("1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0."
+                                 "0.0.8.b.d.0.1.0.0.2.ip6.arpa", T_PTR))
+    .WillOnce(SetReply(&server_, &rsp6));
+
+  ares_batch_addr_t addrs[4];
+  HostResult        result[3];
+  int               count = 0;
+  memset(addrs, 0, sizeof(addrs));
+  addrs[0].addr.family = AF_INET;
+  ares_inet_pton(AF_INET, "2.3.4.5", &addrs[0].addr.addr.addr4);
+  addrs[0].arg         = &result[0];
+  addrs[1].addr.family = AF_INET6;
+  ares_inet_pton(AF_INET6, "2001:db8::1", &addrs[1].addr.addr.addr6);
+  addrs[1].arg         = &result[1];
+  addrs[2]             = addrs[0];
+  addrs[2].arg         = &result[2];
+  addrs[3]             = addrs[0];
+  addrs[3].callback    = CountHostCallback;
+  addrs[3].arg         = &count;
+
+  EXPECT_EQ(ARES_EFORMERR, ares_gethostbyaddr_batch(channel_, addrs, 4, NULL));
+  EXPECT_EQ(ARES_EFORMERR,
+            ares_gethostbyaddr_batch(channel_, NULL, 4, HostCallback));
+  addrs[3].addr.family = AF_UNSPEC;
+  EXPECT_EQ(ARES_EFORMERR,
+            ares_gethostbyaddr_batch(channel_, addrs, 4, HostCallback));
+  addrs[3].addr.family = AF_INET;
+  EXPECT_EQ(ARES_SUCCESS, ares_gethostbyaddr_batch(channel_, NULL, 0, NULL));
+  EXPECT_EQ(0U, ares_queue_active_queries(channel_));
+
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_gethostbyaddr_batch(channel_, addrs, 4, HostCallback));
+  EXPECT_EQ(2U, ares_queue_active_queries(channel_));
+  Process();
+
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(result[i].done_);
+    EXPECT_EQ(ARES_SUCCESS, result[i].status_);
+    EXPECT_EQ("www.google.com", result[i].host_.name_);
+  }
+  EXPECT_EQ(AF_INET6, result[1].host_.addrtype_);
+  EXPECT_EQ(1, count);
+
+  /* Answered from the cache before returning */
+  HostResult cached[2];
+  addrs[0].arg = &cached[0];
+  addrs[1].arg = &cached[1];
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_gethostbyaddr_batch(channel_, addrs, 2, HostCallback));
+  for (size_t i = 0; i < 2; i++) {
+    EXPECT_TRUE(cached[i].done_);
+    EXPECT_EQ(ARES_SUCCESS, cached[i].status_);
+    EXPECT_EQ("www.google.com", cached[i].host_.name_);
+  }
+}
+
 TEST_P(CacheQueriesTest, BlankName) {
   DNSPacket rsp;
   rsp.set_response().set_aa()
@@ -1152,6 +1692,122 @@ TEST_P(MockChannelTest, SearchHighNdots) {
             ss.str());
 }
 
+class MockParallelSearchChannelTest : public MockFlagsChannelOptsTest {
+ public:
+  MockParallelSearchChannelTest()
+    : MockFlagsChannelOptsTest(ARES_FLAG_PARALLEL_SEARCH) {}
+};
+
+TEST_P(MockParallelSearchChannelTest, FirstNameWins) {
+  DNSPacket yesfirst;
+  yesfirst.set_response().set_aa()
+    .add_question(new DNSQuestion("www.first.com", T_A))
+    .add_answer(new DNSARR("www.first.com", 0x0200, {1, 2, 3, 4}));
+  EXPECT_CALL(server_, OnRequest("www.first.com", T_A))
+    .WillOnce(SetReply(&server_, &yesfirst));
+  // Remaining names are sent at the same time, but their answers are not used
+  DNSPacket yessecond;
+  yessecond.set_response().set_aa()
+    .add_question(new DNSQuestion("www.second.org", T_A))
+    .add_answer(new DNSARR("www.second.org", 0x0200, {2, 3, 4, 5}));
+  EXPECT_CALL(server_, OnRequest("www.second.org", T_A))
+    .Times(testing::AtMost(1))
+    .WillRepeatedly(SetReply(&server_, &yessecond));
+  DNSPacket nothird;
+  nothird.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.third.gov", T_A));
+  EXPECT_CALL(server_, OnRequest("www.third.gov", T_A))
+    .Times(testing::AtMost(1))
+    .WillRepeatedly(SetReply(&server_, &nothird));
+  DNSPacket nobare;
+  nobare.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www", T_A));
+  EXPECT_CALL(server_, OnRequest("www", T_A))
+    .Times(testing::AtMost(1))
+    .WillRepeatedly(SetReply(&server_, &nobare));
+
+  SearchResult result;
+  ares_search(channel_, "www", C_IN, T_A, SearchCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  std::stringstream ss;
+  ss << PacketToString(result.data_);
+  EXPECT_EQ("RSP QRY AA NOERROR Q:{'www.first.com' IN A} "
+            "A:{'www.first.com' IN A TTL=512 1.2.3.4}",
+            ss.str());
+}
+
+TEST_P(MockParallelSearchChannelTest, WaitsForEarlierName) {
+  // The first name only answers after a timeout, by which time the later
+  // names have all answered.  The result must still be the one a serial
+  // search would have returned.
+  DNSPacket nofirst;
+  nofirst.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.first.com", T_A));
+  EXPECT_CALL(server_, OnRequest("www.first.com", T_A))
+    .WillOnce(SetReplyData(&server_, std::vector<byte>()))
+    .WillOnce(SetReply(&server_, &nofirst));
+  DNSPacket yessecond;
+  yessecond.set_response().set_aa()
+    .add_question(new DNSQuestion("www.second.org", T_A))
+    .add_answer(new DNSARR("www.second.org", 0x0200, {2, 3, 4, 5}));
+  EXPECT_CALL(server_, OnRequest("www.second.org", T_A))
+    .WillOnce(SetReply(&server_, &yessecond));
+  DNSPacket yesthird;
+  yesthird.set_response().set_aa()
+    .add_question(new DNSQuestion("www.third.gov", T_A))
+    .add_answer(new DNSARR("www.third.gov", 0x0200, {3, 4, 5, 6}));
+  EXPECT_CALL(server_, OnRequest("www.third.gov", T_A))
+    .WillOnce(SetReply(&server_, &yesthird));
+  DNSPacket nobare;
+  nobare.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www", T_A));
+  EXPECT_CALL(server_, OnRequest("www", T_A))
+    .WillOnce(SetReply(&server_, &nobare));
+
+  SearchResult result;
+  ares_search(channel_, "www", C_IN, T_A, SearchCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_LT(0, result.timeouts_);
+  std::stringstream ss;
+  ss << PacketToString(result.data_);
+  EXPECT_EQ("RSP QRY AA NOERROR Q:{'www.second.org' IN A} "
+            "A:{'www.second.org' IN A TTL=512 2.3.4.5}",
+            ss.str());
+}
+
+TEST_P(MockParallelSearchChannelTest, NoDataThenFail) {
+  DNSPacket nofirst;
+  nofirst.set_response().set_aa()
+    .add_question(new DNSQuestion("www.first.com", T_A));
+  ON_CALL(server_, OnRequest("www.first.com", T_A))
+    .WillByDefault(SetReply(&server_, &nofirst));
+  DNSPacket nosecond;
+  nosecond.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.second.org", T_A));
+  ON_CALL(server_, OnRequest("www.second.org", T_A))
+    .WillByDefault(SetReply(&server_, &nosecond));
+  DNSPacket nothird;
+  nothird.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www.third.gov", T_A));
+  ON_CALL(server_, OnRequest("www.third.gov", T_A))
+    .WillByDefault(SetReply(&server_, &nothird));
+  DNSPacket nobare;
+  nobare.set_response().set_aa().set_rcode(NXDOMAIN)
+    .add_question(new DNSQuestion("www", T_A));
+  ON_CALL(server_, OnRequest("www", T_A))
+    .WillByDefault(SetReply(&server_, &nobare));
+
+  SearchResult result;
+  ares_search(channel_, "www", C_IN, T_A, SearchCallback, &result);
+  Process();
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_ENODATA, result.status_);
+}
+
 // Test that performing an EDNS search with an OPT RR options value works. The
 // options value should be included on the requests to the mock server.
 // We are going to do this only via TCP since this won't include the dynamically
@@ -2202,6 +2858,33 @@ TEST_P(MockChannelTest, HostAliasUnreadable) {
 }
 #endif
 
+TEST_P(MockChannelTest, QueryPoolSteadyState) {
+  /* TTL of 0 so nothing is answered from the query cache */
+  DNSPacket reply;
+  reply.set_response().set_aa()
+    .add_question(new DNSQuestion("www.google.com", T_A))
+    .add_answer(new DNSARR("www.google.com", 0, {0x01, 0x02, 0x03, 0x04}));
+  ON_CALL(server_, OnRequest("www.google.com", T_A))
+    .WillByDefault(SetReply(&server_, &reply));
+
+  size_t mallocs = 0;
+  for (size_t i = 0; i < 10; i++) {
+    HostResult result;
+    ares_gethostbyname(channel_, "www.google.com.", AF_INET, HostCallback,
+                       &result);
+    Process();
+    EXPECT_TRUE(result.done_);
+    EXPECT_EQ(ARES_SUCCESS, result.status_);
+    if (i == 0) {
+      mallocs = ares_pool_mallocs(channel_->query_pool);
+      EXPECT_NE((size_t)0, mallocs);
+    }
+  }
+
+  /* Once warmed up, queries reuse the objects of the ones before them */
+  EXPECT_EQ(mallocs, ares_pool_mallocs(channel_->query_pool));
+}
+
 class MockMultiServerChannelTest
   : public MockChannelOptsTest,
     public ::testing::WithParamInterface< std::pair<int, bool> > {
@@ -2276,6 +2959,216 @@ TEST_P(NoRotateMultiMockTest, ThirdServer) {
   CheckExample();
 }
 
+class ServFailCacheMultiMockTest : public MockMultiServerChannelTest {
+ public:
+  ServFailCacheMultiMockTest()
+    : MockMultiServerChannelTest(FillOptions(&opts_),
+                                 ARES_OPT_NOROTATE | ARES_OPT_QUERY_CACHE) {}
+  static struct ares_options* FillOptions(struct ares_options * opts) {
+    memset(opts, 0, sizeof(struct ares_options));
+    opts->qcache_max_ttl = 3600;
+    return opts;
+  }
+ private:
+  struct ares_options opts_;
+};
+
+TEST_P(ServFailCacheMultiMockTest, ServFailCache) {
+  DNSPacket servfailrsp;
+  servfailrsp.set_response().set_aa().set_rcode(SERVFAIL)
+    .add_question(new DNSQuestion("www.example.com", T_A));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_set_qcache_negative_ttl(channel_, 0, 30));
+  EXPECT_EQ(ARES_EFORMERR, ares_set_qcache_negative_ttl(channel_, 0, 301));
+
+  // Each server is only asked once, retries skip servers that already failed
+  // the question and the second lookup never reaches the network.
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[0].get(), &servfailrsp));
+  EXPECT_CALL(*servers_[1], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[1].get(), &servfailrsp));
+  EXPECT_CALL(*servers_[2], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[2].get(), &servfailrsp));
+
+  for (int i = 0; i < 2; i++) {
+    QueryResult result;
+    ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                      ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+    Process();
+    EXPECT_TRUE(result.done_);
+    EXPECT_EQ(ARES_ESERVFAIL, result.status_);
+  }
+}
+
+TEST_P(NoRotateMultiMockTest, ServerSelectP2C) {
+  DNSPacket okrsp;
+  okrsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(new DNSARR("www.example.com", 100, {2,3,4,5}));
+
+  EXPECT_EQ(ARES_EFORMERR,
+            ares_set_server_selection(channel_, (ares_server_select_t)99));
+  EXPECT_EQ(ARES_SUCCESS,
+            ares_set_server_selection(channel_, ARES_SERVER_SELECT_P2C));
+
+  // Without latency data the outstanding query count drives selection, so a
+  // burst of queries is spread over every server rather than all going to
+  // the first one.
+  for (size_t i = 0; i < servers_.size(); i++) {
+    EXPECT_CALL(*servers_[i], OnRequest("www.example.com", T_A))
+      .Times(testing::AtLeast(5))
+      .WillRepeatedly(SetReply(servers_[i].get(), &okrsp));
+  }
+
+  QueryResult result[30];
+  for (size_t i = 0; i < 30; i++) {
+    ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                      ARES_REC_TYPE_A, QueryCallback, &result[i], NULL);
+  }
+  Process();
+
+  for (size_t i = 0; i < 30; i++) {
+    EXPECT_TRUE(result[i].done_);
+    EXPECT_EQ(ARES_SUCCESS, result[i].status_);
+  }
+}
+
+TEST_P(NoRotateMultiMockTest, QueryHedging) {
+  std::vector<byte> nothing;
+  DNSPacket okrsp;
+  okrsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(new DNSARR("www.example.com", 100, {2,3,4,5}));
+
+  EXPECT_EQ(ARES_EFORMERR, ares_set_query_hedging(channel_, 101, 10));
+  EXPECT_EQ(ARES_EFORMERR, ares_set_query_hedging(channel_, 95, 0));
+  EXPECT_EQ(ARES_EFORMERR, ares_set_query_hedging(channel_, 95, 101));
+  EXPECT_EQ(ARES_SUCCESS, ares_set_query_hedging(channel_, 95, 100));
+
+  // The first server answers enough queries to establish its latency, then
+  // stops answering.  The next query should be hedged to the second server
+  // long before it would have timed out.
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .Times(10)
+    .WillRepeatedly(SetReply(servers_[0].get(), &okrsp))
+    .RetiresOnSaturation();
+  for (size_t i = 0; i < 10; i++) {
+    QueryResult result;
+    ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                      ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+    Process();
+    EXPECT_TRUE(result.done_);
+  }
+
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReplyData(servers_[0].get(), nothing));
+  EXPECT_CALL(*servers_[1], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[1].get(), &okrsp));
+  EXPECT_CALL(*servers_[2], OnRequest("www.example.com", T_A)).Times(0);
+
+  // Answered by the hedge: without it the query would first have to time out
+  // on the first server before being retried on the second
+  QueryResult result;
+  ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                    ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_EQ(0U, result.timeouts_);
+}
+
+TEST_P(NoRotateMultiMockTest, QueryHedgingOriginalAnswersWithCookie) {
+  std::vector<byte> nothing;
+  std::vector<byte> server_cookie = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  DNSPacket okrsp;
+  okrsp.set_response().set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(new DNSARR("www.example.com", 100, {2,3,4,5}))
+    .add_additional(new DNSOptRR(0, 0, 0, 1280, { }, server_cookie, false));
+
+  EXPECT_EQ(ARES_SUCCESS, ares_set_query_hedging(channel_, 95, 100));
+
+  // Establish the first server's latency, and that it supports cookies.
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .Times(10)
+    .WillRepeatedly(SetReply(servers_[0].get(), &okrsp))
+    .RetiresOnSaturation();
+  for (size_t i = 0; i < 10; i++) {
+    QueryResult result;
+    ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                      ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+    Process();
+    EXPECT_TRUE(result.done_);
+  }
+
+  // The first server only answers once the hedge has reached the second
+  // server, which never answers.  The answer echoes the client cookie the
+  // first server was sent, not the one sent with the hedge, and must still be
+  // accepted.
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReplyHeld(servers_[0].get(), &okrsp));
+  EXPECT_CALL(*servers_[1], OnRequest("www.example.com", T_A))
+    .WillOnce(DoAll(SetReplyData(servers_[1].get(), nothing),
+                    SendHeldReply(servers_[0].get())));
+
+  QueryResult result;
+  ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                    ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_EQ(0U, result.timeouts_);
+
+  // Cookies are only sent over UDP
+  if (!GetParam().second) {
+    size_t len;
+    const unsigned char *returned_cookie =
+      fetch_server_cookie(result.dnsrec_.dnsrec_, &len);
+    EXPECT_EQ(server_cookie.size(), len);
+    EXPECT_TRUE(returned_cookie != NULL &&
+                memcmp(server_cookie.data(), returned_cookie, len) == 0);
+  }
+}
+
+TEST_P(NoRotateMultiMockTest, FailoverRestoresEDNS) {
+  // Forcing TCP replaces the channel flags, so EDNS isn't in use
+  if (GetParam().second) {
+    return;
+  }
+
+  DNSPacket rspfail;
+  rspfail.set_response().set_aa().set_rcode(FORMERR)
+    .add_question(new DNSQuestion("www.example.com", T_A));
+  DNSPacket servfailrsp;
+  servfailrsp.set_response().set_aa().set_rcode(SERVFAIL)
+    .add_question(new DNSQuestion("www.example.com", T_A));
+  auto answer = new DNSARRNoteUDPSize("www.example.com", 100, {1, 2, 3, 4});
+  DNSPacket rspnote;
+  rspnote.set_response().set_aa()
+    .add_question(new DNSQuestion("www.example.com", T_A))
+    .add_answer(answer);
+
+  // The first server rejects EDNS, and then fails the retry without it.  The
+  // second server supports EDNS, so the query that fails over to it must
+  // still carry the OPT RR.
+  EXPECT_CALL(*servers_[0], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[0].get(), &rspfail))
+    .WillOnce(SetReply(servers_[0].get(), &servfailrsp));
+  EXPECT_CALL(*servers_[1], OnRequest("www.example.com", T_A))
+    .WillOnce(SetReply(servers_[1].get(), &rspnote));
+
+  QueryResult result;
+  ares_query_dnsrec(channel_, "www.example.com.", ARES_CLASS_IN,
+                    ARES_REC_TYPE_A, QueryCallback, &result, NULL);
+  Process();
+
+  EXPECT_TRUE(result.done_);
+  EXPECT_EQ(ARES_SUCCESS, result.status_);
+  EXPECT_EQ(1232, answer->udp_size_);
+}
+
 TEST_P(NoRotateMultiMockTest, ServerNoResponseFailover) {
   std::vector<byte> nothing;
   DNSPacket okrsp;
@@ -2585,7 +3478,10 @@ INSTANTIATE_TEST_SUITE_P(AddressFamilies, MockNoCheckRespChannelTest, ::testing:
 
 INSTANTIATE_TEST_SUITE_P(AddressFamilies, MockEDNSChannelTest, ::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
 
+INSTANTIATE_TEST_SUITE_P(AddressFamilies, MockParallelSearchChannelTest, ::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
+
 INSTANTIATE_TEST_SUITE_P(TransportModes, NoRotateMultiMockTest, ::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
+INSTANTIATE_TEST_SUITE_P(TransportModes, ServFailCacheMultiMockTest, ::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
 
 INSTANTIATE_TEST_SUITE_P(TransportModes, ServerFailoverOptsMultiMockTest, ::testing::ValuesIn(ares::test::families_modes), PrintFamilyMode);
 
@@ -128,6 +128,88 @@ TEST_F(LibraryTest, ParseTxtEmpty) {
   ares_dns_record_destroy(dnsrec); dnsrec = NULL;
 }
 
+TEST_F(LibraryTest, ParseTxtMultiString) {
+  DNSPacket pkt;
+  std::string expected1 = "v=DKIM1; k=rsa; ";
+  std::string expected2 = "";
+  std::string expected3 = "p=MIGfMA0GCSqGSIb3DQEBAQUAA4GNADCBiQKBgQ";
+  pkt.set_qid(0x1234).set_response().set_aa()
+    .add_question(new DNSQuestion("example.com", T_TXT))
+    .add_answer(new DNSTxtRR("example.com", 100,
+                             {expected1, expected2, expected3}));
+  std::vector<byte> data = pkt.data();
+
+  ares_dns_record_t   *dnsrec = NULL;
+  ares_dns_rr_t       *rr     = NULL;
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_parse(data.data(), data.size(), 0, &dnsrec));
+  rr = ares_dns_record_rr_get(dnsrec, ARES_SECTION_ANSWER, 0);
+  ASSERT_NE(nullptr, rr);
+
+  size_t txtdata_len;
+  const unsigned char *txtdata;
+
+  /* Each member is individually NULL terminated */
+  EXPECT_EQ(3, ares_dns_rr_get_abin_cnt(rr, ARES_RR_TXT_DATA));
+  txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 0, &txtdata_len);
+  EXPECT_EQ(expected1, std::string((const char *)txtdata));
+  EXPECT_EQ(expected1.size(), txtdata_len);
+  txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 1, &txtdata_len);
+  EXPECT_EQ(0, txtdata_len);
+  EXPECT_NE(nullptr, txtdata);
+  txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 2, &txtdata_len);
+  EXPECT_EQ(expected3, std::string((const char *)txtdata));
+  EXPECT_EQ(nullptr, ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 3, &txtdata_len));
+
+  txtdata = ares_dns_rr_get_bin(rr, ARES_RR_TXT_DATA, &txtdata_len);
+  EXPECT_EQ(expected1 + expected3, std::string((const char *)txtdata));
+  EXPECT_EQ(expected1.size() + expected3.size(), txtdata_len);
+
+  /* Modifications must be reflected in the combined value */
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_rr_del_abin(rr, ARES_RR_TXT_DATA, 0));
+  EXPECT_EQ(ARES_EFORMERR, ares_dns_rr_del_abin(rr, ARES_RR_TXT_DATA, 2));
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_rr_add_abin(rr, ARES_RR_TXT_DATA,
+                                               (const unsigned char *)"xyz", 3));
+  EXPECT_EQ(3, ares_dns_rr_get_abin_cnt(rr, ARES_RR_TXT_DATA));
+  txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 1, &txtdata_len);
+  EXPECT_EQ(expected3, std::string((const char *)txtdata));
+  txtdata = ares_dns_rr_get_bin(rr, ARES_RR_TXT_DATA, &txtdata_len);
+  EXPECT_EQ(expected3 + "xyz", std::string((const char *)txtdata, txtdata_len));
+
+  /* Single member is returned as-is */
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_rr_del_abin(rr, ARES_RR_TXT_DATA, 0));
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_rr_del_abin(rr, ARES_RR_TXT_DATA, 1));
+  txtdata = ares_dns_rr_get_bin(rr, ARES_RR_TXT_DATA, &txtdata_len);
+  EXPECT_EQ(expected3, std::string((const char *)txtdata));
+
+  /* Writing it back out and parsing gives the same strings */
+  unsigned char *msg = NULL;
+  size_t         msglen = 0;
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_write(dnsrec, &msg, &msglen));
+  ares_dns_record_destroy(dnsrec); dnsrec = NULL;
+  EXPECT_EQ(ARES_SUCCESS, ares_dns_parse(msg, msglen, 0, &dnsrec));
+  ares_free_string(msg);
+  rr = ares_dns_record_rr_get(dnsrec, ARES_SECTION_ANSWER, 0);
+  ASSERT_NE(nullptr, rr);
+  EXPECT_EQ(1, ares_dns_rr_get_abin_cnt(rr, ARES_RR_TXT_DATA));
+  txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, 0, &txtdata_len);
+  EXPECT_EQ(expected3, std::string((const char *)txtdata, txtdata_len));
+
+  /* Appending a member of the same RR to itself, the parsed storage is sized
+   * exactly so this has to grow the buffer the value points into */
+  for (size_t i = 0; i < 4; i++) {
+    txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, i, &txtdata_len);
+    EXPECT_EQ(ARES_SUCCESS,
+              ares_dns_rr_add_abin(rr, ARES_RR_TXT_DATA, txtdata, txtdata_len));
+  }
+  EXPECT_EQ(5, ares_dns_rr_get_abin_cnt(rr, ARES_RR_TXT_DATA));
+  for (size_t i = 0; i < 5; i++) {
+    txtdata = ares_dns_rr_get_abin(rr, ARES_RR_TXT_DATA, i, &txtdata_len);
+    EXPECT_EQ(expected3, std::string((const char *)txtdata, txtdata_len));
+  }
+
+  ares_dns_record_destroy(dnsrec); dnsrec = NULL;
+}
+
 TEST_F(LibraryTest, ParseTxtMalformedReply1) {
   std::vector<byte> data = {
     0x12, 0x34,  // qid
@@ -52,6 +52,10 @@ extern "C" {
 #ifdef HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
+#include <fcntl.h>
+#ifdef HAVE_SYS_IOCTL_H
+#  include <sys/ioctl.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -443,8 +447,10 @@ void DefaultChannelModeTest::Process(unsigned int cancel_ms) {
 }
 
 MockServer::MockServer(int family, unsigned short port)
-  : udpport_(port), tcpport_(port), qid_(-1) {
+  : udpport_(port), tcpport_(port), qid_(-1), hold_reply_(false),
+    held_fd_(ARES_SOCKET_BAD), held_addrlen_(0) {
   reply_ = nullptr;
+  memset(&held_addr_, 0, sizeof(held_addr_));
   // Create a TCP socket to receive data on.
   tcp_data_ = NULL;
   tcp_data_len_ = 0;
@@ -706,7 +712,6 @@ void MockServer::ProcessRequest(ares_socket_t fd, struct sockaddr_storage* addr,
 
   /* DNS 0x20 will mix case, do case-insensitive matching of name in request */
   char lower_name[256];
-  int flags = 0;
 
   arestest_strtolower(lower_name, name, sizeof(lower_name));
 
@@ -748,6 +753,33 @@ void MockServer::ProcessRequest(ares_socket_t fd, struct sockaddr_storage* addr,
     reply[0] = (byte)((qid >> 8) & 0xff);
     reply[1] = (byte)(qid & 0xff);
   }
+
+  if (hold_reply_) {
+    hold_reply_   = false;
+    held_fd_      = fd;
+    held_addrlen_ = addrlen;
+    held_reply_   = reply;
+    if (addr != nullptr) {
+      memcpy(&held_addr_, addr, sizeof(held_addr_));
+    }
+    return;
+  }
+
+  SendReply(fd, addr, addrlen, reply);
+}
+
+void MockServer::SendHeldReply() {
+  if (held_reply_.size() == 0) {
+    return;
+  }
+  SendReply(held_fd_, &held_addr_, held_addrlen_, held_reply_);
+  held_reply_.clear();
+}
+
+void MockServer::SendReply(ares_socket_t fd, struct sockaddr_storage* addr,
+                           ares_socklen_t addrlen, std::vector<byte> reply) {
+  int flags = 0;
+
   if (verbose) {
     std::cerr << "sending reply " << PacketToString(reply)
               << " on port " << ((fd == udpfd_) ? udpport_ : tcpport_)
@@ -1303,6 +1335,60 @@ TempFile::TempFile(const std::string& contents)
 
 }
 
+// Need to put this in own function due to nested lambda bug
+// in VS2013. (C2888)
+static int configure_socket(ares_socket_t s) {
+  // transposed from ares-process, simplified non-block setter.
+#if defined(USE_BLOCKING_SOCKETS)
+  return 0; /* returns success */
+#elif defined(HAVE_FCNTL_O_NONBLOCK)
+  /* most recent unix versions */
+  int flags;
+  flags = fcntl(s, F_GETFL, 0);
+  return fcntl(s, F_SETFL, flags | O_NONBLOCK);
+#elif defined(HAVE_IOCTL_FIONBIO)
+  /* older unix versions */
+  int flags = 1;
+  return ioctl(s, FIONBIO, &flags);
+#elif defined(HAVE_IOCTLSOCKET_FIONBIO)
+#ifdef WATT32
+  char flags = 1;
+#else
+  /* Windows */
+  unsigned long flags = 1UL;
+#endif
+  return ioctlsocket(s, (long)FIONBIO, &flags);
+#elif defined(HAVE_IOCTLSOCKET_CAMEL_FIONBIO)
+  /* Amiga */
+  long flags = 1L;
+  return IoctlSocket(s, FIONBIO, flags);
+#elif defined(HAVE_SETSOCKOPT_SO_NONBLOCK)
+  /* BeOS */
+  long b = 1L;
+  return setsockopt(s, SOL_SOCKET, SO_NONBLOCK, &b, sizeof(b));
+#else
+#  error "no non-blocking method was found/used/set"
+#endif
+}
+
+const struct ares_socket_functions VirtualizeIO::default_functions = {
+  [](int af, int type, int protocol, void *) -> ares_socket_t {
+    auto s = ::socket(af, type, protocol);
+    if (s == ARES_SOCKET_BAD) {
+      return s;
+    }
+    if (configure_socket(s) != 0) {
+      sclose(s);
+      return ares_socket_t(-1);
+    }
+    return s;
+  },
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
 VirtualizeIO::VirtualizeIO(ares_channel_t *c)
   : channel_(c)
 {
@@ -284,6 +284,16 @@ public:
     qid_ = qid;
   }
 
+  // Set the reply to be sent next, but hold it back until SendHeldReply() is
+  // called rather than answering straight away.
+  void SetReplyHeld(const DNSPacket *reply)
+  {
+    SetReply(reply);
+    hold_reply_ = true;
+  }
+
+  void SendHeldReply();
+
   void Disconnect()
   {
     reply_ = nullptr;
@@ -319,6 +329,8 @@ private:
                                 ares_socklen_t addrlen, const std::vector<byte> &req,
                                 const std::string &reqstr, int qid, const char *name,
                                 int rrtype);
+  void           SendReply(ares_socket_t fd, struct sockaddr_storage *addr,
+                           ares_socklen_t addrlen, std::vector<byte> reply);
   void           ProcessPacket(ares_socket_t fd, struct sockaddr_storage *addr,
                                ares_socklen_t addrlen, byte *data, int len);
   unsigned short udpport_;
@@ -330,6 +342,11 @@ private:
   const DNSPacket        *reply_;
   std::string             expected_request_;
   int                     qid_;
+  bool                    hold_reply_;
+  ares_socket_t           held_fd_;
+  struct sockaddr_storage held_addr_;
+  ares_socklen_t          held_addrlen_;
+  std::vector<byte>       held_reply_;
   unsigned char          *tcp_data_;
   size_t                  tcp_data_len_;
 };
@@ -490,6 +507,17 @@ ACTION_P2(SetReplyQID, mockserver, qid)
   mockserver->SetReplyQID(qid);
 }
 
+ACTION_P2(SetReplyHeld, mockserver, reply)
+{
+  mockserver->SetReplyHeld(reply);
+}
+
+// gMock action to send the reply a mock server has been holding back.
+ACTION_P(SendHeldReply, mockserver)
+{
+  mockserver->SendHeldReply();
+}
+
 // gMock action to cancel a channel.
 ACTION_P2(CancelChannel, mockserver, channel)
 {